@@ -484,6 +484,16 @@ HEADERS += src/qt/bitcoingui.h \
     src/init.h \
     src/mruset.h \
     src/utiltime.h \
+    src/blockencodings.h \
+    src/arith_uint256.h \
+    src/logging.h \
+    src/blockfilter.h \
+    src/walletscan.h \
+    src/walletjournal.h \
+    src/jupiterpod.h \
+    src/ipfspool.h \
+    src/bootstrap.h \
+    src/blockstore.h \
     src/openssl_compat.h \
     src/json/json_spirit_writer_template.h \
     src/json/json_spirit_writer.h \
@@ -603,6 +613,16 @@ SOURCES += src/qt/bitcoin.cpp src/qt/bitcoingui.cpp \
     src/addrman.cpp \
     src/db.cpp \
     src/utiltime.cpp \
+    src/blockencodings.cpp \
+    src/arith_uint256.cpp \
+    src/allocators.cpp \
+    src/logging.cpp \
+    src/blockfilter.cpp \
+    src/walletscan.cpp \
+    src/jupiterpod.cpp \
+    src/ipfspool.cpp \
+    src/bootstrap.cpp \
+    src/blockstore.cpp \
     src/eccryptoverify.cpp \
     src/walletdb.cpp \
     src/qt/clientmodel.cpp \
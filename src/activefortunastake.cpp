@@ -191,11 +191,12 @@ bool CActiveFortunastake::Dseep(CTxIn vin, CService service, CKey keyFortunastak
 
     // Update Last Seen timestamp in fortunastake list
     bool found = false;
-    for (CFortunaStake& mn : vecFortunastakes) {
-        //printf(" -- %s\n", mn.vin.ToString().c_str());
-        if(mn.vin == vin) {
+    {
+        LOCK(cs_fortunastakes);
+        CFortunaStake* pmn = vecFortunastakes.Find(vin);
+        if (pmn) {
             found = true;
-            mn.UpdateLastSeen();
+            pmn->UpdateLastSeen();
         }
     }
 
@@ -278,33 +279,20 @@ bool CActiveFortunastake::Register(CTxIn vin, CService service, CKey keyCollater
         return false;
     }
 
-    bool found = false;
-    bool dup = false;
     LOCK(cs_fortunastakes);
-    for (CFortunaStake& mn : vecFortunastakes)
-    {
-        if(mn.pubkey == pubKeyCollateralAddress) {
-            dup = true;
-        }
-    }
-    if (dup) {
+    const CFortunastakeList& list = vecFortunastakes;
+    if (list.FindByPubKey(pubKeyCollateralAddress)) {
         retErrorMessage = "Failed, FS already in list you wookie, use a different pubkey";
         printf("CActiveFortunastake::Register() FAILED! FS Already in List. Change your collateral address to a different address for this FS.\n", retErrorMessage.c_str());
         return false;
     }
-    for (CFortunaStake& mn : vecFortunastakes)
-    {
-        if(mn.vin == vin) {
-            printf("Found FS VIN in FortunaStakes List\n");
-            found = true;
-        }
-    }
-
-    if(!found) {
+    if (list.Find(vin)) {
+        printf("Found FS VIN in FortunaStakes List\n");
+    } else {
         printf("CActiveFortunastake::Register() - Adding to fortunastake list service: %s - vin: %s\n", service.ToString().c_str(), vin.ToString().c_str());
         CFortunaStake mn(service, vin, pubKeyCollateralAddress, vchFortunaStakeSignature, masterNodeSignatureTime, pubKeyFortunastake, PROTOCOL_VERSION);
         mn.UpdateLastSeen(masterNodeSignatureTime);
-        vecFortunastakes.push_back(mn);
+        vecFortunastakes.Add(mn);
     }
 
     //send to all peers
@@ -353,15 +341,9 @@ bool CActiveFortunastake::GetFortunaStakeVin(CTxIn& vin, CPubKey& pubkey, CKey&
             return false;
         }
         //Check the list
-        bool dup = false;
         LOCK(cs_fortunastakes);
-        BOOST_FOREACH(CFortunaStake& mn, vecFortunastakes)
-        {
-            if(mn.pubkey == pubkey) {
-                dup = true;
-            }
-        }
-        if (dup) {
+        const CFortunastakeList& list = vecFortunastakes;
+        if (list.FindByPubKey(pubkey)) {
             printf("CActiveFortunastake::Register() FAILED! FS ALREADY IN LIST.\n");
             return false;
         }
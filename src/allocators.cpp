@@ -0,0 +1,169 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "allocators.h"
+
+#include <atomic>
+#include <new>
+#include <set>
+#include <vector>
+
+static const unsigned int POOL_CLASSES = 15;                // POOL_MIN_SIZE << 14 == POOL_MAX_SIZE
+static const size_t POOL_CLASS_BYTES = 256 * 1024;          // cached per size and thread
+
+static inline unsigned int PoolClass(size_t nSize)
+{
+    unsigned int nClass = 0;
+    for (size_t nClassSize = POOL_MIN_SIZE; nClassSize < nSize; nClassSize <<= 1)
+        nClass++;
+    return nClass;
+}
+
+static inline size_t PoolClassSize(unsigned int nClass)
+{
+    return POOL_MIN_SIZE << nClass;
+}
+
+// Counters are written by the owning thread only, atomic so that
+// GetPoolAllocatorStats can read them from another
+class CPoolCache
+{
+public:
+    std::vector<void*> vFree[POOL_CLASSES];
+    std::atomic<uint64_t> nAllocs;
+    std::atomic<uint64_t> nPoolHits;
+    std::atomic<uint64_t> nFrees;
+    std::atomic<uint64_t> nPoolReturns;
+    std::atomic<uint64_t> nCachedBytes;
+
+    CPoolCache();
+    ~CPoolCache();
+
+    static void Count(std::atomic<uint64_t>& n, uint64_t nAdd)
+    {
+        n.store(n.load(std::memory_order_relaxed) + nAdd, std::memory_order_relaxed);
+    }
+};
+
+class CPoolRegistry
+{
+public:
+    boost::mutex mutex;
+    std::set<CPoolCache*> setCaches;
+    CPoolAllocatorStats retired;    // counts of the threads that exited
+};
+
+static CPoolRegistry& GetPoolRegistry()
+{
+    static CPoolRegistry registry;
+    return registry;
+}
+
+CPoolCache::CPoolCache() : nAllocs(0), nPoolHits(0), nFrees(0), nPoolReturns(0), nCachedBytes(0)
+{
+    CPoolRegistry& registry = GetPoolRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    registry.setCaches.insert(this);
+}
+
+CPoolCache::~CPoolCache()
+{
+    for (unsigned int i = 0; i < POOL_CLASSES; i++)
+        for (unsigned int j = 0; j < vFree[i].size(); j++)
+            ::operator delete(vFree[i][j]);
+
+    CPoolRegistry& registry = GetPoolRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    registry.setCaches.erase(this);
+    registry.retired.nAllocs += nAllocs.load(std::memory_order_relaxed);
+    registry.retired.nPoolHits += nPoolHits.load(std::memory_order_relaxed);
+    registry.retired.nFrees += nFrees.load(std::memory_order_relaxed);
+    registry.retired.nPoolReturns += nPoolReturns.load(std::memory_order_relaxed);
+}
+
+// The cache of a thread is reached through a plain pointer, buffers freed
+// after the thread local destructors ran (in global destructors, say) go
+// straight back to the heap
+static thread_local CPoolCache* pcache = NULL;
+static thread_local bool fCacheDestroyed = false;
+
+class CPoolCacheOwner
+{
+public:
+    ~CPoolCacheOwner()
+    {
+        delete pcache;
+        pcache = NULL;
+        fCacheDestroyed = true;
+    }
+};
+static thread_local CPoolCacheOwner cacheOwner;
+
+static CPoolCache* GetPoolCache()
+{
+    if (pcache == NULL && !fCacheDestroyed)
+    {
+        (void)&cacheOwner;  // registers the destructor of this thread
+        pcache = new CPoolCache();
+    }
+    return pcache;
+}
+
+void* PoolAllocate(size_t nSize)
+{
+    CPoolCache* pool = nSize <= POOL_MAX_SIZE ? GetPoolCache() : NULL;
+    if (pool == NULL)
+        return ::operator new(nSize);
+
+    unsigned int nClass = PoolClass(nSize);
+    CPoolCache::Count(pool->nAllocs, 1);
+    std::vector<void*>& vFree = pool->vFree[nClass];
+    if (!vFree.empty())
+    {
+        void* p = vFree.back();
+        vFree.pop_back();
+        CPoolCache::Count(pool->nPoolHits, 1);
+        CPoolCache::Count(pool->nCachedBytes, -(int64_t)PoolClassSize(nClass));
+        return p;
+    }
+    return ::operator new(PoolClassSize(nClass));
+}
+
+void PoolDeallocate(void* p, size_t nSize)
+{
+    CPoolCache* pool = nSize <= POOL_MAX_SIZE ? GetPoolCache() : NULL;
+    if (pool == NULL)
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    unsigned int nClass = PoolClass(nSize);
+    size_t nClassSize = PoolClassSize(nClass);
+    CPoolCache::Count(pool->nFrees, 1);
+    std::vector<void*>& vFree = pool->vFree[nClass];
+    if (vFree.size() * nClassSize < POOL_CLASS_BYTES || vFree.size() < 2)
+    {
+        vFree.push_back(p);
+        CPoolCache::Count(pool->nPoolReturns, 1);
+        CPoolCache::Count(pool->nCachedBytes, nClassSize);
+        return;
+    }
+    ::operator delete(p);
+}
+
+void GetPoolAllocatorStats(CPoolAllocatorStats& stats)
+{
+    CPoolRegistry& registry = GetPoolRegistry();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    stats = registry.retired;
+    for (std::set<CPoolCache*>::iterator it = registry.setCaches.begin(); it != registry.setCaches.end(); ++it)
+    {
+        stats.nAllocs += (*it)->nAllocs.load(std::memory_order_relaxed);
+        stats.nPoolHits += (*it)->nPoolHits.load(std::memory_order_relaxed);
+        stats.nFrees += (*it)->nFrees.load(std::memory_order_relaxed);
+        stats.nPoolReturns += (*it)->nPoolReturns.load(std::memory_order_relaxed);
+        stats.nCachedBytes += (*it)->nCachedBytes.load(std::memory_order_relaxed);
+    }
+}
@@ -7,6 +7,9 @@
 
 #include <string.h>
 #include <string>
+#include <limits>
+#include <type_traits>
+#include <stdint.h>
 #include <boost/thread/mutex.hpp>
 #include <map>
 #include <openssl/crypto.h> // for OPENSSL_cleanse()
@@ -265,6 +268,82 @@ struct zero_after_free_allocator : public std::allocator<T>
     }
 };
 
+/** Buffers of up to POOL_MAX_SIZE bytes are kept for reuse in a cache per
+ *  thread, by power of two size. A buffer freed on another thread than it
+ *  was allocated on goes to the cache of the freeing thread. */
+static const size_t POOL_MIN_SIZE = 64;
+static const size_t POOL_MAX_SIZE = 1 << 20;
+
+void* PoolAllocate(size_t nSize);
+void PoolDeallocate(void* p, size_t nSize);
+
+class CPoolAllocatorStats
+{
+public:
+    uint64_t nAllocs;
+    uint64_t nPoolHits;     // allocations served from a thread cache
+    uint64_t nFrees;
+    uint64_t nPoolReturns;  // frees kept in a thread cache
+    uint64_t nCachedBytes;
+
+    CPoolAllocatorStats() : nAllocs(0), nPoolHits(0), nFrees(0), nPoolReturns(0), nCachedBytes(0) {}
+};
+
+void GetPoolAllocatorStats(CPoolAllocatorStats& stats);
+
+//
+// Allocator of serialization buffers, takes them from the thread cache.
+// Buffers are only cleared when freed by an allocator made with
+// fZeroOnFree, such as that of CSecureDataStream. The policy travels
+// with the buffer on copy, move and swap.
+//
+template<typename T>
+struct pool_allocator
+{
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+    template<typename _Other> struct rebind
+    { typedef pool_allocator<_Other> other; };
+
+    bool fZeroOnFree;
+
+    pool_allocator(bool fZeroOnFreeIn = false) throw() : fZeroOnFree(fZeroOnFreeIn) {}
+    template <typename U>
+    pool_allocator(const pool_allocator<U>& a) throw() : fZeroOnFree(a.fZeroOnFree) {}
+
+    T* allocate(std::size_t n, const void* hint = 0)
+    {
+        return static_cast<T*>(PoolAllocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if (p == NULL)
+            return;
+        if (fZeroOnFree)
+            memset(p, 0, sizeof(T) * n);
+        PoolDeallocate(p, n * sizeof(T));
+    }
+
+    std::size_t max_size() const throw()
+    {
+        return std::numeric_limits<std::size_t>::max() / sizeof(T);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const pool_allocator<T>& a, const pool_allocator<U>& b) { return a.fZeroOnFree == b.fZeroOnFree; }
+template<typename T, typename U>
+bool operator!=(const pool_allocator<T>& a, const pool_allocator<U>& b) { return a.fZeroOnFree != b.fZeroOnFree; }
+
 // This is exactly like std::string, but with a custom allocator.
 typedef std::basic_string<char, std::char_traits<char>, secure_allocator<char> > SecureString;
 
@@ -0,0 +1,189 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_ARITH_UINT256_H
+#define BITCOIN_ARITH_UINT256_H
+
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+class uint256;
+
+class uint_error : public std::runtime_error
+{
+public:
+    explicit uint_error(const std::string& str) : std::runtime_error(str) {}
+};
+
+/** Unsigned 256-bit integer with multiply, divide and the compact
+ *  difficulty encoding, for target, trust and stake weight math. Values
+ *  live in place, nothing is allocated. Arithmetic wraps modulo 2^256. */
+class arith_uint256
+{
+protected:
+    enum { WIDTH = 8 };
+    uint32_t pn[WIDTH];
+
+public:
+    arith_uint256()
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    arith_uint256(uint64_t b)
+    {
+        pn[0] = (uint32_t)b;
+        pn[1] = (uint32_t)(b >> 32);
+        for (int i = 2; i < WIDTH; i++)
+            pn[i] = 0;
+    }
+
+    explicit arith_uint256(const std::string& str)
+    {
+        SetHex(str);
+    }
+
+    bool operator!() const
+    {
+        for (int i = 0; i < WIDTH; i++)
+            if (pn[i] != 0)
+                return false;
+        return true;
+    }
+
+    const arith_uint256 operator~() const
+    {
+        arith_uint256 ret;
+        for (int i = 0; i < WIDTH; i++)
+            ret.pn[i] = ~pn[i];
+        return ret;
+    }
+
+    const arith_uint256 operator-() const
+    {
+        arith_uint256 ret = ~(*this);
+        ++ret;
+        return ret;
+    }
+
+    arith_uint256& operator=(uint64_t b)
+    {
+        *this = arith_uint256(b);
+        return *this;
+    }
+
+    arith_uint256& operator^=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] ^= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator&=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] &= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator|=(const arith_uint256& b)
+    {
+        for (int i = 0; i < WIDTH; i++)
+            pn[i] |= b.pn[i];
+        return *this;
+    }
+
+    arith_uint256& operator<<=(unsigned int shift);
+    arith_uint256& operator>>=(unsigned int shift);
+
+    arith_uint256& operator+=(const arith_uint256& b)
+    {
+        uint64_t carry = 0;
+        for (int i = 0; i < WIDTH; i++)
+        {
+            uint64_t n = carry + pn[i] + b.pn[i];
+            pn[i] = n & 0xffffffff;
+            carry = n >> 32;
+        }
+        return *this;
+    }
+
+    arith_uint256& operator-=(const arith_uint256& b)
+    {
+        *this += -b;
+        return *this;
+    }
+
+    arith_uint256& operator*=(uint32_t b32);
+    arith_uint256& operator*=(const arith_uint256& b);
+    /** Throws uint_error on division by zero */
+    arith_uint256& operator/=(const arith_uint256& b);
+
+    arith_uint256& operator++()
+    {
+        int i = 0;
+        while (i < WIDTH && ++pn[i] == 0)
+            i++;
+        return *this;
+    }
+
+    arith_uint256& operator--()
+    {
+        int i = 0;
+        while (i < WIDTH && --pn[i] == (uint32_t)-1)
+            i++;
+        return *this;
+    }
+
+    int CompareTo(const arith_uint256& b) const;
+    bool EqualTo(uint64_t b) const;
+
+    friend inline const arith_uint256 operator+(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) += b; }
+    friend inline const arith_uint256 operator-(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) -= b; }
+    friend inline const arith_uint256 operator*(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) *= b; }
+    friend inline const arith_uint256 operator/(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) /= b; }
+    friend inline const arith_uint256 operator*(const arith_uint256& a, uint32_t b) { return arith_uint256(a) *= b; }
+    friend inline const arith_uint256 operator|(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) |= b; }
+    friend inline const arith_uint256 operator&(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) &= b; }
+    friend inline const arith_uint256 operator^(const arith_uint256& a, const arith_uint256& b) { return arith_uint256(a) ^= b; }
+    friend inline const arith_uint256 operator>>(const arith_uint256& a, int shift) { return arith_uint256(a) >>= shift; }
+    friend inline const arith_uint256 operator<<(const arith_uint256& a, int shift) { return arith_uint256(a) <<= shift; }
+    friend inline bool operator==(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) == 0; }
+    friend inline bool operator!=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) != 0; }
+    friend inline bool operator>(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) > 0; }
+    friend inline bool operator<(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) < 0; }
+    friend inline bool operator>=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) >= 0; }
+    friend inline bool operator<=(const arith_uint256& a, const arith_uint256& b) { return a.CompareTo(b) <= 0; }
+    friend inline bool operator==(const arith_uint256& a, uint64_t b) { return a.EqualTo(b); }
+    friend inline bool operator!=(const arith_uint256& a, uint64_t b) { return !a.EqualTo(b); }
+
+    double getdouble() const;
+    std::string GetHex() const;
+    void SetHex(const std::string& str);
+    std::string ToString() const;
+
+    /** Position of the highest bit set plus one, 0 for zero */
+    unsigned int bits() const;
+
+    uint64_t GetLow64() const
+    {
+        return pn[0] | (uint64_t)pn[1] << 32;
+    }
+
+    /** The compact encoding of nBits: a 1 byte size in bytes, a sign bit and
+     *  a 23 bit mantissa. The result is the magnitude, pfNegative is set for
+     *  a nonzero value with the sign bit and pfOverflow for values that do not
+     *  fit in 256 bits, as CBigNum::SetCompact would read them. */
+    arith_uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL);
+    uint32_t GetCompact(bool fNegative = false) const;
+
+    friend uint256 ArithToUint256(const arith_uint256& a);
+    friend arith_uint256 UintToArith256(const uint256& a);
+};
+
+uint256 ArithToUint256(const arith_uint256& a);
+arith_uint256 UintToArith256(const uint256& a);
+
+#endif // BITCOIN_ARITH_UINT256_H
@@ -0,0 +1,141 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "hash.h"
+
+#include <limits>
+#include <unordered_map>
+
+using namespace std;
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block)
+{
+    header.nVersion = block.nVersion;
+    header.hashPrevBlock = block.hashPrevBlock;
+    header.hashMerkleRoot = block.hashMerkleRoot;
+    header.nTime = block.nTime;
+    header.nBits = block.nBits;
+    header.nNonce = block.nNonce;
+    header.vchBlockSig = block.vchBlockSig;
+    nNonce = GetRand(std::numeric_limits<uint64_t>::max());
+
+    // The coinbase and coinstake are new to everyone
+    unsigned int nPrefilled = std::min(block.vtx.size(), (size_t)(block.IsProofOfStake() ? 2 : 1));
+    for (unsigned int i = 0; i < nPrefilled; i++)
+    {
+        CPrefilledTransaction prefilled;
+        prefilled.nIndex = i;
+        prefilled.tx = block.vtx[i];
+        vPrefilledTxn.push_back(prefilled);
+    }
+
+    uint64_t k0, k1;
+    GetShortIDKey(k0, k1);
+    vShortTxIDs.reserve(block.vtx.size() - nPrefilled);
+    for (unsigned int i = nPrefilled; i < block.vtx.size(); i++)
+        vShortTxIDs.push_back(GetShortID(k0, k1, block.vtx[i].GetHash()));
+}
+
+void CBlockHeaderAndShortTxIDs::GetShortIDKey(uint64_t& k0, uint64_t& k1) const
+{
+    uint256 hashBlock = header.GetHash();
+    uint256 hashKey = Hash(BEGIN(hashBlock), END(hashBlock), BEGIN(nNonce), END(nNonce));
+    k0 = hashKey.Get64(0);
+    k1 = hashKey.Get64(1);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortID(uint64_t k0, uint64_t k1, const uint256& txhash)
+{
+    return SipHash(k0, k1, txhash.begin(), sizeof(txhash));
+}
+
+ReadStatus CPartialBlock::Init(const CBlockHeaderAndShortTxIDs& cmpctblock, const CTxMemPool& pool)
+{
+    static const size_t nMinTxSize = ::GetSerializeSize(CTransaction(), SER_NETWORK, PROTOCOL_VERSION);
+    size_t nTx = cmpctblock.BlockTxCount();
+    if (!cmpctblock.header.vtx.empty() || nTx == 0 || nTx > MAX_BLOCK_SIZE / nMinTxSize)
+        return READ_STATUS_INVALID;
+
+    block = cmpctblock.header;
+    block.vtx.resize(nTx);
+    vHave.assign(nTx, false);
+    nTimeReceived = GetTime();
+
+    int nLastIndex = -1;
+    for (const CPrefilledTransaction& prefilled : cmpctblock.vPrefilledTxn)
+    {
+        if ((int)prefilled.nIndex <= nLastIndex || prefilled.nIndex >= nTx || prefilled.tx.IsNull())
+            return READ_STATUS_INVALID;
+        nLastIndex = prefilled.nIndex;
+        block.vtx[prefilled.nIndex] = prefilled.tx;
+        vHave[prefilled.nIndex] = true;
+    }
+
+    // Short IDs take the slots left, in order
+    unordered_map<uint64_t, unsigned int> mapShortIDs;
+    mapShortIDs.reserve(cmpctblock.vShortTxIDs.size());
+    unsigned int nSlot = 0;
+    for (uint64_t nShortID : cmpctblock.vShortTxIDs)
+    {
+        while (vHave[nSlot])
+            nSlot++;
+        // Two transactions of the block with one short ID, fetch it whole
+        if (!mapShortIDs.insert(make_pair(nShortID, nSlot)).second)
+            return READ_STATUS_FAILED;
+        nSlot++;
+    }
+
+    // A slot two mempool transactions match is left to fetch
+    uint64_t k0, k1;
+    cmpctblock.GetShortIDKey(k0, k1);
+    vector<bool> vCollided(nTx, false);
+    size_t nFound = 0;
+    {
+        LOCK(pool.cs);
+        for (map<uint256, CTransaction>::const_iterator mi = pool.mapTx.begin(); mi != pool.mapTx.end() && nFound < mapShortIDs.size(); ++mi)
+        {
+            unordered_map<uint64_t, unsigned int>::iterator it = mapShortIDs.find(CBlockHeaderAndShortTxIDs::GetShortID(k0, k1, mi->first));
+            if (it == mapShortIDs.end() || vCollided[it->second])
+                continue;
+            if (vHave[it->second])
+            {
+                block.vtx[it->second].SetNull();
+                vHave[it->second] = false;
+                vCollided[it->second] = true;
+                nFound--;
+                continue;
+            }
+            block.vtx[it->second] = mi->second;
+            vHave[it->second] = true;
+            nFound++;
+        }
+    }
+    return READ_STATUS_OK;
+}
+
+void CPartialBlock::GetMissing(vector<unsigned int>& vIndexes) const
+{
+    vIndexes.clear();
+    for (unsigned int i = 0; i < vHave.size(); i++)
+        if (!vHave[i])
+            vIndexes.push_back(i);
+}
+
+ReadStatus CPartialBlock::Fill(const vector<CTransaction>& vtxMissing)
+{
+    unsigned int nNext = 0;
+    for (unsigned int i = 0; i < vHave.size(); i++)
+    {
+        if (vHave[i])
+            continue;
+        if (nNext >= vtxMissing.size())
+            return READ_STATUS_INVALID;
+        block.vtx[i] = vtxMissing[nNext++];
+        vHave[i] = true;
+    }
+    if (nNext != vtxMissing.size())
+        return READ_STATUS_INVALID;
+    return READ_STATUS_OK;
+}
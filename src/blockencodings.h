@@ -0,0 +1,110 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BLOCKENCODINGS_H
+#define BITCOIN_BLOCKENCODINGS_H
+
+#include "main.h"
+
+/** Compact block relay version we speak, sent at the end of the version
+ *  message. Peers sending 0 or nothing get blocks announced by inv. */
+static const uint64_t COMPACT_BLOCKS_VERSION = 1;
+/** Blocks deeper than this get sent whole for getblocktxn */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Seconds other peers announcing a block being rebuilt wait to be asked for it */
+static const int64_t COMPACT_BLOCK_TIMEOUT = 10;
+
+/** A transaction sent along in a compact block, the coinbase and the
+ *  coinstake always are */
+class CPrefilledTransaction
+{
+public:
+    unsigned int nIndex;
+    CTransaction tx;
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(VARINT(nIndex));
+        READWRITE(tx);
+    )
+};
+
+/** cmpctblock: a block as its header and signature, the prefilled
+ *  transactions and a short ID for every other one. Short IDs are SipHash of
+ *  the txid keyed by the block hash and a nonce, so they differ per message. */
+class CBlockHeaderAndShortTxIDs
+{
+public:
+    CBlock header;      // no transactions, keeps vchBlockSig
+    uint64_t nNonce;
+    std::vector<uint64_t> vShortTxIDs;
+    std::vector<CPrefilledTransaction> vPrefilledTxn;
+
+    CBlockHeaderAndShortTxIDs() : nNonce(0) {}
+    CBlockHeaderAndShortTxIDs(const CBlock& block);
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(header);
+        READWRITE(nNonce);
+        READWRITE(vShortTxIDs);
+        READWRITE(vPrefilledTxn);
+    )
+
+    size_t BlockTxCount() const { return vShortTxIDs.size() + vPrefilledTxn.size(); }
+
+    /** The SipHash key of the short IDs of this message */
+    void GetShortIDKey(uint64_t& k0, uint64_t& k1) const;
+    static uint64_t GetShortID(uint64_t k0, uint64_t k1, const uint256& txhash);
+};
+
+/** getblocktxn: the transactions a compact block left us missing */
+class CBlockTransactionsRequest
+{
+public:
+    uint256 hashBlock;
+    std::vector<unsigned int> vIndexes;
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(hashBlock);
+        READWRITE(vIndexes);
+    )
+};
+
+/** blocktxn: the answer to getblocktxn, in the order asked */
+class CBlockTransactions
+{
+public:
+    uint256 hashBlock;
+    std::vector<CTransaction> vtx;
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(hashBlock);
+        READWRITE(vtx);
+    )
+};
+
+enum ReadStatus
+{
+    READ_STATUS_OK,
+    READ_STATUS_INVALID,    // the peer sent something malformed
+    READ_STATUS_FAILED,     // could not rebuild the block, fetch it whole
+};
+
+/** A block being rebuilt from a compact block and the mempool */
+class CPartialBlock
+{
+public:
+    CBlock block;
+    std::vector<bool> vHave;
+    int64_t nTimeReceived;
+
+    ReadStatus Init(const CBlockHeaderAndShortTxIDs& cmpctblock, const CTxMemPool& pool);
+    void GetMissing(std::vector<unsigned int>& vIndexes) const;
+    /** Fills in the transactions asked for, in the order of GetMissing */
+    ReadStatus Fill(const std::vector<CTransaction>& vtxMissing);
+};
+
+#endif // BITCOIN_BLOCKENCODINGS_H
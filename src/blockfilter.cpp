@@ -0,0 +1,195 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "hash.h"
+#include "script.h"
+#include "version.h"
+
+#include <algorithm>
+
+using namespace std;
+
+bool fBlockFilterIndex = true;
+
+
+// (x * n) >> 64 without a 128 bit type
+static uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+    uint64_t x_hi = x >> 32, x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32, n_lo = n & 0xFFFFFFFF;
+
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    return ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+}
+
+static void HashElements(const uint256& hashBlock, uint64_t nRange, const GCSElementSet& setElements, vector<uint64_t>& vHashes)
+{
+    uint64_t k0 = hashBlock.Get64(0);
+    uint64_t k1 = hashBlock.Get64(1);
+    vHashes.clear();
+    vHashes.reserve(setElements.size());
+    BOOST_FOREACH(const GCSElement& element, setElements)
+        vHashes.push_back(MapIntoRange(SipHash(k0, k1, element.empty() ? NULL : &element[0], element.size()), nRange));
+    sort(vHashes.begin(), vHashes.end());
+}
+
+/** Writes bits most significant first */
+class CBitWriter
+{
+public:
+    explicit CBitWriter(vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    void Write(uint64_t nData, int nBits)
+    {
+        while (nBits > 0)
+        {
+            int nTake = std::min(8 - nOffset, nBits);
+            nBuffer |= ((nData >> (nBits - nTake)) & ((1U << nTake) - 1)) << (8 - nOffset - nTake);
+            nOffset += nTake;
+            nBits -= nTake;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+
+private:
+    vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset;
+};
+
+class CBitReader
+{
+public:
+    explicit CBitReader(const vector<unsigned char>& vchIn) : vch(vchIn), nPos(0), nBuffer(0), nOffset(8), fEOF(false) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t nData = 0;
+        while (nBits > 0)
+        {
+            if (nOffset == 8)
+            {
+                if (nPos >= vch.size())
+                {
+                    fEOF = true;
+                    return nData << nBits;
+                }
+                nBuffer = vch[nPos++];
+                nOffset = 0;
+            }
+            int nTake = std::min(8 - nOffset, nBits);
+            nData = (nData << nTake) | ((nBuffer >> (8 - nOffset - nTake)) & ((1U << nTake) - 1));
+            nOffset += nTake;
+            nBits -= nTake;
+        }
+        return nData;
+    }
+
+    bool IsEOF() const { return fEOF; }
+
+private:
+    const vector<unsigned char>& vch;
+    size_t nPos;
+    uint8_t nBuffer;
+    int nOffset;
+    bool fEOF;
+};
+
+static void GolombRiceEncode(CBitWriter& writer, uint8_t P, uint64_t x)
+{
+    // Quotient in unary, then the remainder in P bits
+    uint64_t q = x >> P;
+    while (q > 0)
+    {
+        int nBits = q <= 64 ? (int)q : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+    writer.Write(x, P);
+}
+
+static uint64_t GolombRiceDecode(CBitReader& reader, uint8_t P)
+{
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        q++;
+    uint64_t r = reader.Read(P);
+    return (q << P) + r;
+}
+
+void AddBlockFilterScript(const CScript& script, GCSElementSet& setElements)
+{
+    if (script.empty() || script[0] == OP_RETURN)
+        return;
+    setElements.insert(GCSElement(script.begin(), script.end()));
+}
+
+CBlockFilter::CBlockFilter(const uint256& hashBlockIn, const GCSElementSet& setElements) :
+    hashBlock(hashBlockIn), nElements(setElements.size())
+{
+    vector<uint64_t> vHashes;
+    HashElements(hashBlock, (uint64_t)nElements * BLOCK_FILTER_M, setElements, vHashes);
+
+    CBitWriter writer(vchFilter);
+    uint64_t nLast = 0;
+    BOOST_FOREACH(uint64_t nHash, vHashes)
+    {
+        GolombRiceEncode(writer, BLOCK_FILTER_P, nHash - nLast);
+        nLast = nHash;
+    }
+    writer.Flush();
+}
+
+bool CBlockFilter::MatchAny(const GCSElementSet& setElements) const
+{
+    if (nElements == 0 || setElements.empty())
+        return false;
+
+    vector<uint64_t> vQuery;
+    HashElements(hashBlock, (uint64_t)nElements * BLOCK_FILTER_M, setElements, vQuery);
+
+    // Both sides are sorted, walk them together
+    CBitReader reader(vchFilter);
+    uint64_t nValue = 0;
+    vector<uint64_t>::const_iterator it = vQuery.begin();
+    for (uint32_t i = 0; i < nElements; i++)
+    {
+        nValue += GolombRiceDecode(reader, BLOCK_FILTER_P);
+        if (reader.IsEOF())
+            return true;    // truncated filter, let the caller look at the block
+        while (it != vQuery.end() && *it < nValue)
+            ++it;
+        if (it == vQuery.end())
+            return false;
+        if (*it == nValue)
+            return true;
+    }
+    return false;
+}
+
+std::vector<unsigned char> CBlockFilter::GetEncoded() const
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ss, nElements);
+    std::vector<unsigned char> vch(ss.begin(), ss.end());
+    vch.insert(vch.end(), vchFilter.begin(), vchFilter.end());
+    return vch;
+}
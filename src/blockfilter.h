@@ -0,0 +1,57 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <set>
+#include <vector>
+
+class CScript;
+
+/** Golomb-Rice parameter and false positive rate of BIP158 basic filters */
+static const uint8_t BLOCK_FILTER_P = 19;
+static const uint64_t BLOCK_FILTER_M = 784931;
+/** Filters sent for one getcfilters message */
+static const unsigned int MAX_GETCFILTERS_SIZE = 1000;
+
+typedef std::vector<unsigned char> GCSElement;
+typedef std::set<GCSElement> GCSElementSet;
+
+/** Builds and stores a filter for every block connected, set by -blockfilterindex */
+extern bool fBlockFilterIndex;
+
+/** Adds a script to the elements of a block filter. Empty and OP_RETURN
+ *  scripts are left out. */
+void AddBlockFilterScript(const CScript& script, GCSElementSet& setElements);
+
+/** BIP158 basic filter of a block: a Golomb-coded set of the scripts of the
+ *  outputs it creates and of the outputs it spends, keyed by the block hash. */
+class CBlockFilter
+{
+public:
+    uint256 hashBlock;
+    uint32_t nElements;
+    std::vector<unsigned char> vchFilter;   // Golomb-Rice coded deltas of the sorted element hashes
+
+    CBlockFilter() : hashBlock(0), nElements(0) {}
+    CBlockFilter(const uint256& hashBlockIn, const GCSElementSet& setElements);
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(hashBlock);
+        READWRITE(nElements);
+        READWRITE(vchFilter);
+    )
+
+    /** True if any element may be in the block, false if none is */
+    bool MatchAny(const GCSElementSet& setElements) const;
+
+    /** The filter as BIP158 serializes it, N followed by the coded set */
+    std::vector<unsigned char> GetEncoded() const;
+};
+
+#endif // BITCOIN_BLOCKFILTER_H
@@ -0,0 +1,197 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockstore.h"
+#include "util.h"
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+CBlockFileCache blockFileCache;
+
+boost::filesystem::path BlockFilePath(unsigned int nFile)
+{
+    string strBlockFn = strprintf("blk%04u.dat", nFile);
+    return GetDataDir() / strBlockFn;
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    if (pData != NULL)
+    {
+        munmap((void*)pData, nSize);
+        blockFileCache.nBytesMapped -= nSize;
+    }
+#endif
+}
+
+CBlockFileCache::CBlockFileCache() : nReads(0), nCacheHits(0), nRemaps(0), nBytesMapped(0)
+{
+    // Block files are allowed to grow to 2GB each, don't map them into a 32 bit address space
+#if defined(WIN32)
+    nMaxFiles = 0;
+#else
+    nMaxFiles = sizeof(void*) >= 8 ? DEFAULT_BLOCKFILE_CACHE : 0;
+#endif
+}
+
+CBlockFileCache::~CBlockFileCache()
+{
+    Clear();
+}
+
+void CBlockFileCache::SetMaxFiles(unsigned int nMaxFilesIn)
+{
+    LOCK(cs_blockfiles);
+#if defined(WIN32)
+    nMaxFilesIn = 0;
+#else
+    if (sizeof(void*) < 8)
+        nMaxFilesIn = 0;
+#endif
+    nMaxFiles = nMaxFilesIn;
+    while (mapFiles.size() > nMaxFiles)
+        EraseFile(lruFiles.back());
+}
+
+void CBlockFileCache::Clear()
+{
+    LOCK(cs_blockfiles);
+    mapFiles.clear();
+    lruFiles.clear();
+}
+
+void CBlockFileCache::Invalidate(unsigned int nFile)
+{
+    LOCK(cs_blockfiles);
+    EraseFile(nFile);
+}
+
+unsigned int CBlockFileCache::GetOpenFiles()
+{
+    LOCK(cs_blockfiles);
+    return mapFiles.size();
+}
+
+void CBlockFileCache::EraseFile(unsigned int nFile)
+{
+    map<unsigned int, entry_type>::iterator mi = mapFiles.find(nFile);
+    if (mi == mapFiles.end())
+        return;
+    lruFiles.erase(mi->second.second);
+    mapFiles.erase(mi);
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockFileCache::MapFile(unsigned int nFile)
+{
+#ifdef WIN32
+    return std::shared_ptr<const CMappedBlockFile>();
+#else
+    int fd = open(BlockFilePath(nFile).string().c_str(), O_RDONLY);
+    if (fd < 0)
+        return std::shared_ptr<const CMappedBlockFile>();
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return std::shared_ptr<const CMappedBlockFile>();
+    }
+
+    size_t nSize = st.st_size;
+    void* pData = mmap(NULL, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pData == MAP_FAILED)
+    {
+        printf("CBlockFileCache::MapFile() : mmap of blk%04u.dat failed, errno %d\n", nFile, errno);
+        return std::shared_ptr<const CMappedBlockFile>();
+    }
+
+    // Block reads jump all over the file, readahead only wastes page cache
+    madvise(pData, nSize, MADV_RANDOM);
+
+    nBytesMapped += nSize;
+    return std::make_shared<const CMappedBlockFile>(nFile, (const char*)pData, nSize);
+#endif
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockFileCache::GetFile(unsigned int nFile, size_t nMinSize)
+{
+    LOCK(cs_blockfiles);
+
+    map<unsigned int, entry_type>::iterator mi = mapFiles.find(nFile);
+    if (mi != mapFiles.end())
+    {
+        if (mi->second.first->nSize >= nMinSize)
+        {
+            nCacheHits++;
+            lruFiles.splice(lruFiles.begin(), lruFiles, mi->second.second);
+            return mi->second.first;
+        }
+
+        // The file has been appended to since it was mapped
+        EraseFile(nFile);
+        nRemaps++;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapping = MapFile(nFile);
+    if (!mapping || mapping->nSize < nMinSize)
+        return std::shared_ptr<const CMappedBlockFile>();
+
+    lruFiles.push_front(nFile);
+    mapFiles[nFile] = make_pair(mapping, lruFiles.begin());
+    while (mapFiles.size() > nMaxFiles)
+        EraseFile(lruFiles.back());
+
+    return mapping;
+}
+
+bool CBlockFileCache::ReadBlockSpan(unsigned int nFile, unsigned int nBlockPos, CBlockFileSpan& span)
+{
+    if (!IsEnabled() || nFile < 1 || nFile == (unsigned int)-1 || nBlockPos < sizeof(unsigned int))
+        return false;
+    nReads++;
+
+    // WriteToDisk stores the serialized size just in front of the block
+    std::shared_ptr<const CMappedBlockFile> mapping = GetFile(nFile, nBlockPos);
+    if (!mapping)
+        return false;
+
+    unsigned int nSize;
+    memcpy(&nSize, mapping->pData + nBlockPos - sizeof(nSize), sizeof(nSize));
+    if (nSize == 0 || nSize > MAX_SIZE)
+        return false;
+
+    size_t nEnd = (size_t)nBlockPos + nSize;
+    if (nEnd > mapping->nSize && !(mapping = GetFile(nFile, nEnd)))
+        return false;
+
+    span.mapping = mapping;
+    span.pbegin = mapping->pData + nBlockPos;
+    span.pend = span.pbegin + nSize;
+    return true;
+}
+
+bool CBlockFileCache::ReadTxSpan(unsigned int nFile, unsigned int nTxPos, CBlockFileSpan& span)
+{
+    if (!IsEnabled() || nFile < 1 || nFile == (unsigned int)-1)
+        return false;
+    nReads++;
+
+    std::shared_ptr<const CMappedBlockFile> mapping = GetFile(nFile, (size_t)nTxPos + 1);
+    if (!mapping)
+        return false;
+
+    span.mapping = mapping;
+    span.pbegin = mapping->pData + nTxPos;
+    span.pend = mapping->pData + mapping->nSize;
+    return true;
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKSTORE_H
+#define BITCOIN_BLOCKSTORE_H
+
+#include "serialize.h"
+#include "sync.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+static const unsigned int DEFAULT_BLOCKFILE_CACHE = 8;
+
+/** One blk????.dat file mapped read-only into memory.
+ *
+ * Mappings are shared: a CBlockFileSpan holds a reference, so a file that is
+ * evicted from the cache (or remapped because it grew) stays valid until the
+ * last reader lets go of it.
+ */
+class CMappedBlockFile
+{
+public:
+    unsigned int nFile;
+    const char* pData;
+    size_t nSize;
+
+    CMappedBlockFile(unsigned int nFileIn, const char* pDataIn, size_t nSizeIn) : nFile(nFileIn), pData(pDataIn), nSize(nSizeIn) {}
+    ~CMappedBlockFile();
+
+private:
+    CMappedBlockFile(const CMappedBlockFile&);
+    CMappedBlockFile& operator=(const CMappedBlockFile&);
+};
+
+/** A byte range inside a mapped block file. */
+class CBlockFileSpan
+{
+public:
+    std::shared_ptr<const CMappedBlockFile> mapping;
+    const char* pbegin;
+    const char* pend;
+
+    CBlockFileSpan() : pbegin(NULL), pend(NULL) {}
+
+    bool IsNull() const { return pbegin == NULL; }
+    size_t size() const { return pend - pbegin; }
+
+    template<typename T>
+    bool Read(T& obj, int nType, int nVersion) const
+    {
+        if (IsNull())
+            return false;
+        CBufferReader reader(pbegin, pend, nType, nVersion);
+        reader >> obj;
+        return true;
+    }
+};
+
+/** LRU cache of memory mapped block files.
+ *
+ * Replaces fopen+fseek per block read with a lookup in a small set of
+ * mappings. Blocks are located through the size field WriteToDisk stores in
+ * front of every block, transactions by their absolute offset.
+ */
+class CBlockFileCache
+{
+public:
+    std::atomic<uint64_t> nReads;
+    std::atomic<uint64_t> nCacheHits;
+    std::atomic<uint64_t> nRemaps;
+    std::atomic<uint64_t> nBytesMapped;
+
+    CBlockFileCache();
+    ~CBlockFileCache();
+
+    /** Number of files kept mapped, 0 disables the cache */
+    void SetMaxFiles(unsigned int nMaxFilesIn);
+    unsigned int GetMaxFiles() const { return nMaxFiles; }
+    bool IsEnabled() const { return nMaxFiles > 0; }
+
+    /** Span of the serialized block starting at nBlockPos */
+    bool ReadBlockSpan(unsigned int nFile, unsigned int nBlockPos, CBlockFileSpan& span);
+
+    /** Span from nTxPos to the end of the file; the reader stops at the end of the tx */
+    bool ReadTxSpan(unsigned int nFile, unsigned int nTxPos, CBlockFileSpan& span);
+
+    /** Drop all mappings, e.g. before block files are deleted */
+    void Clear();
+
+    /** Drop the mapping of one file so that the next read maps it again */
+    void Invalidate(unsigned int nFile);
+
+    unsigned int GetOpenFiles();
+
+private:
+    typedef std::list<unsigned int> lru_type;
+    typedef std::pair<std::shared_ptr<const CMappedBlockFile>, lru_type::iterator> entry_type;
+
+    CCriticalSection cs_blockfiles;
+    unsigned int nMaxFiles;
+    std::map<unsigned int, entry_type> mapFiles;
+    lru_type lruFiles;
+
+    std::shared_ptr<const CMappedBlockFile> GetFile(unsigned int nFile, size_t nMinSize);
+    std::shared_ptr<const CMappedBlockFile> MapFile(unsigned int nFile);
+    void EraseFile(unsigned int nFile);
+};
+
+extern CBlockFileCache blockFileCache;
+
+boost::filesystem::path BlockFilePath(unsigned int nFile);
+
+#endif // BITCOIN_BLOCKSTORE_H
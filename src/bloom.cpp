@@ -1,6 +1,7 @@
 // Copyright (c) 2012 The Bitcoin developers
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#include <limits>
 #include <math.h>
 #include <stdlib.h>
 
@@ -204,3 +205,89 @@ void CBloomFilter::UpdateEmptyFull()
     isFull = full;
     isEmpty = empty;
 }
+
+CRollingBloomFilter::CRollingBloomFilter(unsigned int nElements, double nFPRate)
+{
+    double logFPRate = log(nFPRate);
+    // The optimal number of hash functions is log(fpRate) / log(0.5)
+    nHashFuncs = max(1, min((int)round(logFPRate / log(0.5)), (int)MAX_HASH_FUNCS));
+    // Holds between nElements and 1.5 * nElements, as a generation is half
+    nEntriesPerGeneration = (nElements + 1) / 2;
+    uint32_t nMaxElements = nEntriesPerGeneration * 3;
+    // Bits for nMaxElements at nFPRate with nHashFuncs: the rate is
+    // (1 - exp(-nHashFuncs * nMaxElements / nFilterBits)) ** nHashFuncs
+    uint32_t nFilterBits = (uint32_t)ceil(-1.0 * nHashFuncs * nMaxElements / log(1.0 - exp(logFPRate / nHashFuncs)));
+    vData.resize(((nFilterBits + 63) / 64) << 1);
+    reset();
+}
+
+static inline uint32_t RollingBloomHash(unsigned int nHashNum, uint32_t nTweak, const vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash);
+}
+
+void CRollingBloomFilter::insert(const vector<unsigned char>& vKey)
+{
+    if (nEntriesThisGeneration == nEntriesPerGeneration)
+    {
+        nEntriesThisGeneration = 0;
+        nGeneration++;
+        if (nGeneration == 4)
+            nGeneration = 1;
+        uint64_t nGenerationMask1 = 0 - (uint64_t)(nGeneration & 1);
+        uint64_t nGenerationMask2 = 0 - (uint64_t)(nGeneration >> 1);
+        // Wipe the slots still holding the generation now reused
+        for (uint32_t p = 0; p < vData.size(); p += 2)
+        {
+            uint64_t p1 = vData[p], p2 = vData[p + 1];
+            uint64_t mask = (p1 ^ nGenerationMask1) | (p2 ^ nGenerationMask2);
+            vData[p] = p1 & mask;
+            vData[p + 1] = p2 & mask;
+        }
+    }
+    nEntriesThisGeneration++;
+
+    for (int n = 0; n < nHashFuncs; n++)
+    {
+        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        int bit = h & 0x3F;
+        uint32_t pos = (h >> 6) % vData.size();
+        // The low bit of pos is dropped, the words of a pair hold the low
+        // and high bit of the slot
+        vData[pos & ~1] = (vData[pos & ~1] & ~(((uint64_t)1) << bit)) | ((uint64_t)(nGeneration & 1)) << bit;
+        vData[pos | 1] = (vData[pos | 1] & ~(((uint64_t)1) << bit)) | ((uint64_t)(nGeneration >> 1)) << bit;
+    }
+}
+
+void CRollingBloomFilter::insert(const uint256& hash)
+{
+    vector<unsigned char> vKey(hash.begin(), hash.end());
+    insert(vKey);
+}
+
+bool CRollingBloomFilter::contains(const vector<unsigned char>& vKey) const
+{
+    for (int n = 0; n < nHashFuncs; n++)
+    {
+        uint32_t h = RollingBloomHash(n, nTweak, vKey);
+        int bit = h & 0x3F;
+        uint32_t pos = (h >> 6) % vData.size();
+        if (!(((vData[pos & ~1] | vData[pos | 1]) >> bit) & 1))
+            return false;
+    }
+    return true;
+}
+
+bool CRollingBloomFilter::contains(const uint256& hash) const
+{
+    vector<unsigned char> vKey(hash.begin(), hash.end());
+    return contains(vKey);
+}
+
+void CRollingBloomFilter::reset()
+{
+    nTweak = GetRand(std::numeric_limits<unsigned int>::max());
+    nEntriesThisGeneration = 0;
+    nGeneration = 1;
+    std::fill(vData.begin(), vData.end(), 0);
+}
@@ -93,4 +93,34 @@ public:
     void UpdateEmptyFull();
 };
 
+/**
+ * RollingBloomFilter is a probabilistic "keep track of most recently inserted"
+ * set. It holds at least the last nElements inserted and forgets older ones
+ * a generation at a time, for the same memory whatever the insert rate.
+ *
+ * Each slot of the filter is two bits, in a pair of 64 bit words, holding the
+ * generation (1 to 3) of the last insert setting it or 0. Starting a new
+ * generation wipes the slots of the generation before the last.
+ */
+class CRollingBloomFilter
+{
+public:
+    CRollingBloomFilter(unsigned int nElements, double nFPRate);
+
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+
+    void reset();
+
+private:
+    int nEntriesPerGeneration;
+    int nEntriesThisGeneration;
+    int nGeneration;
+    std::vector<uint64_t> vData;
+    unsigned int nTweak;
+    int nHashFuncs;
+};
+
 #endif /* BITCOIN_BLOOM_H */
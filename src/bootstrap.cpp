@@ -0,0 +1,690 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bootstrap.h"
+#include "main.h"
+#include "ui_interface.h"
+#include "util.h"
+#include "lz4/lz4.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+//
+// Block import pipeline
+//
+// Importing used to read, deserialize, hash, check and connect every block
+// on one thread while holding cs_main. It is now split into:
+//
+//   reader     - scans the file for message start bytes and copies out the
+//                raw bytes of each block, in file order
+//   workers    - deserialize the block and run the context free CheckBlock()
+//                (Tribus/PoW hash, tx checks, merkle root, stake signature)
+//   connector  - the calling thread; takes the blocks back in file order and
+//                hands them to ProcessBlock under cs_main
+//
+// CheckBlock() marks a block as checked so ProcessBlock and ConnectBlock do
+// not hash it a second time. Both queues are bounded, so memory use stays at
+// roughly DEFAULT_IMPORT_QUEUE blocks however far the workers are ahead.
+//
+
+class CImportBlock
+{
+public:
+    uint64_t nPos;
+    std::vector<char> vData;
+    CBlock block;
+    uint256 hash;
+    bool fParsed;
+    bool fDone;
+
+    CImportBlock() : nPos(0), fParsed(false), fDone(false) {}
+};
+
+typedef std::shared_ptr<CImportBlock> CImportBlockRef;
+
+int GetImportThreads()
+{
+    int nThreads = GetArg("-loadblockthreads", 0);
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency() - 1;
+    return std::max(1, std::min(nThreads, 16));
+}
+
+class CBlockImporter
+{
+public:
+    CImportStats stats;
+
+    CBlockImporter(FILE* fileIn, unsigned int nQueue) : file(fileIn), fCompressed(false), nChunkPos(0), nNextChunk(0), nIndexOffset(0),
+        vBuf(4 * MAX_BLOCK_SIZE), nBegin(0), nEnd(0), nBufPos(0), queueOrdered(nQueue), queueWork(nQueue * 2), fAbort(false) {}
+
+    bool Run();
+
+private:
+    FILE* file;
+
+    // compressed bootstrap: decompressed current chunk and the chunk index
+    bool fCompressed;
+    std::vector<char> vChunk;
+    size_t nChunkPos;
+    std::vector<CBootstrapChunk> vIndex;
+    size_t nNextChunk;
+    uint64_t nIndexOffset;
+
+    // reader's sliding window over the file, refilled with large sequential reads
+    std::vector<char> vBuf;
+    size_t nBegin;
+    size_t nEnd;
+    uint64_t nBufPos; // file offset of vBuf[0]
+
+    // blocks in file order, for the connector
+    CBoundedQueue<CImportBlockRef> queueOrdered;
+    // same blocks, for whichever worker is free
+    CBoundedQueue<CImportBlockRef> queueWork;
+
+    boost::mutex mutexDone;
+    boost::condition_variable condDone;
+    bool fAbort;
+
+    bool OpenSource();
+    bool ReadChunk();
+    size_t ReadSource(char* pch, size_t nSize);
+    bool Fill(size_t nNeed);
+    void ThreadReader();
+    void ThreadWorker();
+    bool WaitDone(const CImportBlockRef& item);
+    void Abort();
+    void PrintProgress(bool fFinal);
+};
+
+bool CBlockImporter::OpenSource()
+{
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        long nSize = ftell(file);
+        stats.nFileSize = nSize > 0 ? nSize : 0;
+    }
+    rewind(file);
+
+    unsigned char pchMagic[sizeof(pchBootstrapLZ4Magic)];
+    if (fread(pchMagic, 1, sizeof(pchMagic), file) != sizeof(pchMagic) || memcmp(pchMagic, pchBootstrapLZ4Magic, sizeof(pchMagic)) != 0)
+    {
+        // plain bootstrap.dat / blk0001.dat
+        rewind(file);
+        return true;
+    }
+
+    fCompressed = true;
+    try {
+        int nVersion;
+        unsigned int nChunkBlocks;
+        char pchHeader[sizeof(nVersion) + sizeof(nChunkBlocks)];
+        if (fread(pchHeader, 1, sizeof(pchHeader), file) != sizeof(pchHeader))
+            return error("LoadExternalBlockFile() : compressed bootstrap truncated");
+        CBufferReader(pchHeader, pchHeader + sizeof(pchHeader), SER_DISK, CLIENT_VERSION) >> nVersion >> nChunkBlocks;
+        if (nVersion > BOOTSTRAP_LZ4_VERSION)
+            return error("LoadExternalBlockFile() : compressed bootstrap version %d not supported", nVersion);
+        uint64_t nDataStart = sizeof(pchMagic) + sizeof(pchHeader);
+
+        // the chunk index is found through the footer
+        uint64_t nOffset;
+        char pchFooter[sizeof(nOffset) + sizeof(pchMagic)];
+        if (stats.nFileSize < nDataStart + sizeof(pchFooter) || fseek(file, -(long)sizeof(pchFooter), SEEK_END) != 0
+            || fread(pchFooter, 1, sizeof(pchFooter), file) != sizeof(pchFooter))
+            return error("LoadExternalBlockFile() : compressed bootstrap truncated");
+        CBufferReader(pchFooter, pchFooter + sizeof(nOffset), SER_DISK, CLIENT_VERSION) >> nOffset;
+        memcpy(pchMagic, pchFooter + sizeof(nOffset), sizeof(pchMagic));
+        if (memcmp(pchMagic, pchBootstrapLZ4Magic, sizeof(pchMagic)) != 0 || nOffset < nDataStart || nOffset > stats.nFileSize - sizeof(pchFooter))
+            return error("LoadExternalBlockFile() : compressed bootstrap has no chunk index");
+
+        std::vector<char> vIndexData(stats.nFileSize - sizeof(pchFooter) - nOffset);
+        if (fseek(file, nOffset, SEEK_SET) != 0
+            || (!vIndexData.empty() && fread(&vIndexData[0], 1, vIndexData.size(), file) != vIndexData.size()))
+            return error("LoadExternalBlockFile() : reading chunk index failed");
+        CBufferReader(vIndexData.data(), vIndexData.data() + vIndexData.size(), SER_DISK, CLIENT_VERSION) >> vIndex;
+        nIndexOffset = nOffset;
+
+        if (fseek(file, nDataStart, SEEK_SET) != 0)
+            return error("LoadExternalBlockFile() : seek to first chunk failed");
+    }
+    catch (std::exception &e) {
+        return error("LoadExternalBlockFile() : reading compressed bootstrap header failed: %s", e.what());
+    }
+
+    printf("LoadExternalBlockFile() : compressed bootstrap with %u chunks\n", (unsigned int)vIndex.size());
+    return true;
+}
+
+bool CBlockImporter::ReadChunk()
+{
+    if (nNextChunk >= vIndex.size())
+        return false;
+
+    const CBootstrapChunk& entry = vIndex[nNextChunk];
+    long nPos = ftell(file);
+    if (nPos < 0 || (uint64_t)nPos != entry.nOffset || entry.nOffset >= nIndexOffset)
+        return error("LoadExternalBlockFile() : chunk %u is not where the index says", (unsigned int)nNextChunk);
+
+    std::vector<char> vHeader(CBootstrapChunk::GetHeaderSize());
+    if (fread(&vHeader[0], 1, vHeader.size(), file) != vHeader.size())
+        return error("LoadExternalBlockFile() : chunk %u header truncated", (unsigned int)nNextChunk);
+
+    CBootstrapChunk chunk;
+    CBufferReader(&vHeader[0], &vHeader[0] + vHeader.size(), SER_DISK, CLIENT_VERSION) >> chunk;
+    if (chunk.nOffset != entry.nOffset || chunk.hashRaw != entry.hashRaw || chunk.nRawSize != entry.nRawSize
+        || chunk.nCompressedSize != entry.nCompressedSize || chunk.nRawSize > BOOTSTRAP_CHUNK_BLOCKS * (MAX_BLOCK_SIZE + 8)
+        || chunk.nCompressedSize > (unsigned int)LZ4_compressBound(chunk.nRawSize))
+        return error("LoadExternalBlockFile() : chunk %u header does not match the index", (unsigned int)nNextChunk);
+
+    std::vector<char> vCompressed(chunk.nCompressedSize);
+    if (chunk.nCompressedSize && fread(&vCompressed[0], 1, vCompressed.size(), file) != vCompressed.size())
+        return error("LoadExternalBlockFile() : chunk %u truncated", (unsigned int)nNextChunk);
+
+    vChunk.resize(chunk.nRawSize);
+    nChunkPos = 0;
+    if (chunk.nRawSize && LZ4_decompress_safe(&vCompressed[0], &vChunk[0], vCompressed.size(), vChunk.size()) != (int)chunk.nRawSize)
+        return error("LoadExternalBlockFile() : chunk %u failed to decompress", (unsigned int)nNextChunk);
+    if (Hash(vChunk.begin(), vChunk.end()) != chunk.hashRaw)
+        return error("LoadExternalBlockFile() : chunk %u checksum mismatch", (unsigned int)nNextChunk);
+
+    nNextChunk++;
+    return true;
+}
+
+size_t CBlockImporter::ReadSource(char* pch, size_t nSize)
+{
+    if (!fCompressed)
+    {
+        size_t nRead = fread(pch, 1, nSize, file);
+        stats.nBytesRead += nRead;
+        return nRead;
+    }
+
+    if (nChunkPos >= vChunk.size())
+    {
+        if (!ReadChunk())
+            return 0;
+        long nPos = ftell(file);
+        stats.nBytesRead = nPos > 0 ? nPos : 0;
+    }
+
+    size_t nRead = std::min(nSize, vChunk.size() - nChunkPos);
+    memcpy(pch, &vChunk[nChunkPos], nRead);
+    nChunkPos += nRead;
+    return nRead;
+}
+
+bool CBlockImporter::Fill(size_t nNeed)
+{
+    if (nEnd - nBegin >= nNeed)
+        return true;
+
+    memmove(&vBuf[0], &vBuf[nBegin], nEnd - nBegin);
+    nBufPos += nBegin;
+    nEnd -= nBegin;
+    nBegin = 0;
+    while (nEnd < nNeed)
+    {
+        size_t nRead = ReadSource(&vBuf[nEnd], vBuf.size() - nEnd);
+        if (nRead == 0)
+            break;
+        nEnd += nRead;
+    }
+    return nEnd >= nNeed;
+}
+
+void CBlockImporter::ThreadReader()
+{
+    RenameThread("denarius-loadblk");
+
+    try {
+        while (!fRequestShutdown && Fill(8))
+        {
+            char* pStart = (char*)memchr(&vBuf[nBegin], pchMessageStart[0], nEnd - nBegin);
+            if (!pStart)
+            {
+                nBegin = nEnd;
+                continue;
+            }
+            nBegin = pStart - &vBuf[0];
+            if (!Fill(8))
+                break;
+            if (memcmp(&vBuf[nBegin], pchMessageStart, sizeof(pchMessageStart)) != 0)
+            {
+                nBegin++;
+                continue;
+            }
+
+            unsigned int nSize;
+            memcpy(&nSize, &vBuf[nBegin + sizeof(pchMessageStart)], sizeof(nSize));
+            if (nSize == 0 || nSize > MAX_BLOCK_SIZE)
+            {
+                nBegin++;
+                continue;
+            }
+            if (!Fill(8 + nSize))
+                break; // truncated last block
+
+            CImportBlockRef item = std::make_shared<CImportBlock>();
+            item->nPos = nBufPos + nBegin + 8;
+            item->vData.assign(vBuf.begin() + nBegin + 8, vBuf.begin() + nBegin + 8 + nSize);
+            nBegin += 8 + nSize;
+            stats.nBlocksRead++;
+
+            if (!queueOrdered.Push(item) || !queueWork.Push(item))
+                break;
+        }
+    }
+    catch (std::exception& e) {
+        PrintExceptionContinue(&e, "ThreadReader()");
+    }
+
+    queueOrdered.Close();
+    queueWork.Close();
+}
+
+void CBlockImporter::ThreadWorker()
+{
+    RenameThread("denarius-loadchk");
+
+    CImportBlockRef item;
+    while (queueWork.Pop(item))
+    {
+        try {
+            CBufferReader reader(&item->vData[0], &item->vData[0] + item->vData.size(), SER_DISK, CLIENT_VERSION);
+            reader >> item->block;
+            item->hash = item->block.GetHash();
+            item->fParsed = true;
+
+            // Result is remembered in CBlock::fChecked, failures are
+            // reported again when the connector calls ProcessBlock.
+            item->block.CheckBlock();
+        }
+        catch (std::exception& e) {
+            printf("LoadExternalBlockFile() : deserialize error for block at offset %" PRIu64"\n", item->nPos);
+        }
+
+        // raw bytes are not needed any more
+        std::vector<char>().swap(item->vData);
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutexDone);
+            item->fDone = true;
+        }
+        condDone.notify_all();
+        item.reset();
+    }
+}
+
+bool CBlockImporter::WaitDone(const CImportBlockRef& item)
+{
+    boost::unique_lock<boost::mutex> lock(mutexDone);
+    while (!item->fDone && !fAbort)
+        condDone.timed_wait(lock, boost::posix_time::milliseconds(500));
+    return item->fDone;
+}
+
+void CBlockImporter::Abort()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexDone);
+        fAbort = true;
+    }
+    queueOrdered.Abort();
+    queueWork.Abort();
+    condDone.notify_all();
+}
+
+void CBlockImporter::PrintProgress(bool fFinal)
+{
+    int64_t nElapsed = std::max((int64_t)1, GetTimeMillis() - stats.nStartTime);
+    double dBlocksPerSec = (stats.nBlocksConnected + stats.nBlocksSkipped) * 1000.0 / nElapsed;
+    double dMBPerSec = stats.nBytesRead * 1000.0 / nElapsed / 1048576.0;
+    int nPercent = stats.nFileSize ? (int)(stats.nBytesRead * 100 / stats.nFileSize) : 0;
+
+    printf("LoadExternalBlockFile() : %s%d%% read, %d connected, %d known, %d failed, %.1f blocks/s, %.2f MB/s, %u queued\n",
+        fFinal ? "done, " : "", nPercent, stats.nBlocksConnected, stats.nBlocksSkipped, stats.nBlocksFailed,
+        dBlocksPerSec, dMBPerSec, (unsigned int)queueOrdered.Size());
+    if (!fFinal)
+        uiInterface.InitMessage(strprintf(_("Importing blocks... %d%% (%d blocks)"), nPercent, stats.nBlocksConnected));
+}
+
+bool CBlockImporter::Run()
+{
+    stats.SetNull();
+    stats.nStartTime = GetTimeMillis();
+    if (!OpenSource())
+        return false;
+
+    int nThreads = GetImportThreads();
+    printf("LoadExternalBlockFile() : importing %" PRIu64" bytes with %d check threads\n", stats.nFileSize, nThreads);
+
+    boost::thread_group threads;
+    threads.create_thread(boost::bind(&CBlockImporter::ThreadReader, this));
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CBlockImporter::ThreadWorker, this));
+
+    int64_t nLastProgress = GetTimeMillis();
+    CImportBlockRef item;
+    while (queueOrdered.Pop(item))
+    {
+        if (fRequestShutdown || !WaitDone(item))
+            break;
+
+        if (!item->fParsed)
+        {
+            stats.nBlocksFailed++;
+            continue;
+        }
+
+        {
+            LOCK(cs_main);
+            if (mapBlockIndex.count(item->hash))
+                stats.nBlocksSkipped++;
+            else if (ProcessBlock(NULL, &item->block))
+                stats.nBlocksConnected++;
+            else
+                stats.nBlocksFailed++;
+        }
+        item.reset();
+
+        if (GetTimeMillis() - nLastProgress > 10000)
+        {
+            PrintProgress(false);
+            nLastProgress = GetTimeMillis();
+        }
+    }
+
+    Abort();
+    threads.join_all();
+    PrintProgress(true);
+
+    return stats.nBlocksConnected > 0;
+}
+
+bool LoadExternalBlockFile(FILE* fileIn)
+{
+    int64_t nStart = GetTimeMillis();
+
+    CAutoFile blkdat(fileIn, SER_DISK, CLIENT_VERSION);
+    if (!blkdat)
+        return false;
+
+    CBlockImporter importer(blkdat, DEFAULT_IMPORT_QUEUE);
+    importer.Run();
+
+    printf("Loaded %i blocks from external file in %" PRId64"ms\n", importer.stats.nBlocksConnected, GetTimeMillis() - nStart);
+    return importer.stats.nBlocksConnected > 0;
+}
+
+//
+// Bootstrap export
+//
+// dumpbootstrap used to read and write one block at a time under cs_main.
+// The export now takes a snapshot of the block positions of the main chain,
+// then workers copy the serialized blocks of whole chunks straight out of the
+// mapped block files and compress them while the calling thread writes the
+// finished chunks in order.
+//
+
+class CExportChunk
+{
+public:
+    CBootstrapChunk header;
+    std::vector<std::pair<unsigned int, unsigned int> > vBlockPos;
+    std::vector<char> vRaw;
+    std::vector<char> vCompressed;
+    bool fOk;
+    bool fDone;
+
+    CExportChunk() : fOk(false), fDone(false) {}
+};
+
+typedef std::shared_ptr<CExportChunk> CExportChunkRef;
+
+class CBootstrapExporter
+{
+public:
+    CBootstrapExporter(bool fCompressIn, unsigned int nQueue) : fCompress(fCompressIn), queueOrdered(nQueue), queueWork(nQueue * 2), fAbort(false) {}
+
+    bool Run(FILE* file, const std::vector<std::pair<unsigned int, unsigned int> >& vBlockPos, int nFirstHeight, CExportStats& stats, std::string& strError);
+
+private:
+    bool fCompress;
+
+    CBoundedQueue<CExportChunkRef> queueOrdered;
+    CBoundedQueue<CExportChunkRef> queueWork;
+
+    boost::mutex mutexDone;
+    boost::condition_variable condDone;
+    bool fAbort;
+
+    bool BuildChunk(CExportChunk& chunk);
+    void ThreadFeeder(const std::vector<std::pair<unsigned int, unsigned int> >* pvBlockPos, int nFirstHeight);
+    void ThreadWorker();
+    bool WaitDone(const CExportChunkRef& chunk);
+    void Abort();
+};
+
+bool CBootstrapExporter::BuildChunk(CExportChunk& chunk)
+{
+    for (unsigned int i = 0; i < chunk.vBlockPos.size(); i++)
+    {
+        unsigned int nFile = chunk.vBlockPos[i].first;
+        unsigned int nBlockPos = chunk.vBlockPos[i].second;
+
+        // The on-disk serialization is exactly what goes into the bootstrap
+        // record, so copy it out of the mapping without deserializing.
+        CBlockFileSpan span;
+        CDataStream ssBlock(SER_DISK, CLIENT_VERSION);
+        const char* pbegin;
+        unsigned int nSize;
+        if (blockFileCache.ReadBlockSpan(nFile, nBlockPos, span))
+        {
+            pbegin = span.pbegin;
+            nSize = span.size();
+        }
+        else
+        {
+            CBlock block;
+            if (!block.ReadFromDisk(nFile, nBlockPos, true))
+                return error("DumpBootstrap() : ReadFromDisk failed for block at height %d", chunk.header.nFirstHeight + (int)i);
+            ssBlock << block;
+            pbegin = &ssBlock[0];
+            nSize = ssBlock.size();
+        }
+
+        chunk.vRaw.insert(chunk.vRaw.end(), pchMessageStart, pchMessageStart + sizeof(pchMessageStart));
+        chunk.vRaw.insert(chunk.vRaw.end(), (const char*)&nSize, (const char*)&nSize + sizeof(nSize));
+        chunk.vRaw.insert(chunk.vRaw.end(), pbegin, pbegin + nSize);
+    }
+
+    chunk.header.nBlocks = chunk.vBlockPos.size();
+    chunk.header.nRawSize = chunk.vRaw.size();
+    chunk.header.hashRaw = Hash(chunk.vRaw.begin(), chunk.vRaw.end());
+    std::vector<std::pair<unsigned int, unsigned int> >().swap(chunk.vBlockPos);
+
+    if (fCompress && !chunk.vRaw.empty())
+    {
+        chunk.vCompressed.resize(LZ4_compressBound(chunk.vRaw.size()));
+        int nCompressed = LZ4_compress(&chunk.vRaw[0], &chunk.vCompressed[0], chunk.vRaw.size());
+        if (nCompressed <= 0)
+            return error("DumpBootstrap() : LZ4_compress failed for chunk at height %d", chunk.header.nFirstHeight);
+        chunk.vCompressed.resize(nCompressed);
+        chunk.header.nCompressedSize = nCompressed;
+        std::vector<char>().swap(chunk.vRaw);
+    }
+    return true;
+}
+
+void CBootstrapExporter::ThreadFeeder(const std::vector<std::pair<unsigned int, unsigned int> >* pvBlockPos, int nFirstHeight)
+{
+    RenameThread("denarius-dumpblk");
+
+    for (unsigned int nStart = 0; nStart < pvBlockPos->size() && !fRequestShutdown; nStart += BOOTSTRAP_CHUNK_BLOCKS)
+    {
+        unsigned int nEnd = std::min((unsigned int)pvBlockPos->size(), nStart + BOOTSTRAP_CHUNK_BLOCKS);
+        CExportChunkRef chunk = std::make_shared<CExportChunk>();
+        chunk->header.nFirstHeight = nFirstHeight + nStart;
+        chunk->vBlockPos.assign(pvBlockPos->begin() + nStart, pvBlockPos->begin() + nEnd);
+
+        if (!queueOrdered.Push(chunk) || !queueWork.Push(chunk))
+            break;
+    }
+
+    queueOrdered.Close();
+    queueWork.Close();
+}
+
+void CBootstrapExporter::ThreadWorker()
+{
+    RenameThread("denarius-dumpchk");
+
+    CExportChunkRef chunk;
+    while (queueWork.Pop(chunk))
+    {
+        try {
+            chunk->fOk = BuildChunk(*chunk);
+        }
+        catch (std::exception& e) {
+            PrintExceptionContinue(&e, "DumpBootstrap()");
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutexDone);
+            chunk->fDone = true;
+        }
+        condDone.notify_all();
+        chunk.reset();
+    }
+}
+
+bool CBootstrapExporter::WaitDone(const CExportChunkRef& chunk)
+{
+    boost::unique_lock<boost::mutex> lock(mutexDone);
+    while (!chunk->fDone && !fAbort)
+        condDone.timed_wait(lock, boost::posix_time::milliseconds(500));
+    return chunk->fDone;
+}
+
+void CBootstrapExporter::Abort()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutexDone);
+        fAbort = true;
+    }
+    queueOrdered.Abort();
+    queueWork.Abort();
+    condDone.notify_all();
+}
+
+bool CBootstrapExporter::Run(FILE* file, const std::vector<std::pair<unsigned int, unsigned int> >& vBlockPos, int nFirstHeight, CExportStats& stats, std::string& strError)
+{
+    int nThreads = GetImportThreads();
+    boost::thread_group threads;
+    threads.create_thread(boost::bind(&CBootstrapExporter::ThreadFeeder, this, &vBlockPos, nFirstHeight));
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CBootstrapExporter::ThreadWorker, this));
+
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    std::vector<CBootstrapChunk> vIndex;
+    uint64_t nFilePos = 0;
+    try {
+        if (fCompress)
+        {
+            fileout << FLATDATA(pchBootstrapLZ4Magic) << BOOTSTRAP_LZ4_VERSION << BOOTSTRAP_CHUNK_BLOCKS;
+            nFilePos = sizeof(pchBootstrapLZ4Magic) + sizeof(BOOTSTRAP_LZ4_VERSION) + sizeof(BOOTSTRAP_CHUNK_BLOCKS);
+        }
+
+        CExportChunkRef chunk;
+        while (queueOrdered.Pop(chunk))
+        {
+            if (fRequestShutdown || !WaitDone(chunk))
+            {
+                strError = "Bootstrap dump interrupted";
+                break;
+            }
+            if (!chunk->fOk)
+            {
+                strError = strprintf("Reading blocks from height %d failed", chunk->header.nFirstHeight);
+                break;
+            }
+
+            if (fCompress)
+            {
+                chunk->header.nOffset = nFilePos;
+                fileout << chunk->header;
+                fileout.write(&chunk->vCompressed[0], chunk->vCompressed.size());
+                nFilePos += CBootstrapChunk::GetHeaderSize() + chunk->vCompressed.size();
+                vIndex.push_back(chunk->header);
+            }
+            else if (!chunk->vRaw.empty())
+            {
+                fileout.write(&chunk->vRaw[0], chunk->vRaw.size());
+                nFilePos += chunk->vRaw.size();
+            }
+
+            stats.nBlocks += chunk->header.nBlocks;
+            stats.nChunks++;
+            stats.nRawBytes += chunk->header.nRawSize;
+            chunk.reset();
+        }
+
+        if (strError.empty() && fCompress)
+        {
+            uint64_t nIndexOffset = nFilePos;
+            fileout << vIndex << nIndexOffset << FLATDATA(pchBootstrapLZ4Magic);
+            nFilePos += ::GetSerializeSize(vIndex, SER_DISK, CLIENT_VERSION) + sizeof(nIndexOffset) + sizeof(pchBootstrapLZ4Magic);
+        }
+        stats.nFileBytes = nFilePos;
+    }
+    catch (std::exception& e) {
+        strError = strprintf("Writing bootstrap file failed: %s", e.what());
+    }
+
+    Abort();
+    threads.join_all();
+    return strError.empty();
+}
+
+bool DumpBootstrap(const boost::filesystem::path& pathDest, int nLastHeight, bool fCompress, CExportStats& stats, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    // Snapshot of where the main chain blocks live; the block files are only
+    // ever appended to, so the positions stay valid after cs_main is released.
+    std::vector<std::pair<unsigned int, unsigned int> > vBlockPos;
+    {
+        LOCK(cs_main);
+        if (nLastHeight < 0 || nLastHeight > nBestHeight)
+        {
+            strError = "Block number out of range.";
+            return false;
+        }
+        vBlockPos.reserve(nLastHeight + 1);
+        for (int nHeight = 0; nHeight <= nLastHeight; nHeight++)
+        {
+            CBlockIndex* pindex = chainActive[nHeight];
+            vBlockPos.push_back(std::make_pair(pindex->nFile, pindex->nBlockPos));
+        }
+    }
+
+    FILE* file = fopen(pathDest.string().c_str(), "wb");
+    if (!file)
+    {
+        strError = "Could not open bootstrap file for writing.";
+        return false;
+    }
+
+    CBootstrapExporter exporter(fCompress, DEFAULT_EXPORT_QUEUE);
+    bool fRet = exporter.Run(file, vBlockPos, 0, stats, strError);
+    stats.nTimeMillis = GetTimeMillis() - nStart;
+
+    printf("DumpBootstrap() : wrote %d blocks in %d chunks, %" PRIu64" bytes (%" PRIu64" uncompressed) to %s in %" PRId64"ms\n",
+        stats.nBlocks, stats.nChunks, stats.nFileBytes, stats.nRawBytes, pathDest.string().c_str(), stats.nTimeMillis);
+    return fRet;
+}
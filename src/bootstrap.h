@@ -0,0 +1,131 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BOOTSTRAP_H
+#define BITCOIN_BOOTSTRAP_H
+
+#include "serialize.h"
+#include "uint256.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <boost/filesystem/path.hpp>
+
+/** Blocks read ahead of the connector while importing */
+static const unsigned int DEFAULT_IMPORT_QUEUE = 256;
+
+/** Blocks per chunk of a compressed bootstrap file */
+static const unsigned int BOOTSTRAP_CHUNK_BLOCKS = 500;
+
+/** Chunks being read and compressed ahead of the writer while exporting */
+static const unsigned int DEFAULT_EXPORT_QUEUE = 32;
+
+static const int BOOTSTRAP_LZ4_VERSION = 1;
+
+/** Compressed bootstrap files start and end with this */
+static const unsigned char pchBootstrapLZ4Magic[8] = { 'D', 'B', 'O', 'O', 'T', 'L', 'Z', '4' };
+
+/** Compressed bootstrap file layout:
+ *
+ *   magic[8] | nVersion | nChunkBlocks
+ *   chunk header (CBootstrapChunk) | LZ4 data      repeated for every chunk
+ *   chunk index (vector of CBootstrapChunk)
+ *   nIndexOffset (uint64) | magic[8]
+ *
+ * Uncompressed, each chunk is a run of ordinary bootstrap.dat records
+ * (message start, size, block), so an import decompresses chunks and feeds
+ * them through the same scanner as a plain file.
+ */
+class CBootstrapChunk
+{
+public:
+    uint64_t nOffset;           // file offset of this header
+    int nFirstHeight;
+    unsigned int nBlocks;
+    unsigned int nRawSize;
+    unsigned int nCompressedSize;
+    uint256 hashRaw;            // Hash() of the uncompressed records
+
+    CBootstrapChunk()
+    {
+        SetNull();
+    }
+
+    IMPLEMENT_SERIALIZE
+    (
+        READWRITE(nOffset);
+        READWRITE(nFirstHeight);
+        READWRITE(nBlocks);
+        READWRITE(nRawSize);
+        READWRITE(nCompressedSize);
+        READWRITE(hashRaw);
+    )
+
+    void SetNull()
+    {
+        nOffset = 0;
+        nFirstHeight = 0;
+        nBlocks = 0;
+        nRawSize = 0;
+        nCompressedSize = 0;
+        hashRaw = 0;
+    }
+
+    static unsigned int GetHeaderSize()
+    {
+        return 8 + 4 + 4 + 4 + 4 + 32;
+    }
+};
+
+/** Progress of a running (or the last) -loadblock/bootstrap.dat import */
+class CImportStats
+{
+public:
+    int64_t nStartTime;
+    uint64_t nFileSize;
+    std::atomic<uint64_t> nBytesRead;
+    std::atomic<int> nBlocksRead;
+    int nBlocksConnected;
+    int nBlocksSkipped;
+    int nBlocksFailed;
+
+    CImportStats()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nStartTime = 0;
+        nFileSize = 0;
+        nBytesRead = 0;
+        nBlocksRead = 0;
+        nBlocksConnected = 0;
+        nBlocksSkipped = 0;
+        nBlocksFailed = 0;
+    }
+};
+
+/** Result of a bootstrap export */
+class CExportStats
+{
+public:
+    int nBlocks;
+    int nChunks;
+    uint64_t nRawBytes;
+    uint64_t nFileBytes;
+    int64_t nTimeMillis;
+
+    CExportStats() : nBlocks(0), nChunks(0), nRawBytes(0), nFileBytes(0), nTimeMillis(0) {}
+};
+
+/** Number of worker threads used by bootstrap import and export */
+int GetImportThreads();
+
+/** Write blocks 0..nLastHeight of the main chain to pathDest, optionally LZ4 compressed */
+bool DumpBootstrap(const boost::filesystem::path& pathDest, int nLastHeight, bool fCompress, CExportStats& stats, std::string& strError);
+
+#endif // BITCOIN_BOOTSTRAP_H
@@ -5,6 +5,7 @@
 #define  BITCOIN_CHECKPOINT_H
 
 #include <map>
+#include "core.h"
 #include "net.h"
 #include "util.h"
 
@@ -42,7 +43,7 @@ namespace Checkpoints
     int GetTotalBlocksEstimate();
 
     // Returns last CBlockIndex* in mapBlockIndex that is a checkpoint
-    CBlockIndex* GetLastCheckpoint(const std::map<uint256, CBlockIndex*>& mapBlockIndex);
+    CBlockIndex* GetLastCheckpoint(const BlockMap& mapBlockIndex);
 
     extern uint256 hashSyncCheckpoint;
     extern uint256 hashPendingCheckpoint;
@@ -13,9 +13,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unordered_map>
 #include <vector>
 #include <inttypes.h>
 
+class CBlockIndex;
 class CScript;
 class CTransaction;
 
@@ -410,4 +412,12 @@ public:
 
 };
 
+/** Block hashes are already uniformly distributed, 64 bits of them make the bucket hash */
+struct BlockHasher
+{
+    size_t operator()(const uint256& hash) const { return hash.Get64(); }
+};
+
+typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+
 #endif
@@ -11,6 +11,9 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 
+#include <leveldb/db.h>
+#include <leveldb/write_batch.h>
+
 #ifndef WIN32
 #include "sys/stat.h"
 #endif
@@ -232,7 +235,7 @@ void CDBEnv::CheckpointLSN(std::string strFile)
 
 
 CDB::CDB(const char *pszFile, const char* pszMode) :
-    pdb(NULL), activeTxn(NULL)
+    pdb(NULL), pldb(NULL), pbatch(NULL), activeTxn(NULL)
 {
     int ret;
     if (pszFile == NULL)
@@ -244,6 +247,25 @@ CDB::CDB(const char *pszFile, const char* pszMode) :
     if (fCreate)
         nFlags |= DB_CREATE;
 
+    if (bitdb.IsLevelDB(pszFile))
+    {
+        LOCK(bitdb.cs_db);
+        pldb = bitdb.OpenLevelDB(pszFile, fCreate);
+        if (pldb == NULL)
+            throw runtime_error(strprintf("CDB() : can't open LevelDB store for %s", pszFile));
+
+        strFile = pszFile;
+        ++bitdb.mapFileUseCount[strFile];
+        if (fCreate && !Exists(string("version")))
+        {
+            bool fTmp = fReadOnly;
+            fReadOnly = false;
+            WriteVersion(CLIENT_VERSION);
+            fReadOnly = fTmp;
+        }
+        return;
+    }
+
     {
         LOCK(bitdb.cs_db);
         if (!bitdb.Open(GetDataDir()))
@@ -304,6 +326,16 @@ static bool IsChainFile(std::string strFile)
 
 void CDB::Close()
 {
+    if (pldb)
+    {
+        if (pbatch)
+            TxnAbortLevelDB();
+        pldb = NULL;
+
+        LOCK(bitdb.cs_db);
+        --bitdb.mapFileUseCount[strFile];
+        return;
+    }
     if (!pdb)
         return;
     if (activeTxn)
@@ -352,6 +384,46 @@ bool CDBEnv::RemoveDb(const string& strFile)
     return (rc == 0);
 }
 
+// A LevelDB store is rewritten in place: the skipped records are deleted and
+// the store compacted, which also drops overwritten values from its files.
+static bool RewriteLevelDB(const string& strFile, const char* pszSkip)
+{
+    printf("Rewriting %s...\n", bitdb.GetLevelDBPath(strFile).string().c_str());
+    leveldb::DB* pldb = bitdb.OpenLevelDB(strFile, false);
+    if (!pldb)
+        return false;
+
+    leveldb::WriteBatch batch;
+    leveldb::Iterator* piter = pldb->NewIterator(leveldb::ReadOptions());
+    for (piter->SeekToFirst(); piter->Valid(); piter->Next())
+    {
+        leveldb::Slice key = piter->key();
+        if (pszSkip &&
+            strncmp(key.data(), pszSkip, std::min(key.size(), strlen(pszSkip))) == 0)
+            batch.Delete(key);
+    }
+    bool fSuccess = piter->status().ok();
+    delete piter;
+
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << string("version");
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << CLIENT_VERSION;
+    batch.Put(leveldb::Slice(&ssKey[0], ssKey.size()), leveldb::Slice(&ssValue[0], ssValue.size()));
+
+    if (fSuccess)
+    {
+        leveldb::WriteOptions options;
+        options.sync = true;
+        fSuccess = pldb->Write(options, &batch).ok();
+    }
+    if (fSuccess)
+        pldb->CompactRange(NULL, NULL);
+    else
+        printf("Rewriting of %s FAILED!\n", strFile.c_str());
+    return fSuccess;
+}
+
 bool CDB::Rewrite(const string& strFile, const char* pszSkip)
 {
     while (!fShutdown)
@@ -360,6 +432,12 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
             LOCK(bitdb.cs_db);
             if (!bitdb.mapFileUseCount.count(strFile) || bitdb.mapFileUseCount[strFile] == 0)
             {
+                if (bitdb.IsLevelDB(strFile))
+                {
+                    bitdb.mapFileUseCount.erase(strFile);
+                    return RewriteLevelDB(strFile, pszSkip);
+                }
+
                 // Flush log data to the dat file
                 bitdb.CloseDb(strFile);
                 bitdb.CheckpointLSN(strFile);
@@ -384,12 +462,12 @@ bool CDB::Rewrite(const string& strFile, const char* pszSkip)
                         fSuccess = false;
                     }
 
-                    Dbc* pcursor = db.GetCursor();
+                    CDBCursor* pcursor = db.GetCursor();
                     if (pcursor)
                         while (fSuccess)
                         {
                             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-                            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                            CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
                             int ret = db.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
                             if (ret == DB_NOTFOUND)
                             {
@@ -462,7 +540,15 @@ void CDBEnv::Flush(bool fShutdown)
             string strFile = (*mi).first;
             int nRefCount = (*mi).second;
             printf("%s refcount=%d\n", strFile.c_str(), nRefCount);
-            if (nRefCount == 0)
+            if (nRefCount == 0 && IsLevelDB(strFile))
+            {
+                SyncLevelDB(strFile);
+                if (fShutdown)
+                    CloseLevelDB(strFile);
+                printf("%s synced\n", strFile.c_str());
+                mapFileUseCount.erase(mi++);
+            }
+            else if (nRefCount == 0)
             {
                 // Move log data to the dat file
                 CloseDb(strFile);
@@ -482,6 +568,17 @@ void CDBEnv::Flush(bool fShutdown)
         printf("DBFlush(%s)%s ended %15" PRId64"ms\n", fShutdown ? "true" : "false", fDbEnvInit ? "" : " db not started", GetTimeMillis() - nStart);
         if (fShutdown)
         {
+            // Stores that were rewritten or backed up are open without a use count
+            map<string, leveldb::DB*>::iterator mil = mapLevelDB.begin();
+            while (mil != mapLevelDB.end())
+            {
+                string strLevelDBFile = (mil++)->first;
+                if (!mapFileUseCount.count(strLevelDBFile))
+                {
+                    SyncLevelDB(strLevelDBFile);
+                    CloseLevelDB(strLevelDBFile);
+                }
+            }
             char** listp;
             if (mapFileUseCount.empty())
             {
@@ -493,6 +590,415 @@ void CDBEnv::Flush(bool fShutdown)
 }
 
 
+//
+// LevelDB wallet store
+//
+
+CDBCursor::~CDBCursor()
+{
+    delete piter;
+}
+
+int CDBCursor::close()
+{
+    int ret = 0;
+    if (pdbc)
+        ret = pdbc->close();
+    delete this;
+    return ret;
+}
+
+int CDBCursor::del(unsigned int fFlags)
+{
+    if (pdbc)
+        return pdbc->del(fFlags);
+    if (!piter->Valid())
+        return DB_NOTFOUND;
+
+    // Goes into the active batch, if there is one
+    leveldb::Slice key = piter->key();
+    CDataStream ssKey(key.data(), key.data() + key.size(), SER_DISK, CLIENT_VERSION);
+    return pdb->EraseLevelDB(ssKey) ? 0 : EIO;
+}
+
+boost::filesystem::path CDBEnv::GetLevelDBPath(const std::string& strFile) const
+{
+    boost::filesystem::path pathFile(strFile);
+    return GetDataDir() / pathFile.replace_extension(".ldb");
+}
+
+boost::filesystem::path CDBEnv::GetMigratedPath(const std::string& strFile) const
+{
+    return GetDataDir() / (strFile + ".pre-leveldb.bak");
+}
+
+leveldb::DB* CDBEnv::OpenLevelDB(const std::string& strFile, bool fCreate)
+{
+    leveldb::DB*& pldb = mapLevelDB[strFile];
+    if (pldb)
+        return pldb;
+
+    leveldb::Options options;
+    options.create_if_missing = fCreate;
+    boost::filesystem::path pathLevelDB = GetLevelDBPath(strFile);
+    leveldb::Status status = leveldb::DB::Open(options, pathLevelDB.string(), &pldb);
+    if (!status.ok())
+    {
+        printf("CDBEnv::OpenLevelDB : error opening %s: %s\n", pathLevelDB.string().c_str(), status.ToString().c_str());
+        pldb = NULL;
+        return NULL;
+    }
+    return pldb;
+}
+
+void CDBEnv::CloseLevelDB(const std::string& strFile)
+{
+    LOCK(cs_db);
+    map<string, leveldb::DB*>::iterator mi = mapLevelDB.find(strFile);
+    if (mi == mapLevelDB.end())
+        return;
+    delete mi->second;
+    mapLevelDB.erase(mi);
+}
+
+bool CDBEnv::SyncLevelDB(const std::string& strFile)
+{
+    LOCK(cs_db);
+    map<string, leveldb::DB*>::iterator mi = mapLevelDB.find(strFile);
+    if (mi == mapLevelDB.end() || !mi->second)
+        return false;
+
+    // A synced write syncs the log with everything appended before it
+    leveldb::WriteBatch batch;
+    leveldb::WriteOptions options;
+    options.sync = true;
+    leveldb::Status status = mi->second->Write(options, &batch);
+    if (!status.ok())
+        return error("CDBEnv::SyncLevelDB : %s", status.ToString().c_str());
+    return true;
+}
+
+bool CDBEnv::BackupLevelDB(const std::string& strFile, const boost::filesystem::path& pathDest)
+{
+    LOCK(cs_db);
+    leveldb::DB* pldb = OpenLevelDB(strFile, false);
+    if (!pldb)
+        return false;
+
+    leveldb::DB* pldbCopy = NULL;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.error_if_exists = true;
+    leveldb::Status status = leveldb::DB::Open(options, pathDest.string(), &pldbCopy);
+    if (!status.ok())
+        return error("CDBEnv::BackupLevelDB : error creating %s: %s", pathDest.string().c_str(), status.ToString().c_str());
+
+    leveldb::WriteBatch batch;
+    leveldb::Iterator* piter = pldb->NewIterator(leveldb::ReadOptions());
+    for (piter->SeekToFirst(); piter->Valid(); piter->Next())
+        batch.Put(piter->key(), piter->value());
+    if (piter->status().ok())
+    {
+        leveldb::WriteOptions writeOptions;
+        writeOptions.sync = true;
+        status = pldbCopy->Write(writeOptions, &batch);
+    }
+    else
+        status = piter->status();
+    delete piter;
+    delete pldbCopy;
+
+    if (!status.ok())
+        return error("CDBEnv::BackupLevelDB : error writing %s: %s", pathDest.string().c_str(), status.ToString().c_str());
+    return true;
+}
+
+class CDBBatchScanner : public leveldb::WriteBatch::Handler
+{
+public:
+    std::string needle;
+    bool* deleted;
+    std::string* foundValue;
+    bool foundEntry;
+
+    CDBBatchScanner() : foundEntry(false) {}
+
+    virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value)
+    {
+        if (key.ToString() == needle)
+        {
+            foundEntry = true;
+            *deleted = false;
+            *foundValue = value.ToString();
+        }
+    }
+
+    virtual void Delete(const leveldb::Slice& key)
+    {
+        if (key.ToString() == needle)
+        {
+            foundEntry = true;
+            *deleted = true;
+        }
+    }
+};
+
+// Reads inside a transaction see its own writes, as they do with Berkeley DB
+bool CDB::ScanBatch(const CDataStream& ssKey, std::string* pstrValue, bool* pfDeleted) const
+{
+    if (!pbatch)
+        return false;
+
+    *pfDeleted = false;
+    CDBBatchScanner scanner;
+    scanner.needle = ssKey.str();
+    scanner.deleted = pfDeleted;
+    scanner.foundValue = pstrValue;
+    leveldb::Status status = pbatch->Iterate(&scanner);
+    if (!status.ok())
+        return error("CDB::ScanBatch : %s", status.ToString().c_str());
+    return scanner.foundEntry;
+}
+
+bool CDB::ReadLevelDB(const CDataStream& ssKey, CDataStream& ssValue)
+{
+    std::string strValue;
+    bool fDeleted = false;
+    if (ScanBatch(ssKey, &strValue, &fDeleted))
+    {
+        if (fDeleted)
+            return false;
+    }
+    else
+    {
+        leveldb::Status status = pldb->Get(leveldb::ReadOptions(), leveldb::Slice(&ssKey[0], ssKey.size()), &strValue);
+        if (!status.ok())
+        {
+            if (!status.IsNotFound())
+                printf("CDB::ReadLevelDB : %s\n", status.ToString().c_str());
+            return false;
+        }
+    }
+
+    ssValue.write(strValue.data(), strValue.size());
+
+    // Clear memory in case it was a private key
+    if (!strValue.empty())
+        OPENSSL_cleanse(&strValue[0], strValue.size());
+    return true;
+}
+
+bool CDB::WriteLevelDB(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite)
+{
+    if (!fOverwrite && ExistsLevelDB(ssKey))
+        return false;
+
+    leveldb::Slice key(&ssKey[0], ssKey.size());
+    leveldb::Slice value(&ssValue[0], ssValue.size());
+    if (pbatch)
+    {
+        pbatch->Put(key, value);
+        return true;
+    }
+
+    // Not synced, ThreadFlushWalletDB syncs the log like it checkpoints Berkeley DB
+    leveldb::Status status = pldb->Put(leveldb::WriteOptions(), key, value);
+    if (!status.ok())
+        return error("CDB::WriteLevelDB : %s", status.ToString().c_str());
+    return true;
+}
+
+bool CDB::EraseLevelDB(const CDataStream& ssKey)
+{
+    leveldb::Slice key(&ssKey[0], ssKey.size());
+    if (pbatch)
+    {
+        pbatch->Delete(key);
+        return true;
+    }
+
+    leveldb::Status status = pldb->Delete(leveldb::WriteOptions(), key);
+    if (!status.ok())
+        return error("CDB::EraseLevelDB : %s", status.ToString().c_str());
+    return true;
+}
+
+bool CDB::ExistsLevelDB(const CDataStream& ssKey)
+{
+    std::string strValue;
+    bool fDeleted = false;
+    if (ScanBatch(ssKey, &strValue, &fDeleted))
+        return !fDeleted;
+
+    leveldb::Status status = pldb->Get(leveldb::ReadOptions(), leveldb::Slice(&ssKey[0], ssKey.size()), &strValue);
+    return status.ok();
+}
+
+CDBCursor* CDB::GetLevelDBCursor()
+{
+    return new CDBCursor(this, pldb->NewIterator(leveldb::ReadOptions()));
+}
+
+int CDB::ReadAtIterator(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags)
+{
+    leveldb::Iterator* piter = pcursor->piter;
+    if (fFlags == DB_SET_RANGE)
+        piter->Seek(leveldb::Slice(&ssKey[0], ssKey.size()));
+    else if (fFlags == DB_NEXT && pcursor->fStarted)
+        piter->Next();
+    else if (fFlags == DB_NEXT || fFlags == DB_FIRST)
+        piter->SeekToFirst();
+    else
+        return EINVAL;
+    pcursor->fStarted = true;
+
+    if (!piter->Valid())
+        return piter->status().ok() ? DB_NOTFOUND : 99999;
+
+    // Convert to streams
+    leveldb::Slice key = piter->key();
+    leveldb::Slice value = piter->value();
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(key.data(), key.size());
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(value.data(), value.size());
+    return 0;
+}
+
+bool CDB::TxnBeginLevelDB()
+{
+    if (pbatch)
+        return false;
+    pbatch = new leveldb::WriteBatch();
+    return true;
+}
+
+bool CDB::TxnCommitLevelDB()
+{
+    if (!pbatch)
+        return false;
+    leveldb::Status status = pldb->Write(leveldb::WriteOptions(), pbatch);
+    delete pbatch;
+    pbatch = NULL;
+    if (!status.ok())
+        return error("CDB::TxnCommitLevelDB : %s", status.ToString().c_str());
+    return true;
+}
+
+bool CDB::TxnAbortLevelDB()
+{
+    if (!pbatch)
+        return false;
+    delete pbatch;
+    pbatch = NULL;
+    return true;
+}
+
+bool CDB::MigrateToLevelDB(const string& strFile)
+{
+    boost::filesystem::path pathLevelDB = bitdb.GetLevelDBPath(strFile);
+    boost::filesystem::path pathTmp(pathLevelDB.string() + ".tmp");
+    printf("Migrating %s to %s...\n", strFile.c_str(), pathLevelDB.string().c_str());
+    int64_t nStart = GetTimeMillis();
+
+    leveldb::DB* pldbCopy = NULL;
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.error_if_exists = true;
+    boost::filesystem::remove_all(pathTmp);
+    leveldb::Status status = leveldb::DB::Open(options, pathTmp.string(), &pldbCopy);
+    if (!status.ok())
+        return error("CDB::MigrateToLevelDB : error creating %s: %s", pathTmp.string().c_str(), status.ToString().c_str());
+
+    bool fSuccess = true;
+    unsigned int nRecords = 0;
+    {
+        CDB db(strFile.c_str(), "r");
+        CDBCursor* pcursor = db.GetCursor();
+        if (!pcursor)
+            fSuccess = false;
+
+        leveldb::WriteBatch batch;
+        while (fSuccess)
+        {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = db.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
+            if (ret == DB_NOTFOUND)
+                break;
+            else if (ret != 0)
+            {
+                fSuccess = false;
+                break;
+            }
+            batch.Put(leveldb::Slice(&ssKey[0], ssKey.size()), leveldb::Slice(&ssValue[0], ssValue.size()));
+            if (++nRecords % 10000 == 0)
+            {
+                status = pldbCopy->Write(leveldb::WriteOptions(), &batch);
+                batch.Clear();
+                if (!status.ok())
+                {
+                    printf("CDB::MigrateToLevelDB : %s\n", status.ToString().c_str());
+                    fSuccess = false;
+                }
+            }
+        }
+        if (pcursor)
+            pcursor->close();
+
+        if (fSuccess)
+        {
+            leveldb::WriteOptions writeOptions;
+            writeOptions.sync = true;
+            status = pldbCopy->Write(writeOptions, &batch);
+            if (!status.ok())
+            {
+                printf("CDB::MigrateToLevelDB : %s\n", status.ToString().c_str());
+                fSuccess = false;
+            }
+        }
+    }
+    delete pldbCopy;
+
+    {
+        // The Berkeley DB file is not opened again, leave it self contained
+        LOCK(bitdb.cs_db);
+        bitdb.CloseDb(strFile);
+        bitdb.CheckpointLSN(strFile);
+        bitdb.mapFileUseCount.erase(strFile);
+    }
+
+    if (fSuccess)
+    {
+        try {
+            boost::filesystem::rename(pathTmp, pathLevelDB);
+        } catch (const boost::filesystem::filesystem_error& e) {
+            printf("CDB::MigrateToLevelDB : %s\n", e.what());
+            fSuccess = false;
+        }
+    }
+    if (!fSuccess)
+    {
+        boost::filesystem::remove_all(pathTmp);
+        return error("CDB::MigrateToLevelDB : migration of %s FAILED", strFile.c_str());
+    }
+
+    printf("Migrated %u records of %s in %" PRId64"ms\n", nRecords, strFile.c_str(), GetTimeMillis() - nStart);
+
+    // The old file keeps the keys as they were, unencrypted if the wallet was,
+    // and encrypting the wallet later does not touch it. Give it a name that
+    // says it is a stale backup.
+    try {
+        boost::filesystem::rename(GetDataDir() / strFile, bitdb.GetMigratedPath(strFile));
+    } catch (const boost::filesystem::filesystem_error& e) {
+        printf("CDB::MigrateToLevelDB : could not rename %s: %s\n", strFile.c_str(), e.what());
+    }
+    return true;
+}
+
+
 //
 // CAddrDB
 //
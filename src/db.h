@@ -8,11 +8,14 @@
 #include "main.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 #include <db_cxx.h>
 
+namespace leveldb { class DB; class Iterator; class WriteBatch; }
+
 class CAddress;
 class CAddrMan;
 class CBlockLocator;
@@ -21,6 +24,7 @@ class CDiskTxPos;
 class CMasterKey;
 class COutPoint;
 class CTxIndex;
+class CDB;
 class CWallet;
 class CWalletTx;
 
@@ -46,6 +50,8 @@ public:
     DbEnv dbenv;
     std::map<std::string, int> mapFileUseCount;
     std::map<std::string, Db*> mapDb;
+    std::set<std::string> setLevelDBFiles;              // files kept in LevelDB instead of Berkeley DB
+    std::map<std::string, leveldb::DB*> mapLevelDB;
 
     CDBEnv();
     ~CDBEnv();
@@ -80,6 +86,20 @@ public:
     void CloseDb(const std::string& strFile);
     bool RemoveDb(const std::string& strFile);
 
+    /* LevelDB store of a wallet file, selected with -walletbackend=leveldb.
+     * Writes are appended to the LevelDB log without a sync, SyncLevelDB
+     * makes them durable. The handles are opened under cs_db.
+     */
+    void UseLevelDB(const std::string& strFile) { setLevelDBFiles.insert(strFile); }
+    bool IsLevelDB(const std::string& strFile) const { return setLevelDBFiles.count(strFile) > 0; }
+    boost::filesystem::path GetLevelDBPath(const std::string& strFile) const;
+    // The Berkeley DB file is renamed to this once it was migrated
+    boost::filesystem::path GetMigratedPath(const std::string& strFile) const;
+    leveldb::DB* OpenLevelDB(const std::string& strFile, bool fCreate);
+    void CloseLevelDB(const std::string& strFile);
+    bool SyncLevelDB(const std::string& strFile);
+    bool BackupLevelDB(const std::string& strFile, const boost::filesystem::path& pathDest);
+
     DbTxn *TxnBegin(int flags=DB_TXN_WRITE_NOSYNC)
     {
         DbTxn* ptxn = NULL;
@@ -93,12 +113,38 @@ public:
 extern CDBEnv bitdb;
 
 
-/** RAII class that provides access to a Berkeley database */
+/** Cursor over a CDB, either a Berkeley DB cursor or a LevelDB iterator.
+ *  Like Dbc, the cursor is freed by close(). */
+class CDBCursor
+{
+public:
+    CDB* pdb;
+    Dbc* pdbc;
+    leveldb::Iterator* piter;   // iterates the committed state, not the active batch
+    bool fStarted;
+
+    CDBCursor(CDB* pdbIn, Dbc* pdbcIn) : pdb(pdbIn), pdbc(pdbcIn), piter(NULL), fStarted(false) {}
+    CDBCursor(CDB* pdbIn, leveldb::Iterator* piterIn) : pdb(pdbIn), pdbc(NULL), piter(piterIn), fStarted(false) {}
+
+    int close();
+    int del(unsigned int fFlags);
+private:
+    ~CDBCursor();
+    CDBCursor(const CDBCursor&);
+    void operator=(const CDBCursor&);
+};
+
+
+/** RAII class that provides access to a Berkeley database or, for files
+ *  selected with CDBEnv::UseLevelDB, to a LevelDB store */
 class CDB
 {
 friend class CNameDB; //Denarius Name Database
+friend class CDBCursor;
 protected:
     Db* pdb;
+    leveldb::DB* pldb;
+    leveldb::WriteBatch* pbatch;    // LevelDB counterpart of activeTxn
     std::string strFile;
     DbTxn *activeTxn;
     bool fReadOnly;
@@ -111,17 +157,43 @@ private:
     CDB(const CDB&);
     void operator=(const CDB&);
 
+    bool ReadLevelDB(const CDataStream& ssKey, CDataStream& ssValue);
+    bool WriteLevelDB(const CDataStream& ssKey, const CDataStream& ssValue, bool fOverwrite);
+    bool EraseLevelDB(const CDataStream& ssKey);
+    bool ExistsLevelDB(const CDataStream& ssKey);
+    bool ScanBatch(const CDataStream& ssKey, std::string* pstrValue, bool* pfDeleted) const;
+    CDBCursor* GetLevelDBCursor();
+    int ReadAtIterator(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags);
+    bool TxnBeginLevelDB();
+    bool TxnCommitLevelDB();
+    bool TxnAbortLevelDB();
+
 protected:
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
-        if (!pdb)
+        if (!pdb && !pldb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (pldb)
+        {
+            CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            if (!ReadLevelDB(ssKey, ssValue))
+                return false;
+            try {
+                ssValue >> value;
+            }
+            catch (std::exception &e) {
+                return false;
+            }
+            return true;
+        }
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Read
@@ -134,7 +206,7 @@ protected:
 
         // Unserialize value
         try {
-            CDataStream ssValue((char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size(), SER_DISK, CLIENT_VERSION);
+            CSecureDataStream ssValue((char*)datValue.get_data(), (char*)datValue.get_data() + datValue.get_size(), SER_DISK, CLIENT_VERSION);
             ssValue >> value;
         }
         catch (std::exception &e) {
@@ -150,7 +222,7 @@ protected:
     template<typename K, typename T>
     bool Write(const K& key, const T& value, bool fOverwrite=true)
     {
-        if (!pdb)
+        if (!pdb && !pldb)
             return false;
         if (fReadOnly)
             assert(!"Write called on database in read-only mode");
@@ -159,12 +231,16 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        Dbt datKey(&ssKey[0], ssKey.size());
 
         // Value
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
+
+        if (pldb)
+            return WriteLevelDB(ssKey, ssValue, fOverwrite);
+
+        Dbt datKey(&ssKey[0], ssKey.size());
         Dbt datValue(&ssValue[0], ssValue.size());
 
         // Write
@@ -179,7 +255,7 @@ protected:
     template<typename K>
     bool Erase(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !pldb)
             return false;
         if (fReadOnly)
             assert(!"Erase called on database in read-only mode");
@@ -188,6 +264,10 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (pldb)
+            return EraseLevelDB(ssKey);
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Erase
@@ -201,13 +281,17 @@ protected:
     template<typename K>
     bool Exists(const K& key)
     {
-        if (!pdb)
+        if (!pdb && !pldb)
             return false;
 
         // Key
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
+
+        if (pldb)
+            return ExistsLevelDB(ssKey);
+
         Dbt datKey(&ssKey[0], ssKey.size());
 
         // Exists
@@ -218,21 +302,26 @@ protected:
         return (ret == 0);
     }
 
-    Dbc* GetCursor()
+    CDBCursor* GetCursor()
     {
+        if (pldb)
+            return GetLevelDBCursor();
         if (!pdb)
             return NULL;
-        Dbc* pcursor = NULL;
-        int ret = pdb->cursor(NULL, &pcursor, 0);
+        Dbc* pdbc = NULL;
+        int ret = pdb->cursor(NULL, &pdbc, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(this, pdbc);
     }
 
 public:
 
-    int ReadAtCursor(Dbc* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
+    int ReadAtCursor(CDBCursor* pcursor, CDataStream& ssKey, CDataStream& ssValue, unsigned int fFlags=DB_NEXT)
     {
+        if (pcursor->piter)
+            return ReadAtIterator(pcursor, ssKey, ssValue, fFlags);
+
         // Read at cursor
         Dbt datKey;
         if (fFlags == DB_SET || fFlags == DB_SET_RANGE || fFlags == DB_GET_BOTH || fFlags == DB_GET_BOTH_RANGE)
@@ -248,7 +337,7 @@ public:
         }
         datKey.set_flags(DB_DBT_MALLOC);
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pcursor->get(&datKey, &datValue, fFlags);
+        int ret = pcursor->pdbc->get(&datKey, &datValue, fFlags);
         if (ret != 0)
             return ret;
         else if (datKey.get_data() == NULL || datValue.get_data() == NULL)
@@ -272,6 +361,8 @@ public:
 
     bool TxnBegin()
     {
+        if (pldb)
+            return TxnBeginLevelDB();
         if (!pdb || activeTxn)
             return false;
         DbTxn* ptxn = bitdb.TxnBegin();
@@ -283,6 +374,8 @@ public:
 
     bool TxnCommit()
     {
+        if (pldb)
+            return TxnCommitLevelDB();
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->commit(0);
@@ -292,6 +385,8 @@ public:
 
     bool TxnAbort()
     {
+        if (pldb)
+            return TxnAbortLevelDB();
         if (!pdb || !activeTxn)
             return false;
         int ret = activeTxn->abort();
@@ -311,6 +406,9 @@ public:
     }
 
     bool static Rewrite(const std::string& strFile, const char* pszSkip = NULL);
+    /* Copies every record of the Berkeley DB file strFile into its LevelDB
+     * store. The Berkeley DB file is left in place as a backup. */
+    bool static MigrateToLevelDB(const std::string& strFile);
 };
 
 
@@ -31,10 +31,14 @@
 #else
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #endif
 
 #include <ctype.h>
 
+#include <atomic>
+#include <unordered_map>
+
 #include "namecoin.h"
 #include "util.h"
 #include "ddns.h"
@@ -78,6 +82,8 @@ int inet_pton(int af, const char *src, void *dst)
   return 0;
 }
 
+#define strtok_r strtok_s
+
 char *strsep(char **s, const char *ct)
 {
     char *sstart = *s;
@@ -96,25 +102,176 @@ char *strsep(char **s, const char *ct)
 
 /*---------------------------------------------------*/
 
-DDns::DDns(const char *bind_ip, uint16_t port_no,
-      const char *gw_suffix, const char *allowed_suff, const char *local_fname, uint8_t verbose)
-    : m_status(0), m_thread(StatRun, this) {
+// Answer cache and counters, shared by all workers
 
-    // Set object to a new state
-    memset(this, 0, sizeof(DDns)); // Clear previous state
-    m_verbose = verbose;
+class DDnsCache {
+  public:
+    DDnsCache() : m_max_names(DDNS_CACHE_NAMES), m_max_ttl(DDNS_CACHE_TTL) {}
 
-    struct sockaddr_in m_address;
-    const int m_addresslen = sizeof(struct sockaddr_in);
-    memset(&m_address, 0, m_addresslen);
+    void Init(uint32_t max_names, uint32_t max_ttl) {
+      m_max_names = max_names / DDNS_CACHE_SHARDS + 1;
+      m_max_ttl   = max_ttl;
+      for(int i = 0; i < DDNS_CACHE_SHARDS; i++) {
+        boost::unique_lock<boost::mutex> lock(m_shards[i].mutex);
+        m_shards[i].names.clear();
+      }
+    }
+
+    // Returns 1 = found, 0 = cached NXDOMAIN, -1 = not cached
+    int Lookup(const string &name, string &value) {
+      if(m_max_ttl == 0)
+        return -1;
+      Shard &shard = GetShard(name);
+      boost::unique_lock<boost::mutex> lock(shard.mutex);
+      std::unordered_map<string, Entry>::iterator it = shard.names.find(name);
+      if(it == shard.names.end())
+        return -1;
+      if(it->second.expires < GetTime()) {
+        shard.names.erase(it);
+        return -1;
+      }
+      if(it->second.found)
+        value = it->second.value;
+      return it->second.found;
+    }
+
+    void Store(const string &name, bool found, const string &value, uint32_t ttl) {
+      if(m_max_ttl == 0)
+        return;
+      Shard &shard = GetShard(name);
+      boost::unique_lock<boost::mutex> lock(shard.mutex);
+      if(shard.names.size() >= m_max_names)
+        shard.names.erase(shard.names.begin()); // arbitrary victim
+      Entry &entry = shard.names[name];
+      entry.found   = found;
+      entry.value   = value;
+      entry.expires = GetTime() + std::min(ttl, m_max_ttl);
+    }
 
-    // Create and socket
+    void Invalidate(const string &name) {
+      Shard &shard = GetShard(name);
+      boost::unique_lock<boost::mutex> lock(shard.mutex);
+      shard.names.erase(name);
+    }
+
+    uint64_t Size() {
+      uint64_t size = 0;
+      for(int i = 0; i < DDNS_CACHE_SHARDS; i++) {
+        boost::unique_lock<boost::mutex> lock(m_shards[i].mutex);
+        size += m_shards[i].names.size();
+      }
+      return size;
+    }
+
+  private:
+    enum { DDNS_CACHE_SHARDS = 16 };
+
+    struct Entry {
+      string  value;
+      int64_t expires;
+      bool    found;
+    };
+
+    struct Shard {
+      boost::mutex mutex;
+      std::unordered_map<string, Entry> names;
+    };
+
+    Shard &GetShard(const string &name) {
+      return m_shards[std::hash<string>()(name) % DDNS_CACHE_SHARDS];
+    }
+
+    Shard    m_shards[DDNS_CACHE_SHARDS];
+    uint32_t m_max_names;
+    uint32_t m_max_ttl;
+}; // class DDnsCache
+
+struct DDnsCounters {
+  std::atomic<uint64_t> queries, dropped, errors, cache_hits, cache_misses;
+  std::atomic<uint64_t> latency_us, latency_max_us;
+  std::atomic<uint64_t> latency_hist[5];
+  std::atomic<uint8_t>  threads;
+
+  DDnsCounters() : queries(0), dropped(0), errors(0), cache_hits(0), cache_misses(0),
+    latency_us(0), latency_max_us(0), threads(0) {
+    for(int i = 0; i < 5; i++)
+      latency_hist[i] = 0;
+  }
+
+  void AddLatency(uint64_t us) {
+    latency_us += us;
+    uint64_t prev = latency_max_us;
+    while(us > prev && !latency_max_us.compare_exchange_weak(prev, us))
+      ;
+    int bucket = 0;
+    for(uint64_t limit = 100; bucket < 4 && us >= limit; limit *= 10)
+      bucket++;
+    latency_hist[bucket]++;
+  }
+}; // struct DDnsCounters
+
+static DDnsCache    ddns_cache;
+static DDnsCounters ddns_stats;
+
+void DDnsCacheInit(uint32_t max_names, uint32_t max_ttl) {
+  ddns_cache.Init(max_names, max_ttl);
+}
+
+void DDnsInvalidate(const string &name) {
+  ddns_cache.Invalidate(name);
+}
+
+void DDnsGetStats(DDnsStats &stats) {
+  stats.queries      = ddns_stats.queries;
+  stats.dropped      = ddns_stats.dropped;
+  stats.errors       = ddns_stats.errors;
+  stats.cache_hits   = ddns_stats.cache_hits;
+  stats.cache_misses = ddns_stats.cache_misses;
+  stats.cache_size   = ddns_cache.Size();
+  stats.latency_us   = ddns_stats.latency_us;
+  stats.latency_max_us = ddns_stats.latency_max_us;
+  for(int i = 0; i < 5; i++)
+    stats.latency_hist[i] = ddns_stats.latency_hist[i];
+  stats.threads      = ddns_stats.threads;
+}
+
+/*---------------------------------------------------*/
+
+SOCKET DDns::OpenSocket(bool reuseport) {
     int ret = socket(PF_INET, SOCK_DGRAM, 0);
-    if(ret < 0) {
-      throw runtime_error("DDns::DDns: Cannot create socket");
-    } else {
-      m_sockfd = ret;
+    if(ret < 0)
+      return INVALID_SOCKET;
+    SOCKET sockfd = ret;
+
+#ifdef SO_REUSEPORT
+    // Every worker binds its own socket to the same port, the kernel spreads
+    // clients over them
+    int one = 1;
+    if(reuseport && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, (const char *)&one, sizeof(one)) < 0) {
+      closesocket(sockfd);
+      return INVALID_SOCKET;
+    }
+#endif
+
+    if(::bind(sockfd, (struct sockaddr *)&m_address, sizeof(struct sockaddr_in)) < 0) {
+      closesocket(sockfd);
+      return INVALID_SOCKET;
     }
+    return sockfd;
+} // DDns::OpenSocket
+
+/*---------------------------------------------------*/
+
+DDns::DDns(const char *bind_ip, uint16_t port_no,
+      const char *gw_suffix, const char *allowed_suff, const char *local_fname, uint8_t verbose,
+      uint8_t threads)
+    : m_dap_ht(NULL), m_value(NULL), m_gw_suffix(NULL), m_daprand(0), m_gw_suf_len(0), m_gw_suf_dots(0),
+      m_verbose(verbose), m_allowed_qty(0), m_status(0), m_allowed_base(NULL), m_local_base(NULL) {
+
+    memset(m_ht_offset, 0, sizeof(m_ht_offset));
+
+    const int m_addresslen = sizeof(struct sockaddr_in);
+    memset(&m_address, 0, m_addresslen);
 
     m_address.sin_family = AF_INET;
     m_address.sin_port = htons(port_no);
@@ -122,13 +279,25 @@ DDns::DDns(const char *bind_ip, uint16_t port_no,
     if(!inet_pton(AF_INET, bind_ip, &m_address.sin_addr.s_addr))
       m_address.sin_addr.s_addr = htonl(INADDR_ANY);
 
+    if(threads < 1)
+      threads = 1;
+#ifndef SO_REUSEPORT
+    bool reuseport = false;
+#else
+    bool reuseport = threads > 1;
+#endif
 
-    if(::bind(m_sockfd, (struct sockaddr *)&m_address, m_addresslen) < 0) {
-//    if(bind(m_sockfd, (struct sockaddr *) &m_address,
-//                     sizeof (struct sockaddr_in)) < 0) {
-      char buf[80];
-      sprintf(buf, "DDns::DDns: Cannot bind to port %u", port_no);
-      throw runtime_error(buf);
+    // Create and bind socket(s); without SO_REUSEPORT all workers share one
+    for(int i = 0; i < (reuseport? threads : 1); i++) {
+      SOCKET sockfd = OpenSocket(reuseport);
+      if(sockfd == INVALID_SOCKET) {
+        if(i > 0)
+          break; // serve with the sockets we have
+        char buf[80];
+        sprintf(buf, "DDns::DDns: Cannot bind to port %u", port_no);
+        throw runtime_error(buf);
+      }
+      m_sockets.push_back(sockfd);
     }
 
     // Create temporary local buf on stack
@@ -169,15 +338,12 @@ DDns::DDns(const char *bind_ip, uint16_t port_no,
     m_dap_ht  = (allowed_len | m_gw_suf_len)? (DNSAP*)calloc(DDNS_DAPSIZE, sizeof(DNSAP)) : NULL;
     m_daprand = GetRand(0xffffffff) | 1;
 
-    m_value  = (char *)malloc(VAL_SIZE + BUF_SIZE + 2 +
-        m_gw_suf_len + allowed_len + local_len + 4);
+    m_value  = (char *)malloc(m_gw_suf_len + allowed_len + local_len + 4);
 
     if(m_value == NULL)
       throw runtime_error("DDns::DDns: Cannot allocate buffer");
 
-    m_buf    = (uint8_t *)(m_value + VAL_SIZE);
-    m_bufend = m_buf + MAX_OUT;
-    char *varbufs = m_value + VAL_SIZE + BUF_SIZE + 2;
+    char *varbufs = m_value;
 
     m_gw_suffix = m_gw_suf_len?
       strcpy(varbufs, gw_suffix) : NULL;
@@ -242,18 +408,32 @@ DDns::DDns(const char *bind_ip, uint16_t port_no,
          port_no, m_allowed_qty, local_qty);
 
     m_status = 1; // Active
+
+    for(int i = 0; i < threads; i++)
+      m_workers.push_back(new DDnsWorker(this, m_sockets[i % m_sockets.size()]));
+    for(unsigned i = 0; i < m_workers.size(); i++)
+      m_threads.create_thread(boost::bind(&DDns::StatRun, m_workers[i]));
+    ddns_stats.threads = m_workers.size();
+
+    if(m_verbose > 0)
+     printf("DDns::DDns: %u workers on %u sockets\n", (unsigned)m_workers.size(), (unsigned)m_sockets.size());
 } // DDns::DDns
 
 /*---------------------------------------------------*/
 
 DDns::~DDns() {
     // reset current object to initial state
+    m_status = 0;
+    for(unsigned i = 0; i < m_sockets.size(); i++) {
 #ifndef WIN32
-    shutdown(m_sockfd, SHUT_RDWR);
+      shutdown(m_sockets[i], SHUT_RDWR);
 #endif
-    close(m_sockfd);
-    MilliSleep(100); // Allow 0.1s my thread to exit
-    // m_thread.join();
+      closesocket(m_sockets[i]);
+    }
+    m_threads.join_all();
+    for(unsigned i = 0; i < m_workers.size(); i++)
+      delete m_workers[i];
+    ddns_stats.threads = 0;
     free(m_value);
     free(m_dap_ht);
     if(m_verbose > 0)
@@ -264,46 +444,142 @@ DDns::~DDns() {
 /*---------------------------------------------------*/
 
 void DDns::StatRun(void *p) {
-  DDns *obj = (DDns*)p;
+  DDnsWorker *obj = (DDnsWorker*)p;
+  RenameThread("denarius-ddns");
   obj->Run();
-//denarius  ExitThread(0);
 } // DDns::StatRun
 
 /*---------------------------------------------------*/
+// Workers run on their own threads; the daemon parks its main thread here
 void DDns::Run() {
+  while(!fShutdown)
+    MilliSleep(200);
+} //  DDns::Run
+
+/*---------------------------------------------------*/
+
+DDnsWorker::DDnsWorker(DDns *dns, SOCKET sockfd)
+    : m_dns(dns), m_hdr(NULL), m_dap_ht(dns->m_dap_ht), m_gw_suffix(dns->m_gw_suffix),
+      m_buf(NULL), m_bufend(NULL), m_snd(NULL), m_rcv(NULL), m_rcvend(NULL), m_sockfd(sockfd), m_rcvlen(0),
+      m_daprand(dns->m_daprand), m_ttl(0), m_label_ref(0), m_gw_suf_len(dns->m_gw_suf_len),
+      m_gw_suf_dots(dns->m_gw_suf_dots), m_verbose(dns->m_verbose), m_allowed_qty(dns->m_allowed_qty),
+      m_allowed_base(dns->m_allowed_base), m_local_base(dns->m_local_base), m_ht_offset(dns->m_ht_offset) {
+    m_value = (char *)malloc(VAL_SIZE + DDNS_BATCH * (BUF_SIZE + 2));
+    if(m_value == NULL)
+      throw runtime_error("DDnsWorker::DDnsWorker: Cannot allocate buffer");
+    m_bufs = (uint8_t *)(m_value + VAL_SIZE);
+} // DDnsWorker::DDnsWorker
+
+DDnsWorker::~DDnsWorker() {
+    free(m_value);
+} // DDnsWorker::~DDnsWorker
+
+/*---------------------------------------------------*/
+// Answer the packet in m_buf/m_rcvlen, unless DAP says to drop it
+void DDnsWorker::HandleOne(struct sockaddr_in *addr, socklen_t addrlen) {
+  int64_t start = GetTimeMicros();
+  DNSAP *dap = NULL;
+
+  if(m_dap_ht != NULL && (dap = CheckDAP(addr->sin_addr.s_addr)) == NULL) {
+    ddns_stats.dropped++;
+    m_snd = m_buf; // nothing to send
+    return;
+  }
+
+  m_bufend = m_buf + MAX_OUT;
+  m_buf[BUF_SIZE] = 0; // Set terminal for infinity QNAME
+  HandlePacket();
+
+  if(dap != NULL)
+    dap->ed_size += (m_snd - m_buf) >> 6;
+
+  ddns_stats.queries++;
+  if(m_buf[3] & 0x0f)
+    ddns_stats.errors++;
+  ddns_stats.AddLatency(GetTimeMicros() - start);
+} // DDnsWorker::HandleOne
+
+/*---------------------------------------------------*/
+void DDnsWorker::Run() {
   if(m_verbose > 2) printf("DDns::Run: started\n");
 
-  while(m_status == 0)
-      MilliSleep(133);
+#ifdef __linux__
+  // Receive and answer up to DDNS_BATCH packets per system call
+  struct mmsghdr     rcv_msgs[DDNS_BATCH], snd_msgs[DDNS_BATCH];
+  struct iovec       rcv_iov[DDNS_BATCH], snd_iov[DDNS_BATCH];
+  struct sockaddr_in addrs[DDNS_BATCH];
 
   for( ; ; ) {
-    m_addrLen = sizeof(m_clientAddress);
-    m_rcvlen  = recvfrom(m_sockfd, (char *)m_buf, BUF_SIZE, 0,
-                (struct sockaddr *) &m_clientAddress, &m_addrLen);
-    if(m_rcvlen <= 0)
-    break;
+    memset(rcv_msgs, 0, sizeof(rcv_msgs));
+    for(int i = 0; i < DDNS_BATCH; i++) {
+      rcv_iov[i].iov_base = m_bufs + i * (BUF_SIZE + 2);
+      rcv_iov[i].iov_len  = BUF_SIZE;
+      rcv_msgs[i].msg_hdr.msg_iov     = &rcv_iov[i];
+      rcv_msgs[i].msg_hdr.msg_iovlen  = 1;
+      rcv_msgs[i].msg_hdr.msg_name    = &addrs[i];
+      rcv_msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    }
 
-    DNSAP *dap = NULL;
+    int rcvqty = recvmmsg(m_sockfd, rcv_msgs, DDNS_BATCH, MSG_WAITFORONE, NULL);
+    if(rcvqty < 0 && errno == EINTR)
+      continue;
+    if(rcvqty <= 0 || m_dns->m_status == 0) {
+      m_rcvlen = rcvqty;
+      break;
+    }
 
-    if(m_dap_ht == NULL || (dap = CheckDAP(m_clientAddress.sin_addr.s_addr)) != NULL) {
-      m_buf[BUF_SIZE] = 0; // Set terminal for infinity QNAME
-      HandlePacket();
+    int sndqty = 0;
+    memset(snd_msgs, 0, sizeof(snd_msgs));
+    for(int i = 0; i < rcvqty; i++) {
+      m_buf    = (uint8_t *)rcv_iov[i].iov_base;
+      m_rcvlen = rcv_msgs[i].msg_len;
+      if(m_rcvlen <= 0)
+        continue;
+      HandleOne(&addrs[i], rcv_msgs[i].msg_hdr.msg_namelen);
+      if(m_snd == m_buf)
+        continue;
+      snd_iov[sndqty].iov_base = m_buf;
+      snd_iov[sndqty].iov_len  = m_snd - m_buf;
+      snd_msgs[sndqty].msg_hdr.msg_iov     = &snd_iov[sndqty];
+      snd_msgs[sndqty].msg_hdr.msg_iovlen  = 1;
+      snd_msgs[sndqty].msg_hdr.msg_name    = &addrs[i];
+      snd_msgs[sndqty].msg_hdr.msg_namelen = rcv_msgs[i].msg_hdr.msg_namelen;
+      sndqty++;
+    }
 
-      sendto(m_sockfd, (const char *)m_buf, m_snd - m_buf, MSG_NOSIGNAL,
-                 (struct sockaddr *) &m_clientAddress, m_addrLen);
+    for(int sent = 0; sent < sndqty; ) {
+      int ret = sendmmsg(m_sockfd, snd_msgs + sent, sndqty - sent, MSG_NOSIGNAL);
+      if(ret <= 0)
+        break;
+      sent += ret;
+    }
+  } // for
+#else
+  struct sockaddr_in clientAddress;
+  socklen_t addrLen;
+  m_buf = m_bufs;
 
-      if(dap != NULL)
-        dap->ed_size += (m_snd - m_buf) >> 6;
-    } // dap check
+  for( ; ; ) {
+    addrLen  = sizeof(clientAddress);
+    m_rcvlen = recvfrom(m_sockfd, (char *)m_buf, BUF_SIZE, 0,
+                (struct sockaddr *) &clientAddress, &addrLen);
+    if(m_rcvlen <= 0 || m_dns->m_status == 0)
+    break;
+
+    HandleOne(&clientAddress, addrLen);
+    if(m_snd != m_buf)
+      sendto(m_sockfd, (const char *)m_buf, m_snd - m_buf, MSG_NOSIGNAL,
+                 (struct sockaddr *) &clientAddress, addrLen);
   } // for
+#endif
 
   if(m_verbose > 2) printf("DDns::Run: Received Exit packet_len=%d\n", m_rcvlen);
 
-} //  DDns::Run
+} //  DDnsWorker::Run
 
 /*---------------------------------------------------*/
 
-void DDns::HandlePacket() {
+void DDnsWorker::HandlePacket() {
   if(m_verbose > 2) printf("DDns::HandlePacket: Handle packet_len=%d\n", m_rcvlen);
 
   m_hdr = (DNSHeader *)m_buf;
@@ -381,7 +657,7 @@ void DDns::HandlePacket() {
 } // DDns::HandlePacket
 
 /*---------------------------------------------------*/
-uint16_t DDns::HandleQuery() {
+uint16_t DDnsWorker::HandleQuery() {
   // Decode qname
   uint8_t key[BUF_SIZE];				// Key, transformed to dot-separated LC
   uint8_t *key_end = key;
@@ -545,7 +821,7 @@ uint16_t DDns::HandleQuery() {
 } // DDns::HandleQuery
 
 /*---------------------------------------------------*/
-int DDns::TryMakeref(uint16_t label_ref) {
+int DDnsWorker::TryMakeref(uint16_t label_ref) {
   char val2[VAL_SIZE];
   char *tokens[MAX_TOK];
   int ttlqty = Tokenize("TTL", NULL, tokens, strcpy(val2, m_value));
@@ -561,7 +837,7 @@ int DDns::TryMakeref(uint16_t label_ref) {
 } //  DDns::TryMakeref
 /*---------------------------------------------------*/
 
-int DDns::Tokenize(const char *key, const char *sep2, char **tokens, char *buf) {
+int DDnsWorker::Tokenize(const char *key, const char *sep2, char **tokens, char *buf) {
   int tokensN = 0;
 
   // Figure out main separator. If not defined, use |
@@ -573,9 +849,10 @@ int DDns::Tokenize(const char *key, const char *sep2, char **tokens, char *buf)
      mainsep[0] = '|';
   mainsep[1] = 0;
 
-  for(char *token = strtok(buf, mainsep);
+  char *save1, *save2;
+  for(char *token = strtok_r(buf, mainsep, &save1);
     token != NULL;
-      token = strtok(NULL, mainsep)) {
+      token = strtok_r(NULL, mainsep, &save1)) {
       // printf("Token:%s\n", token);
       char *val = strchr(token, '=');
       if(val == NULL)
@@ -602,9 +879,9 @@ int DDns::Tokenize(const char *key, const char *sep2, char **tokens, char *buf)
       sep2 = sepulka;
       }
       // Tokenize value
-      for(token = strtok(val, sep2);
+      for(token = strtok_r(val, sep2, &save2);
      token != NULL && tokensN < MAX_TOK;
-       token = strtok(NULL, sep2)) {
+       token = strtok_r(NULL, sep2, &save2)) {
       // printf("Subtoken=%s\n", token);
       tokens[tokensN++] = token;
       }
@@ -615,7 +892,7 @@ int DDns::Tokenize(const char *key, const char *sep2, char **tokens, char *buf)
 
 /*---------------------------------------------------*/
 
-void DDns::Answer_ALL(uint16_t qtype, char *buf) {
+void DDnsWorker::Answer_ALL(uint16_t qtype, char *buf) {
   const char *key;
   switch(qtype) {
       case  1 : key = "A";      break;
@@ -631,7 +908,7 @@ void DDns::Answer_ALL(uint16_t qtype, char *buf) {
   char *tokens[MAX_TOK];
   int tokQty = Tokenize(key, ",", tokens, buf);
 
-  if(m_verbose > 0) printf("DDns::Answer_ALL(QT=%d, key=%s); TokenQty=%d\n", qtype, key, tokQty);
+  if(m_verbose > 0) printf("DDnsWorker::Answer_ALL(QT=%d, key=%s); TokenQty=%d\n", qtype, key, tokQty);
 
   // Shuffle tokens for randomization output order
   for(int i = tokQty; i > 1; ) {
@@ -665,7 +942,7 @@ void DDns::Answer_ALL(uint16_t qtype, char *buf) {
 
 /*---------------------------------------------------*/
 
-void DDns::Fill_RD_IP(char *ipddrtxt, int af) {
+void DDnsWorker::Fill_RD_IP(char *ipddrtxt, int af) {
   uint16_t out_sz;
   switch(af) {
       case AF_INET : out_sz = 4;  break;
@@ -688,7 +965,7 @@ void DDns::Fill_RD_IP(char *ipddrtxt, int af) {
 
 /*---------------------------------------------------*/
 
-void DDns::Fill_RD_DName(char *txt, uint8_t mxsz, int8_t txtcor) {
+void DDnsWorker::Fill_RD_DName(char *txt, uint8_t mxsz, int8_t txtcor) {
   uint8_t *snd0 = m_snd;
   m_snd += 3 + mxsz; // skip SZ and sz0
   uint8_t *tok_sz = m_snd - 1;
@@ -729,23 +1006,40 @@ void DDns::Fill_RD_DName(char *txt, uint8_t mxsz, int8_t txtcor) {
 /*---------------------------------------------------*/
 /*---------------------------------------------------*/
 
-int DDns::Search(uint8_t *key) {
+int DDnsWorker::Search(uint8_t *key) {
   if(m_verbose > 1)
     printf("DDns::Search(%s)\n", key);
 
+  string name = string("dns:") + (const char *)key;
   string value;
-  if (!hooks->getNameValue(string("dns:") + (const char *)key, value))
+  int found = ddns_cache.Lookup(name, value);
+  if(found < 0) {
+    ddns_stats.cache_misses++;
+    found = hooks->getNameValue(name, value);
+    uint32_t ttl = DDNS_CACHE_NEGTTL;
+    if(found) {
+      char val2[VAL_SIZE];
+      char *tokens[MAX_TOK];
+      strncpy(val2, value.c_str(), VAL_SIZE - 1)[VAL_SIZE - 1] = 0;
+      int ttlqty = Tokenize("TTL", NULL, tokens, val2);
+      ttl = ttlqty? atoi(tokens[0]) : 24 * 3600;
+    }
+    ddns_cache.Store(name, found, value, ttl);
+  } else
+    ddns_stats.cache_hits++;
+
+  if(!found)
     return 0;
 
-  strcpy(m_value, value.c_str());
+  strncpy(m_value, value.c_str(), VAL_SIZE - 1)[VAL_SIZE - 1] = 0;
   return 1;
 } //  DDns::Search
 
 /*---------------------------------------------------*/
 
-int DDns::LocalSearch(const uint8_t *key, uint8_t pos, uint8_t step) {
+int DDnsWorker::LocalSearch(const uint8_t *key, uint8_t pos, uint8_t step) {
   if(m_verbose > 1)
-    printf("DDns::LocalSearch(%s, %u, %u) called\n", key, pos, step);
+    printf("DDnsWorker::LocalSearch(%s, %u, %u) called\n", key, pos, step);
     do {
       pos += step;
       if(m_ht_offset[pos] == 0) {
@@ -763,7 +1057,7 @@ int DDns::LocalSearch(const uint8_t *key, uint8_t pos, uint8_t step) {
 
 /*---------------------------------------------------*/
 // Returns x>0 = hash index to update size; x<0 = disable;
-DNSAP *DDns::CheckDAP(uint32_t ip_addr) {
+DNSAP *DDnsWorker::CheckDAP(uint32_t ip_addr) {
   uint32_t hash = ip_addr * m_daprand;
   hash ^= hash >> 16;
   hash += hash >> 8;
@@ -1,10 +1,17 @@
 #ifndef DDNS_H
 #define DDNS_H
 
+#include <string>
+#include <vector>
+
 #include <boost/thread.hpp>
 
 #define DDNS_DAPSIZE     (8 * 1024)
 #define DDNS_DAPTRESHOLD 300 // 20K/min limit answer
+#define DDNS_BATCH       32  // packets per recvmmsg/sendmmsg call
+#define DDNS_CACHE_NAMES 100000
+#define DDNS_CACHE_TTL   600 // max seconds an answer is served from cache
+#define DDNS_CACHE_NEGTTL 60 // seconds a NXDOMAIN is served from cache
 
 struct DNSHeader {
   static const uint32_t QR_MASK = 0x8000;
@@ -34,16 +41,31 @@ struct DNSAP {		// DNS Amplifier Protector ExpDecay structure
   uint16_t ed_size;	// ExpDecay output size in 64-byte units
 } __attribute__((packed));
 
-class DDns {
+struct DDnsStats {
+  uint64_t queries;	// packets answered
+  uint64_t dropped;	// packets dropped by DAP
+  uint64_t errors;	// answers with RCODE != 0
+  uint64_t cache_hits;	// nameindex lookups answered from cache
+  uint64_t cache_misses;	// nameindex lookups that went to the DB
+  uint64_t cache_size;	// names in the answer cache
+  uint64_t latency_us;	// total handling time of answered packets
+  uint64_t latency_max_us;
+  uint64_t latency_hist[5];	// <100us, <1ms, <10ms, <100ms, more
+  uint8_t  threads;
+};
+
+class DDns;
+
+// One receive/answer loop with its own socket (SO_REUSEPORT) and buffers
+class DDnsWorker {
   public:
-     DDns(const char *bind_ip, uint16_t port_no,
-        const char *gw_suffix, const char *allowed_suff, const char *local_fname, uint8_t verbose);
-    ~DDns();
+    DDnsWorker(DDns *dns, SOCKET sockfd);
+    ~DDnsWorker();
 
     void Run();
 
   private:
-    static void StatRun(void *p);
+    void HandleOne(struct sockaddr_in *addr, socklen_t addrlen);
     void HandlePacket();
     uint16_t HandleQuery();
     int  Search(uint8_t *key);
@@ -60,10 +82,12 @@ class DDns {
     inline void Out2(uint16_t x) { x = htons(x); memcpy(m_snd, &x, 2); m_snd += 2; }
     inline void Out4(uint32_t x) { x = htonl(x); memcpy(m_snd, &x, 4); m_snd += 4; }
 
+    DDns     *m_dns;
     DNSHeader *m_hdr;
-    DNSAP    *m_dap_ht;	// Hashtable for DAP; index is hash(IP)
+    DNSAP    *m_dap_ht;	// Hashtable for DAP; index is hash(IP), shared by all workers
     char     *m_value;
     const char *m_gw_suffix;
+    uint8_t  *m_bufs;	// DDNS_BATCH packet buffers
     uint8_t  *m_buf, *m_bufend, *m_snd, *m_rcv, *m_rcvend;
     SOCKET    m_sockfd;
     int       m_rcvlen;
@@ -74,15 +98,52 @@ class DDns {
     uint8_t   m_gw_suf_dots;
     uint8_t   m_verbose;
     uint8_t   m_allowed_qty;
+    const char *m_allowed_base;
+    const char *m_local_base;
+    const int16_t *m_ht_offset; // Hashtable for allowed TLD-suffixes(>0) and local names(<0)
+
+    friend class DDns;
+}; // class DDnsWorker
+
+class DDns {
+  public:
+     DDns(const char *bind_ip, uint16_t port_no,
+        const char *gw_suffix, const char *allowed_suff, const char *local_fname, uint8_t verbose,
+        uint8_t threads = 1);
+    ~DDns();
+
+    // Block the calling thread while the server is running
+    void Run();
+
+  private:
+    static void StatRun(void *p);
+    SOCKET OpenSocket(bool reuseport);
+
+    DNSAP    *m_dap_ht;	// Hashtable for DAP; index is hash(IP)
+    char     *m_value;
+    const char *m_gw_suffix;
+    uint32_t  m_daprand;	// DAP random value for universal hashing
+    uint16_t  m_gw_suf_len;
+    uint8_t   m_gw_suf_dots;
+    uint8_t   m_verbose;
+    uint8_t   m_allowed_qty;
     uint8_t   m_status;
     char     *m_allowed_base;
     char     *m_local_base;
     int16_t   m_ht_offset[0x100]; // Hashtable for allowed TLD-suffixes(>0) and local names(<0)
-    struct sockaddr_in m_clientAddress;
     struct sockaddr_in m_address;
-    socklen_t m_addrLen;
 
-    boost::thread m_thread;
+    std::vector<SOCKET> m_sockets;
+    std::vector<DDnsWorker*> m_workers;
+    boost::thread_group m_threads;
+
+    friend class DDnsWorker;
 }; // class DDns
 
+// Answer cache of decoded dns: values, shared by all workers
+void DDnsCacheInit(uint32_t max_names, uint32_t max_ttl);
+// Drop a name from the cache; called when a block changes it
+void DDnsInvalidate(const std::string &name);
+void DDnsGetStats(DDnsStats &stats);
+
 #endif // DDNS_H
@@ -270,12 +270,16 @@ static const CRPCCommand vRPCCommands[] =
     { "stop",                   &stop,                   true,   true },
     { "getbestblockhash",       &getbestblockhash,       true,   false },
     { "getblockchaininfo",      &getblockchaininfo,      true,   false },
+    { "getblockfilestats",      &getblockfilestats,      true,   false },
+    { "getdbstats",             &getdbstats,             true,   false },
     { "getblockcount",          &getblockcount,          true,   false },
     { "getconnectioncount",     &getconnectioncount,     true,   false },
     { "getpeerinfo",            &getpeerinfo,            true,   false },
     { "getaddednodeinfo",       &getaddednodeinfo,       true,   true },
     { "ping",                   &ping,                   true,   true },
     { "getnettotals",           &getnettotals,           true,   false },
+    { "getnetmsgstats",         &getnetmsgstats,         true,   false },
+    { "getddnsstats",           &getddnsstats,           true,   false },
     { "disconnectnode",         &disconnectnode,         true,   false },
     { "getnetworkinfo",         &getnetworkinfo,         true,   false },
     { "gethashespersec",        &gethashespersec,        true,   false },
@@ -283,7 +287,7 @@ static const CRPCCommand vRPCCommands[] =
     { "setban",                 &setban,                 true,   true },
     { "listbanned",             &listbanned,             true,   true },
     { "clearbanned",            &clearbanned,            true,   true },
-    { "dumpbootstrap",          &dumpbootstrap,          false,  false },
+    { "dumpbootstrap",          &dumpbootstrap,          false,  true },
     { "getdifficulty",          &getdifficulty,          true,   false },
     { "getinfo",                &getinfo,                true,   false },
 	{ "walletstatus",           &walletstatus,           true,   false },
@@ -324,6 +328,7 @@ static const CRPCCommand vRPCCommands[] =
     { "getblock_old",           &getblock_old,           false,  false },
     { "getblockbynumber",       &getblockbynumber,       false,  false },
     { "getblockhash",           &getblockhash,           false,  false },
+    { "getblockfilter",         &getblockfilter,         false,  false },
     { "gettransaction",         &gettransaction,         false,  false },
     { "listtransactions",       &listtransactions,       false,  false },
     { "listaddressgroupings",   &listaddressgroupings,   false,  false },
@@ -357,6 +362,8 @@ static const CRPCCommand vRPCCommands[] =
     { "resendtx",               &resendtx,               false,  true},
     { "makekeypair",            &makekeypair,            false,  true},
     { "setdebug",               &setdebug,               true,   false },
+    { "logging",                &logging,                true,   false },
+    { "getlockstats",           &getlockstats,           true,   false },
     { "sendalert",              &sendalert,              false,  false},
     { "gettxout",               &gettxout,               true,   false },
     { "importaddress",          &importaddress,          false,  false },
@@ -367,6 +374,7 @@ static const CRPCCommand vRPCCommands[] =
     { "importstealthaddress",   &importstealthaddress,   false,  false},
     { "clearwallettransactions",&clearwallettransactions,false,  false},
     { "scanforalltxns",         &scanforalltxns,         false,  false},
+    { "getrescaninfo",          &getrescaninfo,          true,   true },
 
     // Ring Signatures - D e n a r i u s - v3.1.0
     { "senddtoanon",          	&senddtoanon,          	 false,  false},
@@ -407,6 +415,11 @@ static const CRPCCommand vRPCCommands[] =
     { "jupiterduopod",        &jupiterduopod,            false,  true  },
     { "jupitergetblock",      &jupitergetblock,          false,  false },
     { "jupitergetstat",       &jupitergetstat,           false,  false },
+    { "jupitersubmit",        &jupitersubmit,            false,  false },
+    { "jupiterjobstatus",     &jupiterjobstatus,         false,  false },
+    { "jupiterpodadd",        &jupiterpodadd,            false,  true  },
+    { "jupiterpodflush",      &jupiterpodflush,          false,  false },
+    { "jupiterpodverify",     &jupiterpodverify,         false,  false },
 
     // Denarius Name Commands
     { "name_new",               &name_new,               false,  true },
@@ -1377,6 +1390,7 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     if (strMethod == "getblockbynumber"       && n > 1) ConvertTo<bool>(params[1]);
     if (strMethod == "getblockhash"           && n > 0) ConvertTo<int64_t>(params[0]);
     if (strMethod == "dumpbootstrap"          && n > 1) ConvertTo<int64_t>(params[1]);
+    if (strMethod == "dumpbootstrap"          && n > 2) ConvertTo<bool>(params[2]);
     if (strMethod == "move"                   && n > 2) ConvertTo<double>(params[2]);
     if (strMethod == "move"                   && n > 3) ConvertTo<int64_t>(params[3]);
     if (strMethod == "sendfrom"               && n > 2) ConvertTo<double>(params[2]);
@@ -1420,6 +1434,9 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
 
     if (strMethod == "setban"                 && n > 2) ConvertTo<int64_t>(params[2]);
     if (strMethod == "setban"                 && n == 4) ConvertTo<bool>(params[3]);
+    if (strMethod == "logging"                && n > 0) ConvertTo<Array>(params[0]);
+    if (strMethod == "logging"                && n > 1) ConvertTo<Array>(params[1]);
+    if (strMethod == "getlockstats"           && n > 1) ConvertTo<int64_t>(params[1]);
 
     if (strMethod == "senddtoanon"         	  && n > 1) ConvertTo<double>(params[1]);
     if (strMethod == "sendanontoanon"         && n > 1) ConvertTo<double>(params[1]);
@@ -1449,6 +1466,11 @@ Array RPCConvertValues(const std::string &strMethod, const std::vector<std::stri
     if (strMethod == "name_filter"            && n > 1) ConvertTo<boost::int64_t>(params[1]);
     if (strMethod == "name_filter"            && n > 2) ConvertTo<boost::int64_t>(params[2]);
     if (strMethod == "name_filter"            && n > 3) ConvertTo<boost::int64_t>(params[3]);
+    if (strMethod == "name_filter"            && n > 5) ConvertTo<bool>(params[5]);
+    if (strMethod == "name_count"             && n > 0) ConvertTo<bool>(params[0]);
+    if (strMethod == "jupitersubmit"          && n > 0) ConvertTo<Array>(params[0]);
+    if (strMethod == "jupiterjobstatus"       && n > 0) ConvertTo<boost::int64_t>(params[0]);
+    if (strMethod == "jupiterpodadd"          && n > 0) ConvertTo<Array>(params[0]);
     if (strMethod == "sendtoname"             && n > 1) ConvertTo<double>(params[1]);
 
     return params;
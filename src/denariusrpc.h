@@ -176,6 +176,8 @@ extern json_spirit::Value addnode(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value ping(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getaddednodeinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getnettotals(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getnetmsgstats(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getddnsstats(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getnetworkinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value disconnectnode(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value setban(const json_spirit::Array& params, bool fHelp);
@@ -188,6 +190,8 @@ extern json_spirit::Value dumpprivkey(const json_spirit::Array& params, bool fHe
 extern json_spirit::Value importprivkey(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value setdebug(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value logging(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getlockstats(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value sendalert(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value getsubsidy(const json_spirit::Array& params, bool fHelp);
@@ -255,12 +259,15 @@ extern json_spirit::Value searchrawtransactions(const json_spirit::Array& params
 extern json_spirit::Value getbestblockhash(const json_spirit::Array& params, bool fHelp); // in rpcblockchain.cpp
 extern json_spirit::Value getblockcount(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockchaininfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getblockfilestats(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getdbstats(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value setbestblockbyheight(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value dumpbootstrap(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value settxfee(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getblockfilter(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockheader(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock_old(const json_spirit::Array& params, bool fHelp);
@@ -278,6 +285,11 @@ extern json_spirit::Value jupiterduo(const json_spirit::Array& params, bool fHel
 extern json_spirit::Value jupiterduopod(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value jupitergetblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value jupitergetstat(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value jupitersubmit(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value jupiterjobstatus(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value jupiterpodadd(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value jupiterpodflush(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value jupiterpodverify(const json_spirit::Array& params, bool fHelp);
 
 extern json_spirit::Value name_new(const json_spirit::Array& params, bool fHelp); // in namecoin.cpp Denairus Name commands
 extern json_spirit::Value name_update(const json_spirit::Array& params, bool fHelp);
@@ -297,6 +309,7 @@ extern json_spirit::Value liststealthaddresses(const json_spirit::Array& params,
 extern json_spirit::Value importstealthaddress(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value clearwallettransactions(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value scanforalltxns(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getrescaninfo(const json_spirit::Array& params, bool fHelp);
 
 //RPC Ring Sigs - D e n a r i u s - Q0FSU0VOIEtMT0NL
 extern json_spirit::Value senddtoanon(const json_spirit::Array& params, bool fHelp);
@@ -918,21 +918,20 @@ bool CFortunaQueue::Relay()
 
 bool CFortunaQueue::CheckSignature()
 {
-    for (CFortunaStake& mn : vecFortunastakes) {
-
-        if(mn.vin == vin) {
-            std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
+    LOCK(cs_fortunastakes);
+    const CFortunastakeList& list = vecFortunastakes;
+    const CFortunaStake* pmn = list.Find(vin);
+    if (!pmn)
+        return false;
 
-            std::string errorMessage = "";
-            if(!forTunaSigner.VerifyMessage(mn.pubkey2, vchSig, strMessage, errorMessage)){
-                return error("CFortunaQueue::CheckSignature() - Got bad fortunastake address signature %s \n", vin.ToString().c_str());
-            }
+    std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
 
-            return true;
-        }
+    std::string errorMessage = "";
+    if(!forTunaSigner.VerifyMessage(pmn->pubkey2, vchSig, strMessage, errorMessage)){
+        return error("CFortunaQueue::CheckSignature() - Got bad fortunastake address signature %s \n", vin.ToString().c_str());
     }
 
-    return false;
+    return true;
 }
 
 
@@ -965,24 +964,18 @@ void ThreadCheckForTunaPool(void* parg)
         {
 
         LOCK(cs_fortunastakes);
-            vector<CFortunaStake>::iterator it = vecFortunastakes.begin();
             //check them separately
-            while(it != vecFortunastakes.end()){
-                (*it).Check();
-                ++it;
-            }
+            for (CFortunaStake& mn : vecFortunastakes)
+                mn.Check();
 
-            //remove inactive
-            it = vecFortunastakes.begin();
-            while(it != vecFortunastakes.end()){
-                if((*it).enabled == 4 || (*it).enabled == 3){
-                    printf("Removing inactive fortunastake %s\n", (*it).addr.ToString().c_str());
-                    it = vecFortunastakes.erase(it);
-                    mnCount = mnCount-1;
-                } else {
-                    ++it;
-                }
-            }
+            //remove inactive, in one pass so the indexes are rebuilt once
+            mnCount -= vecFortunastakes.RemoveIf([](const CFortunaStake& mn) {
+                if (mn.enabled != 4 && mn.enabled != 3)
+                    return false;
+                printf("Removing inactive fortunastake %s\n", mn.addr.ToString().c_str());
+                collateralWatch.Remove(mn.vin.prevout);
+                return true;
+            });
 
         }
             fortunastakePayments.CleanPaymentList();
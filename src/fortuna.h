@@ -159,24 +159,22 @@ public:
 
     bool GetAddress(CService &addr)
     {
-        for (CFortunaStake mn : vecFortunastakes) {
-            if(mn.vin == vin){
-                addr = mn.addr;
-                return true;
-            }
-        }
-        return false;
+        LOCK(cs_fortunastakes);
+        CFortunaStake* pmn = vecFortunastakes.Find(vin);
+        if (!pmn)
+            return false;
+        addr = pmn->addr;
+        return true;
     }
 
     bool GetProtocolVersion(int &protocolVersion)
     {
-        for (CFortunaStake mn : vecFortunastakes) {
-            if(mn.vin == vin){
-                protocolVersion = mn.protocolVersion;
-                return true;
-            }
-        }
-        return false;
+        LOCK(cs_fortunastakes);
+        CFortunaStake* pmn = vecFortunastakes.Find(vin);
+        if (!pmn)
+            return false;
+        protocolVersion = pmn->protocolVersion;
+        return true;
     }
 
     bool Sign();
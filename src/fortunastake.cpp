@@ -19,7 +19,9 @@ int CFortunaStake::minProtoVersion = MIN_MN_PROTO_VERSION;
 CCriticalSection cs_fortunastakes;
 
 /** The list of active fortunastakes */
-std::vector<CFortunaStake> vecFortunastakes;
+CFortunastakeList vecFortunastakes;
+/** Spend state of their collateral */
+CCollateralWatch collateralWatch;
 std::vector<pair<int, CFortunaStake*> > vecFortunastakeScores;
 std::vector<CFortunaStake> vecFortunastakeScoresList;
 CFortunaPayments ranks;
@@ -133,36 +135,32 @@ void ProcessMessageFortunastake(CNode* pfrom, std::string& strCommand, CDataStre
 
         //search existing fortunastake list, this is where we update existing fortunastakes with new dsee broadcasts
         LOCK(cs_fortunastakes);
-        for (CFortunaStake& mn : vecFortunastakes) {
-            if(mn.vin.prevout == vin.prevout) {
-                // count == -1 when it's a new entry
-                //   e.g. We don't want the entry relayed/time updated when we're syncing the list
-                // mn.pubkey = pubkey, IsVinAssociatedWithPubkey is validated once below,
-                //   after that they just need to match
-                if(count == -1 && mn.pubkey == pubkey && !mn.UpdatedWithin(FORTUNASTAKE_MIN_DSEE_SECONDS)){
-					mn.UpdateLastSeen(sigTime); // Updated UpdateLastSeen with sigTime
-                    //mn.UpdateLastSeen(); // update last seen without the sigTime since it's a new entry
-					
-                    if(mn.now < sigTime){ //take the newest entry
-                        if (fDebugFS & fDebugNet) printf("dsee - Got updated entry for %s\n", addr.ToString().c_str());
-                        mn.UpdateLastSeen(); // update with current time (i.e. the time we received this 'new' dsee
-                        mn.pubkey2 = pubkey2;
-                        mn.now = sigTime;
-                        mn.sig = vchSig;
-                        mn.protocolVersion = protocolVersion;
-                        mn.addr = addr;
-
-                        RelayForTunaElectionEntry(vin, addr, vchSig, sigTime, pubkey, pubkey2, count, current, lastUpdated, protocolVersion);
-                    }
+        CFortunaStake* pmn = vecFortunastakes.Find(vin.prevout);
+        if (pmn) {
+            CFortunaStake& mn = *pmn;
+            // count == -1 when it's a new entry
+            //   e.g. We don't want the entry relayed/time updated when we're syncing the list
+            // mn.pubkey = pubkey, IsVinAssociatedWithPubkey is validated once below,
+            //   after that they just need to match
+            if(count == -1 && mn.pubkey == pubkey && !mn.UpdatedWithin(FORTUNASTAKE_MIN_DSEE_SECONDS)){
+                mn.UpdateLastSeen(sigTime); // Updated UpdateLastSeen with sigTime
+                //mn.UpdateLastSeen(); // update last seen without the sigTime since it's a new entry
+
+                if(mn.now < sigTime){ //take the newest entry
+                    if (fDebugFS & fDebugNet) printf("dsee - Got updated entry for %s\n", addr.ToString().c_str());
+                    mn.UpdateLastSeen(); // update with current time (i.e. the time we received this 'new' dsee
+                    mn.pubkey2 = pubkey2;
+                    mn.now = sigTime;
+                    mn.sig = vchSig;
+                    mn.protocolVersion = protocolVersion;
+                    mn.addr = addr;
+
+                    RelayForTunaElectionEntry(vin, addr, vchSig, sigTime, pubkey, pubkey2, count, current, lastUpdated, protocolVersion);
                 }
-
-                return;
             }
-        }
 
-        sort(vecFortunastakes.begin(), vecFortunastakes.end());
-        vecFortunastakes.erase(unique(vecFortunastakes.begin(), vecFortunastakes.end() ), vecFortunastakes.end());
-        // printf("Sorted and removed duplicate FS out of the vector!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
+            return;
+        }
 
         if (count > 0) {
             mnMedianCount.input(count);
@@ -215,7 +213,7 @@ void ProcessMessageFortunastake(CNode* pfrom, std::string& strCommand, CDataStre
 
             if (fDebugFS) printf("Registered new fortunastake %s (%i/%i)\n", addr.ToString().c_str(), count, current);
 
-            vecFortunastakes.push_back(mn);
+            vecFortunastakes.Add(mn);
 
         } else {
             if (fDebugFS) printf("dsee - Rejected fortunastake entry %s: %s\n", addr.ToString().c_str(),vinError.c_str());
@@ -245,34 +243,34 @@ void ProcessMessageFortunastake(CNode* pfrom, std::string& strCommand, CDataStre
         }
 
         // see if we have this fortunastake
-	      LOCK(cs_fortunastakes);
-        for (CFortunaStake& mn : vecFortunastakes) {
-            if(mn.vin.prevout == vin.prevout) {
-            	// printf("dseep - Found corresponding mn for vin: %s\n", vin.ToString().c_str());
-            	// take this only if it's newer
-                if(mn.lastDseep < sigTime){
-                    std::string strMessage = mn.addr.ToString() + boost::lexical_cast<std::string>(sigTime) + boost::lexical_cast<std::string>(stop);
-
-                    std::string errorMessage = "";
-                    if(!forTunaSigner.VerifyMessage(mn.pubkey2, vchSig, strMessage, errorMessage)){
-                        if (fDebugFS) printf("dseep - Got bad fortunastake address signature %s \n", vin.ToString().c_str());
-                        //Misbehaving(pfrom->GetId(), 100);
-                        return;
-                    }
+        LOCK(cs_fortunastakes);
+        CFortunaStake* pmn = vecFortunastakes.Find(vin.prevout);
+        if (pmn) {
+            CFortunaStake& mn = *pmn;
+            // printf("dseep - Found corresponding mn for vin: %s\n", vin.ToString().c_str());
+            // take this only if it's newer
+            if(mn.lastDseep < sigTime){
+                std::string strMessage = mn.addr.ToString() + boost::lexical_cast<std::string>(sigTime) + boost::lexical_cast<std::string>(stop);
+
+                std::string errorMessage = "";
+                if(!forTunaSigner.VerifyMessage(mn.pubkey2, vchSig, strMessage, errorMessage)){
+                    if (fDebugFS) printf("dseep - Got bad fortunastake address signature %s \n", vin.ToString().c_str());
+                    //Misbehaving(pfrom->GetId(), 100);
+                    return;
+                }
 
-                    mn.lastDseep = sigTime;
+                mn.lastDseep = sigTime;
 
-                    if(!mn.UpdatedWithin(FORTUNASTAKE_MIN_DSEEP_SECONDS)){
-                        mn.UpdateLastSeen();
-                        if(stop) {
-                            mn.Disable();
-                            mn.Check(true);
-                        }
-                        RelayForTunaElectionEntryPing(vin, vchSig, sigTime, stop);
+                if(!mn.UpdatedWithin(FORTUNASTAKE_MIN_DSEEP_SECONDS)){
+                    mn.UpdateLastSeen();
+                    if(stop) {
+                        mn.Disable();
+                        mn.Check(true);
                     }
+                    RelayForTunaElectionEntryPing(vin, vchSig, sigTime, stop);
                 }
-                return;
             }
+            return;
         }
 
         if (fDebugFS) printf("dseep - Couldn't find fortunastake entry %s\n", vin.ToString().c_str());
@@ -327,25 +325,37 @@ void ProcessMessageFortunastake(CNode* pfrom, std::string& strCommand, CDataStre
               }
         } //else, asking for a specific node which is ok
 
-	      LOCK(cs_fortunastakes);
-        int count = vecFortunastakes.size();
+        if (vin != CTxIn()) {
+            LOCK(cs_fortunastakes);
+            const CFortunastakeList& list = vecFortunastakes;
+            int nIndex = list.GetIndex(vin);
+            if (nIndex >= 0 && !list[nIndex].addr.IsRFC1918()) {
+                const CFortunaStake& mn = list[nIndex];
+                // the position sent counts the entries a full dseg would send before it
+                int i = 0;
+                for (int j = 0; j < nIndex; j++)
+                    if (!list[j].addr.IsRFC1918())
+                        i++;
+                if(fDebugFS && fDebugNet) printf("dseg - Sending fortunastake entry - %s \n", mn.addr.ToString().c_str());
+                pfrom->PushMessage("dsee", mn.vin, mn.addr, mn.sig, mn.now, mn.pubkey, mn.pubkey2, (int)list.size(), i, mn.lastTimeSeen, mn.protocolVersion);
+                printf("dseg - Sent 1 fortunastake entries to %s\n", pfrom->addr.ToString().c_str());
+            }
+            return;
+        }
+
+        // send the whole list from a snapshot, dsee and dseep keep being processed meanwhile
+        std::shared_ptr<const std::vector<CFortunaStake> > vStakes = vecFortunastakes.GetSnapshot();
+        int count = vStakes->size();
         int i = 0;
 
-        for (CFortunaStake mn : vecFortunastakes) {
+        for (CFortunaStake mn : *vStakes) {
 
             if(mn.addr.IsRFC1918()) continue; //local network
 
-            if(vin == CTxIn()){
-                mn.Check(true);
-                if(mn.IsEnabled()) {
-                    if(fDebugFS && fDebugNet) printf("dseg - Sending fortunastake entry - %s \n", mn.addr.ToString().c_str());
-                    pfrom->PushMessage("dsee", mn.vin, mn.addr, mn.sig, mn.now, mn.pubkey, mn.pubkey2, count, i, mn.lastTimeSeen, mn.protocolVersion);
-                }
-            } else if (vin == mn.vin) {
+            mn.Check(true);
+            if(mn.IsEnabled()) {
                 if(fDebugFS && fDebugNet) printf("dseg - Sending fortunastake entry - %s \n", mn.addr.ToString().c_str());
                 pfrom->PushMessage("dsee", mn.vin, mn.addr, mn.sig, mn.now, mn.pubkey, mn.pubkey2, count, i, mn.lastTimeSeen, mn.protocolVersion);
-                printf("dseg - Sent 1 fortunastake entries to %s\n", pfrom->addr.ToString().c_str());
-                return;
             }
             i++;
         }
@@ -482,11 +492,150 @@ struct CompareValueOnly2
     }
 };
 
+bool CFortunastakeList::Add(const CFortunaStake& mn)
+{
+    if (!mapVin.insert(make_pair(mn.vin.prevout, vStakes.size())).second)
+        return false;
+    mapPubKey.insert(make_pair(mn.pubkey.GetID(), vStakes.size()));
+    vStakes.push_back(mn);
+    fChanged = true;
+    fRankedDirty = true;
+    return true;
+}
+
+void CFortunastakeList::Shuffle()
+{
+    std::random_shuffle(vStakes.begin(), vStakes.end());
+    Reindex();
+}
+
+void CFortunastakeList::Reindex()
+{
+    mapVin.clear();
+    mapPubKey.clear();
+    for (size_t i = 0; i < vStakes.size(); i++)
+    {
+        mapVin.insert(make_pair(vStakes[i].vin.prevout, i));
+        mapPubKey.insert(make_pair(vStakes[i].pubkey.GetID(), i));
+    }
+    fChanged = true;
+    fRankedDirty = true;
+}
+
+struct CompareRankedLastPaid
+{
+    CompareRankedLastPaid(const std::vector<CFortunaStake>& vStakesIn) : vStakes(vStakesIn) {}
+    bool operator()(size_t a, size_t b) const
+    {
+        return vStakes[a] < vStakes[b];
+    }
+    const std::vector<CFortunaStake>& vStakes;
+};
+
+const std::vector<size_t>& CFortunastakeList::GetRanked()
+{
+    if (fRankedDirty) {
+        vRanked.resize(vStakes.size());
+        for (size_t i = 0; i < vRanked.size(); i++)
+            vRanked[i] = i;
+        // mapVin keeps collaterals unique, so sorting is all that is left
+        stable_sort(vRanked.begin(), vRanked.end(), CompareRankedLastPaid(vStakes));
+        fRankedDirty = false;
+    }
+    return vRanked;
+}
+
+const CFortunaStake* CFortunastakeList::Find(const COutPoint& outpoint) const
+{
+    std::unordered_map<COutPoint, size_t, FortunastakeOutPointHasher>::const_iterator it = mapVin.find(outpoint);
+    if (it == mapVin.end())
+        return NULL;
+    return &vStakes[it->second];
+}
+
+const CFortunaStake* CFortunastakeList::Find(const CTxIn& vin) const
+{
+    const CFortunaStake* pmn = Find(vin.prevout);
+    if (!pmn || pmn->vin != vin)
+        return NULL;
+    return pmn;
+}
+
+const CFortunaStake* CFortunastakeList::FindByPubKey(const CPubKey& pubkey) const
+{
+    std::unordered_map<CKeyID, size_t, FortunastakeKeyIdHasher>::const_iterator it = mapPubKey.find(pubkey.GetID());
+    if (it == mapPubKey.end() || vStakes[it->second].pubkey != pubkey)
+        return NULL;
+    return &vStakes[it->second];
+}
+
+const CFortunaStake* CFortunastakeList::FindByPayee(const CScript& payee) const
+{
+    CTxDestination dest;
+    if (!ExtractDestination(payee, dest))
+        return NULL;
+    const CKeyID* keyid = boost::get<CKeyID>(&dest);
+    if (!keyid || GetScriptForDestination(*keyid) != payee)
+        return NULL;
+
+    std::unordered_map<CKeyID, size_t, FortunastakeKeyIdHasher>::const_iterator it = mapPubKey.find(*keyid);
+    if (it == mapPubKey.end())
+        return NULL;
+    return &vStakes[it->second];
+}
+
+// The caller may change the entry it gets, so the next snapshot is taken anew
+CFortunaStake* CFortunastakeList::MarkChanged(const CFortunaStake* pmn)
+{
+    if (pmn)
+        fChanged = true;
+    return const_cast<CFortunaStake*>(pmn);
+}
+
+CFortunaStake* CFortunastakeList::Find(const COutPoint& outpoint)
+{
+    return MarkChanged(static_cast<const CFortunastakeList*>(this)->Find(outpoint));
+}
+
+CFortunaStake* CFortunastakeList::Find(const CTxIn& vin)
+{
+    return MarkChanged(static_cast<const CFortunastakeList*>(this)->Find(vin));
+}
+
+CFortunaStake* CFortunastakeList::FindByPubKey(const CPubKey& pubkey)
+{
+    return MarkChanged(static_cast<const CFortunastakeList*>(this)->FindByPubKey(pubkey));
+}
+
+CFortunaStake* CFortunastakeList::FindByPayee(const CScript& payee)
+{
+    return MarkChanged(static_cast<const CFortunastakeList*>(this)->FindByPayee(payee));
+}
+
+int CFortunastakeList::GetIndex(const CTxIn& vin) const
+{
+    std::unordered_map<COutPoint, size_t, FortunastakeOutPointHasher>::const_iterator it = mapVin.find(vin.prevout);
+    if (it == mapVin.end() || vStakes[it->second].vin != vin)
+        return -1;
+    return (int)it->second;
+}
+
+std::shared_ptr<const std::vector<CFortunaStake> > CFortunastakeList::GetSnapshot()
+{
+    LOCK(cs_fortunastakes);
+    if (fChanged || !snapshot) {
+        snapshot = std::make_shared<const std::vector<CFortunaStake> >(vStakes);
+        fChanged = false;
+    }
+    return snapshot;
+}
+
 int CountFortunastakesAboveProtocol(int protocolVersion)
 {
     int i = 0;
     LOCK(cs_fortunastakes);
-    for (CFortunaStake& mn : vecFortunastakes) {
+    const CFortunastakeList& list = vecFortunastakes;
+    for (const CFortunaStake& mn : list) {
         if(mn.protocolVersion < protocolVersion) continue;
         i++;
     }
@@ -497,31 +646,38 @@ int CountFortunastakesAboveProtocol(int protocolVersion)
 
 int GetFortunastakeByVin(CTxIn& vin)
 {
-    int i = 0;
     LOCK(cs_fortunastakes);
-    for (CFortunaStake& mn : vecFortunastakes) {
-        if (mn.vin == vin) return i;
-        i++;
-    }
+    return vecFortunastakes.GetIndex(vin);
+}
 
-    return -1;
+// Whether mn is enabled. Check() only does work once FORTUNASTAKE_CHECK_SECONDS
+// have passed, only then is it run, on a copy.
+static bool IsFortunastakeEnabled(const CFortunaStake& mn)
+{
+    if (GetTime() - mn.lastTimeChecked < FORTUNASTAKE_CHECK_SECONDS)
+        return mn.IsEnabled();
+    CFortunaStake mnCheck(mn);
+    mnCheck.Check();
+    return mnCheck.IsEnabled();
 }
 
 int GetCurrentFortunaStake(int mod, int64_t nBlockHeight, int minProtocol)
 {
     if (IsInitialBlockDownload()) return 0;
-    int i = 0;
     unsigned int score = 0;
     int winner = -1;
-    LOCK(cs_fortunastakes);
-    // scan for winner
-    for (CFortunaStake mn : vecFortunastakes) {
-        mn.Check();
+    std::shared_ptr<const std::vector<CFortunaStake> > vStakes;
+    std::vector<size_t> vRanked;
+    {
+        LOCK(cs_fortunastakes);
+        vStakes = vecFortunastakes.GetSnapshot();
+        vRanked = vecFortunastakes.GetRanked();
+    }
+    // scan for winner in rank order, the first of equal scores wins
+    for (size_t nPos : vRanked) {
+        const CFortunaStake& mn = (*vStakes)[nPos];
         if(mn.protocolVersion < minProtocol) continue;
-        if(!mn.IsEnabled()) {
-            i++;
-            continue;
-        }
+        if(!IsFortunastakeEnabled(mn)) continue;
 
         // calculate the score for each fortunastake
         uint256 n = mn.CalculateScore(mod, nBlockHeight);
@@ -531,9 +687,8 @@ int GetCurrentFortunaStake(int mod, int64_t nBlockHeight, int minProtocol)
         // determine the winner
         if(n2 > score){
             score = n2;
-            winner = i;
+            winner = nPos;
         }
-        i++;
     }
 
     return winner;
@@ -1079,7 +1234,7 @@ void CFortunaStake::UpdateLastPaidBlock(const CBlockIndex *pindex, int nMaxBlock
 // the proof of work for that block. The further away they are the better, the furthest will win the election
 // and get paid this block
 //
-uint256 CFortunaStake::CalculateScore(int mod, int64_t nBlockHeight)
+uint256 CFortunaStake::CalculateScore(int mod, int64_t nBlockHeight) const
 {
     if(pindexBest == NULL) return 0;
 
@@ -1131,7 +1286,8 @@ void CFortunaStake::Check(bool forceCheck)
     enabled = 1; // OK
 }
 
-bool CheckFortunastakeVin(CTxIn& vin, std::string& errorMessage, CBlockIndex* pindex) {
+// Looks the collateral up on disk, nHeight is set to the height it confirmed at
+static bool ReadFortunastakeVin(const CTxIn& vin, std::string& errorMessage, int& nHeight) {
     CTxDB txdb("r");
     CTxIndex txindex;
     CTransaction ctx;
@@ -1141,19 +1297,17 @@ bool CheckFortunastakeVin(CTxIn& vin, std::string& errorMessage, CBlockIndex* pi
     {
         errorMessage = "could not find transaction";
         return false;
-    } else {
-        if(mapBlockIndex.find(hashBlock) != mapBlockIndex.end())
-        {
-            int confirms = pindex->nHeight - mapBlockIndex[hashBlock]->nHeight;
-            if (confirms < FORTUNASTAKE_MIN_CONFIRMATIONS_NOPAY) {
-                errorMessage = strprintf("specified vin has only %d/%d more confirms",confirms,FORTUNASTAKE_MIN_CONFIRMATIONS_NOPAY);
-                return false;
-            }
-        }
     }
 
-    CTxOut vout = ctx.vout[vin.prevout.n];
-    if (vout.nValue != GetMNCollateral()*COIN)
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi == mapBlockIndex.end())
+    {
+        errorMessage = "specified vin transaction is not in a block";
+        return false;
+    }
+    nHeight = mi->second->nHeight;
+
+    if (vin.prevout.n >= ctx.vout.size() || ctx.vout[vin.prevout.n].nValue != GetMNCollateral()*COIN)
     {
         errorMessage = "specified vin was not a fortunastake capable transaction";
         return false;
@@ -1172,6 +1326,141 @@ bool CheckFortunastakeVin(CTxIn& vin, std::string& errorMessage, CBlockIndex* pi
     return false;
 }
 
+bool CheckFortunastakeVin(CTxIn& vin, std::string& errorMessage, CBlockIndex* pindex) {
+    int nHeight = 0;
+    bool fSpent = false;
+
+    if (!collateralWatch.Get(vin.prevout, nHeight, fSpent))
+    {
+        // Blocks connect under cs_main and mempool spends are marked under
+        // mempool.cs, so with both held no spend slips in between the read
+        // and the Add. Callers may hold cs_fortunastakes, which is taken after
+        // cs_main, so only try for it and leave the outpoint unwatched if busy.
+        TRY_LOCK(cs_main, lockMain);
+        LOCK(mempool.cs);
+        if (!ReadFortunastakeVin(vin, errorMessage, nHeight))
+            return false;
+
+        fSpent = mempool.mapNextTx.count(vin.prevout) > 0;
+        if (lockMain)
+            collateralWatch.Add(vin.prevout, nHeight, fSpent);
+    }
+
+    if (fSpent) {
+        errorMessage = "vin was spent";
+        return false;
+    }
+
+    int confirms = pindex->nHeight - nHeight;
+    if (confirms < FORTUNASTAKE_MIN_CONFIRMATIONS_NOPAY) {
+        errorMessage = strprintf("specified vin has only %d/%d more confirms",confirms,FORTUNASTAKE_MIN_CONFIRMATIONS_NOPAY);
+        return false;
+    }
+
+    return true;
+}
+
+void CCollateralWatch::Add(const COutPoint& outpoint, int nHeight, bool fSpentInMempool)
+{
+    LOCK(cs);
+    CEntry& entry = mapWatched[outpoint];
+    entry.nHeight = nHeight;
+    entry.fSpentInChain = false;
+    entry.fSpentInMempool = fSpentInMempool;
+}
+
+void CCollateralWatch::Remove(const COutPoint& outpoint)
+{
+    LOCK(cs);
+    mapWatched.erase(outpoint);
+}
+
+bool CCollateralWatch::Get(const COutPoint& outpoint, int& nHeight, bool& fSpent) const
+{
+    LOCK(cs);
+    std::unordered_map<COutPoint, CEntry, FortunastakeOutPointHasher>::const_iterator it = mapWatched.find(outpoint);
+    if (it == mapWatched.end())
+        return false;
+    nHeight = it->second.nHeight;
+    fSpent = it->second.fSpentInChain || it->second.fSpentInMempool;
+    return true;
+}
+
+void CCollateralWatch::SpendInputs(const CTransaction& tx, bool fMempool, std::vector<COutPoint>& vSpent)
+{
+    LOCK(cs);
+    if (mapWatched.empty())
+        return;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        std::unordered_map<COutPoint, CEntry, FortunastakeOutPointHasher>::iterator it = mapWatched.find(txin.prevout);
+        if (it == mapWatched.end())
+            continue;
+        if (!it->second.fSpentInChain && !it->second.fSpentInMempool)
+            vSpent.push_back(txin.prevout);
+        if (fMempool)
+            it->second.fSpentInMempool = true;
+        else
+            it->second.fSpentInChain = true;
+    }
+}
+
+void CCollateralWatch::RemoveFromMempool(const CTransaction& tx)
+{
+    LOCK(cs);
+    if (mapWatched.empty())
+        return;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        std::unordered_map<COutPoint, CEntry, FortunastakeOutPointHasher>::iterator it = mapWatched.find(txin.prevout);
+        if (it != mapWatched.end())
+            it->second.fSpentInMempool = false;
+    }
+}
+
+void CCollateralWatch::Disconnect(const CTransaction& tx)
+{
+    LOCK(cs);
+    if (mapWatched.empty())
+        return;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        std::unordered_map<COutPoint, CEntry, FortunastakeOutPointHasher>::iterator it = mapWatched.find(txin.prevout);
+        if (it != mapWatched.end())
+            it->second.fSpentInChain = false;
+    }
+    // collateral created by tx has to be looked up again once it confirms
+    uint256 hash = tx.GetHash();
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+        mapWatched.erase(COutPoint(hash, i));
+}
+
+void FortunastakeCollateralSpent(const CTransaction& tx, bool fMempool)
+{
+    std::vector<COutPoint> vSpent;
+    if (fMempool) {
+        LOCK(mempool.cs);
+        if (!mempool.exists(tx.GetHash()))
+            return;
+        collateralWatch.SpendInputs(tx, true, vSpent);
+    } else {
+        collateralWatch.SpendInputs(tx, false, vSpent);
+    }
+    if (vSpent.empty())
+        return;
+
+    LOCK(cs_fortunastakes);
+    BOOST_FOREACH(const COutPoint& outpoint, vSpent)
+    {
+        CFortunaStake* pmn = vecFortunastakes.Find(outpoint);
+        if (!pmn)
+            continue;
+        if (fDebugFS) printf("FortunastakeCollateralSpent() : collateral of %s spent by %s\n", pmn->addr.ToString().c_str(), tx.GetHash().ToString().c_str());
+        pmn->enabled = 3;
+        pmn->status = "vin was spent";
+    }
+}
+
 bool CFortunastakePayments::CheckSignature(CFortunastakePaymentWinner& winner)
 {
     //note: need to investigate why this is failing
@@ -1340,7 +1629,7 @@ bool CFortunastakePayments::ProcessBlock(int nBlockHeight)
         if(++c > (int)vecFortunastakes.size()) break;
     }
 
-    std::random_shuffle ( vecFortunastakes.begin(), vecFortunastakes.end() );
+    vecFortunastakes.Shuffle();
     for (CFortunaStake& mn : vecFortunastakes) {
         bool found = false;
         for (CTxIn& vin : vecLastPayments)
@@ -1460,35 +1749,31 @@ void CFortunaPayments::update(const CBlockIndex *pindex, bool force)
                 if(!block.ReadFromDisk(BlockReading, true)) // shouldn't really happen
                     continue;
 
-                bool found = false;
                 // if it's a legit block, then count it against this node and record it in a vector
                 if (block.IsProofOfWork() || block.IsProofOfStake())
                 {
                     for (CTxOut txout : block.vtx[block.IsProofOfWork() ? 0 : 1].vout)
                     {
-                        for (CFortunaStake& mn : vecFortunastakes)
+                        CFortunaStake* pmn = vecFortunastakes.FindByPayee(txout.scriptPubKey);
+                        if (pmn)
                         {
-                            if (GetScriptForDestination(mn.pubkey.GetID()) == txout.scriptPubKey)
-                            {
-                                  int height = BlockReading->nHeight;
-                                  int64_t amount = txout.nValue;
-                                  uint256 hash = BlockReading->GetBlockHash();
-                                  CFortunaPayData data;
-
-                                  data.height = height;
-                                  data.amount = amount;
-                                  data.hash = hash;
-                                  mn.payData.push_back(data);
-
-                                  // first match is the last! ;)
-                                  if (mn.nBlockLastPaid == 0) {
-                                      mn.nBlockLastPaid = height;
-                                  }
-                                  found = true;
-                                  break;
+                            CFortunaStake& mn = *pmn;
+                            int height = BlockReading->nHeight;
+                            int64_t amount = txout.nValue;
+                            uint256 hash = BlockReading->GetBlockHash();
+                            CFortunaPayData data;
+
+                            data.height = height;
+                            data.amount = amount;
+                            data.hash = hash;
+                            mn.payData.push_back(data);
+
+                            // first match is the last! ;)
+                            if (mn.nBlockLastPaid == 0) {
+                                mn.nBlockLastPaid = height;
                             }
+                            break;
                         }
-                        if (found) break;
                     }
                 }
             if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
@@ -16,7 +16,12 @@
 #include "main.h"
 #include "script.h"
 
+#include <memory>
+#include <unordered_map>
+
 class CFortunaStake;
+class CFortunastakeList;
+class CCollateralWatch;
 class CFortunastakePayments;
 class uint256;
 
@@ -49,7 +54,7 @@ using namespace std;
 class CFortunastakePaymentWinner;
 
 extern CCriticalSection cs_fortunastakes;
-extern std::vector<CFortunaStake> vecFortunastakes;
+extern CFortunastakeList vecFortunastakes;
 extern std::vector<pair<int, CFortunaStake*> > vecFortunastakeScores;
 extern std::vector<pair<int, CFortunaStake> > vecFortunastakeRanks;
 extern CFortunastakePayments fortunastakePayments;
@@ -57,6 +62,7 @@ extern std::vector<CTxIn> vecFortunastakeAskedFor;
 extern map<uint256, CFortunastakePaymentWinner> mapSeenFortunastakeVotes;
 extern map<int64_t, uint256> mapCacheBlockHashes;
 extern unsigned int mnCount;
+extern CCollateralWatch collateralWatch;
 
 
 // manage the fortunastake connections
@@ -66,6 +72,8 @@ int CountFortunastakesAboveProtocol(int protocolVersion);
 
 void ProcessMessageFortunastake(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 bool CheckFortunastakeVin(CTxIn& vin, std::string& errorMessage, CBlockIndex *pindex);
+// Disables the fortunastakes whose collateral tx spends, from ConnectBlock and mempool acceptance
+void FortunastakeCollateralSpent(const CTransaction& tx, bool fMempool);
 
 // For storing payData
 class CFortunaPayData
@@ -192,7 +200,7 @@ public:
         payCount = 0;
     }
 
-    uint256 CalculateScore(int mod=1, int64_t nBlockHeight=0);
+    uint256 CalculateScore(int mod=1, int64_t nBlockHeight=0) const;
 
     int SetPayRate(int nHeight);
     bool GetPaymentInfo(const CBlockIndex *pindex, int64_t &totalValue, double &actualRate);
@@ -210,7 +218,7 @@ public:
         }
     }
 
-    bool IsActive() {
+    bool IsActive() const {
         if (lastTimeSeen - now > (max(FORTUNASTAKE_FAIR_PAYMENT_MINIMUM, (int)mnCount) * 30))
         { // dsee broadcast is more than a round old, let's consider it active
                 return true;
@@ -239,7 +247,7 @@ public:
         lastTimeSeen = 0;
     }
 
-    bool IsEnabled()
+    bool IsEnabled() const
     {
         return enabled == 1;
     }
@@ -259,6 +267,137 @@ public:
 
 
 
+struct FortunastakeOutPointHasher
+{
+    size_t operator()(const COutPoint& outpoint) const { return outpoint.hash.Get64() ^ outpoint.n; }
+};
+
+struct FortunastakeKeyIdHasher
+{
+    size_t operator()(const CKeyID& keyid) const { return keyid.Get64(); }
+};
+
+//
+// The list of known fortunastakes. Entries stay in a vector, in the order they
+// were added, so callers that work with list positions (ranks, winners) are
+// unchanged. Lookups by collateral outpoint and by collateral key go through
+// hash indexes instead of walking the list. Guarded by cs_fortunastakes.
+//
+class CFortunastakeList
+{
+public:
+    typedef std::vector<CFortunaStake>::iterator iterator;
+    typedef std::vector<CFortunaStake>::const_iterator const_iterator;
+
+    CFortunastakeList() : fChanged(true), fRankedDirty(true) {}
+
+    // Mutable access may change any entry, the next snapshot is taken anew
+    iterator begin() { fChanged = true; return vStakes.begin(); }
+    iterator end() { return vStakes.end(); }
+    const_iterator begin() const { return vStakes.begin(); }
+    const_iterator end() const { return vStakes.end(); }
+    CFortunaStake& operator[](size_t i) { fChanged = true; return vStakes[i]; }
+    const CFortunaStake& operator[](size_t i) const { return vStakes[i]; }
+    size_t size() const { return vStakes.size(); }
+    bool empty() const { return vStakes.empty(); }
+
+    // Adds an entry, false if its collateral is listed already
+    bool Add(const CFortunaStake& mn);
+
+    // Removes the entries pred returns true for, keeping the order of the rest
+    template<typename Predicate>
+    unsigned int RemoveIf(Predicate pred)
+    {
+        unsigned int nRemoved = 0;
+        std::vector<CFortunaStake>::iterator itKeep = vStakes.begin();
+        for (std::vector<CFortunaStake>::iterator it = vStakes.begin(); it != vStakes.end(); ++it)
+        {
+            if (pred(*it)) {
+                nRemoved++;
+                continue;
+            }
+            if (itKeep != it)
+                *itKeep = *it;
+            ++itKeep;
+        }
+        if (nRemoved > 0) {
+            vStakes.erase(itKeep, vStakes.end());
+            Reindex();
+        }
+        return nRemoved;
+    }
+
+    void Shuffle();
+    // Positions of the entries by the block last paid, the order dsee used
+    // to sort the list into. Rebuilt on first use after entries come or go.
+    const std::vector<size_t>& GetRanked();
+
+    // Lookups through a const list leave the snapshot alone, the mutable
+    // ones are for callers that change the entry and mark the list changed
+    const CFortunaStake* Find(const CTxIn& vin) const;
+    CFortunaStake* Find(const CTxIn& vin);
+    // Matches the collateral outpoint only, whatever the scriptSig
+    const CFortunaStake* Find(const COutPoint& outpoint) const;
+    CFortunaStake* Find(const COutPoint& outpoint);
+    const CFortunaStake* FindByPubKey(const CPubKey& pubkey) const;
+    CFortunaStake* FindByPubKey(const CPubKey& pubkey);
+    // The entry whose collateral key a P2PKH payment script pays
+    const CFortunaStake* FindByPayee(const CScript& payee) const;
+    CFortunaStake* FindByPayee(const CScript& payee);
+    // Position of the entry in the list, -1 if it is not listed
+    int GetIndex(const CTxIn& vin) const;
+
+    // A copy of the list for readers that should not hold cs_fortunastakes
+    // while they work through it. It is shared until the list changes.
+    std::shared_ptr<const std::vector<CFortunaStake> > GetSnapshot();
+
+private:
+    std::vector<CFortunaStake> vStakes;
+    std::unordered_map<COutPoint, size_t, FortunastakeOutPointHasher> mapVin;
+    std::unordered_map<CKeyID, size_t, FortunastakeKeyIdHasher> mapPubKey;   // first entry with the key
+    std::shared_ptr<const std::vector<CFortunaStake> > snapshot;
+    bool fChanged;
+    std::vector<size_t> vRanked;
+    bool fRankedDirty;
+
+    void Reindex();
+    CFortunaStake* MarkChanged(const CFortunaStake* pmn);
+};
+
+
+//
+// Spend state of the collateral of listed fortunastakes. An outpoint is added
+// after its first full check against the chain, from then on it is kept up to
+// date from ConnectBlock, DisconnectBlock and the mempool, so checking a
+// fortunastake needs no disk reads.
+//
+class CCollateralWatch
+{
+public:
+    // Starts watching unspent collateral confirmed at nHeight
+    void Add(const COutPoint& outpoint, int nHeight, bool fSpentInMempool);
+    void Remove(const COutPoint& outpoint);
+    bool Get(const COutPoint& outpoint, int& nHeight, bool& fSpent) const;
+
+    // Marks the watched outpoints tx spends, vSpent gets the ones newly spent
+    void SpendInputs(const CTransaction& tx, bool fMempool, std::vector<COutPoint>& vSpent);
+    // tx left the mempool, mined or not
+    void RemoveFromMempool(const CTransaction& tx);
+    // tx was disconnected: its inputs are unspent again, its outputs are gone
+    void Disconnect(const CTransaction& tx);
+
+private:
+    struct CEntry
+    {
+        int nHeight;
+        bool fSpentInChain;
+        bool fSpentInMempool;
+    };
+
+    mutable CCriticalSection cs;
+    std::unordered_map<COutPoint, CEntry, FortunastakeOutPointHasher> mapWatched;
+};
+
 // Get the current winner for this block
 int GetCurrentFortunaStake(int mod=1, int64_t nBlockHeight=0, int minProtocol=CFortunaStake::minProtoVersion);
 bool CheckFSPayment(CBlockIndex* pindex, int64_t value, CFortunaStake &mn);
@@ -124,6 +124,9 @@
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/** SipHash-2-4 of nSize bytes at pch with the 128 bit key k0, k1 */
+uint64_t SipHash(uint64_t k0, uint64_t k1, const unsigned char* pch, size_t nSize);
+
 typedef struct
 {
     SHA512_CTX ctxInner;
@@ -7,6 +7,8 @@
 #include "init.h"
 #include "main.h"
 #include "txdb.h"
+#include "blockfilter.h"
+#include "logging.h"
 #include "walletdb.h"
 #include "denariusrpc.h"
 #include "net.h"
@@ -20,6 +22,7 @@
 #include "smessage.h"
 #include "ringsig.h"
 #include "ddns.h"
+#include "ipfspool.h"
 
 #ifdef USE_NATIVETOR
 #include "tor/anonymize.h" //Tor native optional integration (Flag -nativetor=1)
@@ -116,6 +119,9 @@ void Shutdown(void* parg)
         if(ddns) {
             delete ddns;
         }
+#ifdef USE_IPFS
+        StopJupiterUploads();
+#endif
         Finalise();
         /*
         SecureMsgShutdown();
@@ -132,6 +138,7 @@ void Shutdown(void* parg)
         NewThread(ExitTimeout, NULL);
         MilliSleep(50);
         printf("Denarius exited\n\n");
+        StopLogging();
         fExit = true;
 #ifndef QT_GUI
         // ensure non-UI client gets exited here, but let Bitcoin-Qt reach 'return 0;' in bitcoin.cpp
@@ -304,6 +311,21 @@ std::string HelpMessage()
         "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n" +
         "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 25)") + "\n" +
         "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n" +
+        "  -dbwritebuffer=<n>     " + _("Set chain database write buffer size in megabytes (default: 16)") + "\n" +
+        "  -dbmaxopenfiles=<n>    " + _("Maximum number of chain database files kept open (default: 1000)") + "\n" +
+        "  -dbblocksize=<n>       " + _("Set chain database block size in kilobytes (default: 4)") + "\n" +
+        "  -dbcompression         " + _("Compress chain database blocks with Snappy when available (default: 1)") + "\n" +
+        "  -dbbatchblocks=<n>     " + strprintf(_("Write the chain index in one batch every <n> blocks during initial block download, 0 to disable (default: %u)"), DEFAULT_DB_BATCH_BLOCKS) + "\n" +
+        "  -dbbatchsize=<n>       " + strprintf(_("Write the batched chain index earlier once it reaches <n> megabytes (default: %u)"), DEFAULT_DB_BATCH_SIZE) + "\n" +
+        "  -dbcompact             " + _("Compact the chain database in the background after initial block download (default: 1)") + "\n" +
+        "  -blockfilterindex      " + _("Build and store a compact filter of every block connected and serve them to peers (default: 1)") + "\n" +
+        "  -ddnsthreads=<n>       " + _("Number of threads answering DNS queries (default: up to 4)") + "\n" +
+        "  -ddnscachesize=<n>     " + strprintf(_("Number of names kept in the DNS answer cache (default: %u)"), DDNS_CACHE_NAMES) + "\n" +
+        "  -ddnscachettl=<n>      " + strprintf(_("Maximum seconds a DNS answer is cached, 0 to disable (default: %u)"), DDNS_CACHE_TTL) + "\n" +
+        "  -jupiterthreads=<n>    " + _("Number of threads uploading the files of jupitersubmit jobs (default: 4)") + "\n" +
+        "  -jupiterpodbatch=<n>   " + _("Anchor a Jupiter POD batch once it holds <n> items (default: 1000)") + "\n" +
+        "  -jupiterpodwindow=<n>  " + _("Anchor a Jupiter POD batch once its oldest item is <n> seconds old (default: 3600)") + "\n" +
+        "  -blockfilecache=<n>    " + strprintf(_("Keep up to <n> block files memory mapped for reads, 0 to disable (default: %u)"), DEFAULT_BLOCKFILE_CACHE) + "\n" +
         "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n" +
         "  -proxy=<ip:port>       " + _("Connect through socks proxy") + "\n" +
         "  -socks=<n>             " + _("Select the version of socks proxy to use (4-5, default: 5)") + "\n" +
@@ -333,6 +355,7 @@ std::string HelpMessage()
         "  -softbantime=<n>       " + _("Number of seconds to keep soft banned peers from reconnecting (default: 3600)") + "\n" +
         "  -maxreceivebuffer=<n>  " + _("Maximum per-connection receive buffer, <n>*1000 bytes (default: 5000)") + "\n" +
         "  -maxsendbuffer=<n>     " + _("Maximum per-connection send buffer, <n>*1000 bytes (default: 1000)") + "\n" +
+        "  -invinterval=<n>       " + strprintf(_("Average seconds between transaction announcements to inbound peers, half that for outbound (default: %u)"), DEFAULT_INVENTORY_BROADCAST_INTERVAL) + "\n" +
 #ifdef USE_UPNP
 #if USE_UPNP
         "  -upnp                  " + _("Use UPnP to map the listening port (default: 1 when listening)") + "\n" +
@@ -355,6 +378,11 @@ std::string HelpMessage()
         "  -debugchain            " + _("Output extra blockchain debugging information") + "\n" +
         "  -logtimestamps         " + _("Prepend debug output with timestamp") + "\n" +
         "  -shrinkdebugfile       " + _("Shrink debug.log file on client startup (default: 1 when no -debug)") + "\n" +
+        "  -logformat=<fmt>       " + _("Format of debug.log lines: text or json (default: text)") + "\n" +
+        "  -logbuffer=<n>         " + _("Log lines queued for the debug.log writer before lines are dropped (default: 16384)") + "\n" +
+        "  -lockstats             " + _("Profile lock waits and hold times per call site, see getlockstats") + "\n" +
+        "  -lockstatssample=<n>   " + _("Measure the hold time of one in <n> uncontended locks (default: 16)") + "\n" +
+        "  -lockstatsinterval=<n> " + _("Seconds between lock profile summaries in debug.log, 0 for none (default: 600)") + "\n" +
         "  -printtoconsole        " + _("Send trace/debug info to console instead of debug.log file") + "\n" +
 #ifdef WIN32
         "  -printtodebugger       " + _("Send trace/debug info to debugger") + "\n" +
@@ -372,18 +400,24 @@ std::string HelpMessage()
         "  -upgradewallet         " + _("Upgrade wallet to latest format") + "\n" +
         "  -keypool=<n>           " + _("Set key pool size to <n> (default: 100)") + "\n" +
         "  -rescan                " + _("Rescan the block chain for missing wallet transactions") + "\n" +
+        "  -rescanthreads=<n>     " + _("Threads reading blocks during a wallet rescan (default: 0 = all cores)") + "\n" +
         "  -zapwallettxes         " + _("Clear list of wallet transactions (diagnostic tool; implies -rescan)") + "\n" +
         "  -salvagewallet         " + _("Attempt to recover private keys from a corrupt wallet.dat") + "\n" +
+        "  -walletbackend=<name>  " + _("Wallet store: bdb (wallet.dat) or leveldb, which migrates wallet.dat on first start (default: bdb)") + "\n" +
+        "  -forcebdbwallet        " + _("Load wallet.dat even though the wallet was migrated to LevelDB") + "\n" +
         "  -checkblocks=<n>       " + _("How many blocks to check at startup (default: 2500, 0 = all)") + "\n" +
         "  -checklevel=<n>        " + _("How thorough the block verification is (0-6, default: 1)") + "\n" +
         "  -loadblock=<file>      " + _("Imports blocks from external blk000?.dat file") + "\n" +
+        "  -loadblockthreads=<n>  " + _("Number of threads checking blocks during -loadblock/bootstrap.dat import (default: cores - 1)") + "\n" +
 
         "\n" + _("Block creation options:") + "\n" +
         "  -blockminsize=<n>      "   + _("Set minimum block size in bytes (default: 0)") + "\n" +
         "  -blockmaxsize=<n>      "   + _("Set maximum block size in bytes (default: 250000)") + "\n" +
         "  -blockprioritysize=<n> "   + _("Set maximum size of high-priority/low-fee transactions in bytes (default: 27000)") + "\n" +
         "  -maxorphantx=<n>       "   + strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS) + "\n" +
+        "  -maxorphantxkb=<n>     "   + strprintf(_("Keep at most <n> kB of unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TX_KB) + "\n" +
         "  -maxorphanblocks=<n>   "   + strprintf(_("Keep at most <n> unconnectable blocks in memory (default: %u)"), DEFAULT_MAX_ORPHAN_BLOCKS) + "\n" +
+        "  -maxorphanblockskb=<n> "   + strprintf(_("Keep at most <n> kB of unconnectable block data in memory, headers only past it (default: %u)"), DEFAULT_MAX_ORPHAN_BLOCKS_KB) + "\n" +
 
         "\n" + _("SSL options: (see the Bitcoin Wiki for SSL setup instructions)") + "\n" +
         "  -rpcssl                                  " + _("Use OpenSSL (https) for JSON-RPC connections") + "\n" +
@@ -607,10 +641,28 @@ bool AppInit2()
     fDebugFS = GetBoolArg("-debugfs");
     fDebugRingSig = GetBoolArg("-debugringsig");
 
+    uint32_t nCategories = LOG_NONE;
+    if (fDebugNet) nCategories |= LOG_NET;
+    if (fDebugSmsg) nCategories |= LOG_SMSG;
+    if (fDebugChain) nCategories |= LOG_CHAIN;
+    if (fDebugFS) nCategories |= LOG_FS;
+    if (fDebugRingSig) nCategories |= LOG_RINGSIG;
+    if (fDebug) nCategories |= LOG_BENCH;
+    BOOST_FOREACH(const string& strCategory, mapMultiArgs["-debug"])
+    {
+        uint32_t nCategory;
+        if (strCategory != "" && strCategory != "1" && GetLogCategory(strCategory, nCategory))
+            nCategories |= nCategory;
+    }
+    SetLogCategories(nCategories);
+
+    SetLockStats(GetBoolArg("-lockstats"), GetArg("-lockstatssample", 16));
+
     fNoSmsg = GetBoolArg("-nosmsg");
     fDisableStealth = GetBoolArg("-disablestealth"); // force-disable stealth transaction scanning
 
     bitdb.SetDetach(GetBoolArg("-detachdb", false));
+    blockFileCache.SetMaxFiles(GetArg("-blockfilecache", DEFAULT_BLOCKFILE_CACHE));
 
 #if !defined(WIN32) && !defined(QT_GUI)
     fDaemon = GetBoolArg("-daemon");
@@ -680,6 +732,11 @@ bool AppInit2()
     hooks = InitHook(); //Initialized Denarius Name Hooks
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
+
+    string strLogFormat = GetArg("-logformat", "text");
+    if (strLogFormat != "text" && strLogFormat != "json")
+        return InitError(strprintf(_("Unknown -logformat: '%s'"), strLogFormat.c_str()));
+    StartLogging(GetArg("-logbuffer", DEFAULT_LOG_BUFFER), strLogFormat == "json" ? LOG_FORMAT_JSON : LOG_FORMAT_TEXT);
     printf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     printf("Denarius version %s (%s)\n", FormatFullVersion().c_str(), CLIENT_DATE.c_str());
 #if (OPENSSL_VERSION_NUMBER < 0x10100000L) //WIP OpenSSL 1.0.x only, OpenSSL 1.1 not supported yet
@@ -722,6 +779,10 @@ bool AppInit2()
     if (fNoSmsg)
         nLocalServices &= ~(SMSG_RELAY);
 
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", true);
+    if (fBlockFilterIndex)
+        nLocalServices |= NODE_COMPACT_FILTERS;
+
     // Anonymous Ring Signatures ~ D e n a r i u s - v3.0.0.0
     if (initialiseRingSigs() != 0)
         return InitError("initialiseRingSigs() failed.");
@@ -739,14 +800,25 @@ bool AppInit2()
         return InitError(msg);
     }
 
-    if (GetBoolArg("-salvagewallet"))
+    string strWalletBackend = GetArg("-walletbackend", "bdb");
+    if (strWalletBackend != "bdb" && strWalletBackend != "leveldb")
+        return InitError(strprintf(_("Unknown -walletbackend: '%s'"), strWalletBackend.c_str()));
+    bool fLevelDBWallet = (strWalletBackend == "leveldb");
+    bool fLevelDBWalletExists = fLevelDBWallet && filesystem::exists(bitdb.GetLevelDBPath(strWalletFileName));
+
+    // After a migration wallet.dat is only a backup, missing everything written since
+    if (!fLevelDBWallet && filesystem::exists(bitdb.GetLevelDBPath(strWalletFileName)) && !GetBoolArg("-forcebdbwallet"))
+        return InitError(strprintf(_("The wallet was migrated to %s, %s would be out of date. Start with -walletbackend=leveldb, or with -forcebdbwallet to load %s anyway."),
+                                   bitdb.GetLevelDBPath(strWalletFileName).string().c_str(), strWalletFileName.c_str(), strWalletFileName.c_str()));
+
+    if (GetBoolArg("-salvagewallet") && !fLevelDBWalletExists)
     {
         // Recover readable keypairs:
         if (!CWalletDB::Recover(bitdb, strWalletFileName, true))
             return false;
     };
 
-    if (filesystem::exists(GetDataDir() / strWalletFileName))
+    if (filesystem::exists(GetDataDir() / strWalletFileName) && !fLevelDBWalletExists)
     {
         CDBEnv::VerifyResult r = bitdb.Verify(strWalletFileName, CWalletDB::Recover);
         if (r == CDBEnv::RECOVER_OK)
@@ -762,6 +834,23 @@ bool AppInit2()
             return InitError(_("wallet.dat corrupt, salvage failed"));
     };
 
+    if (fLevelDBWallet)
+    {
+        // The first start with -walletbackend=leveldb migrates wallet.dat, which is kept as a backup
+        if (!fLevelDBWalletExists && filesystem::exists(GetDataDir() / strWalletFileName))
+        {
+            uiInterface.InitMessage(_("Migrating wallet to LevelDB..."));
+            if (!CDB::MigrateToLevelDB(strWalletFileName))
+                return InitError(_("Error migrating wallet.dat to LevelDB"));
+            if (filesystem::exists(bitdb.GetMigratedPath(strWalletFileName)))
+                InitWarning(strprintf(_("Warning: the wallet was migrated to LevelDB, the old wallet file is kept as %s."
+                                        " It holds the private keys as they were, unencrypted if the wallet was not encrypted,"
+                                        " and encrypting the wallet later does not change it. Delete it once it is no longer needed."),
+                                      bitdb.GetMigratedPath(strWalletFileName).string().c_str()));
+        }
+        bitdb.UseLevelDB(strWalletFileName);
+    }
+
     // ********************************************************* Step 6: network initialization
 
     nBloomFilterElements = GetArg("-bloomfilterelements", 1536);
@@ -1001,10 +1090,10 @@ bool AppInit2()
     printf("Loading Denarius name index...\n");
     nStart2 = GetTimeMillis();
 
-    extern bool createNameIndexFile();
-    if (!filesystem::exists(GetDataDir() / "denariusnamesindex.dat") && !createNameIndexFile())
+    extern bool LoadNameIndex();
+    if (!LoadNameIndex())
     {
-        printf("Fatal error: Failed to create denariusnamesindex.dat\n");
+        printf("Fatal error: Failed to load the name index\n");
         return false;
     }
 
@@ -1021,7 +1110,7 @@ bool AppInit2()
     {
         string strMatch = mapArgs["-printblock"];
         int nFound = 0;
-        for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+        for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
         {
             uint256 hash = (*mi).first;
             if (strncmp(hash.ToString().c_str(), strMatch.c_str(), strMatch.size()) == 0)
@@ -1288,6 +1377,9 @@ bool AppInit2()
     //Threading still needs reworking
     NewThread(ThreadCheckForTunaPool, NULL);
 
+    if (!NewThread(ThreadLockStats, NULL))
+        printf("Error: NewThread(ThreadLockStats) failed\n");
+
     RandAddSeedPerfmon();
 
     // reindex addresses found in blockchain
@@ -1346,8 +1438,11 @@ bool AppInit2()
         string bind_ip = GetArg("-ddnsbindip", "");
         string allowed = GetArg("-ddnsallowed", "");
         string localcf = GetArg("-ddnslocalcf", "");
+        int threads = GetArg("-ddnsthreads", std::min(4, std::max(1, (int)boost::thread::hardware_concurrency())));
+        threads = std::max(1, std::min(16, threads));
+        DDnsCacheInit(GetArg("-ddnscachesize", DDNS_CACHE_NAMES), GetArg("-ddnscachettl", DDNS_CACHE_TTL));
         ddns = new DDns(bind_ip.c_str(), port,
-        suffix.c_str(), allowed.c_str(), localcf.c_str(), verbose);
+        suffix.c_str(), allowed.c_str(), localcf.c_str(), verbose, threads);
         printf("Denarius DNS Server started on %d!\n", port);
     }
 
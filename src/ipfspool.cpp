@@ -0,0 +1,236 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ipfspool.h"
+#include "init.h"
+#include "jupiterpod.h"
+#include "util.h"
+
+#ifdef USE_IPFS
+#include <ipfs/client.h>
+#include <ipfs/http/transport.h>
+
+#include <deque>
+#include <map>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+std::string GetJupiterHost()
+{
+    if (GetBoolArg("-jupiterlocal"))
+        return GetArg("-jupiterip", "localhost:5001");
+    return "https://ipfs.infura.io:5001";
+}
+
+static CCriticalSection cs_ipfsClients;
+static multimap<string, ipfs::Client*> mapIdleClients;
+static bool fClientsClosed = false;    // after shutdown clients are deleted, not pooled
+
+CIPFSClientLease::CIPFSClientLease(const std::string& strHostIn) : strHost(strHostIn), pclient(NULL)
+{
+    {
+        LOCK(cs_ipfsClients);
+        multimap<string, ipfs::Client*>::iterator mi = mapIdleClients.find(strHost);
+        if (mi != mapIdleClients.end())
+        {
+            pclient = mi->second;
+            mapIdleClients.erase(mi);
+        }
+    }
+    if (!pclient)
+        pclient = new ipfs::Client(strHost);
+}
+
+CIPFSClientLease::~CIPFSClientLease()
+{
+    {
+        LOCK(cs_ipfsClients);
+        if (!fClientsClosed && mapIdleClients.count(strHost) < MAX_IDLE_IPFS_CLIENTS)
+        {
+            mapIdleClients.insert(make_pair(strHost, pclient));
+            return;
+        }
+    }
+    delete pclient;
+}
+
+std::string CJupiterItem::GetStateName() const
+{
+    switch (nState)
+    {
+    case QUEUED:    return "queued";
+    case UPLOADING: return "uploading";
+    case DONE:      return "done";
+    case FAILED:    return "failed";
+    }
+    return "unknown";
+}
+
+//
+// Upload jobs
+//
+
+static boost::mutex mutexJobs;
+static boost::condition_variable condJobs;
+static map<int, CJupiterJob> mapJobs;
+static deque<pair<int, unsigned int> > queueItems; // job id, item index
+static map<int, unsigned int> mapJobPending;       // items of a job not finished yet
+static int nLastJobId = 0;
+static boost::thread_group* pthreadsJupiter = NULL;
+
+// Hash the file while the upload reads it, the second read is served by the page cache
+static void HashFile(const string strPath, uint256* phash, int64_t* pnSize, bool* pfOk)
+{
+    *pfOk = GetFileSHA256(strPath, *phash, *pnSize);
+}
+
+static void UploadItem(const string& strHost, CJupiterItem& item)
+{
+    bool fHashOk = false;
+    boost::thread threadHash(boost::bind(&HashFile, item.strPath, &item.hashContent, &item.nSize, &fHashOk));
+
+    try
+    {
+        // kFileName makes curl stream the file from disk instead of loading it into memory
+        string strName = boost::filesystem::path(item.strPath).filename().string();
+        ipfs::Json add_result;
+        {
+            CIPFSClientLease client(strHost);
+            client->FilesAdd({{strName, ipfs::http::FileUpload::Type::kFileName, item.strPath}}, &add_result);
+        }
+        const string& strHash = add_result[0]["hash"];
+        item.strHash = strHash;
+    }
+    catch (const std::exception& e)
+    {
+        item.strError = e.what();
+    }
+    threadHash.join();
+
+    if (item.strError.empty() && !fHashOk)
+        item.strError = "cannot read " + item.strPath;
+    item.nState = item.strError.empty() ? CJupiterItem::DONE : CJupiterItem::FAILED;
+}
+
+static void ThreadJupiterUpload()
+{
+    RenameThread("denarius-jupiter");
+
+    while (!fShutdown)
+    {
+        int nJobId;
+        unsigned int nItem;
+        string strHost;
+        CJupiterItem item("");
+        {
+            boost::unique_lock<boost::mutex> lock(mutexJobs);
+            if (queueItems.empty())
+            {
+                condJobs.timed_wait(lock, boost::posix_time::seconds(1));
+                continue;
+            }
+            nJobId = queueItems.front().first;
+            nItem = queueItems.front().second;
+            queueItems.pop_front();
+
+            CJupiterJob& job = mapJobs[nJobId];
+            job.vItems[nItem].nState = CJupiterItem::UPLOADING;
+            strHost = job.strHost;
+            item = job.vItems[nItem];
+        }
+
+        UploadItem(strHost, item);
+        if (fDebug)
+            printf("Jupiter job %d: %s %s %s\n", nJobId, item.strPath.c_str(), item.GetStateName().c_str(),
+                item.strError.empty() ? item.strHash.c_str() : item.strError.c_str());
+
+        boost::unique_lock<boost::mutex> lock(mutexJobs);
+        map<int, CJupiterJob>::iterator mi = mapJobs.find(nJobId);
+        if (mi == mapJobs.end())
+            continue;
+        mi->second.vItems[nItem] = item;
+        if (--mapJobPending[nJobId] == 0)
+        {
+            mapJobPending.erase(nJobId);
+            mi->second.nDoneTime = GetTime();
+        }
+    }
+}
+
+int SubmitJupiterJob(const std::string& strHost, const std::vector<std::string>& vFiles)
+{
+    boost::unique_lock<boost::mutex> lock(mutexJobs);
+
+    if (!pthreadsJupiter && !fShutdown)
+    {
+        int nThreads = std::max(1, (int)GetArg("-jupiterthreads", DEFAULT_JUPITER_THREADS));
+        pthreadsJupiter = new boost::thread_group();
+        for (int i = 0; i < nThreads; i++)
+            pthreadsJupiter->create_thread(&ThreadJupiterUpload);
+    }
+
+    // Forget the oldest finished jobs
+    for (map<int, CJupiterJob>::iterator mi = mapJobs.begin(); mapJobs.size() >= MAX_JUPITER_JOBS && mi != mapJobs.end(); )
+    {
+        if (mi->second.IsDone())
+            mapJobs.erase(mi++);
+        else
+            ++mi;
+    }
+
+    CJupiterJob& job = mapJobs[++nLastJobId];
+    job.nId = nLastJobId;
+    job.strHost = strHost;
+    job.nCreateTime = GetTime();
+    for (unsigned int i = 0; i < vFiles.size(); i++)
+    {
+        job.vItems.push_back(CJupiterItem(vFiles[i]));
+        queueItems.push_back(make_pair(job.nId, i));
+    }
+    if (vFiles.empty())
+        job.nDoneTime = job.nCreateTime;
+    else
+        mapJobPending[job.nId] = vFiles.size();
+
+    condJobs.notify_all();
+    return job.nId;
+}
+
+void StopJupiterUploads()
+{
+    boost::thread_group* pthreads;
+    {
+        boost::unique_lock<boost::mutex> lock(mutexJobs);
+        pthreads = pthreadsJupiter;
+        pthreadsJupiter = NULL;
+        condJobs.notify_all();
+    }
+    if (pthreads)
+    {
+        // Workers stop waiting at once, an upload in flight is finished first
+        pthreads->interrupt_all();
+        pthreads->join_all();
+        delete pthreads;
+    }
+
+    LOCK(cs_ipfsClients);
+    fClientsClosed = true;
+    for (multimap<string, ipfs::Client*>::iterator mi = mapIdleClients.begin(); mi != mapIdleClients.end(); ++mi)
+        delete mi->second;
+    mapIdleClients.clear();
+}
+
+bool GetJupiterJob(int nId, CJupiterJob& job)
+{
+    boost::unique_lock<boost::mutex> lock(mutexJobs);
+    map<int, CJupiterJob>::const_iterator mi = mapJobs.find(nId);
+    if (mi == mapJobs.end())
+        return false;
+    job = mi->second;
+    return true;
+}
+#endif
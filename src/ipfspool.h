@@ -0,0 +1,88 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_IPFSPOOL_H
+#define BITCOIN_IPFSPOOL_H
+
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+namespace ipfs { class Client; }
+
+/** Threads uploading the files of jupitersubmit jobs */
+static const int DEFAULT_JUPITER_THREADS = 4;
+/** Idle IPFS clients kept per node */
+static const unsigned int MAX_IDLE_IPFS_CLIENTS = 8;
+/** Finished jobs that are kept for jupiterjobstatus */
+static const unsigned int MAX_JUPITER_JOBS = 100;
+
+/** IPFS API node selected by -jupiterlocal and -jupiterip */
+std::string GetJupiterHost();
+
+/** Borrows an IPFS client for a node from a shared pool. A client keeps its
+ *  curl handle, and with it the keep-alive connection, between calls. */
+class CIPFSClientLease
+{
+public:
+    explicit CIPFSClientLease(const std::string& strHostIn);
+    ~CIPFSClientLease();
+
+    ipfs::Client& operator*() { return *pclient; }
+    ipfs::Client* operator->() { return pclient; }
+
+private:
+    CIPFSClientLease(const CIPFSClientLease&);
+    CIPFSClientLease& operator=(const CIPFSClientLease&);
+
+    std::string strHost;
+    ipfs::Client* pclient;
+};
+
+/** One file of an upload job */
+class CJupiterItem
+{
+public:
+    enum State
+    {
+        QUEUED,
+        UPLOADING,
+        DONE,
+        FAILED,
+    };
+
+    std::string strPath;
+    State nState;
+    std::string strHash;    // IPFS CID
+    uint256 hashContent;    // SHA256 of the file, computed while it uploads
+    int64_t nSize;
+    std::string strError;
+
+    CJupiterItem(const std::string& strPathIn) : strPath(strPathIn), nState(QUEUED), hashContent(0), nSize(0) {}
+
+    std::string GetStateName() const;
+};
+
+class CJupiterJob
+{
+public:
+    int nId;
+    std::string strHost;
+    int64_t nCreateTime;
+    int64_t nDoneTime;
+    std::vector<CJupiterItem> vItems;
+
+    CJupiterJob() : nId(0), nCreateTime(0), nDoneTime(0) {}
+
+    bool IsDone() const { return nDoneTime != 0; }
+};
+
+/** Queue the upload of vFiles to strHost, files are uploaded in parallel by
+ *  -jupiterthreads workers. Returns the id of the job. */
+int SubmitJupiterJob(const std::string& strHost, const std::vector<std::string>& vFiles);
+bool GetJupiterJob(int nId, CJupiterJob& job);
+/** Joins the upload workers and frees the pooled clients, called on shutdown */
+void StopJupiterUploads();
+
+#endif // BITCOIN_IPFSPOOL_H
@@ -0,0 +1,254 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jupiterpod.h"
+#include "base58.h"
+#include "init.h"
+#include "main.h"
+#include "wallet.h"
+#include "walletdb.h"
+
+#include <boost/filesystem.hpp>
+#include <openssl/sha.h>
+
+using namespace std;
+
+static CCriticalSection cs_jupiterPod;
+static vector<string> vPendingItems;
+static int64_t nPendingSince = 0;
+
+// A batch whose anchor transaction went out, kept until its proofs are stored
+struct CJupiterPodBatch
+{
+    vector<string> vItems;
+    uint256 txid;
+    int64_t nTime;
+};
+static vector<CJupiterPodBatch> vUnwrittenBatches;
+
+bool GetFileSHA256(const std::string& strPath, uint256& hash, int64_t& nSize)
+{
+    FILE* file = fopen(strPath.c_str(), "rb");
+    if (!file)
+        return false;
+
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    vector<unsigned char> vBuf(1 << 20);
+    size_t nRead;
+    nSize = 0;
+    while ((nRead = fread(&vBuf[0], 1, vBuf.size(), file)) > 0)
+    {
+        SHA256_Update(&ctx, &vBuf[0], nRead);
+        nSize += nRead;
+    }
+    bool fOk = !ferror(file);
+    fclose(file);
+
+    SHA256_Final(hash.begin(), &ctx);
+    return fOk;
+}
+
+bool GetJupiterPodItem(const std::string& strCidOrFile, std::string& strItem)
+{
+    if (boost::filesystem::is_regular_file(strCidOrFile))
+    {
+        uint256 hash;
+        int64_t nSize;
+        if (!GetFileSHA256(strCidOrFile, hash, nSize))
+            return false;
+        strItem = "sha256:" + HexStr(hash.begin(), hash.end());
+        return true;
+    }
+    if (strCidOrFile.empty())
+        return false;
+    strItem = "ipfs:" + strCidOrFile;
+    return true;
+}
+
+uint256 GetJupiterPodLeaf(const std::string& strItem)
+{
+    return Hash(strItem.begin(), strItem.end());
+}
+
+uint256 BuildJupiterPodTree(const std::vector<uint256>& vLeaves, std::vector<uint256>& vTree)
+{
+    vTree = vLeaves;
+    int j = 0;
+    for (int nSize = vLeaves.size(); nSize > 1; nSize = (nSize + 1) / 2)
+    {
+        for (int i = 0; i < nSize; i += 2)
+        {
+            int i2 = std::min(i+1, nSize-1);
+            vTree.push_back(Hash(BEGIN(vTree[j+i]),  END(vTree[j+i]),
+                                 BEGIN(vTree[j+i2]), END(vTree[j+i2])));
+        }
+        j += nSize;
+    }
+    return (vTree.empty() ? 0 : vTree.back());
+}
+
+std::vector<uint256> GetJupiterPodBranch(const std::vector<uint256>& vTree, int nLeaves, int nIndex)
+{
+    std::vector<uint256> vMerkleBranch;
+    int j = 0;
+    for (int nSize = nLeaves; nSize > 1; nSize = (nSize + 1) / 2)
+    {
+        int i = std::min(nIndex^1, nSize-1);
+        vMerkleBranch.push_back(vTree[j+i]);
+        nIndex >>= 1;
+        j += nSize;
+    }
+    return vMerkleBranch;
+}
+
+bool AddJupiterPodItem(const std::string& strItem, unsigned int& nPending)
+{
+    LOCK(cs_jupiterPod);
+    if (vPendingItems.empty())
+        nPendingSince = GetTime();
+    vPendingItems.push_back(strItem);
+    nPending = vPendingItems.size();
+
+    return nPending >= (unsigned int)GetArg("-jupiterpodbatch", DEFAULT_JUPITER_POD_BATCH) ||
+           GetTime() - nPendingSince >= GetArg("-jupiterpodwindow", DEFAULT_JUPITER_POD_WINDOW);
+}
+
+static CBitcoinAddress GetJupiterPodAddress(const uint256& hashRoot)
+{
+    return CBitcoinAddress(CKeyID(Hash160(hashRoot.begin(), hashRoot.end())));
+}
+
+// Stores the proof of every item of an anchored batch in one wallet db transaction
+static bool WriteJupiterPodProofs(const CJupiterPodBatch& batch)
+{
+    vector<uint256> vLeaves, vTree;
+    for (unsigned int i = 0; i < batch.vItems.size(); i++)
+        vLeaves.push_back(GetJupiterPodLeaf(batch.vItems[i]));
+    uint256 hashRoot = BuildJupiterPodTree(vLeaves, vTree);
+
+    CWalletDB walletdb(pwalletMain->strWalletFile);
+    walletdb.TxnBegin();
+    for (unsigned int i = 0; i < batch.vItems.size(); i++)
+    {
+        CJupiterProof proof;
+        proof.strItem = batch.vItems[i];
+        proof.hashRoot = hashRoot;
+        proof.txid = batch.txid;
+        proof.nIndex = i;
+        proof.vMerkleBranch = GetJupiterPodBranch(vTree, vLeaves.size(), i);
+        proof.nTime = batch.nTime;
+        if (!walletdb.WriteJupiterProof(vLeaves[i], proof))
+        {
+            walletdb.TxnAbort();
+            return false;
+        }
+    }
+    return walletdb.TxnCommit();
+}
+
+bool AnchorJupiterPodBatch(CWalletTx& wtx, uint256& hashRoot, unsigned int& nItems, std::string& strError)
+{
+    LOCK(cs_jupiterPod);
+
+    // Batches already paid for are never anchored again, only their proofs
+    // are written again until that works
+    while (!vUnwrittenBatches.empty())
+    {
+        if (!WriteJupiterPodProofs(vUnwrittenBatches.front()))
+        {
+            strError = "Failed to write Jupiter POD proofs of tx " + vUnwrittenBatches.front().txid.GetHex();
+            return false;
+        }
+        vUnwrittenBatches.erase(vUnwrittenBatches.begin());
+    }
+
+    if (vPendingItems.empty())
+    {
+        strError = "No pending Jupiter POD items";
+        return false;
+    }
+    if (pwalletMain->IsLocked())
+    {
+        strError = "Error, Your wallet is locked! Please unlock your wallet!";
+        return false;
+    }
+
+    vector<uint256> vLeaves, vTree;
+    for (unsigned int i = 0; i < vPendingItems.size(); i++)
+        vLeaves.push_back(GetJupiterPodLeaf(vPendingItems[i]));
+    hashRoot = BuildJupiterPodTree(vLeaves, vTree);
+
+    // One 0.001 D POD for the whole batch, paid to the address of the root
+    wtx.mapValue["comment"] = hashRoot.GetHex();
+    wtx.mapValue["to"] = "Jupiter POD Batch";
+    std::string sNarr = "Jupiter POD Batch";
+    strError = pwalletMain->SendMoneyToDestination(GetJupiterPodAddress(hashRoot).Get(), 0.001 * COIN, sNarr, wtx);
+    if (strError != "")
+        return false;
+
+    CJupiterPodBatch batch;
+    batch.vItems.swap(vPendingItems);
+    batch.txid = wtx.GetHash();
+    batch.nTime = GetTime();
+    nItems = batch.vItems.size();
+    if (!WriteJupiterPodProofs(batch))
+    {
+        vUnwrittenBatches.push_back(batch);
+        strError = "Failed to write Jupiter POD proofs, root " + hashRoot.GetHex() + ", they are written again with the next batch";
+        return false;
+    }
+
+    printf("Jupiter POD batch of %u items anchored, root %s tx %s\n", nItems, hashRoot.GetHex().c_str(), wtx.GetHash().GetHex().c_str());
+    return true;
+}
+
+bool VerifyJupiterPodItem(const std::string& strItem, CJupiterProof& proof, bool& fValid, int& nConfirmations, std::string& strError)
+{
+    fValid = false;
+    nConfirmations = 0;
+
+    uint256 hashLeaf = GetJupiterPodLeaf(strItem);
+    if (!CWalletDB(pwalletMain->strWalletFile).ReadJupiterProof(hashLeaf, proof))
+        return false;
+
+    if (CBlock::CheckMerkleBranch(hashLeaf, proof.vMerkleBranch, proof.nIndex) != proof.hashRoot)
+    {
+        strError = "Merkle branch does not lead to the anchored root";
+        return true;
+    }
+
+    CTransaction tx;
+    uint256 hashBlock = 0;
+    if (!GetTransaction(proof.txid, tx, hashBlock))
+    {
+        strError = "Anchor transaction not found";
+        return true;
+    }
+
+    CScript scriptRoot;
+    scriptRoot.SetDestination(GetJupiterPodAddress(proof.hashRoot).Get());
+    bool fPaysRoot = false;
+    for (const CTxOut& txout : tx.vout)
+        if (txout.scriptPubKey == scriptRoot)
+            fPaysRoot = true;
+    if (!fPaysRoot)
+    {
+        strError = "Anchor transaction does not pay to the root address";
+        return true;
+    }
+
+    if (hashBlock != 0)
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        if (mi != mapBlockIndex.end() && mi->second->IsInMainChain())
+            nConfirmations = 1 + nBestHeight - mi->second->nHeight;
+    }
+    if (nConfirmations == 0)
+        strError = "Anchor transaction is not in the main chain yet";
+
+    fValid = nConfirmations > 0;
+    return true;
+}
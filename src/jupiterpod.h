@@ -0,0 +1,44 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_JUPITERPOD_H
+#define BITCOIN_JUPITERPOD_H
+
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+class CJupiterProof;
+class CWalletTx;
+
+/** Items collected before a batch is anchored */
+static const unsigned int DEFAULT_JUPITER_POD_BATCH = 1000;
+/** Seconds the oldest pending item waits before its batch is anchored */
+static const unsigned int DEFAULT_JUPITER_POD_WINDOW = 3600;
+
+/** SHA256 of a file's contents, read in 1MB chunks */
+bool GetFileSHA256(const std::string& strPath, uint256& hash, int64_t& nSize);
+
+/** Describes a CID or a local file as "ipfs:<cid>" or "sha256:<digest>" */
+bool GetJupiterPodItem(const std::string& strCidOrFile, std::string& strItem);
+uint256 GetJupiterPodLeaf(const std::string& strItem);
+
+/** Merkle tree over the leaves, laid out like CBlock::vMerkleTree so that
+ *  CBlock::CheckMerkleBranch verifies its branches. */
+uint256 BuildJupiterPodTree(const std::vector<uint256>& vLeaves, std::vector<uint256>& vTree);
+std::vector<uint256> GetJupiterPodBranch(const std::vector<uint256>& vTree, int nLeaves, int nIndex);
+
+/** Adds an item to the pending batch. Returns true when the batch window
+ *  is full and the batch should be anchored. */
+bool AddJupiterPodItem(const std::string& strItem, unsigned int& nPending);
+
+/** Anchors the Merkle root of the pending items in one transaction and
+ *  stores the proof of every item in the wallet. */
+bool AnchorJupiterPodBatch(CWalletTx& wtx, uint256& hashRoot, unsigned int& nItems, std::string& strError);
+
+/** Checks the stored proof of an item and its transaction against the chain.
+ *  Returns false if there is no proof for the item. */
+bool VerifyJupiterPodItem(const std::string& strItem, CJupiterProof& proof, bool& fValid, int& nConfirmations, std::string& strError);
+
+#endif // BITCOIN_JUPITERPOD_H
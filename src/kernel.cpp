@@ -41,6 +41,38 @@ int64_t GetWeight(int64_t nIntervalBeginning, int64_t nIntervalEnd)
     return min(nIntervalEnd - nIntervalBeginning - nStakeMinAge, (int64_t)nStakeMaxAge);
 }
 
+// The target is nBits scaled by the coin day weight of the stake. It used to
+// be a CBigNum, signed and unbounded: a negative target fails and one past
+// 2**256 is met by any hash, the product is checked for that here.
+bool CheckStakeTarget(const uint256& hashProofOfStake, unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight, uint256& targetProofOfStake)
+{
+    bool fNegative, fOverflow;
+    arith_uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits, &fNegative, &fOverflow);
+
+    // Division truncated toward zero, the magnitude is that of the absolute values
+    bool fWeightNegative = (nValueIn < 0) != (nTimeWeight < 0);
+    uint64_t nValueAbs = nValueIn < 0 ? 0 - (uint64_t)nValueIn : nValueIn;
+    uint64_t nTimeAbs = nTimeWeight < 0 ? 0 - (uint64_t)nTimeWeight : nTimeWeight;
+    arith_uint256 bnCoinDayWeight = arith_uint256(nValueAbs) * arith_uint256(nTimeAbs) / arith_uint256(COIN) / arith_uint256(24 * 60 * 60);
+
+    arith_uint256 bnTarget;
+    bool fTargetNegative = false, fTargetOverflow = false;
+    if (!!bnCoinDayWeight && (fOverflow || !!bnTargetPerCoinDay))
+    {
+        fTargetNegative = fNegative != fWeightNegative;
+        bnTarget = bnCoinDayWeight * bnTargetPerCoinDay;
+        unsigned int nProductBits = bnCoinDayWeight.bits() + bnTargetPerCoinDay.bits();
+        fTargetOverflow = fOverflow || nProductBits > 257 ||
+            (nProductBits == 257 && bnTarget / bnCoinDayWeight != bnTargetPerCoinDay);
+    }
+    targetProofOfStake = ArithToUint256(bnTarget);
+
+    if (fTargetNegative)
+        return false;
+    return fTargetOverflow || UintToArith256(hashProofOfStake) <= bnTarget;
+}
+
 // Get the last stake modifier and its generation time from a given block
 static bool GetLastStakeModifier(const CBlockIndex* pindex, uint64_t& nStakeModifier, int64_t& nModifierTime)
 {
@@ -221,7 +253,7 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 static bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
     nStakeModifier = 0;
-    std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlockFrom);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlockFrom);
     if (mi == mapBlockIndex.end())
         return error("GetKernelStakeModifier() : block not indexed");
     const CBlockIndex* pindexFrom = mi->second;
@@ -233,7 +265,7 @@ static bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifi
     // loop to find the stake modifier later by a selection interval
     while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval)
     {
-        if (!pindex->pnext)
+        if (!chainActive.Next(pindex))
         {   // reached best block; may happen if node is behind on block chain
             if (fPrintProofOfStake || (pindex->GetBlockTime() + nStakeMinAge - nStakeModifierSelectionInterval > GetAdjustedTime()))
             {
@@ -243,7 +275,7 @@ static bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifi
                 return false;
             };
         };
-        pindex = pindex->pnext;
+        pindex = chainActive.Next(pindex);
         if (pindex->GeneratedStakeModifier())
         {
             nStakeModifierHeight = pindex->nHeight;
@@ -285,15 +317,11 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
         return error("CheckStakeKernelHash() : min age violation");
 
-    CBigNum bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
     int64_t nValueIn = txPrev.vout[prevout.n].nValue;
+    int64_t nTimeWeight = GetWeight((int64_t)txPrev.nTime, (int64_t)nTimeTx);
 
     uint256 hashBlockFrom = blockFrom.GetHash();
 
-    CBigNum bnCoinDayWeight = CBigNum(nValueIn) * GetWeight((int64_t)txPrev.nTime, (int64_t)nTimeTx) / COIN / (24 * 60 * 60);
-    targetProofOfStake = (bnCoinDayWeight * bnTargetPerCoinDay).getuint256();
-
     // Calculate hash
     CDataStream ss(SER_GETHASH, 0);
     uint64_t nStakeModifier = 0;
@@ -307,6 +335,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
 
     ss << nTimeBlockFrom << nTxPrevOffset << txPrev.nTime << prevout.n << nTimeTx;
     hashProofOfStake = Hash(ss.begin(), ss.end());
+    bool fMeetsTarget = CheckStakeTarget(hashProofOfStake, nBits, nValueIn, nTimeWeight, targetProofOfStake);
 
     if (fPrintProofOfStake)
     {
@@ -322,13 +351,11 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
             nTimeBlockFrom, nTxPrevOffset, txPrev.nTime, prevout.n, nTimeTx,
             hashProofOfStake.ToString().c_str());
 
-        CBigNum nTry = CBigNum(hashProofOfStake);
-        CBigNum nTar = bnCoinDayWeight * bnTargetPerCoinDay;
-        printf("try    %s\n                    target %s\n", nTry.ToString().c_str(), nTar.ToString().c_str());
+        printf("try    %s\n                    target %s\n", hashProofOfStake.ToString().c_str(), targetProofOfStake.ToString().c_str());
     };
 
     // Now check if proof-of-stake hash meets target protocol
-    if (CBigNum(hashProofOfStake) > bnCoinDayWeight * bnTargetPerCoinDay)
+    if (!fMeetsTarget)
         return false;
     if (fDebug && !fPrintProofOfStake)
     {
@@ -22,6 +22,10 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 // Sets hashProofOfStake on success return
 bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned int nTxPrevOffset, const CTransaction& txPrev, const COutPoint& prevout, unsigned int nTimeTx, uint256& hashProofOfStake, uint256& targetProofOfStake, bool fPrintProofOfStake=false);
 
+// Check whether hashProofOfStake meets the target of nBits for nValueIn staked
+// nTimeWeight seconds, sets targetProofOfStake
+bool CheckStakeTarget(const uint256& hashProofOfStake, unsigned int nBits, int64_t nValueIn, int64_t nTimeWeight, uint256& targetProofOfStake);
+
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
 bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake, uint256& targetProofOfStake);
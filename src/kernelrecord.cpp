@@ -105,33 +105,47 @@ double KernelRecord::getProbToMintStake(double difficulty, int timeOffset) const
     return target * coinAge / pow(static_cast<double>(2), 256);
 }
 
+int64_t KernelRecord::getDayWeight() const
+{
+    int64_t nWeight = GetAdjustedTime() - nTime - nStakeMinAge;
+    return nWeight >= 0 ? nWeight / nOneDay : -((nOneDay - 1 - nWeight) / nOneDay);
+}
+
+// Sum of min(max(x, 0), nMax) for x in [nFirst, nFirst + nCount)
+static double SumDayWeights(int64_t nFirst, int64_t nCount, int64_t nMax)
+{
+    double dSum = 0;
+    int64_t nLow = max(nFirst, (int64_t)0);
+    int64_t nHigh = min(nFirst + nCount - 1, nMax);
+    if (nLow <= nHigh)
+        dSum += (double)(nLow + nHigh) * (nHigh - nLow + 1) / 2;
+    int64_t nCapped = nFirst + nCount - max(nFirst, nMax + 1);
+    if (nCapped > 0)
+        dSum += (double)nCapped * nMax;
+    return dSum;
+}
+
 double KernelRecord::getProbToMintWithinNMinutes(double difficulty, int minutes)
 {
-    if(difficulty != prevDifficulty || minutes != prevMinutes)
+    // The day weight grows by one each day of the interval until nStakeMaxAge,
+    // so the stake weight of the whole interval has a closed form. Every second
+    // the output stakes with probability coinAge / (2^32 * difficulty), which
+    // is small enough for (1 - p)^n to be taken as exp(-n * p).
+    int64_t nDayWeight = getDayWeight();
+    if(difficulty != prevDifficulty || minutes != prevMinutes || nDayWeight != prevDayWeight)
     {
-        double prob = 1;
-        double p;
         int d = minutes / (60 * 24); // Number of full days
         int m = minutes % (60 * 24); // Number of minutes in the last day
-        int i, timeOffset;
+        int64_t nMaxDayWeight = ((int64_t)nStakeMaxAge - nStakeMinAge) / nOneDay;
 
-        // Probabilities for the first d days
-        for(i = 0; i < d; i++)
-        {
-            timeOffset = i * 86400;
-            p = pow(1 - getProbToMintStake(difficulty, timeOffset), 86400);
-            prob *= p;
-        }
+        double dWeight = 86400 * SumDayWeights(nDayWeight, d, nMaxDayWeight) +
+                         60.0 * m * SumDayWeights(nDayWeight + d, 1, nMaxDayWeight);
+        double dCoins = (double)nValue / COIN;
 
-        // Probability for the m minutes of the last day
-        timeOffset = d * 86400;
-        p = pow(1 - getProbToMintStake(difficulty, timeOffset), 60 * m);
-        prob *= p;
-
-        prob = 1 - prob;
-        prevProbability = prob;
+        prevProbability = 1 - exp(-dCoins * dWeight / (4294967296.0 * difficulty));
         prevDifficulty = difficulty;
         prevMinutes = minutes;
+        prevDayWeight = nDayWeight;
     }
     return prevProbability;
 }
@@ -10,12 +10,12 @@ class KernelRecord
 {
 public:
     KernelRecord():
-        hash(), nTime(0), address(""), nValue(0), idx(0), spent(false), coinAge(0), prevMinutes(0), prevDifficulty(0), prevProbability(0)
+        hash(), nTime(0), address(""), nValue(0), idx(0), spent(false), coinAge(0), prevMinutes(0), prevDifficulty(0), prevProbability(0), prevDayWeight(0)
     {
     }
 
     KernelRecord(uint256 hash, int64_t nTime):
-            hash(hash), nTime(nTime), address(""), nValue(0), idx(0), spent(false), coinAge(0), prevMinutes(0), prevDifficulty(0), prevProbability(0)
+            hash(hash), nTime(nTime), address(""), nValue(0), idx(0), spent(false), coinAge(0), prevMinutes(0), prevDifficulty(0), prevProbability(0), prevDayWeight(0)
     {
     }
 
@@ -23,7 +23,7 @@ public:
                  const std::string &address,
                  int64_t nValue, int idx, bool spent, int64_t coinAge):
         hash(hash), nTime(nTime), address(address), nValue(nValue),
-        idx(idx), spent(spent), coinAge(coinAge), prevMinutes(0), prevDifficulty(0), prevProbability(0)
+        idx(idx), spent(spent), coinAge(coinAge), prevMinutes(0), prevDifficulty(0), prevProbability(0), prevDayWeight(0)
     {
     }
 
@@ -42,13 +42,17 @@ public:
     std::string getTxID();
     int64_t getAge() const;
     uint64_t getCoinDay() const;
+    /** Whole days of stake weight the output has now, negative before nStakeMinAge */
+    int64_t getDayWeight() const;
     double getProbToMintStake(double difficulty, int timeOffset = 0) const;
+    /** Cached until the difficulty, the interval or the day weight changes */
     double getProbToMintWithinNMinutes(double difficulty, int minutes);
     int64_t getPoSReward(int nBits, int timeOffset);
 protected:
     int prevMinutes;
     double prevDifficulty;
     double prevProbability;
+    int64_t prevDayWeight;
 };
 
 #endif // KERNELRECORD_H
@@ -0,0 +1,346 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logging.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+std::atomic<uint32_t> nLogCategories(LOG_NONE);
+
+static const struct
+{
+    uint32_t nCategory;
+    const char* pszName;
+    bool* pfFlag;
+} logCategories[] =
+{
+    { LOG_NET,      "net",      &fDebugNet },
+    { LOG_SMSG,     "smsg",     &fDebugSmsg },
+    { LOG_CHAIN,    "chain",    &fDebugChain },
+    { LOG_FS,       "fs",       &fDebugFS },
+    { LOG_RINGSIG,  "ringsig",  &fDebugRingSig },
+    { LOG_BENCH,    "bench",    NULL },
+};
+
+bool GetLogCategory(const std::string& strName, uint32_t& nCategory)
+{
+    if (strName == "" || strName == "1" || strName == "all") {
+        nCategory = LOG_ALL;
+        return true;
+    }
+    for (unsigned int i = 0; i < ARRAYLEN(logCategories); i++)
+    {
+        if (strName == logCategories[i].pszName) {
+            nCategory = logCategories[i].nCategory;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::pair<std::string, bool> > ListLogCategories()
+{
+    std::vector<std::pair<std::string, bool> > vCategories;
+    for (unsigned int i = 0; i < ARRAYLEN(logCategories); i++)
+        vCategories.push_back(make_pair(std::string(logCategories[i].pszName), LogAcceptFlag(logCategories[i].nCategory)));
+    return vCategories;
+}
+
+void SetLogCategories(uint32_t nCategories)
+{
+    nLogCategories.store(nCategories, std::memory_order_relaxed);
+    for (unsigned int i = 0; i < ARRAYLEN(logCategories); i++)
+        if (logCategories[i].pfFlag)
+            *logCategories[i].pfFlag = (nCategories & logCategories[i].nCategory) != 0;
+}
+
+// Bounded queue of log fragments, any number of threads push, the writer
+// thread pops. A slot is free for position p when its sequence is p and
+// holds the fragment of position p when its sequence is p + 1.
+class CLogSlot
+{
+public:
+    std::atomic<size_t> nSequence;
+    int64_t nTime;
+    const char* pszCategory;
+    std::string str;
+};
+
+static CLogSlot* pSlots = NULL;     // never freed, logging may run in global destructors
+static size_t nSlotMask = 0;
+static std::atomic<size_t> nEnqueuePos(0);
+static size_t nDequeuePos = 0;      // writer thread only
+
+static std::atomic<bool> fAsync(false);
+static std::atomic<int> nProducers(0);
+static std::atomic<uint64_t> nQueued(0);
+static std::atomic<uint64_t> nWritten(0);
+static std::atomic<uint64_t> nDropped(0);
+static std::atomic<uint64_t> nBytes(0);
+static std::atomic<uint64_t> nWrites(0);
+
+static LogFormat logFormat = LOG_FORMAT_TEXT;
+static FILE* fileLog = NULL;
+static boost::thread* pthreadLogWriter = NULL;
+static boost::mutex* pmutexWriter = NULL;
+static boost::condition_variable* pcondWriter = NULL;
+static bool fStopWriter = false;
+
+bool IsLoggingAsync()
+{
+    return fAsync.load(std::memory_order_acquire);
+}
+
+bool LogQueue(const char* pszCategory, std::string& str)
+{
+    if (!fAsync.load(std::memory_order_acquire))
+        return false;
+    nProducers.fetch_add(1, std::memory_order_acq_rel);
+    if (!fAsync.load(std::memory_order_acquire)) {
+        nProducers.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+
+    CLogSlot* pslot = NULL;
+    size_t nPos = nEnqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        CLogSlot& slot = pSlots[nPos & nSlotMask];
+        size_t nSequence = slot.nSequence.load(std::memory_order_acquire);
+        intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPos;
+        if (nDiff == 0) {
+            if (nEnqueuePos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed)) {
+                pslot = &slot;
+                break;
+            }
+        } else if (nDiff < 0) {
+            break;  // full
+        } else {
+            nPos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    if (pslot) {
+        pslot->nTime = GetTime();
+        pslot->pszCategory = pszCategory;
+        pslot->str.swap(str);
+        pslot->nSequence.store(nPos + 1, std::memory_order_release);
+        nQueued.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        nDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    nProducers.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+static void AppendJSONString(std::string& strOut, const std::string& str, size_t nBegin, size_t nEnd)
+{
+    strOut += '"';
+    for (size_t i = nBegin; i < nEnd; i++)
+    {
+        unsigned char ch = str[i];
+        switch (ch)
+        {
+        case '"':  strOut += "\\\""; break;
+        case '\\': strOut += "\\\\"; break;
+        case '\n': strOut += "\\n"; break;
+        case '\r': strOut += "\\r"; break;
+        case '\t': strOut += "\\t"; break;
+        default:
+            if (ch < 0x20)
+                strOut += strprintf("\\u%04x", ch);
+            else
+                strOut += ch;
+        }
+    }
+    strOut += '"';
+}
+
+// Writer thread state
+static bool fStartedNewLine = true;
+static int64_t nLastTime = -1;
+static std::string strLastTime;
+static std::string strLine;         // JSON mode, the line being put together
+static int64_t nLineTime = 0;
+static const char* pszLineCategory = NULL;
+static uint64_t nDroppedReported = 0;
+
+static void FormatFragment(std::string& strOut, int64_t nTime, const char* pszCategory, const std::string& str)
+{
+    if (logFormat == LOG_FORMAT_TEXT)
+    {
+        if (fLogTimestamps && fStartedNewLine) {
+            if (nTime != nLastTime) {
+                nLastTime = nTime;
+                strLastTime = DateTimeStrFormat("%x %H:%M:%S", nTime);
+            }
+            strOut += strLastTime;
+            strOut += ' ';
+        }
+        strOut += str;
+        fStartedNewLine = !str.empty() && str[str.size() - 1] == '\n';
+        return;
+    }
+
+    if (strLine.empty()) {
+        nLineTime = nTime;
+        pszLineCategory = pszCategory;
+    }
+    strLine += str;
+
+    size_t nBegin = 0, nEnd;
+    while ((nEnd = strLine.find('\n', nBegin)) != std::string::npos)
+    {
+        strOut += strprintf("{\"time\":%" PRId64",\"category\":", nLineTime);
+        strOut += pszLineCategory ? strprintf("\"%s\"", pszLineCategory) : std::string("null");
+        strOut += ",\"message\":";
+        AppendJSONString(strOut, strLine, nBegin, nEnd);
+        strOut += "}\n";
+        nBegin = nEnd + 1;
+        nLineTime = nTime;
+        pszLineCategory = pszCategory;
+    }
+    strLine.erase(0, nBegin);
+}
+
+// Formats up to nMax queued fragments into strOut
+static unsigned int DrainQueue(std::string& strOut, unsigned int nMax)
+{
+    unsigned int n = 0;
+    for (; n < nMax; n++)
+    {
+        CLogSlot& slot = pSlots[nDequeuePos & nSlotMask];
+        if (slot.nSequence.load(std::memory_order_acquire) != nDequeuePos + 1)
+            break;
+        FormatFragment(strOut, slot.nTime, slot.pszCategory, slot.str);
+        slot.str.clear();
+        slot.nSequence.store(nDequeuePos + nSlotMask + 1, std::memory_order_release);
+        nDequeuePos++;
+    }
+
+    uint64_t nDroppedNow = nDropped.load(std::memory_order_relaxed);
+    if (nDroppedNow != nDroppedReported) {
+        std::string strDropped = strprintf("logging: %" PRIu64" lines dropped, log buffer full\n", nDroppedNow - nDroppedReported);
+        nDroppedReported = nDroppedNow;
+        FormatFragment(strOut, GetTime(), NULL, strDropped);
+    }
+    return n;
+}
+
+static void WriteOut(std::string& strOut)
+{
+    if (strOut.empty())
+        return;
+
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileLog) == NULL)
+            fileLog = NULL;
+    }
+    if (fileLog) {
+        fwrite(strOut.data(), 1, strOut.size(), fileLog);
+        fflush(fileLog);
+    }
+    nBytes.fetch_add(strOut.size(), std::memory_order_relaxed);
+    nWrites.fetch_add(1, std::memory_order_relaxed);
+    strOut.clear();
+}
+
+static void ThreadLogWriter()
+{
+    RenameThread("denarius-log");
+
+    std::string strOut;
+    while (true)
+    {
+        bool fStop;
+        {
+            boost::unique_lock<boost::mutex> lock(*pmutexWriter);
+            fStop = fStopWriter;
+        }
+
+        unsigned int n = DrainQueue(strOut, 4096);
+        nWritten.fetch_add(n, std::memory_order_relaxed);
+        WriteOut(strOut);
+        if (n > 0)
+            continue;
+
+        // fAsync is off once stopping, nothing more is queued after the
+        // last producer is out
+        if (fStop && nProducers.load(std::memory_order_acquire) == 0) {
+            nWritten.fetch_add(DrainQueue(strOut, ~0U), std::memory_order_relaxed);
+            if (!strLine.empty()) {
+                std::string strEnd("\n");
+                FormatFragment(strOut, GetTime(), NULL, strEnd);
+            }
+            WriteOut(strOut);
+            return;
+        }
+
+        // Loggers never signal, a short sleep keeps the hot paths free of syscalls
+        boost::unique_lock<boost::mutex> lock(*pmutexWriter);
+        if (!fStopWriter)
+            pcondWriter->timed_wait(lock, boost::posix_time::milliseconds(50));
+    }
+}
+
+void StartLogging(unsigned int nCapacity, LogFormat format)
+{
+    if (pthreadLogWriter || fPrintToConsole)
+        return;
+
+    boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+    fileLog = fopen(pathDebug.string().c_str(), "a");
+    if (!fileLog)
+        return;
+    setvbuf(fileLog, NULL, _IOFBF, 1 << 16);
+
+    size_t nSlots = 64;
+    while (nSlots < nCapacity && nSlots < (1U << 22))
+        nSlots <<= 1;
+    pSlots = new CLogSlot[nSlots];
+    for (size_t i = 0; i < nSlots; i++)
+        pSlots[i].nSequence.store(i, std::memory_order_relaxed);
+    nSlotMask = nSlots - 1;
+
+    logFormat = format;
+    pmutexWriter = new boost::mutex();
+    pcondWriter = new boost::condition_variable();
+    pthreadLogWriter = new boost::thread(&ThreadLogWriter);
+    fAsync.store(true, std::memory_order_release);
+}
+
+void StopLogging()
+{
+    if (!pthreadLogWriter)
+        return;
+
+    fAsync.store(false, std::memory_order_release);
+    {
+        boost::unique_lock<boost::mutex> lock(*pmutexWriter);
+        fStopWriter = true;
+    }
+    pcondWriter->notify_all();
+    pthreadLogWriter->join();
+    delete pthreadLogWriter;
+    pthreadLogWriter = NULL;
+
+    fclose(fileLog);
+    fileLog = NULL;
+}
+
+void GetLogStats(CLogStats& stats)
+{
+    stats.fAsync = IsLoggingAsync();
+    stats.nCapacity = pSlots ? nSlotMask + 1 : 0;
+    stats.nQueued = nQueued.load(std::memory_order_relaxed);
+    stats.nWritten = nWritten.load(std::memory_order_relaxed);
+    stats.nDropped = nDropped.load(std::memory_order_relaxed);
+    stats.nBytes = nBytes.load(std::memory_order_relaxed);
+    stats.nWrites = nWrites.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_LOGGING_H
+#define BITCOIN_LOGGING_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Lines debug.log can queue before the writer thread takes them, -logbuffer */
+static const unsigned int DEFAULT_LOG_BUFFER = 16384;
+
+/** Debug categories, switched on by -debug=<name>, the -debug* flags or the
+ *  logging RPC. Each keeps its fDebug* flag in step, so the existing
+ *  if (fDebugNet) printf(...) guards filter at the cost of a load. */
+enum LogCategory
+{
+    LOG_NONE        = 0,
+    LOG_NET         = (1U << 0),
+    LOG_SMSG        = (1U << 1),
+    LOG_CHAIN       = (1U << 2),
+    LOG_FS          = (1U << 3),
+    LOG_RINGSIG     = (1U << 4),
+    LOG_BENCH       = (1U << 5),
+    LOG_ALL         = ~0U,
+};
+
+enum LogFormat
+{
+    LOG_FORMAT_TEXT,
+    LOG_FORMAT_JSON,    // one object per line: time, category, message
+};
+
+extern std::atomic<uint32_t> nLogCategories;
+
+static inline bool LogAcceptFlag(uint32_t nCategory)
+{
+    return (nLogCategories.load(std::memory_order_relaxed) & nCategory) != 0;
+}
+
+bool GetLogCategory(const std::string& strName, uint32_t& nCategory);
+std::vector<std::pair<std::string, bool> > ListLogCategories();
+void SetLogCategories(uint32_t nCategories);
+
+class CLogStats
+{
+public:
+    bool fAsync;
+    unsigned int nCapacity;
+    uint64_t nQueued;
+    uint64_t nWritten;
+    uint64_t nDropped;  // lines lost because the buffer was full
+    uint64_t nBytes;
+    uint64_t nWrites;   // batches written
+
+    CLogStats() : fAsync(false), nCapacity(0), nQueued(0), nWritten(0), nDropped(0), nBytes(0), nWrites(0) {}
+};
+
+void GetLogStats(CLogStats& stats);
+
+/** Starts the thread writing debug.log. Before it runs and after
+ *  StopLogging, log lines are written by the thread logging them. */
+void StartLogging(unsigned int nCapacity, LogFormat format);
+/** Writes out what is queued and stops the writer thread */
+void StopLogging();
+bool IsLoggingAsync();
+
+/** Queues a fragment of a line for debug.log, str is taken. A full buffer
+ *  drops the fragment and counts it. False if the writer thread is not
+ *  running, the caller then writes the fragment itself. */
+bool LogQueue(const char* pszCategory, std::string& str);
+
+#endif // BITCOIN_LOGGING_H
@@ -5,6 +5,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "alert.h"
+#include "blockencodings.h"
+#include "blockfilter.h"
 #include "checkpoints.h"
 #include "db.h"
 #include "txdb.h"
@@ -44,12 +46,14 @@ CCriticalSection cs_main;
 CTxMemPool mempool;
 //unsigned int nTransactionsUpdated = 0;
 
-map<uint256, CBlockIndex*> mapBlockIndex;
+BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
+CChain chainActive;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
 
-CBigNum bnProofOfWorkLimit(~uint256(0) >> 20);      // "standard" scrypt target limit for proof of work, results with 0,000244140625 proof-of-work difficulty
-CBigNum bnProofOfStakeLimit(~uint256(0) >> 20);
-CBigNum bnProofOfWorkLimitTestNet(~uint256(0) >> 16);
+arith_uint256 bnProofOfWorkLimit(~arith_uint256(0) >> 20);      // "standard" scrypt target limit for proof of work, results with 0,000244140625 proof-of-work difficulty
+arith_uint256 bnProofOfStakeLimit(~arith_uint256(0) >> 20);
+arith_uint256 bnProofOfWorkLimitTestNet(~arith_uint256(0) >> 16);
 
 /** Fees smaller than this (in denarii) are considered zero fee (for relaying and mining) */
 // CFeeRate minRelayTxFee = CFeeRate(SUBCENT);
@@ -80,12 +84,21 @@ CMedianFilter<int> cPeerBlockCounts(5, 0); // Amount of blocks that other nodes
 
 std::map<int64_t, CAnonOutputCount> mapAnonOutputStats;
 //map<int64_t, CAnonOutputCount> mapAnonOutputStats; // display only, not 100% accurate, height could become inaccurate due to undos
-map<uint256, CBlock*> mapOrphanBlocks;
-multimap<uint256, CBlock*> mapOrphanBlocksByPrev;
+map<uint256, COrphanBlock*> mapOrphanBlocks;
+multimap<uint256, COrphanBlock*> mapOrphanBlocksByPrev;
 set<pair<COutPoint, unsigned int> > setStakeSeenOrphan;
+static vector<COrphanBlock*> vOrphanBlocks;         // for picking one at random
+static vector<COrphanBlock*> vOrphanBlocksData;     // the ones holding their block
+static uint64_t nOrphanBlocksBytes = 0;
+static map<NodeId, uint64_t> mapOrphanBlocksBytesByPeer;
+static int64_t nNextOrphanBlocksExpire = 0;
 
-map<uint256, CTransaction> mapOrphanTransactions;
+map<uint256, COrphanTx> mapOrphanTransactions;
 map<uint256, set<uint256> > mapOrphanTransactionsByPrev;
+static vector<map<uint256, COrphanTx>::iterator> vOrphanTransactions;
+static uint64_t nOrphanTransactionsBytes = 0;
+static map<NodeId, uint64_t> mapOrphanTransactionsBytesByPeer;
+static int64_t nNextOrphanTransactionsExpire = 0;
 
 // Constant stuff for coinbase transactions we create:
 CScript COINBASE_FLAGS;
@@ -291,7 +304,11 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats)
 // mapOrphanTransactions
 //
 
-bool AddOrphanTx(const CTransaction& tx)
+// Orphans are budgeted in bytes as well as in number, and no peer may take
+// more than half of a pool. Each pool keeps a list of its entries for O(1)
+// random eviction, an entry knows its position and is swapped out of it.
+
+bool AddOrphanTx(const CTransaction& tx, NodeId peer)
 {
     uint256 hash = tx.GetHash();
     if (mapOrphanTransactions.count(hash))
@@ -313,7 +330,28 @@ bool AddOrphanTx(const CTransaction& tx)
         return false;
     };
 
-    mapOrphanTransactions[hash] = tx;
+    uint64_t nMaxBytes = (uint64_t)std::max((int64_t)0, GetArg("-maxorphantxkb", DEFAULT_MAX_ORPHAN_TX_KB)) * 1000;
+    uint64_t& nPeerBytes = mapOrphanTransactionsBytesByPeer[peer];
+    if (peer != -1 && nPeerBytes + nSize > nMaxBytes / 2)
+    {
+        if (nPeerBytes == 0)
+            mapOrphanTransactionsBytesByPeer.erase(peer);
+        if (fDebug)
+            printf("ignoring orphan tx %s, peer %d holds %" PRIu64" bytes of orphans\n", hash.ToString().substr(0,10).c_str(), peer, nPeerBytes);
+        return false;
+    };
+    nPeerBytes += nSize;
+
+    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.insert(make_pair(hash, COrphanTx())).first;
+    COrphanTx& orphan = it->second;
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTimeExpire = GetTime() + ORPHAN_TX_EXPIRE_TIME;
+    orphan.nSize = nSize;
+    orphan.nPos = vOrphanTransactions.size();
+    vOrphanTransactions.push_back(it);
+    nOrphanTransactionsBytes += nSize;
+
     for (const CTxIn& txin : tx.vin)
         mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
 
@@ -324,29 +362,52 @@ bool AddOrphanTx(const CTransaction& tx)
 
 void static EraseOrphanTx(uint256 hash)
 {
-    if (!mapOrphanTransactions.count(hash))
+    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
+    if (it == mapOrphanTransactions.end())
         return;
-    const CTransaction& tx = mapOrphanTransactions[hash];
-    for (const CTxIn& txin : tx.vin)
+    const COrphanTx& orphan = it->second;
+    for (const CTxIn& txin : orphan.tx.vin)
     {
-        mapOrphanTransactionsByPrev[txin.prevout.hash].erase(hash);
-        if (mapOrphanTransactionsByPrev[txin.prevout.hash].empty())
-            mapOrphanTransactionsByPrev.erase(txin.prevout.hash);
+        map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+        if (itPrev == mapOrphanTransactionsByPrev.end())
+            continue;
+        itPrev->second.erase(hash);
+        if (itPrev->second.empty())
+            mapOrphanTransactionsByPrev.erase(itPrev);
     }
-    mapOrphanTransactions.erase(hash);
+
+    map<NodeId, uint64_t>::iterator itPeer = mapOrphanTransactionsBytesByPeer.find(orphan.fromPeer);
+    if (itPeer != mapOrphanTransactionsBytesByPeer.end() && (itPeer->second -= orphan.nSize) == 0)
+        mapOrphanTransactionsBytesByPeer.erase(itPeer);
+    nOrphanTransactionsBytes -= orphan.nSize;
+
+    vOrphanTransactions[orphan.nPos] = vOrphanTransactions.back();
+    vOrphanTransactions[orphan.nPos]->second.nPos = orphan.nPos;
+    vOrphanTransactions.pop_back();
+    mapOrphanTransactions.erase(it);
 }
 
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, uint64_t nMaxBytes)
 {
     unsigned int nEvicted = 0;
-    while (mapOrphanTransactions.size() > nMaxOrphans)
+
+    int64_t nNow = GetTime();
+    if (nNextOrphanTransactionsExpire <= nNow)
+    {
+        vector<uint256> vExpired;
+        for (map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.begin(); it != mapOrphanTransactions.end(); ++it)
+            if (it->second.nTimeExpire <= nNow)
+                vExpired.push_back(it->first);
+        for (const uint256& hash : vExpired)
+            EraseOrphanTx(hash);
+        nEvicted += vExpired.size();
+        nNextOrphanTransactionsExpire = nNow + ORPHAN_EXPIRE_INTERVAL;
+    }
+
+    while (mapOrphanTransactions.size() > nMaxOrphans || nOrphanTransactionsBytes > nMaxBytes)
     {
         // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        map<uint256, CTransaction>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
+        EraseOrphanTx(vOrphanTransactions[GetRand(vOrphanTransactions.size())]->first);
         ++nEvicted;
     }
     return nEvicted;
@@ -757,7 +818,7 @@ int CMerkleTx::SetMerkleBranch(const CBlock* pblock)
     vMerkleBranch = pblock->GetMerkleBranch(nIndex);
 
     // Is the tx in a block that's in the main chain
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1080,6 +1141,7 @@ bool CTxMemPool::accept(CTxDB& txdb, CTransaction &tx, bool fCheckInputs,
             //Add the TX to our Pending Names in Name DB
             hooks->AddToPendingNames(tx);
         }
+        FortunastakeCollateralSpent(tx, true);
 
         ///// are we sure this is ok when loading transactions or restoring block txes
         // If updated, erase old tx from wallet
@@ -1291,6 +1353,7 @@ bool CTxMemPool::remove(const CTransaction &tx, bool fRecursive)
             for (const CTxIn& txin : tx.vin)
                 mapNextTx.erase(txin.prevout);
             mapTx.erase(hash);
+            collateralWatch.RemoveFromMempool(tx);
 
             if (tx.nVersion == ANON_TXN_VERSION)
             {
@@ -1356,7 +1419,7 @@ int CMerkleTx::GetDepthInMainChainINTERNAL(CBlockIndex* &pindexRet) const
     AssertLockHeld(cs_main);
 
     // Find the block it claims to be in
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1436,7 +1499,7 @@ int CTxIndex::GetDepthInMainChain() const
     if (!block.ReadFromDisk(pos.nFile, pos.nBlockPos, false))
         return 0;
     // Find the block in the index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
+    BlockMap::iterator mi = mapBlockIndex.find(block.GetHash());
     if (mi == mapBlockIndex.end())
         return 0;
     CBlockIndex* pindex = (*mi).second;
@@ -1550,22 +1613,70 @@ bool TxnHashInSystem(CTxDB* ptxdb, uint256& txnHash)
 //     return true;
 // }
 
-static CBlockIndex* pblockindexFBBHLast;
-CBlockIndex* FindBlockByHeight(int nHeight)
+void CChain::SetTip(CBlockIndex* pindex)
 {
-    CBlockIndex *pblockindex;
-    if (nHeight < nBestHeight / 2)
-        pblockindex = pindexGenesisBlock;
+    if (pindex == NULL)
+    {
+        vChain.clear();
+        return;
+    }
+    vChain.resize(pindex->nHeight + 1);
+    while (pindex && vChain[pindex->nHeight] != pindex)
+    {
+        vChain[pindex->nHeight] = pindex;
+        pindex = pindex->pprev;
+    }
+}
+
+void* CBlockIndexArena::Allocate()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nAllocated++;
+    if (pfree)
+    {
+        FreeEntry* p = pfree;
+        pfree = p->pnext;
+        return p;
+    }
+    if (nChunkUsed == CHUNK_OBJECTS)
+    {
+        vChunks.push_back((char*)::operator new(CHUNK_OBJECTS * sizeof(CBlockIndex)));
+        nChunks++;
+        nChunkUsed = 0;
+    }
+    return vChunks.back() + sizeof(CBlockIndex) * nChunkUsed++;
+}
+
+void CBlockIndexArena::Free(void* p)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nAllocated--;
+    FreeEntry* pentry = (FreeEntry*)p;
+    pentry->pnext = pfree;
+    pfree = pentry;
+}
+
+void* CBlockIndex::operator new(size_t nSize)
+{
+    // CDiskBlockIndex inherits this operator but is larger
+    if (nSize != sizeof(CBlockIndex))
+        return ::operator new(nSize);
+    return blockIndexArena.Allocate();
+}
+
+void CBlockIndex::operator delete(void* p, size_t nSize)
+{
+    if (p == NULL)
+        return;
+    if (nSize != sizeof(CBlockIndex))
+        ::operator delete(p);
     else
-        pblockindex = pindexBest;
-    if (pblockindexFBBHLast && abs(nHeight - pblockindex->nHeight) > abs(nHeight - pblockindexFBBHLast->nHeight))
-        pblockindex = pblockindexFBBHLast;
-    while (pblockindex->nHeight > nHeight)
-        pblockindex = pblockindex->pprev;
-    while (pblockindex->nHeight < nHeight)
-        pblockindex = pblockindex->pnext;
-    pblockindexFBBHLast = pblockindex;
-    return pblockindex;
+        blockIndexArena.Free(p);
+}
+
+CBlockIndex* FindBlockByHeight(int nHeight)
+{
+    return chainActive[nHeight];
 }
 
 bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions)
@@ -1582,46 +1693,185 @@ bool CBlock::ReadFromDisk(const CBlockIndex* pindex, bool fReadTransactions)
     return true;
 }
 
-uint256 static GetOrphanRoot(const CBlock* pblock)
+// Work back to the first block in the orphan chain. Orphans leave the pool
+// from the root down or from the leaves up, whole subtrees on expiry, so an
+// ancestor still in the pool is joined to the block by orphans and the
+// hashRoot shortcuts can be followed and shortened on the way.
+static COrphanBlock* GetOrphanRoot(COrphanBlock* porphan)
 {
-    // Work back to the first block in the orphan chain
-    while (mapOrphanBlocks.count(pblock->hashPrevBlock))
-        pblock = mapOrphanBlocks[pblock->hashPrevBlock];
-    return pblock->GetHash();
+    vector<COrphanBlock*> vPath;
+    COrphanBlock* proot = porphan;
+    while (true)
+    {
+        map<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocks.find(proot->hashRoot);
+        if (mi == mapOrphanBlocks.end() || mi->second == proot)
+            mi = mapOrphanBlocks.find(proot->hashPrev);
+        if (mi == mapOrphanBlocks.end())
+            break;
+        vPath.push_back(proot);
+        proot = mi->second;
+    }
+    for (COrphanBlock* p : vPath)
+        p->hashRoot = proot->hashBlock;
+    return proot;
 }
 
 // ppcoin: find block wanted by given orphan block
-uint256 WantedByOrphan(const CBlock* pblockOrphan)
+uint256 WantedByOrphan(COrphanBlock* pblockOrphan)
+{
+    return GetOrphanRoot(pblockOrphan)->hashPrev;
+}
+
+// A block held only as a header is wanted again once its parent is in
+static bool HaveOrphanBlock(const uint256& hash)
 {
-    // Work back to the first block in the orphan chain
-    while (mapOrphanBlocks.count(pblockOrphan->hashPrevBlock))
-        pblockOrphan = mapOrphanBlocks[pblockOrphan->hashPrevBlock];
-    return pblockOrphan->hashPrevBlock;
+    map<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocks.find(hash);
+    if (mi == mapOrphanBlocks.end())
+        return false;
+    return mi->second->HaveData() || !mapBlockIndex.count(mi->second->hashPrev);
 }
 
-// Remove a random orphan block (which does not have any dependent orphans).
-void static PruneOrphanBlocks()
+static void DropOrphanBlockData(COrphanBlock* porphan)
 {
-    if (mapOrphanBlocksByPrev.size() <= (size_t)std::max((int64_t)0, GetArg("-maxorphanblocks", DEFAULT_MAX_ORPHAN_BLOCKS)))
+    if (!porphan->HaveData())
         return;
 
-    // Pick a random orphan block.
-    int pos = insecure_rand() % mapOrphanBlocksByPrev.size();
-    std::multimap<uint256, CBlock*>::iterator it = mapOrphanBlocksByPrev.begin();
-    while (pos--) it++;
+    map<NodeId, uint64_t>::iterator itPeer = mapOrphanBlocksBytesByPeer.find(porphan->fromPeer);
+    if (itPeer != mapOrphanBlocksBytesByPeer.end() && (itPeer->second -= porphan->vchBlock.size()) == 0)
+        mapOrphanBlocksBytesByPeer.erase(itPeer);
+    nOrphanBlocksBytes -= porphan->vchBlock.size();
+    std::vector<unsigned char>().swap(porphan->vchBlock);
+
+    vOrphanBlocksData[porphan->nDataPos] = vOrphanBlocksData.back();
+    vOrphanBlocksData[porphan->nDataPos]->nDataPos = porphan->nDataPos;
+    vOrphanBlocksData.pop_back();
+}
+
+static void EraseOrphanBlock(COrphanBlock* porphan)
+{
+    DropOrphanBlockData(porphan);
 
-    // As long as this block has other orphans depending on it, move to one of those successors.
-    do {
-        std::multimap<uint256, CBlock*>::iterator it2 = mapOrphanBlocksByPrev.find(it->second->GetHash());
-        if (it2 == mapOrphanBlocksByPrev.end())
+    for (multimap<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(porphan->hashPrev);
+         mi != mapOrphanBlocksByPrev.end() && mi->first == porphan->hashPrev; ++mi)
+    {
+        if (mi->second == porphan) {
+            mapOrphanBlocksByPrev.erase(mi);
             break;
-        it = it2;
-    } while(1);
+        }
+    }
+    if (porphan->fProofOfStake)
+        setStakeSeenOrphan.erase(porphan->stake);
+    mapOrphanBlocks.erase(porphan->hashBlock);
+
+    vOrphanBlocks[porphan->nPos] = vOrphanBlocks.back();
+    vOrphanBlocks[porphan->nPos]->nPos = porphan->nPos;
+    vOrphanBlocks.pop_back();
+    delete porphan;
+}
 
-    uint256 hash = it->second->GetHash();
-    delete it->second;
-    mapOrphanBlocksByPrev.erase(it);
-    mapOrphanBlocks.erase(hash);
+// Erases an orphan and every orphan building on it
+static unsigned int EraseOrphanBlockTree(COrphanBlock* porphan)
+{
+    vector<COrphanBlock*> vErase(1, porphan);
+    for (unsigned int i = 0; i < vErase.size(); i++)
+    {
+        multimap<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(vErase[i]->hashBlock);
+        for (; mi != mapOrphanBlocksByPrev.end() && mi->first == vErase[i]->hashBlock; ++mi)
+            vErase.push_back(mi->second);
+    }
+    for (COrphanBlock* p : vErase)
+        EraseOrphanBlock(p);
+    return vErase.size();
+}
+
+static COrphanBlock* AddOrphanBlock(const CBlock& block, NodeId peer)
+{
+    COrphanBlock* porphan = new COrphanBlock();
+    porphan->hashBlock = block.GetHash();
+    porphan->hashPrev = block.hashPrevBlock;
+    porphan->fProofOfStake = block.IsProofOfStake();
+    if (porphan->fProofOfStake)
+        porphan->stake = block.GetProofOfStake();
+    porphan->fromPeer = peer;
+    porphan->nTimeExpire = GetTime() + ORPHAN_BLOCK_EXPIRE_TIME;
+
+    map<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocks.find(porphan->hashPrev);
+    porphan->hashRoot = mi != mapOrphanBlocks.end() ? mi->second->hashRoot : porphan->hashBlock;
+
+    porphan->nPos = vOrphanBlocks.size();
+    vOrphanBlocks.push_back(porphan);
+    mapOrphanBlocks.insert(make_pair(porphan->hashBlock, porphan));
+    mapOrphanBlocksByPrev.insert(make_pair(porphan->hashPrev, porphan));
+
+    // A peer over half the budget only gets its headers kept
+    uint64_t nMaxBytes = (uint64_t)std::max((int64_t)0, GetArg("-maxorphanblockskb", DEFAULT_MAX_ORPHAN_BLOCKS_KB)) * 1000;
+    uint64_t& nPeerBytes = mapOrphanBlocksBytesByPeer[peer];
+    unsigned int nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    if (peer == -1 || nPeerBytes + nSize <= nMaxBytes / 2)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss.reserve(nSize);
+        ss << block;
+        porphan->vchBlock.assign(ss.begin(), ss.end());
+        porphan->nDataPos = vOrphanBlocksData.size();
+        vOrphanBlocksData.push_back(porphan);
+        nPeerBytes += nSize;
+        nOrphanBlocksBytes += nSize;
+    }
+    if (nPeerBytes == 0)
+        mapOrphanBlocksBytesByPeer.erase(peer);
+
+    // Over the budget, drop the data of random orphans
+    while (nOrphanBlocksBytes > nMaxBytes)
+        DropOrphanBlockData(vOrphanBlocksData[GetRand(vOrphanBlocksData.size())]);
+    return porphan;
+}
+
+static bool ReadOrphanBlock(const COrphanBlock* porphan, CBlock& block)
+{
+    try {
+        CBufferReader ss((const char*)&porphan->vchBlock[0], (const char*)&porphan->vchBlock[0] + porphan->vchBlock.size(), SER_NETWORK, PROTOCOL_VERSION);
+        ss >> block;
+    } catch (std::exception& e) {
+        return error("ReadOrphanBlock() : deserialize or I/O error");
+    }
+    return true;
+}
+
+// Expires old orphans and makes room for one more
+void static LimitOrphanBlocks()
+{
+    int64_t nNow = GetTime();
+    if (nNextOrphanBlocksExpire <= nNow)
+    {
+        unsigned int nExpired = 0;
+        for (unsigned int i = 0; i < vOrphanBlocks.size(); )
+        {
+            if (vOrphanBlocks[i]->nTimeExpire <= nNow)
+                nExpired += EraseOrphanBlockTree(vOrphanBlocks[i]);
+            else
+                i++;
+        }
+        if (nExpired && fDebug)
+            printf("LimitOrphanBlocks() : expired %u orphan blocks\n", nExpired);
+        nNextOrphanBlocksExpire = nNow + ORPHAN_EXPIRE_INTERVAL;
+    }
+
+    size_t nMaxOrphans = (size_t)std::max((int64_t)0, GetArg("-maxorphanblocks", DEFAULT_MAX_ORPHAN_BLOCKS));
+    while (!vOrphanBlocks.empty() && vOrphanBlocks.size() >= nMaxOrphans)
+    {
+        // Pick a random orphan block, as long as it has other orphans
+        // depending on it move to one of those successors
+        COrphanBlock* porphan = vOrphanBlocks[GetRand(vOrphanBlocks.size())];
+        while (true)
+        {
+            multimap<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocksByPrev.find(porphan->hashBlock);
+            if (mi == mapOrphanBlocksByPrev.end())
+                break;
+            porphan = mi->second;
+        }
+        EraseOrphanBlock(porphan);
+    }
 }
 
 // Proof of Work miner's coin base reward
@@ -1697,10 +1947,17 @@ static const int64_t nTargetTimespan = 60;
 //
 // maximum nBits value could possible be required nTime after
 //
-unsigned int ComputeMaxBits(CBigNum bnTargetLimit, unsigned int nBase, int64_t nTime)
+unsigned int ComputeMaxBits(const arith_uint256& bnTargetLimit, unsigned int nBase, int64_t nTime)
 {
-    CBigNum bnResult;
-    bnResult.SetCompact(nBase);
+    // nBase is the nBits of an accepted block, never negative. A base above
+    // the limit ends at the limit, without doubling past 256 bits.
+    bool fNegative, fOverflow;
+    arith_uint256 bnResult;
+    bnResult.SetCompact(nBase, &fNegative, &fOverflow);
+    if (fNegative)
+        bnResult = 0;
+    if (fOverflow || bnResult > bnTargetLimit)
+        return bnTargetLimit.GetCompact();
     bnResult *= 2;
     while (nTime > 0 && bnResult < bnTargetLimit)
     {
@@ -1742,7 +1999,7 @@ const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfSta
 
 unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake)
 {
-    CBigNum bnTargetLimit = fProofOfStake ? bnProofOfStakeLimit : bnProofOfWorkLimit;
+    const arith_uint256& bnTargetLimit = fProofOfStake ? bnProofOfStakeLimit : bnProofOfWorkLimit;
 
     if (pindexLast == NULL)
         return bnTargetLimit.GetCompact(); // genesis block
@@ -1760,13 +2017,26 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
 
     // ppcoin: target change every block
     // ppcoin: retarget with exponential moving toward target spacing
-    CBigNum bnNew;
-    bnNew.SetCompact(pindexPrev->nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnNew;
+    bnNew.SetCompact(pindexPrev->nBits, &fNegative, &fOverflow);
     int64_t nInterval = nTargetTimespan / nTargetSpacing;
-    bnNew *= ((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
-    bnNew /= ((nInterval + 1) * nTargetSpacing);
+    int64_t nMul = (nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing;
+    int64_t nDiv = (nInterval + 1) * nTargetSpacing;
+
+    // A negative or zero target, or factor, gives a result <= 0. A product
+    // past 256 bits divided by nDiv is still far above the limit.
+    if (fNegative || nMul <= 0 || !bnNew)
+        bnNew = 0;
+    else if (fOverflow || bnNew.bits() + arith_uint256(nMul).bits() > 256)
+        bnNew = bnTargetLimit;
+    else
+    {
+        bnNew *= arith_uint256(nMul);
+        bnNew /= arith_uint256(nDiv);
+    }
 
-    if (bnNew <= 0 || bnNew > bnTargetLimit)
+    if (!bnNew || bnNew > bnTargetLimit)
         bnNew = bnTargetLimit;
 
     return bnNew.GetCompact();
@@ -1774,15 +2044,16 @@ unsigned int GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfS
 
 bool CheckProofOfWork(uint256 hash, unsigned int nBits)
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
     // Check range
-    if (bnTarget <= 0 || bnTarget > bnProofOfWorkLimit)
+    if (fNegative || fOverflow || !bnTarget || bnTarget > bnProofOfWorkLimit)
         return error("CheckProofOfWork() : nBits below minimum work");
 
     // Check proof of work matches claimed amount
-    if (hash > bnTarget.getuint256())
+    if (UintToArith256(hash) > bnTarget)
         return error("CheckProofOfWork() : hash doesn't match nBits");
 
     return true;
@@ -2392,8 +2663,11 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fWriteNames)
 {
     // Disconnect in reverse order
     for (int i = vtx.size()-1; i >= 0; i--)
+    {
         if (!vtx[i].DisconnectInputs(txdb))
             return false;
+        collateralWatch.Disconnect(vtx[i]);
+    }
 
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
@@ -2407,11 +2681,15 @@ bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fWriteNames)
 
     // denarius: undo name transactions in reverse order
     for (int i = vtx.size() - 1; i >= 0; i--)
-        hooks->DisconnectInputs(vtx[i]);
+        hooks->DisconnectInputs(txdb, vtx[i]);
 
     // ppcoin: clean up wallet after disconnecting coinstake
     for (CTransaction& tx : vtx)
+    {
         SyncWithWallets(tx, this, false, false);
+        // wallet views re-read the transaction, it is no longer confirmed
+        UpdatedTransaction(tx.GetHash());
+    }
 
     return true;
 }
@@ -2566,6 +2844,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck, boo
     int64_t nStakeReward = 0;
     unsigned int nSigOps = 0;
 
+    bool fBlockFilter = fBlockFilterIndex && !fJustCheck;
+    GCSElementSet setFilterElements;
+
     //DiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(vtx.size()));
     CDiskTxPos pos(pindex->nFile, pindex->nBlockPos, nTxPos);
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
@@ -2655,8 +2936,22 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck, boo
 
             if (!tx.ConnectInputs(txdb, mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, flags))
                 return false;
+
+            if (fBlockFilter)
+            {
+                for (const CTxIn& txin : tx.vin)
+                {
+                    MapPrevTx::const_iterator mi = mapInputs.find(txin.prevout.hash);
+                    if (mi != mapInputs.end() && txin.prevout.n < mi->second.second.vout.size())
+                        AddBlockFilterScript(mi->second.second.vout[txin.prevout.n].scriptPubKey, setFilterElements);
+                }
+            }
         }
 
+        if (fBlockFilter)
+            for (const CTxOut& txout : tx.vout)
+                AddBlockFilterScript(txout.scriptPubKey, setFilterElements);
+
         mapQueuedChanges[hashTx] = CTxIndex(posThisTx, tx.vout.size());
 
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
@@ -2798,46 +3093,44 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck, boo
                                 ExtractDestination(vtx[1].vout[i].scriptPubKey, mnDest);
                                 CBitcoinAddress mnAddress(mnDest);
                                 if (fDebug) printf("CheckBlock-POS() : Found fortunastake payment: %s D to %s.\n",FormatMoney(vtx[1].vout[i].nValue).c_str(), mnAddress.ToString().c_str());
-                                for (CFortunaStake& mn : vecFortunastakes)
+                                CFortunaStake* pmn = vecFortunastakes.FindByPayee(vtx[1].vout[i].scriptPubKey);
+                                if (pmn)
                                 {
+                                    CFortunaStake& mn = *pmn;
                                     pubScript = GetScriptForDestination(mn.pubkey.GetID());
                                     CTxDestination address1;
                                     ExtractDestination(pubScript, address1);
                                     CBitcoinAddress address2(address1);
 
-                                    if (vtx[1].vout[i].scriptPubKey == pubScript)
-                                    {
-                                        int64_t value = vtx[1].vout[i].nValue;
-                                        if (fDebug) printf("CheckBlock-POS() : Fortunastake PoS payee found at block %d: %s who got paid %s D rate:%" PRId64" rank:%d lastpaid:%d\n", pindex->nHeight, address2.ToString().c_str(), FormatMoney(value).c_str(), mn.payRate, mn.nRank, mn.nBlockLastPaid);
-
-                                        if (!fIsInitialDownload) {
-                                            if (!CheckPoSFSPayment(pindex, vtx[1].vout[i].nValue, mn)) // CheckPoSFSPayment()
-                                            {
-                                                if (pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT || pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT_TESTNET) { //Update PoS FS Payments to not go out of sync
-													//printf("CheckBlock-POS() : Out-of-cycle fortunastake payment detected, rejecting block.");
-                                                    printf("CheckBlock-POS() : Out-of-cycle FortunaStake payment detected, rejecting block. rank:%d value:%s avg:%s payRate:%s payCount:%d\n",mn.nRank,FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str(),FormatMoney(mn.payRate).c_str(), mn.payCount);
-                                                } else {
-                                                    printf("CheckBlock-POS(): This fortunastake payment is too aggressive and will be accepted after block %d\n", MN_ENFORCEMENT_ACTIVE_HEIGHT);
-                                                }
-                                                //break;
+                                    int64_t value = vtx[1].vout[i].nValue;
+                                    if (fDebug) printf("CheckBlock-POS() : Fortunastake PoS payee found at block %d: %s who got paid %s D rate:%" PRId64" rank:%d lastpaid:%d\n", pindex->nHeight, address2.ToString().c_str(), FormatMoney(value).c_str(), mn.payRate, mn.nRank, mn.nBlockLastPaid);
+
+                                    if (!fIsInitialDownload) {
+                                        if (!CheckPoSFSPayment(pindex, vtx[1].vout[i].nValue, mn)) // CheckPoSFSPayment()
+                                        {
+                                            if (pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT || pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT_TESTNET) { //Update PoS FS Payments to not go out of sync
+												//printf("CheckBlock-POS() : Out-of-cycle fortunastake payment detected, rejecting block.");
+                                                printf("CheckBlock-POS() : Out-of-cycle FortunaStake payment detected, rejecting block. rank:%d value:%s avg:%s payRate:%s payCount:%d\n",mn.nRank,FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str(),FormatMoney(mn.payRate).c_str(), mn.payCount);
                                             } else {
-                                                if (fDebug) printf("CheckBlock-POS() : Payment meets rate requirement: payee has earnt %s against average %s\n",FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str());
+                                                printf("CheckBlock-POS(): This fortunastake payment is too aggressive and will be accepted after block %d\n", MN_ENFORCEMENT_ACTIVE_HEIGHT);
                                             }
+                                            //break;
                                         } else {
-                                            if (fDebug) printf("CheckBlock-POS() : Wallet currently in startup mode, ignoring rate requirements.");
+                                            if (fDebug) printf("CheckBlock-POS() : Payment meets rate requirement: payee has earnt %s against average %s\n",FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str());
                                         }
-                                        // add mn payment data
-                                        mn.nBlockLastPaid = pindex->nHeight;
-                                        CFortunaPayData data;
-                                        data.height = pindex->nHeight;
-                                        data.amount = value;
-                                        data.hash = pindex->GetBlockHash();
-                                        mn.payData.push_back(data);
-                                        mn.SetPayRate(pindex->nHeight);
-                                        foundPayee = true;
-                                        paymentOK = true;
-                                        break;
+                                    } else {
+                                        if (fDebug) printf("CheckBlock-POS() : Wallet currently in startup mode, ignoring rate requirements.");
                                     }
+                                    // add mn payment data
+                                    mn.nBlockLastPaid = pindex->nHeight;
+                                    CFortunaPayData data;
+                                    data.height = pindex->nHeight;
+                                    data.amount = value;
+                                    data.hash = pindex->GetBlockHash();
+                                    mn.payData.push_back(data);
+                                    mn.SetPayRate(pindex->nHeight);
+                                    foundPayee = true;
+                                    paymentOK = true;
                                 }
                                 // if payee not found in mn list, check if the pubkey holds a 5K transaction
                                 if (!foundPayee) {
@@ -2926,47 +3219,45 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck, boo
 
                             CScript pubScript;
 
-                            for (CFortunaStake& mn : vecFortunastakes)
+                            CFortunaStake* pmn = vecFortunastakes.FindByPayee(payee);
+                            if (pmn)
                             {
+                                CFortunaStake& mn = *pmn;
                                 pubScript = GetScriptForDestination(mn.pubkey.GetID());
                                 CTxDestination address1;
                                 ExtractDestination(pubScript, address1);
                                 CBitcoinAddress address2(address1);
 
-                                if (payee == pubScript)
-                                {
-                                    if (fDebug) printf("CheckBlock-POW() : Fortunastake PoW payee found at block %d: %s who got paid %s D rate:%" PRId64" rank:%d lastpaid:%d\n", pindex->nHeight, address2.ToString().c_str(), FormatMoney(vtx[0].vout[i].nValue).c_str(), FormatMoney(mn.payRate).c_str(), mn.nRank, mn.nBlockLastPaid);
-                                    if (!fIsInitialDownload) {
-                                        if (!CheckFSPayment(pindex, vtx[0].vout[i].nValue, mn)) // if MN is being paid and it's bottom 50% ranked, don't let it be paid.
+                                if (fDebug) printf("CheckBlock-POW() : Fortunastake PoW payee found at block %d: %s who got paid %s D rate:%" PRId64" rank:%d lastpaid:%d\n", pindex->nHeight, address2.ToString().c_str(), FormatMoney(vtx[0].vout[i].nValue).c_str(), FormatMoney(mn.payRate).c_str(), mn.nRank, mn.nBlockLastPaid);
+                                if (!fIsInitialDownload) {
+                                    if (!CheckFSPayment(pindex, vtx[0].vout[i].nValue, mn)) // if MN is being paid and it's bottom 50% ranked, don't let it be paid.
+                                    {
+                                        if (pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT || pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT_TESTNET)
                                         {
-                                            if (pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT || pindexBest->nHeight >= MN_ENFORCEMENT_ACTIVE_HEIGHT_TESTNET)
-                                            {
-                                                printf("CheckBlock-POW() : Fortunastake overpayment detected, rejecting block. rank:%d value:%s avg:%s payRate:%s payCount:%d\n",mn.nRank,FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str(),FormatMoney(mn.payRate).c_str(), mn.payCount);
-                                            } else {
-                                                printf("WARNING: This fortunastake payment is too aggressive and will not be accepted after block %d\n", MN_ENFORCEMENT_ACTIVE_HEIGHT);
-                                            }
-                                            //break;
+                                            printf("CheckBlock-POW() : Fortunastake overpayment detected, rejecting block. rank:%d value:%s avg:%s payRate:%s payCount:%d\n",mn.nRank,FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str(),FormatMoney(mn.payRate).c_str(), mn.payCount);
                                         } else {
-                                            if (fDebug) printf("CheckBlock-POW() : Payment meets rate requirement: payee has earnt %s against average %s\n",FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str());
+                                            printf("WARNING: This fortunastake payment is too aggressive and will not be accepted after block %d\n", MN_ENFORCEMENT_ACTIVE_HEIGHT);
                                         }
+                                        //break;
                                     } else {
-                                        if (fDebug) printf("CheckBlock-POW() : Wallet currently in startup mode, ignoring rate requirements.");
+                                        if (fDebug) printf("CheckBlock-POW() : Payment meets rate requirement: payee has earnt %s against average %s\n",FormatMoney(mn.payValue).c_str(),FormatMoney(nAverageFSIncome).c_str());
                                     }
-
-                                    mn.nBlockLastPaid = pindex->nHeight;
-                                    CFortunaPayData data;
-                                    data.height = pindex->nHeight;
-                                    data.amount = vtx[0].vout[i].nValue;
-                                    data.hash = pindex->GetBlockHash();
-                                    mn.payData.push_back(data);
-                                    mn.SetPayRate(pindex->nHeight);
-                                    foundPayee = true;
-                                    paymentOK = true;
-                                    break;
-                                } else if (payee == burnPayee) {
-                                    printf("CheckBlock-POW() : Found fortunastake payment: %s D to burn address.\n", FormatMoney(vtx[0].vout[i].nValue).c_str());
-                                    foundPayee = true;
+                                } else {
+                                    if (fDebug) printf("CheckBlock-POW() : Wallet currently in startup mode, ignoring rate requirements.");
                                 }
+
+                                mn.nBlockLastPaid = pindex->nHeight;
+                                CFortunaPayData data;
+                                data.height = pindex->nHeight;
+                                data.amount = vtx[0].vout[i].nValue;
+                                data.hash = pindex->GetBlockHash();
+                                mn.payData.push_back(data);
+                                mn.SetPayRate(pindex->nHeight);
+                                foundPayee = true;
+                                paymentOK = true;
+                            } else if (payee == burnPayee && !vecFortunastakes.empty()) {
+                                printf("CheckBlock-POW() : Found fortunastake payment: %s D to burn address.\n", FormatMoney(vtx[0].vout[i].nValue).c_str());
+                                foundPayee = true;
                             }
 
                             // if payee not found in mn list, check if the pubkey holds a 5K transaction
@@ -3061,6 +3352,12 @@ bool CBlock::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex, bool fJustCheck, boo
         if (!txdb.UpdateTxIndex((*mi).first, (*mi).second))
             return error("ConnectBlock() : UpdateTxIndex failed");
     }
+
+    if (fBlockFilter && !txdb.WriteBlockFilter(CBlockFilter(pindex->GetBlockHash(), setFilterElements)))
+        return error("ConnectBlock() : WriteBlockFilter failed");
+
+    for (CTransaction& tx : vtx)
+        FortunastakeCollateralSpent(tx, false);
     if(GetBoolArg("-addrindex", false))
     {
         // Write Address Index
@@ -3216,15 +3513,8 @@ bool static Reorganize(CTxDB& txdb, CBlockIndex* pindexNew)
     if (!txdb.TxnCommit())
         return error("Reorganize() : TxnCommit failed");
 
-    // Disconnect shorter branch
-    for (CBlockIndex* pindex : vDisconnect)
-        if (pindex->pprev)
-            pindex->pprev->pnext = NULL;
-
-    // Connect longer branch
-    for (CBlockIndex* pindex : vConnect)
-        if (pindex->pprev)
-            pindex->pprev->pnext = pindex;
+    // Disconnect shorter branch, connect longer branch
+    chainActive.SetTip(pindexNew);
 
     // Resurrect memory transactions that were in the disconnected branch
     for (CTransaction& tx : vResurrect)
@@ -3259,7 +3549,7 @@ bool CBlock::SetBestChainInner(CTxDB& txdb, CBlockIndex *pindexNew)
         return error("SetBestChain() : TxnCommit failed");
 
     // Add to current best branch
-    pindexNew->pprev->pnext = pindexNew;
+    chainActive.SetTip(pindexNew);
 
     // Delete redundant memory transactions
     for (CTransaction& tx : vtx)
@@ -3280,6 +3570,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
         if (!txdb.TxnCommit())
             return error("SetBestChain() : TxnCommit failed");
         pindexGenesisBlock = pindexNew;
+        chainActive.SetTip(pindexNew);
     }
     else if (hashPrevBlock == hashBestChain)
     {
@@ -3345,7 +3636,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
     // New best block
     hashBestChain = hash;
     pindexBest = pindexNew;
-    pblockindexFBBHLast = NULL;
+    chainActive.SetTip(pindexNew);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexNew->nChainTrust;
     nTimeBestReceived = GetTime();
@@ -3397,7 +3688,7 @@ bool CBlock::SetBestChain(CTxDB& txdb, CBlockIndex* pindexNew)
 // age (trust score) of competing branches.
 bool CTransaction::GetCoinAge(CTxDB& txdb, uint64_t& nCoinAge) const
 {
-    CBigNum bnCentSecond = 0;  // coin age in the unit of cent-seconds
+    arith_uint256 bnCentSecond = 0;  // coin age in the unit of cent-seconds
     nCoinAge = 0;
 
     if (IsCoinBase())
@@ -3421,16 +3712,16 @@ bool CTransaction::GetCoinAge(CTxDB& txdb, uint64_t& nCoinAge) const
             continue; // only count coins meeting min age requirement
 
         int64_t nValueIn = txPrev.vout[txin.prevout.n].nValue;
-        bnCentSecond += CBigNum(nValueIn) * (nTime-txPrev.nTime) / CENT;
+        bnCentSecond += arith_uint256(nValueIn) * (uint32_t)(nTime - txPrev.nTime) / arith_uint256(CENT);
 
         if (fDebug && GetBoolArg("-printcoinage"))
             printf("coin age nValueIn=%" PRId64" nTimeDiff=%d bnCentSecond=%s\n", nValueIn, nTime - txPrev.nTime, bnCentSecond.ToString().c_str());
     }
 
-    CBigNum bnCoinDay = bnCentSecond * CENT / COIN / (24 * 60 * 60);
+    arith_uint256 bnCoinDay = bnCentSecond * arith_uint256(CENT) / arith_uint256(COIN) / arith_uint256(24 * 60 * 60);
     if (fDebug && GetBoolArg("-printcoinage"))
         printf("coin age bnCoinDay=%s\n", bnCoinDay.ToString().c_str());
-    nCoinAge = bnCoinDay.getuint64();
+    nCoinAge = bnCoinDay.GetLow64();
     return true;
 }
 
@@ -3468,7 +3759,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
     if (!pindexNew)
         return error("AddToBlockIndex() : new CBlockIndex failed");
     pindexNew->phashBlock = &hash;
-    map<uint256, CBlockIndex*>::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator miPrev = mapBlockIndex.find(hashPrevBlock);
     if (miPrev != mapBlockIndex.end())
     {
         pindexNew->pprev = (*miPrev).second;
@@ -3496,7 +3787,7 @@ bool CBlock::AddToBlockIndex(unsigned int nFile, unsigned int nBlockPos, const u
         return error("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=0x%016" PRIx64, pindexNew->nHeight, nStakeModifier);
 
     // Add to mapBlockIndex
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
+    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     if (pindexNew->IsProofOfStake())
         setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
     pindexNew->phashBlock = &((*mi).first);
@@ -3536,6 +3827,9 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
     // These are checks that are independent of context
     // that can be verified before saving an orphan block.
 
+    if (fChecked)
+        return true;
+
     // Size limits
     if (vtx.empty() || vtx.size() > MAX_BLOCK_SIZE || ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION) > MAX_BLOCK_SIZE)
         return DoS(100, error("CheckBlock() : size limits failed"));
@@ -3614,6 +3908,8 @@ bool CBlock::CheckBlock(bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig) c
     if (fCheckMerkleRoot && hashMerkleRoot != BuildMerkleTree())
         return DoS(100, error("CheckBlock() : hashMerkleRoot mismatch"));
 
+    if (fCheckPOW && fCheckMerkleRoot && fCheckSig)
+        fChecked = true;
 
     return true;
 }
@@ -3631,7 +3927,7 @@ bool CBlock::AcceptBlock()
         return error("AcceptBlock() : block already in mapBlockIndex");
 
     // Get prev block index
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashPrevBlock);
+    BlockMap::iterator mi = mapBlockIndex.find(hashPrevBlock);
     if (mi == mapBlockIndex.end())
         return DoS(10, error("AcceptBlock() : prev block not found"));
     CBlockIndex* pindexPrev = (*mi).second;
@@ -3703,10 +3999,30 @@ bool CBlock::AcceptBlock()
     int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
     if (hashBestChain == hash)
     {
+        // Peers speaking compact blocks get one straight away, it saves them
+        // the getdata round trip and most of the transactions
+        CInv inv(MSG_BLOCK, hash);
+        std::unique_ptr<CBlockHeaderAndShortTxIDs> pcmpctblock;
         LOCK(cs_vNodes);
         for (CNode* pnode : vNodes)
-            if (nBestHeight > (pnode->nChainHeight != -1 ? pnode->nChainHeight - 2000 : nBlockEstimate))
-                pnode->PushInventory(CInv(MSG_BLOCK, hash));
+        {
+            if (nBestHeight <= (pnode->nChainHeight != -1 ? pnode->nChainHeight - 2000 : nBlockEstimate))
+                continue;
+            if (pnode->nCompactBlocksVersion >= COMPACT_BLOCKS_VERSION && pnode->fSuccessfullyConnected)
+            {
+                {
+                    LOCK(pnode->cs_inventory);
+                    if (pnode->filterInventoryKnown.contains(hash))
+                        continue;
+                    pnode->filterInventoryKnown.insert(hash);
+                }
+                if (!pcmpctblock)
+                    pcmpctblock.reset(new CBlockHeaderAndShortTxIDs(*this));
+                pnode->PushMessage("cmpctblock", *pcmpctblock);
+            }
+            else
+                pnode->PushInventory(inv);
+        }
     }
 
     // ppcoin: check pending sync-checkpoint
@@ -3717,13 +4033,17 @@ bool CBlock::AcceptBlock()
 
 uint256 CBlockIndex::GetBlockTrust() const
 {
-    CBigNum bnTarget;
-    bnTarget.SetCompact(nBits);
+    bool fNegative, fOverflow;
+    arith_uint256 bnTarget;
+    bnTarget.SetCompact(nBits, &fNegative, &fOverflow);
 
-    if (bnTarget <= 0)
+    if (fNegative || fOverflow || !bnTarget)
         return 0;
 
-    return ((CBigNum(1)<<256) / (bnTarget+1)).getuint256();
+    // 2**256 / (bnTarget+1) does not fit in 256 bits, but it is equal to
+    // ~bnTarget / (bnTarget+1) + 1 for any bnTarget below 2**256 - 1,
+    // which a compact target always is
+    return ArithToUint256((~bnTarget / (bnTarget + 1)) + 1);
 }
 
 bool CBlockIndex::IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned int nRequired, unsigned int nToCheck)
@@ -3747,8 +4067,16 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     uint256 hash = pblock->GetHash();
     if (mapBlockIndex.count(hash))
         return error("ProcessBlock() : already have block %d %s", mapBlockIndex[hash]->nHeight, hash.ToString().substr(0,20).c_str());
-    if (mapOrphanBlocks.count(hash))
-        return error("ProcessBlock() : already have block (orphan) %s", hash.ToString().substr(0,20).c_str());
+    map<uint256, COrphanBlock*>::iterator miOrphan = mapOrphanBlocks.find(hash);
+    if (miOrphan != mapOrphanBlocks.end())
+    {
+        if (miOrphan->second->HaveData())
+            return error("ProcessBlock() : already have block (orphan) %s", hash.ToString().substr(0,20).c_str());
+        // Kept as a header only, its data is wanted once the parent is in
+        if (!mapBlockIndex.count(pblock->hashPrevBlock))
+            return true;
+        EraseOrphanBlock(miOrphan->second);
+    }
 
     // ppcoin: check proof-of-stake
     // Limited duplicity on stake: prevents block flood attack
@@ -3765,16 +4093,17 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     {
         // Extra checks to prevent "fill up memory by spamming with bogus blocks"
         int64_t deltaTime = pblock->GetBlockTime() - pcheckpoint->nTime;
-        CBigNum bnNewBlock;
-        bnNewBlock.SetCompact(pblock->nBits);
-        CBigNum bnRequired;
+        bool fNegative, fOverflow;
+        arith_uint256 bnNewBlock;
+        bnNewBlock.SetCompact(pblock->nBits, &fNegative, &fOverflow);
+        arith_uint256 bnRequired;
 
         if (pblock->IsProofOfStake())
             bnRequired.SetCompact(ComputeMinStake(GetLastBlockIndex(pcheckpoint, true)->nBits, deltaTime, pblock->nTime));
         else
             bnRequired.SetCompact(ComputeMinWork(GetLastBlockIndex(pcheckpoint, false)->nBits, deltaTime));
 
-        if (bnNewBlock > bnRequired)
+        if (!fNegative && (fOverflow || bnNewBlock > bnRequired))
         {
             if (pfrom)
                 pfrom->Misbehaving(100);
@@ -3816,8 +4145,7 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
             printf("ProcessBlock: ORPHAN BLOCK, prev=%s\n", pblock->hashPrevBlock.ToString().substr(0,20).c_str());
             //LogPrintf("ProcessBlock: ORPHAN BLOCK %lu, prev=%s\n", (unsigned long)mapOrphanBlocks.size(), pblock->hashPrevBlock.ToString());
 
-        //if (pfrom)
-            //PruneOrphanBlocks();
+        LimitOrphanBlocks();
 
         // ppcoin: check proof-of-stake
         if (pblock->IsProofOfStake())
@@ -3829,14 +4157,12 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
             else
                 setStakeSeenOrphan.insert(pblock->GetProofOfStake());
         }
-        CBlock* pblock2 = new CBlock(*pblock);
-        mapOrphanBlocks.insert(make_pair(hash, pblock2));
-        mapOrphanBlocksByPrev.insert(make_pair(pblock2->hashPrevBlock, pblock2));
+        COrphanBlock* pblock2 = AddOrphanBlock(*pblock, pfrom ? pfrom->GetId() : -1);
 
         // Ask this guy to fill in what we're missing
         if (pfrom)
         {
-            pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(pblock2));
+            pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(pblock2)->hashBlock);
 			//PushGetBlocks(pfrom, pindexBest, GetOrphanRoot(pblock2));
             // ppcoin: getblocks may not obtain the ancestor block rejected
             // earlier by duplicate-stake check so we ask for it again directly
@@ -3856,18 +4182,26 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     for (unsigned int i = 0; i < vWorkQueue.size(); i++)
     {
         uint256 hashPrev = vWorkQueue[i];
-        for (multimap<uint256, CBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
+        vector<COrphanBlock*> vOrphans;
+        for (multimap<uint256, COrphanBlock*>::iterator mi = mapOrphanBlocksByPrev.lower_bound(hashPrev);
              mi != mapOrphanBlocksByPrev.upper_bound(hashPrev);
              ++mi)
+            vOrphans.push_back((*mi).second);
+
+        for (COrphanBlock* porphan : vOrphans)
         {
-            CBlock* pblockOrphan = (*mi).second;
-            if (pblockOrphan->AcceptBlock())
-                vWorkQueue.push_back(pblockOrphan->GetHash());
-            mapOrphanBlocks.erase(pblockOrphan->GetHash());
-            setStakeSeenOrphan.erase(pblockOrphan->GetProofOfStake());
-            delete pblockOrphan;
+            // Kept as a header only, stays until its data comes in again
+            if (!porphan->HaveData())
+            {
+                if (pfrom)
+                    pfrom->AskFor(CInv(MSG_BLOCK, porphan->hashBlock));
+                continue;
+            }
+            CBlock blockOrphan;
+            if (ReadOrphanBlock(porphan, blockOrphan) && blockOrphan.AcceptBlock())
+                vWorkQueue.push_back(porphan->hashBlock);
+            EraseOrphanBlock(porphan);
         }
-        mapOrphanBlocksByPrev.erase(hashPrev);
     }
 
     if (fDebug && GetBoolArg("-showtimers", false)) {
@@ -3986,12 +4320,6 @@ bool CheckDiskSpace(uint64_t nAdditionalBytes)
 
 static unsigned int nCurrentBlockFile = 1;
 
-static filesystem::path BlockFilePath(unsigned int nFile)
-{
-    string strBlockFn = strprintf("blk%04u.dat", nFile);
-    return GetDataDir() / strBlockFn;
-}
-
 FILE* OpenBlockFile(unsigned int nFile, unsigned int nBlockPos, const char* pszMode)
 {
     if ((nFile < 1) || (nFile == (unsigned int) -1))
@@ -4087,7 +4415,7 @@ bool LoadBlockIndex(bool fAllowNew)
             if (false && (blocktest.GetHash() != hashGenesisBlockTestNet)) {
             // This will figure out a valid hash and Nonce if you're
             // creating a different genesis block:
-                uint256 hashTarget = CBigNum().SetCompact(blocktest.nBits).getuint256();
+                uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(blocktest.nBits));
                 while (blocktest.GetHash() > hashTarget)
                 {
                     ++blocktest.nNonce;
@@ -4152,7 +4480,7 @@ bool LoadBlockIndex(bool fAllowNew)
             if (false && (block.GetHash() != hashGenesisBlock)) {
             // This will figure out a valid hash and Nonce if you're
             // creating a different genesis block:
-                uint256 hashTarget = CBigNum().SetCompact(block.nBits).getuint256();
+                uint256 hashTarget = ArithToUint256(arith_uint256().SetCompact(block.nBits));
                 while (block.GetHash() > hashTarget)
                 {
                     ++block.nNonce;
@@ -4222,7 +4550,7 @@ void PrintBlockTree()
     AssertLockHeld(cs_main);
     // pre-compute tree structure
     map<CBlockIndex*, vector<CBlockIndex*> > mapNext;
-    for (map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
+    for (BlockMap::iterator mi = mapBlockIndex.begin(); mi != mapBlockIndex.end(); ++mi)
     {
         CBlockIndex* pindex = (*mi).second;
         mapNext[pindex->pprev].push_back(pindex);
@@ -4279,7 +4607,7 @@ void PrintBlockTree()
         vector<CBlockIndex*>& vNext = mapNext[pindex];
         for (unsigned int i = 0; i < vNext.size(); i++)
         {
-            if (vNext[i]->pnext)
+            if (chainActive.Next(vNext[i]))
             {
                 swap(vNext[0], vNext[i]);
                 break;
@@ -4292,66 +4620,6 @@ void PrintBlockTree()
     }
 }
 
-bool LoadExternalBlockFile(FILE* fileIn)
-{
-    int64_t nStart = GetTimeMillis();
-
-    int nLoaded = 0;
-    {
-        LOCK(cs_main);
-        try {
-            CAutoFile blkdat(fileIn, SER_DISK, CLIENT_VERSION);
-            unsigned int nPos = 0;
-            while (nPos != (unsigned int)-1 && blkdat.good() && !fRequestShutdown)
-            {
-                unsigned char pchData[65536];
-                do {
-                    fseek(blkdat, nPos, SEEK_SET);
-                    int nRead = fread(pchData, 1, sizeof(pchData), blkdat);
-                    if (nRead <= 8)
-                    {
-                        nPos = (unsigned int)-1;
-                        break;
-                    }
-                    void* nFind = memchr(pchData, pchMessageStart[0], nRead+1-sizeof(pchMessageStart));
-                    if (nFind)
-                    {
-                        if (memcmp(nFind, pchMessageStart, sizeof(pchMessageStart))==0)
-                        {
-                            nPos += ((unsigned char*)nFind - pchData) + sizeof(pchMessageStart);
-                            break;
-                        }
-                        nPos += ((unsigned char*)nFind - pchData) + 1;
-                    }
-                    else
-                        nPos += sizeof(pchData) - sizeof(pchMessageStart) + 1;
-                } while(!fRequestShutdown);
-                if (nPos == (unsigned int)-1)
-                    break;
-                fseek(blkdat, nPos, SEEK_SET);
-                unsigned int nSize;
-                blkdat >> nSize;
-                if (nSize > 0 && nSize <= MAX_BLOCK_SIZE)
-                {
-                    CBlock block;
-                    blkdat >> block;
-                    if (ProcessBlock(NULL,&block))
-                    {
-                        nLoaded++;
-                        nPos += 4 + nSize;
-                    }
-                }
-            }
-        }
-        catch (std::exception &e) {
-            printf("%s() : Deserialize or I/O error caught during load\n",
-                   __PRETTY_FUNCTION__);
-        }
-    }
-    printf("Loaded %i blocks from external file in %" PRId64"ms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
-}
-
 //////////////////////////////////////////////////////////////////////////////
 //
 // CAlert
@@ -4435,7 +4703,7 @@ bool static AlreadyHave(CTxDB& txdb, const CInv& inv)
 
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash) ||
-               mapOrphanBlocks.count(inv.hash);
+               HaveOrphanBlock(inv.hash);
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_FORTUNASTAKE_WINNER:
@@ -4473,7 +4741,7 @@ void static ProcessGetData(CNode* pfrom)
             {
                 bool send = false;
                 // Send block from disk
-                map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(inv.hash);
+                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end())
                 {
                     send = true;
@@ -4513,15 +4781,7 @@ void static ProcessGetData(CNode* pfrom)
             {
                 // Send stream from relay memory
                 bool pushed = false;
-                /*{
-                    LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                    if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
-                        pushed = true;
-                    }
-                }*/
-                if (!pushed && inv.type == MSG_TX) {
+                if (inv.type == MSG_TX) {
                     if(mapFortunaBroadcastTxes.count(inv.hash)){
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
@@ -4534,6 +4794,19 @@ void static ProcessGetData(CNode* pfrom)
                         pfrom->PushMessage("dstx", ss);
                         pushed = true;
                     } else {
+                        std::shared_ptr<const CDataStream> pss;
+                        {
+                            LOCK(cs_mapRelay);
+                            map<CInv, std::shared_ptr<const CDataStream> >::iterator mi = mapRelay.find(inv);
+                            if (mi != mapRelay.end())
+                                pss = mi->second;
+                        }
+                        if (pss) {
+                            pfrom->PushMessage("tx", *pss);
+                            pushed = true;
+                        }
+                    }
+                    if (!pushed) {
                         CTransaction tx;
                         if (mempool.lookup(inv.hash, tx)) {
                             CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
@@ -4590,6 +4863,38 @@ void static ProcessGetData(CNode* pfrom)
     }
 }
 
+// Asks for a block whole, when it could not be rebuilt from a compact block
+void static AskForFullBlock(CNode* pfrom, const uint256& hash)
+{
+    vector<CInv> vGetData(1, CInv(MSG_BLOCK, hash));
+    pfrom->PushMessage("getdata", vGetData);
+}
+
+void static ProcessCompactBlock(CNode* pfrom, CBlock& block)
+{
+    AssertLockHeld(cs_main);
+
+    uint256 hash = block.GetHash();
+    // A short ID matched the wrong mempool transaction
+    if (block.BuildMerkleTree() != block.hashMerkleRoot)
+    {
+        if (fDebugNet)
+            printf("compact block %s did not rebuild, asking for it whole\n", hash.ToString().substr(0,20).c_str());
+        AskForFullBlock(pfrom, hash);
+        return;
+    }
+
+    CInv inv(MSG_BLOCK, hash);
+    if (ProcessBlock(pfrom, &block))
+        mapAlreadyAskedFor.erase(inv);
+
+    if (block.nDoS)
+        pfrom->Misbehaving(block.nDoS);
+
+    if (fSecMsgEnabled)
+        SecureMsgScanBlock(block);
+}
+
 // The message start string is designed to be unlikely to occur in normal data.
 // The characters are rarely used upper ASCII, not valid as UTF-8, and produce
 // a large 4-byte int at any alignment.
@@ -4645,6 +4950,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             vRecv >> pfrom->strSubVer;
         if (!vRecv.empty())
             vRecv >> pfrom->nChainHeight;
+        if (vRecv.size() >= sizeof(pfrom->nCompactBlocksVersion))
+            vRecv >> pfrom->nCompactBlocksVersion;
+        if (!GetBoolArg("-compactblocks", true))
+            pfrom->nCompactBlocksVersion = 0;
 
         // Disconnect if the peer's subversion is < /Denarii:3.3.9.14/
         // Leaving this out for now until new update is out for a bit
@@ -4893,7 +5202,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             if (!fAlreadyHave)
                 pfrom->AskFor(inv);                
             else if (inv.type == MSG_BLOCK && mapOrphanBlocks.count(inv.hash)) {
-                pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(mapOrphanBlocks[inv.hash]));
+                pfrom->PushGetBlocks(pindexBest, GetOrphanRoot(mapOrphanBlocks[inv.hash])->hashBlock);
 				//PushGetBlocks(pfrom, pindexBest, GetOrphanRoot(mapOrphanBlocks[inv.hash]));
             } else if (nInv == nLastBlock) {
                 // In case we are on a very long side-chain, it is possible that we already have
@@ -4949,10 +5258,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
         // Send the rest of the chain
         if (pindex)
-            pindex = pindex->pnext;
+            pindex = chainActive.Next(pindex);
         int nLimit = 1000;
         if (fDebugNet) printf("getblocks %d to %s limit %d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString().substr(0,20).c_str(), nLimit);
-        for (; pindex; pindex = pindex->pnext)
+        for (; pindex; pindex = chainActive.Next(pindex))
         {
             if (pindex->GetBlockHash() == hashStop)
             {
@@ -5004,7 +5313,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         if (locator.IsNull())
         {
             // If locator is null, return the hashStop block
-            map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashStop);
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
             if (mi == mapBlockIndex.end())
                 return true;
             pindex = (*mi).second;
@@ -5014,13 +5323,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             // Find the last block the caller has in the main chain
             pindex = locator.GetBlockIndex();
             if (pindex)
-                pindex = pindex->pnext;
+                pindex = chainActive.Next(pindex);
         }
 
         vector<CBlock> vHeaders;
         int nLimit = 2000;
         if (fDebugNet) printf("getheaders %d to %s\n", (pindex ? pindex->nHeight : -1), hashStop.ToString().substr(0,20).c_str());
-        for (; pindex; pindex = pindex->pnext)
+        for (; pindex; pindex = chainActive.Next(pindex))
         {
             vHeaders.push_back(pindex->GetBlockHeader());
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
@@ -5053,13 +5362,15 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             // Recursively process any orphan transactions that depended on this one
             for (unsigned int i = 0; i < vWorkQueue.size(); i++)
             {
-                uint256 hashPrev = vWorkQueue[i];
-                for (set<uint256>::iterator mi = mapOrphanTransactionsByPrev[hashPrev].begin();
-                     mi != mapOrphanTransactionsByPrev[hashPrev].end();
+                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
+                if (itByPrev == mapOrphanTransactionsByPrev.end())
+                    continue;
+                for (set<uint256>::iterator mi = itByPrev->second.begin();
+                     mi != itByPrev->second.end();
                      ++mi)
                 {
                     const uint256& orphanTxHash = *mi;
-                    CTransaction& orphanTx = mapOrphanTransactions[orphanTxHash];
+                    CTransaction& orphanTx = mapOrphanTransactions[orphanTxHash].tx;
                     bool fMissingInputs2 = false;
 
                     if (orphanTx.AcceptToMemoryPool(txdb, &fMissingInputs2))
@@ -5085,12 +5396,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
         else if (fMissingInputs)
         {
-            AddOrphanTx(tx);
+            AddOrphanTx(tx, pfrom->GetId());
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             //unsigned int nEvicted = LimitOrphanTxSize(MAX_ORPHAN_TRANSACTIONS);
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            uint64_t nMaxOrphanTxBytes = (uint64_t)std::max((int64_t)0, GetArg("-maxorphantxkb", DEFAULT_MAX_ORPHAN_TX_KB)) * 1000;
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx, nMaxOrphanTxBytes);
 
             if (nEvicted > 0)
                 printf("mapOrphan overflow, removed %u tx\n", nEvicted);
@@ -5123,6 +5435,124 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == "cmpctblock")
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        uint256 hashBlock = cmpctblock.header.GetHash();
+
+        if (fDebugNet) printf("received compact block %s\n", hashBlock.ToString().substr(0,20).c_str());
+
+        CInv inv(MSG_BLOCK, hashBlock);
+        pfrom->AddInventoryKnown(inv);
+
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hashBlock) || mapOrphanBlocks.count(hashBlock))
+            return true;
+
+        // Nothing to check it against without the parent, take the orphan path
+        if (!mapBlockIndex.count(cmpctblock.header.hashPrevBlock))
+        {
+            AskForFullBlock(pfrom, hashBlock);
+            return true;
+        }
+
+        std::shared_ptr<CPartialBlock> ppartial(new CPartialBlock());
+        ReadStatus status = ppartial->Init(cmpctblock, mempool);
+        if (status == READ_STATUS_INVALID)
+        {
+            pfrom->Misbehaving(100);
+            return error("ProcessMessage() : invalid compact block %s", hashBlock.ToString().c_str());
+        }
+        if (status == READ_STATUS_FAILED)
+        {
+            AskForFullBlock(pfrom, hashBlock);
+            return true;
+        }
+
+        CBlockTransactionsRequest req;
+        req.hashBlock = hashBlock;
+        ppartial->GetMissing(req.vIndexes);
+        if (req.vIndexes.empty())
+        {
+            ProcessCompactBlock(pfrom, ppartial->block);
+            return true;
+        }
+
+        // Other peers announcing the block are asked for it only after
+        // COMPACT_BLOCK_TIMEOUT, by then it is usually rebuilt
+        int64_t& nRequestTime = mapAlreadyAskedFor[inv];
+        nRequestTime = std::max(nRequestTime, (GetTime() - 2 * 60 + COMPACT_BLOCK_TIMEOUT) * 1000000);
+
+        if (fDebugNet) printf("compact block %s missing %" PRIszu" of %" PRIszu" transactions\n", hashBlock.ToString().substr(0,20).c_str(), req.vIndexes.size(), cmpctblock.BlockTxCount());
+        // A block still waiting on blocktxn is fetched whole rather than dropped
+        if (pfrom->ppartialBlock && pfrom->ppartialBlock->block.GetHash() != hashBlock)
+            AskForFullBlock(pfrom, pfrom->ppartialBlock->block.GetHash());
+        pfrom->ppartialBlock = ppartial;
+        pfrom->PushMessage("getblocktxn", req);
+    }
+
+
+    else if (strCommand == "getblocktxn")
+    {
+        CBlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(req.hashBlock);
+        if (mi == mapBlockIndex.end())
+            return true;
+
+        CBlock block;
+        if (!block.ReadFromDisk(mi->second))
+            return error("ProcessMessage() : getblocktxn failed to read block %s", req.hashBlock.ToString().c_str());
+
+        // Only recent blocks are rebuilt, older ones go whole
+        if (pindexBest->nHeight - mi->second->nHeight > MAX_BLOCKTXN_DEPTH)
+        {
+            pfrom->PushMessage("block", block);
+            return true;
+        }
+
+        CBlockTransactions resp;
+        resp.hashBlock = req.hashBlock;
+        resp.vtx.reserve(req.vIndexes.size());
+        for (unsigned int nIndex : req.vIndexes)
+        {
+            if (nIndex >= block.vtx.size())
+            {
+                pfrom->Misbehaving(100);
+                return error("ProcessMessage() : getblocktxn index %u out of range", nIndex);
+            }
+            resp.vtx.push_back(block.vtx[nIndex]);
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+
+    else if (strCommand == "blocktxn")
+    {
+        CBlockTransactions resp;
+        vRecv >> resp;
+
+        LOCK(cs_main);
+        std::shared_ptr<CPartialBlock> ppartial;
+        if (!pfrom->ppartialBlock || pfrom->ppartialBlock->block.GetHash() != resp.hashBlock)
+            return true;
+        ppartial.swap(pfrom->ppartialBlock);
+
+        if (mapBlockIndex.count(resp.hashBlock) || mapOrphanBlocks.count(resp.hashBlock))
+            return true;
+
+        if (ppartial->Fill(resp.vtx) != READ_STATUS_OK)
+        {
+            pfrom->Misbehaving(100);
+            return error("ProcessMessage() : blocktxn for %s does not fit the request", resp.hashBlock.ToString().c_str());
+        }
+        ProcessCompactBlock(pfrom, ppartial->block);
+    }
+
+
     else if (strCommand == "getaddr")
     {
         // Don't return addresses older than nCutOff timestamp
@@ -5151,6 +5581,44 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == "getcfilters")
+    {
+        unsigned char nFilterType;
+        unsigned int nStartHeight;
+        uint256 hashStop;
+        vRecv >> nFilterType >> nStartHeight >> hashStop;
+
+        if (!fBlockFilterIndex || nFilterType != 0)
+            return true;
+
+        vector<CBlockIndex*> vBlocks;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashStop);
+            if (mi == mapBlockIndex.end() || !mi->second->IsInMainChain())
+                return true;
+            CBlockIndex* pindexStop = mi->second;
+            if ((int)nStartHeight > pindexStop->nHeight || pindexStop->nHeight - (int)nStartHeight >= (int)MAX_GETCFILTERS_SIZE)
+            {
+                pfrom->Misbehaving(10);
+                return error("message getcfilters range %u-%d", nStartHeight, pindexStop->nHeight);
+            }
+            for (CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vBlocks.push_back(pindex);
+        }
+
+        // Oldest first. Blocks connected before -blockfilterindex have no filter, stop at the first one
+        CTxDB txdb("r");
+        for (vector<CBlockIndex*>::reverse_iterator it = vBlocks.rbegin(); it != vBlocks.rend(); ++it)
+        {
+            CBlockFilter filter;
+            if (!txdb.ReadBlockFilter((*it)->GetBlockHash(), filter))
+                break;
+            pfrom->PushMessage("cfilter", nFilterType, filter.hashBlock, filter.GetEncoded());
+        }
+    }
+
+
     else if (strCommand == "checkorder")
     {
         uint256 hashReply;
@@ -5402,11 +5870,13 @@ bool ProcessMessages(CNode* pfrom)
         {
             printf("ProcessMessages(%s, %u bytes) : CHECKSUM ERROR nChecksum=%08x hdr.nChecksum=%08x\n",
                strCommand.c_str(), nMessageSize, nChecksum, hdr.nChecksum);
+            pfrom->RecordMessageRecv(strCommand, CMessageHeader::HEADER_SIZE + nMessageSize, 0);
             continue;
         }
 
         // Process message
         bool fRet = false;
+        int64_t nTimeStart = GetTimeMicros();
         try
         {
             fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
@@ -5440,6 +5910,8 @@ bool ProcessMessages(CNode* pfrom)
             PrintExceptionContinue(NULL, "ProcessMessages()");
         }
 
+        pfrom->RecordMessageRecv(strCommand, CMessageHeader::HEADER_SIZE + nMessageSize, GetTimeMicros() - nTimeStart);
+
         if (!fRet)
             printf("ProcessMessage(%s, %u bytes) FAILED\n", strCommand.c_str(), nMessageSize);
 
@@ -5492,6 +5964,19 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         }
 
 
+        // Peer did not answer getblocktxn in time, ask for the whole block
+        if (pto->ppartialBlock && GetTime() - pto->ppartialBlock->nTimeReceived > COMPACT_BLOCK_TIMEOUT)
+        {
+            uint256 hashBlock = pto->ppartialBlock->block.GetHash();
+            pto->ppartialBlock.reset();
+            if (!mapBlockIndex.count(hashBlock) && !mapOrphanBlocks.count(hashBlock))
+            {
+                if (fDebugNet) printf("compact block %s timed out, requesting full block\n", hashBlock.ToString().substr(0,20).c_str());
+                AskForFullBlock(pto, hashBlock);
+            }
+        }
+
+
 		// Start block sync
         if (pto->fStartSync && !fImporting && !fReindex) {
             pto->fStartSync = false;
@@ -5573,47 +6058,34 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         // Message: inventory
         //
+        // Transactions go out in batches, each peer on its own Poisson timer
+        // so that the order peers hear of a transaction does not give away
+        // where it came from. Everything else goes out right away.
         vector<CInv> vInv;
         vector<CInv> vInvWait;
         {
             LOCK(pto->cs_inventory);
+            bool fSendTxInv = false;
+            int64_t nNow = GetTimeMicros();
+            if (pto->nNextInvSend < nNow)
+            {
+                fSendTxInv = true;
+                int nInterval = (int)std::max((int64_t)1, GetArg("-invinterval", DEFAULT_INVENTORY_BROADCAST_INTERVAL));
+                pto->nNextInvSend = PoissonNextSend(nNow, pto->fInbound ? nInterval : std::max(1, nInterval / 2));
+            }
+
             vInv.reserve(pto->vInventoryToSend.size());
-            vInvWait.reserve(pto->vInventoryToSend.size());
             for (const CInv& inv : pto->vInventoryToSend)
             {
-                if (pto->setInventoryKnown.count(inv))
-                    continue;
-
-                // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle)
+                if (inv.type == MSG_TX && !fSendTxInv)
                 {
-                    // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
-                    uint256 hashRand = inv.hash ^ hashSalt;
-                    hashRand = Hash(BEGIN(hashRand), END(hashRand));
-                    bool fTrickleWait = ((hashRand & 3) != 0);
-
-                    // always trickle our own transactions
-                    if (!fTrickleWait)
-                    {
-                        CWalletTx wtx;
-                        if (GetTransaction(inv.hash, wtx))
-                            if (wtx.fFromMe)
-                                fTrickleWait = true;
-                    }
-
-                    if (fTrickleWait)
-                    {
-                        vInvWait.push_back(inv);
-                        continue;
-                    }
+                    vInvWait.push_back(inv);
+                    continue;
                 }
 
-                // returns true if wasn't already contained in the set
-                if (pto->setInventoryKnown.insert(inv).second)
+                if (!pto->filterInventoryKnown.contains(inv.hash))
                 {
+                    pto->filterInventoryKnown.insert(inv.hash);
                     vInv.push_back(inv);
                     if (vInv.size() >= 1000)
                     {
@@ -5622,7 +6094,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
                     }
                 }
             }
-            pto->vInventoryToSend = vInvWait;
+            pto->vInventoryToSend.swap(vInvWait);
         }
         if (!vInv.empty())
             pto->PushMessage("inv", vInv);
@@ -8,11 +8,13 @@
 
 #include "core.h"
 #include "bignum.h"
+#include "arith_uint256.h"
 #include "sync.h"
 #include "net.h"
 #include "script.h"
 #include "scrypt.h"
 #include "hashblock.h"
+#include "blockstore.h"
 
 #include <list>
 
@@ -47,6 +49,7 @@ class CWallet;
 class CWalletTx;
 class CBlock;
 class CBlockIndex;
+class COrphanBlock;
 class CKeyItem;
 class CReserveKey;
 class COutPoint;
@@ -71,8 +74,18 @@ static const unsigned int MAX_TX_SIGOPS = MAX_BLOCK_SIGOPS/5;
 //static const unsigned int MAX_ORPHAN_TRANSACTIONS = MAX_BLOCK_SIZE/100; deprecated
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100; //Was 10k, lets handle 100
+/** Default for -maxorphantxkb, kB of orphan transactions kept in memory */
+static const unsigned int DEFAULT_MAX_ORPHAN_TX_KB = 500;
 /** Default for -maxorphanblocks, maximum number of orphan blocks kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS = 750; //Default 750, Lets handle 1000 maybe?
+/** Default for -maxorphanblockskb, kB of orphan block data kept in memory,
+ *  orphans past it are kept as headers and fetched again when needed */
+static const unsigned int DEFAULT_MAX_ORPHAN_BLOCKS_KB = 40000;
+/** Seconds an orphan transaction or block is kept for */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+static const int64_t ORPHAN_BLOCK_EXPIRE_TIME = 60 * 60;
+/** Seconds between sweeps for expired orphans */
+static const int64_t ORPHAN_EXPIRE_INTERVAL = 5 * 60;
 static const unsigned int MAX_INV_SZ = 50000;
 static const int64_t MIN_TX_FEE = 1000;
 static const int64_t MIN_NAME_FEE = 9000000; // 0.09 D Name OP Miner Fee
@@ -111,7 +124,7 @@ inline int64_t GetMNCollateral() { return 5000; }
 
 extern CScript COINBASE_FLAGS;
 extern CCriticalSection cs_main;
-extern std::map<uint256, CBlockIndex*> mapBlockIndex;
+extern BlockMap mapBlockIndex;
 extern std::set<std::pair<COutPoint, unsigned int> > setStakeSeen;
 extern CBlockIndex* pindexGenesisBlock;
 extern unsigned int nTargetSpacing;
@@ -135,11 +148,12 @@ extern int64_t nTimeBestReceived;
 extern CCriticalSection cs_setpwalletRegistered;
 extern std::set<CWallet*> setpwalletRegistered;
 extern unsigned char pchMessageStart[4];
-extern std::map<uint256, CBlock*> mapOrphanBlocks;
+extern std::map<uint256, COrphanBlock*> mapOrphanBlocks;
 extern std::map<int64_t, CAnonOutputCount> mapAnonOutputStats;
 
-extern CBigNum bnProofOfWorkLimit;
-extern CBigNum bnProofOfWorkLimitTestNet;
+extern arith_uint256 bnProofOfWorkLimit;
+extern arith_uint256 bnProofOfWorkLimitTestNet;
+extern arith_uint256 bnProofOfStakeLimit;
 
 //extern CTxMemPool mempool;
 
@@ -195,7 +209,7 @@ std::string GetWarnings(std::string strFor);
 bool GetTransaction(const uint256 &hash, CTransaction &tx, uint256 &hashBlock, bool s=false);
 bool GetKeyImage(CTxDB* ptxdb, ec_point& keyImage, CKeyImageSpent& keyImageSpent, bool& fInMempool);
 bool TxnHashInSystem(CTxDB* ptxdb, uint256& txnHash);
-uint256 WantedByOrphan(const CBlock* pblockOrphan);
+uint256 WantedByOrphan(COrphanBlock* pblockOrphan);
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake);
 void StakeMiner(CWallet *pwallet);
 void ResendWalletTransactions(bool fForce = false);
@@ -444,6 +458,22 @@ public:
 
     bool ReadFromDisk(CDiskTxPos pos, FILE** pfileRet=NULL)
     {
+        if (!pfileRet)
+        {
+            CBlockFileSpan span;
+            if (blockFileCache.ReadTxSpan(pos.nFile, pos.nTxPos, span))
+            {
+                try {
+                    span.Read(*this, SER_DISK, CLIENT_VERSION);
+                    return true;
+                }
+                catch (std::exception &e) {
+                    // tx may straddle the end of a stale mapping, remap on the next read
+                    blockFileCache.Invalidate(pos.nFile);
+                }
+            }
+        }
+
         CAutoFile filein = CAutoFile(OpenBlockFile(pos.nFile, 0, pfileRet ? "rb+" : "rb"), SER_DISK, CLIENT_VERSION);
         if (!filein)
             return error("CTransaction::ReadFromDisk() : OpenBlockFile failed");
@@ -751,6 +781,7 @@ public:
 
     // memory only
     mutable std::vector<uint256> vMerkleTree;
+    mutable bool fChecked; // passed a full CheckBlock(), don't hash it all again
 
     // Denial-of-service detection:
     mutable int nDoS;
@@ -795,6 +826,7 @@ public:
         vtx.clear();
         vchBlockSig.clear();
         vMerkleTree.clear();
+        fChecked = false;
         nDoS = 0;
     }
 
@@ -937,6 +969,22 @@ public:
     {
         SetNull();
 
+        int nType = SER_DISK | (fReadTransactions ? 0 : SER_BLOCKHEADERONLY);
+        CBlockFileSpan span;
+        if (blockFileCache.ReadBlockSpan(nFile, nBlockPos, span))
+        {
+            try {
+                span.Read(*this, nType, CLIENT_VERSION);
+            }
+            catch (std::exception &e) {
+                return error("%s() : deserialize error", __PRETTY_FUNCTION__);
+            }
+
+            if (fReadTransactions && IsProofOfWork() && !CheckProofOfWork(GetPoWHash(), nBits))
+                return error("CBlock::ReadFromDisk() : errors in block header");
+            return true;
+        }
+
         // Open history file to read
         CAutoFile filein = CAutoFile(OpenBlockFile(nFile, nBlockPos, "rb"), SER_DISK, CLIENT_VERSION);
         if (!filein)
@@ -1004,34 +1052,69 @@ private:
 // bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
 
 
+/** A transaction waiting for its inputs */
+class COrphanTx
+{
+public:
+    CTransaction tx;
+    NodeId fromPeer;
+    int64_t nTimeExpire;
+    unsigned int nSize;
+    size_t nPos;            // in the pool's list of orphans
+};
+
+/** A block waiting for its parent. The block is kept serialized, and only
+ *  the header fields below once the orphan pool is over its memory budget:
+ *  such a block counts as missing when its parent arrives and is fetched
+ *  again.
+ */
+class COrphanBlock
+{
+public:
+    uint256 hashBlock;
+    uint256 hashPrev;
+    uint256 hashRoot;       // an ancestor in the pool, shortcut for the orphan root
+    std::pair<COutPoint, unsigned int> stake;
+    bool fProofOfStake;
+    NodeId fromPeer;
+    int64_t nTimeExpire;
+    std::vector<unsigned char> vchBlock;
+    size_t nPos;            // in the pool's list of orphans
+    size_t nDataPos;        // in the list of orphans holding vchBlock
+
+    bool HaveData() const { return !vchBlock.empty(); }
+};
+
 
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
- * candidates to be the next block.  pprev and pnext link a path through the
- * main/longest chain.  A blockindex may have multiple pprev pointing back
- * to it, but pnext will only point forward to the longest branch, or will
- * be null if the block is not part of the longest chain.
+ * candidates to be the next block.  pprev links every block back to the
+ * genesis block, the main/longest chain is the height indexed chainActive.
+ *
+ * Fields are ordered by alignment to keep the object free of padding, and
+ * objects are carved out of CBlockIndexArena rather than allocated one by
+ * one, as a node keeps one of these for every block ever seen.
  */
 class CBlockIndex
 {
 public:
     const uint256* phashBlock;
     CBlockIndex* pprev;
-    CBlockIndex* pnext;
-    unsigned int nFile;
-    unsigned int nBlockPos;
-    uint256 nChainTrust; // ppcoin: trust score of block chain
-    int nHeight;
 
     int64_t nMint;
     int64_t nMoneySupply;
+    uint64_t nStakeModifier; // hash modifier for proof-of-stake
 
-    // Number of transactions in this block.
-    // Note: in a potential headers-first mode, this number cannot be relied upon
-    unsigned int nTx;
+    uint256 nChainTrust; // ppcoin: trust score of block chain
+    uint256 hashProof;
 
-    // (memory only) Number of transactions in the chain up to and including this block
-    unsigned int nChainTx; // change to 64-bit type when necessary; won't happen before 2030
+    // proof-of-stake specific fields
+    COutPoint prevoutStake;
+    unsigned int nStakeTime;
+
+    unsigned int nFile;
+    unsigned int nBlockPos;
+    int nHeight;
 
     unsigned int nFlags;  // ppcoin: block index flags
     enum
@@ -1041,15 +1124,8 @@ public:
         BLOCK_STAKE_MODIFIER = (1 << 2), // regenerated stake modifier
     };
 
-    uint64_t nStakeModifier; // hash modifier for proof-of-stake
     unsigned int nStakeModifierChecksum; // checksum of index; in-memeory only
 
-    // proof-of-stake specific fields
-    COutPoint prevoutStake;
-    unsigned int nStakeTime;
-
-    uint256 hashProof;
-
     // block header
     int nVersion;
     uint256 hashMerkleRoot;
@@ -1061,7 +1137,6 @@ public:
     {
         phashBlock = NULL;
         pprev = NULL;
-        pnext = NULL;
         nFile = 0;
         nBlockPos = 0;
         nHeight = 0;
@@ -1086,7 +1161,6 @@ public:
     {
         phashBlock = NULL;
         pprev = NULL;
-        pnext = NULL;
         nFile = nFileIn;
         nBlockPos = nBlockPosIn;
         nHeight = 0;
@@ -1116,6 +1190,9 @@ public:
         nNonce         = block.nNonce;
     }
 
+    static void* operator new(size_t nSize);
+    static void operator delete(void* p, size_t nSize);
+
     CBlock GetBlockHeader() const
     {
         CBlock block;
@@ -1139,21 +1216,9 @@ public:
         return (int64_t)nTime;
     }
 
-    CBigNum GetBlockWork() const
-    {
-        CBigNum bnTarget;
-        bnTarget.SetCompact(nBits);
-        if (bnTarget <= 0)
-            return 0;
-        return (CBigNum(1)<<256) / (bnTarget+1);
-    }
-
     uint256 GetBlockTrust() const;
 
-    bool IsInMainChain() const
-    {
-        return (pnext || this == pindexBest);
-    }
+    bool IsInMainChain() const;
 
     bool CheckIndex() const
     {
@@ -1231,8 +1296,8 @@ public:
 
     std::string ToString() const
     {
-        return strprintf("CBlockIndex(nprev=%p, pnext=%p, nFile=%u, nBlockPos=%-6d nHeight=%d, nMint=%s, nMoneySupply=%s, nFlags=(%s)(%d)(%s), nStakeModifier=%016x, nStakeModifierChecksum=%08x, hashProof=%s, prevoutStake=(%s), nStakeTime=%d merkle=%s, hashBlock=%s)",
-            pprev, pnext, nFile, nBlockPos, nHeight,
+        return strprintf("CBlockIndex(nprev=%p, nFile=%u, nBlockPos=%-6d nHeight=%d, nMint=%s, nMoneySupply=%s, nFlags=(%s)(%d)(%s), nStakeModifier=%016x, nStakeModifierChecksum=%08x, hashProof=%s, prevoutStake=(%s), nStakeTime=%d merkle=%s, hashBlock=%s)",
+            pprev, nFile, nBlockPos, nHeight,
             FormatMoney(nMint).c_str(), FormatMoney(nMoneySupply).c_str(),
             GeneratedStakeModifier() ? "MOD" : "-", GetStakeEntropyBit(), IsProofOfStake()? "PoS" : "PoW",
             nStakeModifier, nStakeModifierChecksum,
@@ -1250,6 +1315,97 @@ public:
 
 
 
+/** Fixed size allocator for CBlockIndex.
+ *
+ * Block index objects are allocated in chunks and never handed back to the
+ * heap, which saves the per allocation overhead of malloc and keeps indexes
+ * of neighbouring blocks close together in memory.
+ */
+class CBlockIndexArena
+{
+public:
+    CBlockIndexArena() : pfree(NULL), nChunkUsed(CHUNK_OBJECTS), nAllocated(0), nChunks(0) {}
+
+    void* Allocate();
+    void Free(void* p);
+
+    size_t GetAllocated() const { return nAllocated; }
+    size_t GetBytesReserved() const { return nChunks * CHUNK_OBJECTS * sizeof(CBlockIndex); }
+
+private:
+    enum { CHUNK_OBJECTS = 4096 };
+
+    struct FreeEntry { FreeEntry* pnext; };
+
+    boost::mutex mutex;
+    std::vector<char*> vChunks;
+    FreeEntry* pfree;
+    size_t nChunkUsed;
+    size_t nAllocated;
+    size_t nChunks;
+};
+
+extern CBlockIndexArena blockIndexArena;
+
+/** An in-memory indexed chain of blocks: chain[nHeight] is the block at that height. */
+class CChain
+{
+private:
+    std::vector<CBlockIndex*> vChain;
+
+public:
+    /** Returns the index entry for the genesis block of this chain, or NULL if none. */
+    CBlockIndex* Genesis() const
+    {
+        return vChain.size() > 0 ? vChain[0] : NULL;
+    }
+
+    /** Returns the index entry for the tip of this chain, or NULL if none. */
+    CBlockIndex* Tip() const
+    {
+        return vChain.size() > 0 ? vChain[vChain.size() - 1] : NULL;
+    }
+
+    /** Returns the index entry at a particular height in this chain, or NULL if no such height exists. */
+    CBlockIndex* operator[](int nHeight) const
+    {
+        if (nHeight < 0 || nHeight >= (int)vChain.size())
+            return NULL;
+        return vChain[nHeight];
+    }
+
+    /** Efficiently check whether a block is present in this chain. */
+    bool Contains(const CBlockIndex* pindex) const
+    {
+        return (*this)[pindex->nHeight] == pindex;
+    }
+
+    /** Find the successor of a block in this chain, or NULL if the given index is not found or is the tip. */
+    CBlockIndex* Next(const CBlockIndex* pindex) const
+    {
+        if (Contains(pindex))
+            return (*this)[pindex->nHeight + 1];
+        return NULL;
+    }
+
+    /** Return the maximal height in the chain, -1 if it is empty. */
+    int Height() const
+    {
+        return vChain.size() - 1;
+    }
+
+    /** Set/initialize a chain with a given tip. Only the part that differs from the current chain is touched. */
+    void SetTip(CBlockIndex* pindex);
+};
+
+/** The currently-connected chain of blocks. */
+extern CChain chainActive;
+
+inline bool CBlockIndex::IsInMainChain() const
+{
+    return chainActive.Contains(this);
+}
+
 /** Used to marshal pointers into hashes for db storage. */
 class CDiskBlockIndex : public CBlockIndex
 {
@@ -1270,6 +1426,7 @@ public:
     explicit CDiskBlockIndex(CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : 0);
+        CBlockIndex* pnext = chainActive.Next(pindex);
         hashNext = (pnext ? pnext->GetBlockHash() : 0);
     }
 
@@ -1371,7 +1528,7 @@ public:
 
     explicit CBlockLocator(uint256 hashBlock)
     {
-        std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
         if (mi != mapBlockIndex.end())
             Set((*mi).second);
     }
@@ -1424,7 +1581,7 @@ public:
         int nStep = 1;
         for (const uint256& hash : vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1443,7 +1600,7 @@ public:
         // Find the first block the caller has in the main chain
         for (const uint256& hash : vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
@@ -1459,7 +1616,7 @@ public:
         // Find the first block the caller has in the main chain
         for (const uint256& hash : vHave)
         {
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+            BlockMap::iterator mi = mapBlockIndex.find(hash);
             if (mi != mapBlockIndex.end())
             {
                 CBlockIndex* pindex = (*mi).second;
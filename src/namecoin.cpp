@@ -4,6 +4,7 @@
 #include "script.h"
 #include "wallet.h"
 #include "denariusrpc.h"
+#include "ddns.h"
 
 extern CWallet* pwalletMain;
 extern std::map<uint256, CTransaction> mapTransactions;
@@ -33,7 +34,7 @@ public:
 	virtual bool IsNameFeeEnough(CTxDB& txdb, const CTransaction &tx);
     //virtual bool CheckInputs(const CTransactionRef& tx, const CBlockIndex* pindexBlock, vector<nameTempProxy> &vName, const CDiskTxPos& pos, const CAmount& txFee);
     //virtual bool ConnectInputs(CTxDB& txdb, map<uint256, CTxIndex>& mapTestPool, const CTransaction& tx, vector<CTransaction>& vTxPrev, vector<CTxIndex>& vTxindex, const CBlockIndex* pindexBlock, const CDiskTxPos& txPos, vector<nameTempProxy>& vName);
-    virtual bool DisconnectInputs(const CTransaction& tx);
+    virtual bool DisconnectInputs(CTxDB& txdb, const CTransaction& tx);
     virtual bool ConnectBlock(CTxDB& txdb, CBlockIndex* pindex);
     virtual bool ExtractAddress(const CScript& script, string& address);
     virtual void AddToPendingNames(const CTransaction& tx);
@@ -112,8 +113,24 @@ bool CalculateExpiresAt(CNameRecord& nameRec)
 }
 
 // Tests if name is active. You can optionaly specify at which height it is/was active.
+bool NameActive(const vector<unsigned char> &vchName, int currentBlockHeight = -1)
+{
+    CNameSummary summary;
+    if (!GetNameSummary(vchName, summary))
+        return false;
+
+    if (currentBlockHeight < 0)
+        currentBlockHeight = pindexBest->nHeight;
+
+    return summary.IsActive(currentBlockHeight);
+}
+
 bool NameActive(CNameDB& dbName, const vector<unsigned char> &vchName, int currentBlockHeight = -1)
 {
+    // Outside of a transaction the summaries show the same state as the database
+    if (!dbName.IsInTransaction())
+        return NameActive(vchName, currentBlockHeight);
+
     CNameRecord nameRec;
     if (!dbName.ReadName(vchName, nameRec))
         return false;
@@ -127,12 +144,6 @@ bool NameActive(CNameDB& dbName, const vector<unsigned char> &vchName, int curre
     return currentBlockHeight <= nameRec.nExpiresAt;
 }
 
-bool NameActive(const vector<unsigned char> &vchName, int currentBlockHeight = -1)
-{
-    CNameDB dbName("r");
-    return NameActive(dbName, vchName, currentBlockHeight);
-}
-
 // Returns minimum name operation fee rounded down to cents. Should be used during|before transaction creation.
 // If you wish to calculate if fee is enough - use IsNameFeeEnough() function.
 // Generaly:  GetNameOpFee() > IsNameFeeEnough().
@@ -545,7 +556,157 @@ string SendMoneyWithInputTx(CScript scriptPubKey, int64_t nValue, int64_t nNetFe
     return "";
 }
 
-// scans denariusnamesindex.dat and return names with their last CNameIndex
+// Summaries of all names in the index, updated when a write to the index is committed
+static CCriticalSection cs_nameSummaries;
+static map<vector<unsigned char>, CNameSummary> mapNameSummaries;
+static unsigned int nActiveNames = 0; // names whose last op is not name_delete
+
+// Names that are not deleted, bucketed by the height they expire at. nLiveNames
+// counts those that have not expired at nLiveHeight; moving nLiveHeight only
+// visits the buckets in between.
+static map<int, set<vector<unsigned char> > > mapNameExpiry;
+static int nLiveHeight = 0;
+static unsigned int nLiveNames = 0;
+
+static void AddNameSummary(const vector<unsigned char>& vchName, const CNameSummary& summary)
+{
+    AssertLockHeld(cs_nameSummaries);
+    mapNameSummaries[vchName] = summary;
+    if (summary.fDeleted)
+        return;
+    nActiveNames++;
+    mapNameExpiry[summary.nExpiresAt].insert(vchName);
+    if (summary.nExpiresAt >= nLiveHeight)
+        nLiveNames++;
+}
+
+static void RemoveNameSummary(map<vector<unsigned char>, CNameSummary>::iterator mi)
+{
+    AssertLockHeld(cs_nameSummaries);
+    const CNameSummary& summary = mi->second;
+    if (!summary.fDeleted)
+    {
+        nActiveNames--;
+        map<int, set<vector<unsigned char> > >::iterator bi = mapNameExpiry.find(summary.nExpiresAt);
+        if (bi != mapNameExpiry.end())
+        {
+            bi->second.erase(mi->first);
+            if (bi->second.empty())
+                mapNameExpiry.erase(bi);
+        }
+        if (summary.nExpiresAt >= nLiveHeight)
+            nLiveNames--;
+    }
+    mapNameSummaries.erase(mi);
+}
+
+static void SeekLiveHeight(int nHeight)
+{
+    AssertLockHeld(cs_nameSummaries);
+    if (nHeight > nLiveHeight)
+    {
+        // names expiring in [nLiveHeight, nHeight) are no longer live
+        map<int, set<vector<unsigned char> > >::const_iterator bi = mapNameExpiry.lower_bound(nLiveHeight);
+        for (; bi != mapNameExpiry.end() && bi->first < nHeight; ++bi)
+            nLiveNames -= bi->second.size();
+    }
+    else if (nHeight < nLiveHeight)
+    {
+        map<int, set<vector<unsigned char> > >::const_iterator bi = mapNameExpiry.lower_bound(nHeight);
+        for (; bi != mapNameExpiry.end() && bi->first < nLiveHeight; ++bi)
+            nLiveNames += bi->second.size();
+    }
+    nLiveHeight = nHeight;
+}
+
+CNameSummary::CNameSummary(CNameRecord& rec) : nRegisteredAt(0), nExpiresAt(rec.nExpiresAt), fDeleted(rec.deleted())
+{
+    if (!rec.vtxPos.empty())
+        nRegisteredAt = rec.vtxPos[rec.nLastActiveChainIndex].nHeight;
+}
+
+static void SetNameSummary(const vector<unsigned char>& vchName, const CNameSummary& summary, bool fErase)
+{
+    {
+        LOCK(cs_nameSummaries);
+        map<vector<unsigned char>, CNameSummary>::iterator mi = mapNameSummaries.find(vchName);
+        if (mi != mapNameSummaries.end())
+            RemoveNameSummary(mi);
+        if (!fErase)
+            AddNameSummary(vchName, summary);
+    }
+    DDnsInvalidate(stringFromVch(vchName));
+}
+
+bool GetNameSummary(const vector<unsigned char>& vchName, CNameSummary& summary)
+{
+    LOCK(cs_nameSummaries);
+    map<vector<unsigned char>, CNameSummary>::const_iterator mi = mapNameSummaries.find(vchName);
+    if (mi == mapNameSummaries.end())
+        return false;
+    summary = mi->second;
+    return true;
+}
+
+// Returns up to nMax names that are not deleted, starting at vchStart
+void GetNameSummaries(const vector<unsigned char>& vchStart, unsigned int nMax,
+                      vector<pair<vector<unsigned char>, CNameSummary> >& vSummaries)
+{
+    LOCK(cs_nameSummaries);
+    map<vector<unsigned char>, CNameSummary>::const_iterator mi = mapNameSummaries.lower_bound(vchStart);
+    for (; mi != mapNameSummaries.end() && vSummaries.size() < nMax; ++mi)
+        if (!mi->second.fDeleted)
+            vSummaries.push_back(*mi);
+}
+
+unsigned int GetNameCount()
+{
+    LOCK(cs_nameSummaries);
+    return nActiveNames;
+}
+
+unsigned int GetLiveNameCount(int nHeight)
+{
+    LOCK(cs_nameSummaries);
+    SeekLiveHeight(nHeight);
+    return nLiveNames;
+}
+
+// Returns the names that have not expired at nHeight, in order of expiry.
+// Like CNameSummary::IsActive a name is still live at its nExpiresAt.
+void GetLiveNames(int nHeight, vector<pair<vector<unsigned char>, CNameSummary> >& vSummaries)
+{
+    LOCK(cs_nameSummaries);
+    map<int, set<vector<unsigned char> > >::const_iterator bi = mapNameExpiry.lower_bound(nHeight);
+    for (; bi != mapNameExpiry.end(); ++bi)
+    {
+        BOOST_FOREACH(const vector<unsigned char>& vchName, bi->second)
+        {
+            map<vector<unsigned char>, CNameSummary>::const_iterator mi = mapNameSummaries.find(vchName);
+            if (mi != mapNameSummaries.end())
+                vSummaries.push_back(*mi);
+        }
+    }
+}
+
+bool CNameDB::WriteName(const vector<unsigned char>& name, CNameRecord &rec)
+{
+    if (!txdb.Write(make_pair(string("namei"), name), rec))
+        return false;
+    txdb.OnCommit(boost::bind(&SetNameSummary, name, CNameSummary(rec), false));
+    return true;
+}
+
+bool CNameDB::EraseName(const vector<unsigned char>& name)
+{
+    if (!txdb.Erase(make_pair(string("namei"), name)))
+        return false;
+    txdb.OnCommit(boost::bind(&SetNameSummary, name, CNameSummary(), true));
+    return true;
+}
+
+// returns names with their last CNameIndex, walking the summaries so that
+// only the records that are returned get read
 bool CNameDB::ScanNames(
         const vector<unsigned char>& vchName,
         unsigned int nMax,
@@ -556,43 +717,95 @@ bool CNameDB::ScanNames(
             >
         >& nameScan)
 {
-    Dbc* pcursor = GetCursor();
-    if (!pcursor)
-        return false;
+    vector<pair<vector<unsigned char>, CNameSummary> > vSummaries;
+    GetNameSummaries(vchName, nMax, vSummaries);
 
-    unsigned int fFlags = DB_SET_RANGE;
-    while (true)
+    for (unsigned int i = 0; i < vSummaries.size(); i++)
     {
-        // Read next record
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        if (fFlags == DB_SET_RANGE)
-            ssKey << make_pair(string("namei"), vchName);
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
-        fFlags = DB_NEXT;
-        if (ret == DB_NOTFOUND)
-            break;
-        else if (ret != 0)
-            return false;
+        CNameRecord val;
+        if (!ReadName(vSummaries[i].first, val) || val.deleted() || val.vtxPos.empty())
+            continue;
+        nameScan.push_back(make_pair(vSummaries[i].first, make_pair(val.vtxPos.back(), val.nExpiresAt)));
+    }
+    return true;
+}
 
-        // Unserialize
-        string strType;
-        ssKey >> strType;
-        if (strType == "namei")
+extern bool createNameIndexFile();
+
+// The summaries are rebuilt from the "namei" records on every start. A chain
+// database without the "nameindex" marker predates the move of the index out
+// of denariusnamesindex.dat and gets its index rebuilt from the blocks.
+bool LoadNameIndex()
+{
+    CTxDB txdb("r+");
+    CNameDB dbName(txdb);
+
+    int nIndexVersion;
+    if (!dbName.ReadIndexVersion(nIndexVersion))
+    {
         {
-            vector<unsigned char> vchName;
-            ssKey >> vchName;
-            CNameRecord val;
-            ssValue >> val;
-            if (val.deleted() || val.vtxPos.empty())
-                continue;
-            nameScan.push_back(make_pair(vchName, make_pair(val.vtxPos.back(), val.nExpiresAt)));
+            leveldb::DB* pdb = txdb.GetInstance();
+            leveldb::WriteBatch batch;
+            leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+            CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+            ssStartKey << make_pair(string("namei"), vector<unsigned char>());
+            for (iterator->Seek(ssStartKey.str()); iterator->Valid(); iterator->Next())
+            {
+                CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+                ssKey.write(iterator->key().data(), iterator->key().size());
+                string strType;
+                ssKey >> strType;
+                if (strType != "namei")
+                    break;
+                batch.Delete(iterator->key());
+            }
+            delete iterator;
+            if (!pdb->Write(leveldb::WriteOptions(), &batch).ok())
+                return error("LoadNameIndex() : failed to clear name index");
         }
 
-        if (nameScan.size() >= nMax)
+        if (pindexBest && pindexBest->nHeight >= RELEASE_HEIGHT && !createNameIndexFile())
+            return false;
+        if (!dbName.WriteIndexVersion(1))
+            return error("LoadNameIndex() : failed to write name index version");
+        // createNameIndexFile() already filled the summaries
+        return true;
+    }
+
+    leveldb::Iterator* iterator = txdb.GetInstance()->NewIterator(leveldb::ReadOptions());
+    CDataStream ssStartKey(SER_DISK, CLIENT_VERSION);
+    ssStartKey << make_pair(string("namei"), vector<unsigned char>());
+
+    vector<pair<vector<unsigned char>, CNameSummary> > vLoaded;
+    for (iterator->Seek(ssStartKey.str()); iterator->Valid() && !fRequestShutdown; iterator->Next())
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.write(iterator->key().data(), iterator->key().size());
+        string strType;
+        ssKey >> strType;
+        if (strType != "namei")
             break;
+        vector<unsigned char> vchName;
+        ssKey >> vchName;
+
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue.write(iterator->value().data(), iterator->value().size());
+        CNameRecord rec;
+        ssValue >> rec;
+
+        vLoaded.push_back(make_pair(vchName, CNameSummary(rec)));
     }
-    pcursor->close();
+    delete iterator;
+
+    LOCK(cs_nameSummaries);
+    mapNameSummaries.clear();
+    mapNameExpiry.clear();
+    nActiveNames = nLiveNames = 0;
+    nLiveHeight = pindexBest ? pindexBest->nHeight : 0;
+    for (unsigned int i = 0; i < vLoaded.size(); i++)
+        AddNameSummary(vLoaded[i].first, vLoaded[i].second);
+
+    printf("LoadNameIndex() : %u names, %u active, %u not expired\n", (unsigned int)vLoaded.size(), nActiveNames, nLiveNames);
     return true;
 }
 
@@ -946,7 +1159,7 @@ Value name_list(const Array& params, bool fHelp)
             oName.push_back(Pair("transferred", true));
         oName.push_back(Pair("address", item.second.strAddress));
         oName.push_back(Pair("expires_in", item.second.nExpiresAt - pindexBest->nHeight));
-        if (item.second.nExpiresAt - pindexBest->nHeight <= 0)
+        if (item.second.nExpiresAt - pindexBest->nHeight < 0)
             oName.push_back(Pair("expired", true));
 
         oRes.push_back(oName);
@@ -1100,7 +1313,7 @@ Value name_show(const Array& params, bool fHelp)
         if (nameRec.deleted())
             oName.push_back(Pair("deleted", true));
         else
-            if (nameRec.nExpiresAt - pindexBest->nHeight <= 0)
+            if (nameRec.nExpiresAt - pindexBest->nHeight < 0)
                 oName.push_back(Pair("expired", true));
     }
 
@@ -1182,15 +1395,16 @@ bool mycompare2 (const Object &lhs, const Object &rhs)
 }
 Value name_filter(const Array& params, bool fHelp)
 {
-    if (fHelp || params.size() > 5)
+    if (fHelp || params.size() > 6)
         throw runtime_error(
-                "name_filter [[[[[regexp] maxage=36000] from=0] nb=0] stat]\n"
+                "name_filter [[[[[[regexp] maxage=36000] from=0] nb=0] stat] active=false]\n"
                 "scan and filter names\n"
                 "[regexp] : apply [regexp] on names, empty means all names\n"
                 "[maxage] : look in last [maxage] blocks\n"
                 "[from] : show results from number [from]\n"
                 "[nb] : show [nb] results, 0 means all\n"
                 "[stats] : show some stats instead of results\n"
+                "[active] : only names that have not expired, without going through all names\n"
                 "name_filter \"\" 5 # list names updated in last 5 blocks\n"
                 "name_filter \"^id/\" # list all names from the \"id\" namespace\n"
                 "name_filter \"^id/\" 36000 0 0 stat # display stats (number of names) on active names from the \"id\" namespace\n"
@@ -1204,6 +1418,7 @@ Value name_filter(const Array& params, bool fHelp)
     int nNb = 0;
     int nMaxAge = 36000;
     bool fStat = false;
+    bool fActive = false;
     int nCountFrom = 0;
     int nCountNb = 0;
 
@@ -1223,38 +1438,39 @@ Value name_filter(const Array& params, bool fHelp)
     if (params.size() > 4)
         fStat = (params[4].get_str() == "stat" ? true : false);
 
+    if (params.size() > 5)
+        fActive = params[5].get_bool();
+
 
     CNameDB dbName("r");
     vector<Object> oRes;
 
+    // filter on the summaries, only matching names get their record read
     vector<unsigned char> vchName;
-    vector<pair<vector<unsigned char>, pair<CNameIndex,int> > > nameScan;
-    if (!dbName.ScanNames(vchName, 100000000, nameScan))
-        throw JSONRPCError(RPC_WALLET_ERROR, "scan failed");
+    vector<pair<vector<unsigned char>, CNameSummary> > vSummaries;
+    if (fActive)
+        GetLiveNames(pindexBest->nHeight, vSummaries);
+    else
+        GetNameSummaries(vchName, 100000000, vSummaries);
 
     // compile regex once
     using namespace boost::xpressive;
     smatch nameparts;
     sregex cregex = sregex::compile(strRegexp);
 
-    pair<vector<unsigned char>, pair<CNameIndex,int> > pairScan;
-    BOOST_FOREACH(pairScan, nameScan)
+    for (unsigned int i = 0; i < vSummaries.size(); i++)
     {
-        string name = stringFromVch(pairScan.first);
+        const CNameSummary& summary = vSummaries[i].second;
 
-        // regexp
-        if(strRegexp != "" && !regex_search(name, nameparts, cregex))
+        // max age
+        int nHeight = summary.nRegisteredAt;
+        if(nMaxAge != 0 && pindexBest->nHeight - nHeight >= nMaxAge)
             continue;
 
-        CNameIndex txName = pairScan.second.first;
-
-        CNameRecord nameRec;
-        if (!dbName.ReadName(pairScan.first, nameRec))
-            continue;
+        string name = stringFromVch(vSummaries[i].first);
 
-        // max age
-        int nHeight = nameRec.vtxPos[nameRec.nLastActiveChainIndex].nHeight;
-        if(nMaxAge != 0 && pindexBest->nHeight - nHeight >= nMaxAge)
+        // regexp
+        if(strRegexp != "" && !regex_search(name, nameparts, cregex))
             continue;
 
         // from limits
@@ -1264,16 +1480,20 @@ Value name_filter(const Array& params, bool fHelp)
 
         Object oName;
         if (!fStat) {
+            CNameRecord nameRec;
+            if (!dbName.ReadName(vSummaries[i].first, nameRec) || nameRec.vtxPos.empty())
+                continue;
+
             oName.push_back(Pair("name", name));
 
-            string value = stringFromVch(txName.vchValue);
+            string value = stringFromVch(nameRec.vtxPos.back().vchValue);
             oName.push_back(Pair("value", limitString(value, -1, "\n...(value too large - use name_show to see full value)")));
 
             oName.push_back(Pair("registered_at", nHeight)); // pos = 2 in comparison function (above name_filter)
 
-            int nExpiresIn = nameRec.nExpiresAt - pindexBest->nHeight;
+            int nExpiresIn = summary.nExpiresAt - pindexBest->nHeight;
             oName.push_back(Pair("expires_in", nExpiresIn));
-            if (nExpiresIn <= 0)
+            if (nExpiresIn < 0)
                 oName.push_back(Pair("expired", true));
         }
         oRes.push_back(oName);
@@ -1295,7 +1515,7 @@ Value name_filter(const Array& params, bool fHelp)
     {
         Object oStat;
         oStat.push_back(Pair("blocks",    (int)nBestHeight));
-        oStat.push_back(Pair("count",     (int)oRes2.size()));
+        oStat.push_back(Pair("count",     (int)oRes.size()));
         //oStat.push_back(Pair("sha256sum", SHA256(oRes), true));
         return oStat;
     }
@@ -1358,7 +1578,7 @@ Value name_scan(const Array& params, bool fHelp)
         string value = stringFromVch(vchValue);
         oName.push_back(Pair("value", limitString(value, mMaxShownValue, "\n...(value redacted - use name_show to see full value)")));
         oName.push_back(Pair("expires_in", nExpiresAt - pindexBest->nHeight));
-        if (nExpiresAt - pindexBest->nHeight <= 0)
+        if (nExpiresAt - pindexBest->nHeight < 0)
             oName.push_back(Pair("expired", true));
 
         oRes.push_back(oName);
@@ -1369,33 +1589,20 @@ Value name_scan(const Array& params, bool fHelp)
 
 Value name_count(const Array& params, bool fHelp)
 {
-    if (fHelp || params.size() > 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-                "name_count\n"
-                "Scan all names and return the current total count\n"
+                "name_count [active=false]\n"
+                "Return the current total count of names\n"
+                "[active] : only count names that have not expired\n"
                 );
 
     if (!IsSynchronized())
         throw runtime_error("Blockchain is still downloading - wait until it is done.");
 
-    vector<unsigned char> vchName;
-    int nMax = 100000000; // Maximum names to scan -1 for unlimited
-
-    CNameDB dbName("r");
-
-    vector<pair<vector<unsigned char>, pair<CNameIndex,int> > > nameScan;
-    if (!dbName.ScanNames(vchName, nMax, nameScan))
-        throw JSONRPCError(RPC_WALLET_ERROR, "count scan failed");
+    if (params.size() > 0 && params[0].get_bool())
+        return (int)GetLiveNameCount(pindexBest->nHeight);
 
-    //Object oNameCount;
-    int nCount = 0;
-    pair<vector<unsigned char>, pair<CNameIndex,int> > pairScan;
-    BOOST_FOREACH(pairScan, nameScan)
-    {
-        nCount++;
-    }
-    //oNameCount.push_back(Pair("count", nCount));
-    return nCount;
+    return (int)GetNameCount();
 }
 
 bool createNameScript(CScript& nameScript, const vector<unsigned char> &vchName, const vector<unsigned char> &vchValue, int nRentalDays, int op, string& err_msg)
@@ -2008,8 +2215,7 @@ NameTxReturn name_delete(const vector<unsigned char> &vchName)
 bool createNameIndexFile()
 {
     printf("Scanning Denarius blockchain for names to create a fast index...\n");
-    CNameDB dbName("cr+");
-    CTxDB txdb("r");
+    CTxDB txdb("r+");
 
     LOCK(cs_main);
 
@@ -2026,48 +2232,14 @@ bool createNameIndexFile()
             printf("[%d%%]...\n", percentageDone);
             reportDone = percentageDone/10;
         }
-        //uiInterface.InitMessage(strprintf("Creating name index... %i", percentageDone));
-
-        CBlockIndex* pindex = pindexBest; //nHeight maybe should be = pindexBest
-        CBlock block;
-            
-        if(!block.ReadFromDisk(pindex, true)) { // shouldn't really happen
-            continue;
-        }
-        // collect name tx from block
-        vector<nameTempProxy> vName;
-        //CDiskTxPos pos(pindex->nFile, pindex->nBlockPos, nTxPos);
-        CDiskTxPos pos(pindex->nFile, pindex->nBlockPos, GetSizeOfCompactSize(block.vtx.size()));
-        //CDiskTxPos pos(pindex->nBlockPos, GetSizeOfCompactSize(block.vtx.size())); // start position
-        for (unsigned int i=0; i<block.vtx.size(); i++)
-        {
-            const CTransaction& tx = block.vtx[i];
-            if (tx.IsCoinStake() || tx.IsCoinBase())
-            {
-                pos.nTxPos += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);  // set next tx position
-                continue;
-            }
-
-            // calculate tx fee
-            CAmount input = 0;
-            for (const CTxIn& txin : tx.vin)
-            {
-                CTransaction txPrev;
-                uint256 hashBlock = 0;
-                if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock))
-                    return error("createNameIndexFile() : prev transaction not found");
-
-                input += txPrev.vout[txin.prevout.n].nValue;
-            }
-            CAmount fee = input - tx.GetValueOut();
-
-            //hooks->CheckInputs(tx, pindex, vName, pos, fee);                    // collect valid name tx to vName
-            pos.nTxPos += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);  // set next tx position
-        }
 
-        // execute name operations, if any
+        // execute name operations of the block, if any, in one batch
+        CBlockIndex* pindex = chainActive[nHeight];
+        if (!txdb.TxnBegin())
+            return error("createNameIndexFile() : TxnBegin failed");
         hooks->ConnectBlock(txdb, pindex);
-
+        if (!txdb.TxnCommit())
+            return error("createNameIndexFile() : TxnCommit failed");
     }
     return true;
 }
@@ -2304,7 +2476,8 @@ bool ConnectInputs(CTxDB& txdb,
     string info = "ConnectInputsHook(): name=" + sName + ", value=" + stringFromVch(nti.vchValue) + ", tx=" + tx.GetHash().GetHex() +
         ", block=" + boost::lexical_cast<string>(pindexBlock->nHeight) + " -";
 
-    CNameDB dbName("r");
+    // read through the transaction of the block, it holds the name changes of a reorganization
+    CNameDB dbName(txdb);
 
     switch (nti.op)
     {
@@ -2390,7 +2563,7 @@ bool ConnectInputs(CTxDB& txdb,
     return true;
 }
 
-bool CNamecoinHooks::DisconnectInputs(const CTransaction& tx)
+bool CNamecoinHooks::DisconnectInputs(CTxDB& txdb, const CTransaction& tx)
 {
     if (tx.nVersion != NAMECOIN_TX_VERSION)
         return true;
@@ -2400,8 +2573,8 @@ bool CNamecoinHooks::DisconnectInputs(const CTransaction& tx)
         return error("DisconnectInputsHook() : could not decode Denarius name tx");
 
     {
-        CNameDB dbName("cr+");
-        dbName.TxnBegin();
+        // changes go into the transaction that disconnects the block
+        CNameDB dbName(txdb);
 
         CNameRecord nameRec;
         if (!dbName.ReadName(nti.vchName, nameRec))
@@ -2438,8 +2611,6 @@ bool CNamecoinHooks::DisconnectInputs(const CTransaction& tx)
             return error("DisconnectInputsHook() : failed to calculate expiration time before writing to name DB");
         if (!dbName.WriteName(nti.vchName, nameRec))
             return error("DisconnectInputsHook() : failed to write to name DB");
-
-        dbName.TxnCommit();
     }
 
     return true;
@@ -2532,8 +2703,9 @@ bool CNamecoinHooks::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex)
     if (vName.empty())
         return true;
 
-    // All of these name ops should succed. If there is an error - denariusnamesindex.dat is probably corrupt.
-    CNameDB dbName("cr+");
+    // All of these name ops should succed. If there is an error - the name index is probably corrupt.
+    // They are written into the transaction of the block, so the index never gets ahead of the chain.
+    CNameDB dbName(txdb);
     set< vector<unsigned char> > sNameNew;
     for (const nameTempProxy &i : vName)
     {
@@ -2544,8 +2716,6 @@ bool CNamecoinHooks::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex)
         if (dbName.ExistsName(i.vchName) && !dbName.ReadName(i.vchName, nameRec))
             return error("%s failed to read from name DB", info.c_str());
 
-        dbName.TxnBegin();
-
         // only first name_new for same name in same block will get written
         if  (i.op == OP_NAME_NEW && sNameNew.count(i.vchName))
             continue;
@@ -2587,8 +2757,6 @@ bool CNamecoinHooks::ConnectBlock(CTxDB& txdb, CBlockIndex* pindex)
                     mapNamePending.erase(i.vchName);
             }
         }
-        if (!dbName.TxnCommit())
-            return error("%s failed on write", info.c_str());
         printf("%s success!\n", info.c_str());
     }
 
@@ -2625,18 +2793,15 @@ bool CNamecoinHooks::deletePendingName(const CTransaction& tx)
 bool CNamecoinHooks::getNameValue(const string& name, string& value)
 {
     vector<unsigned char> vchName = vchFromString(name);
-    CNameDB dbName("r");
-    if (!dbName.ExistsName(vchName))
+    if (!NameActive(vchName))
         return false;
 
+    CNameDB dbName("r");
     CTransaction tx;
     NameTxInfo nti;
     if (!(GetLastTxOfName(dbName, vchName, tx) && DecodeNameTx(tx, nti, false, true)))
         return false;
 
-    if (!NameActive(dbName, vchName))
-        return false;
-
     value = stringFromVch(nti.vchValue);
 
     return true;
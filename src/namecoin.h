@@ -66,19 +66,38 @@ public:
     )
 };
 
-class CNameDB : public CDB
+// Compact copy of a CNameRecord that is kept in memory for every name, so that
+// liveness checks and name listings don't have to read and decode the record.
+class CNameSummary
 {
 public:
-    CNameDB(const char* pszMode="r+") : CDB("denariusnamesindex.dat", pszMode) {}
+    int nRegisteredAt;  // height of the first tx in the last active chain
+    int nExpiresAt;
+    bool fDeleted;
+
+    CNameSummary() : nRegisteredAt(0), nExpiresAt(0), fDeleted(true) {}
+    explicit CNameSummary(CNameRecord& rec);
 
-    bool WriteName(const std::vector<unsigned char>& name, const CNameRecord &rec)
+    bool IsActive(int nHeight) const
     {
-        return Write(make_pair(std::string("namei"), name), rec);
+        return !fDeleted && nHeight <= nExpiresAt;
     }
+};
+
+// The name index is stored in the chain database under "namei" keys. A CNameDB
+// constructed from the CTxDB of a block being connected writes into that
+// transaction, so a block and its name changes are committed together.
+class CNameDB
+{
+public:
+    CNameDB(const char* pszMode="r+") : txdbOwn(pszMode), txdb(txdbOwn) {}
+    CNameDB(CTxDB& txdbIn) : txdbOwn("r"), txdb(txdbIn) {}
+
+    bool WriteName(const std::vector<unsigned char>& name, CNameRecord &rec);
 
     bool ReadName(const std::vector<unsigned char>& name, CNameRecord &rec)
     {
-        bool ret = Read(make_pair(std::string("namei"), name), rec);
+        bool ret = txdb.Read(make_pair(std::string("namei"), name), rec);
         int s = rec.vtxPos.size();
         if (s > 0)
             assert(s > rec.nLastActiveChainIndex);
@@ -87,14 +106,26 @@ public:
 
     bool ExistsName(const std::vector<unsigned char>& name)
     {
-        return Exists(make_pair(std::string("namei"), name));
+        return txdb.Exists(make_pair(std::string("namei"), name));
     }
 
-    bool EraseName(const std::vector<unsigned char>& name)
+    bool EraseName(const std::vector<unsigned char>& name);
+
+    bool ReadIndexVersion(int& nIndexVersion)
+    {
+        nIndexVersion = 0;
+        return txdb.Read(std::string("nameindex"), nIndexVersion);
+    }
+
+    bool WriteIndexVersion(int nIndexVersion)
     {
-        return Erase(make_pair(std::string("namei"), name));
+        return txdb.Write(std::string("nameindex"), nIndexVersion);
     }
 
+    bool TxnBegin() { return txdb.TxnBegin(); }
+    bool TxnCommit() { return txdb.TxnCommit(); }
+    bool IsInTransaction() const { return txdb.IsInTransaction(); }
+
     bool ScanNames(
             const std::vector<unsigned char>& vchName,
             unsigned int nMax,
@@ -106,8 +137,23 @@ public:
             >& nameScan
             );
     bool DumpToTextFile();
+
+private:
+    CTxDB txdbOwn;
+    CTxDB& txdb;
 };
 
+// In-memory name summaries, reflecting the committed state of the index
+bool GetNameSummary(const std::vector<unsigned char>& vchName, CNameSummary& summary);
+void GetNameSummaries(const std::vector<unsigned char>& vchStart, unsigned int nMax,
+                      std::vector<std::pair<std::vector<unsigned char>, CNameSummary> >& vSummaries);
+unsigned int GetNameCount();
+// Uses the expiry index, cost depends on the names returned, not on all names
+unsigned int GetLiveNameCount(int nHeight);
+void GetLiveNames(int nHeight, std::vector<std::pair<std::vector<unsigned char>, CNameSummary> >& vSummaries);
+// Loads the in-memory name summaries, rebuilding the index if needed
+bool LoadNameIndex();
+
 extern std::map<std::vector<unsigned char>, uint256> mapMyNames;
 extern std::map<std::vector<unsigned char>, std::set<uint256> > mapNamePending;
 
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockencodings.h"
 #include "db.h"
 #include "net.h"
 #include "init.h"
@@ -11,6 +12,7 @@
 #include "ui_interface.h"
 #include "fortuna.h"
 #include <sys/stat.h>
+#include <math.h>
 
 #ifdef WIN32
 #include <string.h>
@@ -77,7 +79,7 @@ CAddrMan addrman;
 
 vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay;
+map<CInv, std::shared_ptr<const CDataStream> > mapRelay;
 deque<pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 map<CInv, int64_t> mapAlreadyAskedFor;
@@ -485,6 +487,8 @@ uint64_t CNode::nTotalBytesRecv = 0;
 uint64_t CNode::nTotalBytesSent = 0;
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
+mapMsgStats_t CNode::mapTotalRecvMsgStats;
+mapMsgStats_t CNode::mapTotalSendMsgStats;
 
 uint64_t CNode::nMaxOutboundLimit = 0;
 uint64_t CNode::nMaxOutboundTotalBytesSentInCycle = 0;
@@ -639,8 +643,10 @@ void CNode::PushVersion()
     CAddress addrMe = GetLocalAddress(&addr);
     RAND_bytes((unsigned char*)&nLocalHostNonce, sizeof(nLocalHostNonce));
     printf("send version message: version %d, blocks=%d, us=%s, them=%s, peer=%s\n", PROTOCOL_VERSION, nBestHeight, addrMe.ToString().c_str(), addrYou.ToString().c_str(), addr.ToString().c_str());
+    // Older nodes stop reading after the height
+    uint64_t nCompactBlocks = GetBoolArg("-compactblocks", true) ? COMPACT_BLOCKS_VERSION : 0;
     PushMessage("version", PROTOCOL_VERSION, nLocalServices, nTime, addrYou, addrMe,
-                nLocalHostNonce, FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>()), nBestHeight);
+                nLocalHostNonce, FormatSubVersion(CLIENT_NAME, CLIENT_VERSION, std::vector<string>()), nBestHeight, nCompactBlocks);
 }
 
 
@@ -867,6 +873,11 @@ void CNode::copyStats(CNodeStats &stats)
         X(nRecvBytes);
     }
     X(fWhitelisted);
+    {
+        LOCK(cs_msgStats);
+        X(mapSendMsgStats);
+        X(mapRecvMsgStats);
+    }
 
     // It is common for nodes with good ping times to suddenly become lagged,
     // due to a new block arriving or other large transfer.
@@ -888,6 +899,53 @@ void CNode::copyStats(CNodeStats &stats)
 }
 #undef X
 
+// The commands counted by name, whatever a peer sends otherwise is MSG_STATS_OTHER
+static const char* pszMsgStatsCommands[] = {
+    "version", "verack", "addr", "getaddr", "inv", "getdata", "notfound", "getblocks", "getheaders",
+    "headers", "tx", "block", "mempool", "ping", "pong", "alert", "checkpoint", "checkorder", "reply",
+    "cmpctblock", "getblocktxn", "blocktxn", "getcfilters", "cfilter", "getsporks", "spork",
+    "mnget", "mnw", "dsee", "dseep", "dseg", "dsq", "dsi", "dsf", "dss", "dssu", "dsc", "dstx", "txlreq",
+    "mktinv", "smsgDisabled", "smsgIgnore", "smsgPing", "smsgPong", "smsgInv", "smsgShow", "smsgHave",
+    "smsgWant", "smsgMsg", "smsgMatch",
+};
+static const set<string> setMsgStatsCommands(pszMsgStatsCommands, pszMsgStatsCommands + ARRAYLEN(pszMsgStatsCommands));
+
+static void AddMessageStats(mapMsgStats_t& mapStats, const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros)
+{
+    const std::string& strKey = setMsgStatsCommands.count(strCommand) ? strCommand : MSG_STATS_OTHER;
+    mapStats[strKey].Add(nBytes, nTimeMicros);
+}
+
+void CNode::RecordMessageRecv(const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros)
+{
+    {
+        LOCK(cs_msgStats);
+        AddMessageStats(mapRecvMsgStats, strCommand, nBytes, nTimeMicros);
+    }
+    LOCK(cs_totalBytesRecv);
+    AddMessageStats(mapTotalRecvMsgStats, strCommand, nBytes, nTimeMicros);
+}
+
+void CNode::RecordMessageSent(const std::string& strCommand, uint64_t nBytes)
+{
+    {
+        LOCK(cs_msgStats);
+        AddMessageStats(mapSendMsgStats, strCommand, nBytes, 0);
+    }
+    LOCK(cs_totalBytesSent);
+    AddMessageStats(mapTotalSendMsgStats, strCommand, nBytes, 0);
+}
+
+void CNode::GetTotalMsgStats(mapMsgStats_t& mapRecv, mapMsgStats_t& mapSend)
+{
+    {
+        LOCK(cs_totalBytesRecv);
+        mapRecv = mapTotalRecvMsgStats;
+    }
+    LOCK(cs_totalBytesSent);
+    mapSend = mapTotalSendMsgStats;
+}
+
 void CNode::RecordBytesRecv(uint64_t bytes)
 {
     LOCK(cs_totalBytesRecv);
@@ -1057,9 +1115,10 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     if (hdr.nMessageSize > MAX_SIZE)
             return -1;
 
-    // switch state to reading message data
+    // switch state to reading message data, the buffer grows with the
+    // data received rather than to the size the header claims
     in_data = true;
-    vRecv.resize(hdr.nMessageSize);
+    vRecv.reserve(std::min(hdr.nMessageSize, MESSAGE_RECV_RESERVE));
 
     return nCopy;
 }
@@ -1069,7 +1128,7 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
-    memcpy(&vRecv[nDataPos], pch, nCopy);
+    vRecv.write(pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
@@ -2757,20 +2816,27 @@ void RelayTransaction(const CTransaction& tx, const uint256& hash, const CDataSt
     {
         LOCK(cs_mapRelay);
         // Expire old relay messages
-        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
+        int64_t nNow = GetTime();
+        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < nNow)
         {
             mapRelay.erase(vRelayExpiration.front().second);
             vRelayExpiration.pop_front();
         }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
-        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
+        // Save original serialized message so newer versions are preserved,
+        // one copy answers getdata from every peer
+        if (mapRelay.insert(std::make_pair(inv, std::make_shared<const CDataStream>(ss))).second)
+            vRelayExpiration.push_back(std::make_pair(nNow + RELAY_EXPIRE_TIME, inv));
     }
 
     RelayInventory(inv);
 }
 
+int64_t PoissonNextSend(int64_t nNow, int nAverageIntervalSeconds)
+{
+    return nNow + (int64_t)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * nAverageIntervalSeconds * -1000000.0 + 0.5);
+}
+
 void RelayTransactionLockReq(const CTransaction& tx, const uint256& hash, bool relayToAll)
 {
     CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
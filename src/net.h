@@ -6,6 +6,7 @@
 #define BITCOIN_NET_H
 
 #include <deque>
+#include <memory>
 #include <boost/array.hpp>
 #include <boost/foreach.hpp>
 #include <openssl/rand.h>
@@ -14,6 +15,7 @@
 #include <arpa/inet.h>
 #endif
 
+#include "bloom.h"
 #include "core.h"
 #include "mruset.h"
 #include "netbase.h"
@@ -23,6 +25,7 @@
 class CRequestTracker;
 class CNode;
 class CBlockIndex;
+class CPartialBlock;
 extern int nBestHeight;
 
 
@@ -30,6 +33,15 @@ extern int nBestHeight;
 static const int PING_INTERVAL = 2 * 60;
 /** Time after which to disconnect, after waiting for a ping response (or inactivity). */
 static const int TIMEOUT_INTERVAL = 20 * 60;
+/** Bytes of a message reserved when its header arrives, larger messages grow the buffer as their data comes in */
+static const unsigned int MESSAGE_RECV_RESERVE = 256 * 1024;
+/** Inventory a peer is remembered to know, at least the last this many */
+static const unsigned int INVENTORY_KNOWN_FILTER_SIZE = 50000;
+/** Default for -invinterval, average seconds between transaction inventory
+ *  sends to an inbound peer. Outbound peers get them twice as often. */
+static const int DEFAULT_INVENTORY_BROADCAST_INTERVAL = 5;
+/** Seconds a relayed transaction is kept to answer getdata from */
+static const int64_t RELAY_EXPIRE_TIME = 15 * 60;
 
 inline unsigned int ReceiveFloodSize() { return 1000*GetArg("-maxreceivebuffer", 5*1000); }
 inline unsigned int SendBufferSize() { return 1000*GetArg("-maxsendbuffer", 1*1000); }
@@ -151,7 +163,7 @@ extern CAddrMan addrman;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, std::shared_ptr<const CDataStream> > mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern std::map<CInv, int64_t> mapAlreadyAskedFor;
@@ -176,6 +188,31 @@ public:
     std::vector<int> vHeightInFlight;
 };
 
+/** Traffic of one message command: messages and bytes with headers and, for
+ *  received ones, the time ProcessMessage spent on them */
+class CMessageStats
+{
+public:
+    uint64_t nCount;
+    uint64_t nBytes;
+    int64_t nTimeMicros;
+
+    CMessageStats() : nCount(0), nBytes(0), nTimeMicros(0) {}
+
+    void Add(uint64_t nBytesIn, int64_t nTimeMicrosIn)
+    {
+        nCount++;
+        nBytes += nBytesIn;
+        nTimeMicros += nTimeMicrosIn;
+    }
+};
+
+typedef std::map<std::string, CMessageStats> mapMsgStats_t;
+
+/** Message stats key for commands we do not know, so junk commands from a
+ *  peer cannot grow the maps */
+static const char* const MSG_STATS_OTHER = "*other*";
+
 class CNodeStats
 {
 public:
@@ -199,6 +236,8 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    mapMsgStats_t mapSendMsgStats;
+    mapMsgStats_t mapRecvMsgStats;
 };
 
 
@@ -354,6 +393,9 @@ public:
 
     uint64_t nSendBytes;
     uint64_t nRecvBytes;
+    CCriticalSection cs_msgStats;
+    mapMsgStats_t mapSendMsgStats;
+    mapMsgStats_t mapRecvMsgStats;
 
     int64_t nLastSendEmpty;
     int64_t nTimeConnected;
@@ -411,6 +453,10 @@ public:
 	bool fStartSync;
 	int nMisbehavior;
 
+    // compact block relay
+    uint64_t nCompactBlocksVersion;     // from the version message, 0 if none
+    std::shared_ptr<CPartialBlock> ppartialBlock;   // waiting on blocktxn
+
     // flood relay
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
@@ -419,9 +465,10 @@ public:
     uint256 hashCheckpointKnown; // ppcoin: known sent sync-checkpoint
 
     // inventory based relay
-    mruset<CInv> setInventoryKnown;
+    CRollingBloomFilter filterInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     CCriticalSection cs_inventory;
+    int64_t nNextInvSend;
     std::multimap<int64_t, CInv> mapAskFor;
 
     SecMsgNode smsgData;
@@ -436,7 +483,7 @@ public:
     // Whether a ping is requested.
     bool fPingQueued;
 
-    CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn = "", bool fInboundIn=false) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000)
+    CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn = "", bool fInboundIn=false) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000), filterInventoryKnown(INVENTORY_KNOWN_FILTER_SIZE, 0.000001)
     {
         nServices = 0;
         hSocket = hSocketIn;
@@ -467,10 +514,11 @@ public:
         hashLastGetBlocksEnd = 0;
         nChainHeight = -1;
 		fStartSync = false;
+        nCompactBlocksVersion = 0;
         fGetAddr = false;
         nMisbehavior = 0;
         hashCheckpointKnown = 0;
-        setInventoryKnown.max_size(SendBufferSize() / 1000);
+        nNextInvSend = 0;
         nPingNonceSent = 0;
         nPingUsecStart = 0;
         nPingUsecTime = 0;
@@ -502,6 +550,8 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+    static mapMsgStats_t mapTotalRecvMsgStats;
+    static mapMsgStats_t mapTotalSendMsgStats;
 
     // outbound limit & stats
     static uint64_t nMaxOutboundTotalBytesSentInCycle;
@@ -571,7 +621,7 @@ public:
     {
         {
             LOCK(cs_inventory);
-            setInventoryKnown.insert(inv);
+            filterInventoryKnown.insert(inv.hash);
         }
     }
 
@@ -579,7 +629,7 @@ public:
     {
         {
             LOCK(cs_inventory);
-            if (!setInventoryKnown.count(inv))
+            if (!filterInventoryKnown.contains(inv.hash))
                 vInventoryToSend.push_back(inv);
         }
     }
@@ -652,6 +702,9 @@ public:
             printf("(%d bytes)\n", nSize);
         }
 
+        const char* pszCommand = &ssSend[CMessageHeader::MESSAGE_START_SIZE];
+        RecordMessageSent(std::string(pszCommand, strnlen(pszCommand, CMessageHeader::COMMAND_SIZE)), ssSend.size());
+
         std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
         ssSend.GetAndClear(*it);
         nSendSize += (*it).size();
@@ -908,6 +961,11 @@ template<typename T1, typename T2, typename T3, typename T4, typename T5, typena
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
 
+    // Per command stats, for this node and in total
+    void RecordMessageRecv(const std::string& strCommand, uint64_t nBytes, int64_t nTimeMicros);
+    void RecordMessageSent(const std::string& strCommand, uint64_t nBytes);
+    static void GetTotalMsgStats(mapMsgStats_t& mapRecv, mapMsgStats_t& mapSend);
+
     //!set the max outbound target in bytes
     static void SetMaxOutboundTarget(uint64_t limit);
     static uint64_t GetMaxOutboundTarget();
@@ -930,6 +988,10 @@ template<typename T1, typename T2, typename T3, typename T4, typename T5, typena
     static uint64_t GetMaxOutboundTimeLeftInCycle();
 };
 
+/** Time in microseconds of the next event of a Poisson process with the
+ *  given average interval, for timing sends so that they do not line up */
+int64_t PoissonNextSend(int64_t nNow, int nAverageIntervalSeconds);
+
 inline void RelayInventory(const CInv& inv)
 {
     // Put on lists to offer to the other nodes
@@ -276,9 +276,13 @@ void FortunastakeManager::updateNodeList()
     if (pindexBest->GetBlockHash() == lastNodeUpdateHash) return;
     lastNodeUpdateHash = pindexBest->GetBlockHash();
 
-    TRY_LOCK(cs_fortunastakes, lockFortunastakes);
-    if(!lockFortunastakes)
-        return;
+    std::shared_ptr<const std::vector<CFortunaStake> > vStakes;
+    {
+        TRY_LOCK(cs_fortunastakes, lockFortunastakes);
+        if(!lockFortunastakes)
+            return;
+        vStakes = vecFortunastakes.GetSnapshot();
+    }
 
     ui->countLabel->setText("Updating...");
     if (mnCount == 0 || IsInitialBlockDownload()) return;
@@ -288,7 +292,7 @@ void FortunastakeManager::updateNodeList()
     ui->tableWidget->clearContents();
     ui->tableWidget->setRowCount(0);
 
-    BOOST_FOREACH(CFortunaStake& mn, vecFortunastakes)
+    BOOST_FOREACH(const CFortunaStake& mn, *vStakes)
     {
         bool bFound = false;
         int nodeRow = 0;
@@ -445,12 +449,12 @@ void FortunastakeManager::updateNodeList()
     int64_t payPer24H = roundPerSec * 86400;
 
     if (mnCount > 0)
-        ui->countLabel->setText(QString("%1/%2 active (average income: %3/day)").arg(vecFortunastakes.size()).arg(mnCount).arg(QString::fromStdString(FormatMoney(payPer24H))));
+        ui->countLabel->setText(QString("%1/%2 active (average income: %3/day)").arg(vStakes->size()).arg(mnCount).arg(QString::fromStdString(FormatMoney(payPer24H))));
     else
         ui->countLabel->setText("Loading...");
 
-    if (mnCount < vecFortunastakes.size())
-        ui->countLabel->setText(QString("%1 active (average income: %2/day)").arg(vecFortunastakes.size()).arg(QString::fromStdString(FormatMoney(payPer24H))));
+    if (mnCount < vStakes->size())
+        ui->countLabel->setText(QString("%1 active (average income: %2/day)").arg(vStakes->size()).arg(QString::fromStdString(FormatMoney(payPer24H))));
 
     ui->tableWidget->setSortingEnabled(true);
     ui->tableWidget->setUpdatesEnabled(true);
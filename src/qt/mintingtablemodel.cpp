@@ -14,6 +14,8 @@
 
 #include "wallet.h"
 
+#include <boost/thread.hpp>
+
 #include <QLocale>
 #include <QList>
 #include <QColor>
@@ -24,6 +26,11 @@
 
 extern double GetDifficulty(const CBlockIndex* blockindex);
 
+// Wallet transactions are loaded as the view asks for rows, at least this many rows at a time
+static const int MINTING_FETCH_ROWS = 256;
+// Stake probabilities are recomputed once the difficulty moved by more than this
+static const double MINTING_DIFFICULTY_STEP = 0.01;
+
 static int column_alignments[] = {
     Qt::AlignLeft|Qt::AlignVCenter,
     Qt::AlignLeft|Qt::AlignVCenter,
@@ -55,32 +62,166 @@ class MintingTablePriv
 public:
     MintingTablePriv(CWallet *wallet, MintingTableModel *parent):
         wallet(wallet),
-        parent(parent)
+        parent(parent),
+        fFetchedAny(false),
+        fFetchedAll(false),
+        fFetching(false),
+        fFetchAllWanted(false),
+        fRequest(false),
+        fRequestAny(false),
+        fResult(false),
+        fResultAny(false),
+        fResultAll(false)
     {
+        threadFetcher = boost::thread(&MintingTablePriv::threadFetch, this);
+    }
+    ~MintingTablePriv()
+    {
+        threadFetcher.interrupt();
+        threadFetcher.join();
     }
     CWallet *wallet;
     MintingTableModel *parent;
 
     QList<KernelRecord> cachedWallet;
 
-    void refreshWallet()
+    /* Wallet transactions are loaded in hash order, up to and including hashFetched */
+    bool fFetchedAny;
+    bool fFetchedAll;
+    uint256 hashFetched;
+
+    /* Batches are read by threadFetch, one request at a time, so the GUI
+       thread never waits on cs_main for them */
+    bool fFetching;
+    bool fFetchAllWanted;
+    QList<uint256> skippedWhileFetching;
+
+    boost::thread threadFetcher;
+    boost::mutex mutexFetch;
+    boost::condition_variable condFetch;
+    // Request and result of threadFetch, guarded by mutexFetch
+    bool fRequest;
+    bool fRequestAny;
+    uint256 hashRequestFrom;
+    bool fResult;
+    QList<KernelRecord> resultRows;
+    bool fResultAny;
+    bool fResultAll;
+    uint256 hashResultLast;
+
+    bool isFetched(const uint256 &hash)
     {
-#ifdef WALLET_UPDATE_DEBUG
-        qDebug() << "refreshWallet";
-#endif
-        cachedWallet.clear();
+        return fFetchedAll || (fFetchedAny && !(hashFetched < hash));
+    }
+
+    void threadFetch()
+    {
+        RenameThread("denarius-mintingfetch");
+
+        try
         {
-            LOCK(wallet->cs_wallet);
-            for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+            while (true)
             {
-                    std::vector<KernelRecord> txList = KernelRecord::decomposeOutput(wallet, it->second);
-                    BOOST_FOREACH(KernelRecord& kr, txList) {
-                        if(!kr.spent) {
-                            cachedWallet.append(kr);
+                bool fAny;
+                uint256 hashFrom;
+                {
+                    boost::unique_lock<boost::mutex> lock(mutexFetch);
+                    while (!fRequest)
+                        condFetch.wait(lock);
+                    fRequest = false;
+                    fAny = fRequestAny;
+                    hashFrom = hashRequestFrom;
+                }
+
+                QList<KernelRecord> toInsert;
+                bool fAll;
+                {
+                    LOCK2(cs_main, wallet->cs_wallet);
+                    std::map<uint256, CWalletTx>::iterator it = fAny ? wallet->mapWallet.upper_bound(hashFrom) : wallet->mapWallet.begin();
+                    for(; it != wallet->mapWallet.end() && toInsert.size() < MINTING_FETCH_ROWS; ++it)
+                    {
+                        std::vector<KernelRecord> txList = KernelRecord::decomposeOutput(wallet, it->second);
+                        BOOST_FOREACH(KernelRecord& kr, txList) {
+                            if(!kr.spent) {
+                                toInsert.append(kr);
+                            }
                         }
+                        hashFrom = it->first;
+                        fAny = true;
                     }
+                    fAll = (it == wallet->mapWallet.end());
+                }
+
+                {
+                    boost::lock_guard<boost::mutex> lock(mutexFetch);
+                    resultRows.swap(toInsert);
+                    fResultAny = fAny;
+                    fResultAll = fAll;
+                    hashResultLast = hashFrom;
+                    fResult = true;
+                }
+                QMetaObject::invokeMethod(parent, "applyFetched", Qt::QueuedConnection);
             }
         }
+        catch (boost::thread_interrupted&)
+        {
+        }
+    }
+
+    void fetchMore()
+    {
+#ifdef WALLET_UPDATE_DEBUG
+        qDebug() << "fetchMore";
+#endif
+        if(fFetching || fFetchedAll)
+            return;
+        fFetching = true;
+        {
+            boost::lock_guard<boost::mutex> lock(mutexFetch);
+            fRequest = true;
+            fRequestAny = fFetchedAny;
+            hashRequestFrom = hashFetched;
+        }
+        condFetch.notify_one();
+    }
+
+    /* Inserts the batch read by threadFetch, returns true once the whole wallet is loaded */
+    bool applyFetched()
+    {
+        QList<KernelRecord> toInsert;
+        {
+            boost::lock_guard<boost::mutex> lock(mutexFetch);
+            if(!fResult)
+                return false;
+            fResult = false;
+            toInsert.swap(resultRows);
+            fFetchedAny = fResultAny;
+            fFetchedAll = fResultAll;
+            hashFetched = hashResultLast;
+        }
+        fFetching = false;
+
+        // mapWallet is sorted by hash, so the new rows go to the end
+        if(!toInsert.isEmpty())
+        {
+            parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size()+toInsert.size()-1);
+            cachedWallet.append(toInsert);
+            parent->endInsertRows();
+        }
+
+        // The batch may have been read before these changed
+        if(!skippedWhileFetching.isEmpty())
+        {
+            QList<uint256> skipped;
+            skipped.swap(skippedWhileFetching);
+            updateWallet(skipped);
+        }
+
+        if(fFetchedAll)
+            return true;
+        if(fFetchAllWanted)
+            fetchMore();
+        return false;
     }
 
      /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -104,6 +245,13 @@ public:
             for(int update_idx = updated_sorted.size()-1; update_idx >= 0; --update_idx)
             {
                 const uint256 &hash = updated_sorted.at(update_idx);
+                // Not loaded yet, fetchMore reads it when the view gets there
+                if(!isFetched(hash))
+                {
+                    if(fFetching)
+                        skippedWhileFetching.append(hash);
+                    continue;
+                }
                 // Find transaction in wallet
                 std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
                 bool inWallet = mi != wallet->mapWallet.end();
@@ -224,10 +372,12 @@ MintingTableModel::MintingTableModel(CWallet *wallet, WalletModel *parent):
         wallet(wallet),
         walletModel(parent),
         mintingInterval(10),
+        mintingDifficulty(0),
+        cachedNumBlocks(-1),
         priv(new MintingTablePriv(wallet, this))
 {
     columns << tr("Transaction") <<  tr("Address") << tr("Balance") << tr("Age") << tr("Coin Days") << tr("Stake Probability"); //Removed Stake Reward temporarily
-    priv->refreshWallet();
+    updateDifficulty();
 
     QTimer *timer = new QTimer(this);
     connect(timer, SIGNAL(timeout()), this, SLOT(update()));
@@ -261,6 +411,60 @@ void MintingTableModel::update()
         priv->updateWallet(updated);
         mintingProxyModel->invalidate(); // Force deletion of empty rows
     }
+
+    updateDifficulty();
+}
+
+void MintingTableModel::updateDifficulty()
+{
+    if(cachedNumBlocks == nBestHeight)
+        return;
+
+    double difficulty;
+    {
+        TRY_LOCK(cs_main, lockMain);
+        if(!lockMain)
+            return;
+        cachedNumBlocks = nBestHeight;
+        difficulty = GetDifficulty(GetLastBlockIndex(pindexBest, true));
+    }
+
+    // Stake probabilities of all rows follow the difficulty, only move them
+    // when it changed enough to show
+    if(mintingDifficulty > 0 && qAbs(difficulty / mintingDifficulty - 1) <= MINTING_DIFFICULTY_STEP)
+        return;
+    mintingDifficulty = difficulty;
+    if(priv->size() > 0)
+        emit dataChanged(index(0, MintProbability), index(priv->size()-1, MintProbability));
+}
+
+bool MintingTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return !priv->fFetchedAll && !priv->fFetching;
+}
+
+void MintingTableModel::fetchMore(const QModelIndex &parent)
+{
+    Q_UNUSED(parent);
+    priv->fetchMore();
+}
+
+void MintingTableModel::fetchAll()
+{
+    priv->fFetchAllWanted = true;
+    priv->fetchMore();
+}
+
+bool MintingTableModel::isFetchedAll() const
+{
+    return priv->fFetchedAll;
+}
+
+void MintingTableModel::applyFetched()
+{
+    if(priv->applyFetched())
+        emit fetchedAll();
 }
 
 void MintingTableModel::setMintingProxyModel(MintingFilterProxy *mintingProxy)
@@ -408,10 +612,10 @@ QString MintingTableModel::formatTxPoSReward(KernelRecord *wtx) const
 
 double MintingTableModel::getDayToMint(KernelRecord *wtx) const
 {
-    const CBlockIndex *p = GetLastBlockIndex(pindexBest, true);
-    double difficulty = GetDifficulty(p);
+    if(mintingDifficulty <= 0)
+        return 0;
 
-    double prob = wtx->getProbToMintWithinNMinutes(difficulty, mintingInterval);
+    double prob = wtx->getProbToMintWithinNMinutes(mintingDifficulty, mintingInterval);
     prob = prob * 100;
     return prob;
 }
@@ -42,6 +42,11 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+    /* Keeps loading batches in the background until the whole wallet is in the model */
+    void fetchAll();
+    bool isFetchedAll() const;
 
     void setMintingInterval(int interval);
 
@@ -50,6 +55,8 @@ private:
     WalletModel *walletModel;
     QStringList columns;
     int mintingInterval;
+    double mintingDifficulty;
+    int cachedNumBlocks;
     MintingTablePriv *priv;
     MintingFilterProxy *mintingProxyModel;
 
@@ -63,8 +70,15 @@ private:
     QString formatTxBalance(const KernelRecord *wtx) const;
     QString formatTxCoinDay(const KernelRecord *wtx) const;
     QString formatTxPoSReward(KernelRecord *wtx) const;
+    void updateDifficulty();
 private slots:
     void update();
+    /* Insert the rows read off the GUI thread */
+    void applyFetched();
+
+signals:
+    /* All wallet outputs are loaded, sorting and exporting cover every row */
+    void fetchedAll();
 
     friend class MintingTablePriv;
 };
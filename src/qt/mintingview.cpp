@@ -18,6 +18,7 @@
 #include <QComboBox>
 #include <QMessageBox>
 #include <QMenu>
+#include <QEventLoop>
 
 MintingView::MintingView(QWidget *parent) :
     QWidget(parent), model(0), mintingView(0)
@@ -158,6 +159,8 @@ void MintingView::setModel(WalletModel *model)
         mintingView->setSelectionMode(QAbstractItemView::ExtendedSelection);
         mintingView->setSortingEnabled(true);
         mintingView->sortByColumn(MintingTableModel::CoinDay, Qt::DescendingOrder);
+        // The view is sorted, so the top rows are only right once every output is loaded
+        model->getMintingTableModel()->fetchAll();
         mintingView->verticalHeader()->hide();
 
         mintingView->horizontalHeader()->resizeSection(
@@ -221,6 +224,16 @@ void MintingView::exportClicked()
 
     if (filename.isNull()) return;
 
+    // Export every output, not just the ones loaded so far
+    MintingTableModel *mintingModel = model->getMintingTableModel();
+    if (!mintingModel->isFetchedAll())
+    {
+        QEventLoop loop;
+        connect(mintingModel, SIGNAL(fetchedAll()), &loop, SLOT(quit()));
+        mintingModel->fetchAll();
+        loop.exec();
+    }
+
     CSVModelWriter writer(filename);
 
     // name, column, role
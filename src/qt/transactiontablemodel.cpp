@@ -52,7 +52,8 @@ class TransactionTablePriv
 public:
     TransactionTablePriv(CWallet *wallet, TransactionTableModel *parent):
             wallet(wallet),
-            parent(parent)
+            parent(parent),
+            nNumBlocks(-1)
     {
     }
     CWallet *wallet;
@@ -64,107 +65,68 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Number of blocks the rows were last shown at */
+    int nNumBlocks;
+
+    /* Replace the whole model with records read off the GUI thread.
      */
-    void refreshWallet()
+    void resetRecords(const std::map<uint256, QList<TransactionRecord> > &mapRecords)
     {
         OutputDebugStringF("refreshWallet\n");
+        parent->beginResetModel();
         cachedWallet.clear();
-        {
-            LOCK2(cs_main, wallet->cs_wallet);
-            for(std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
-            {
-                if(TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
-            }
-        }
+        for(std::map<uint256, QList<TransactionRecord> >::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it)
+            cachedWallet.append(it->second);
+        parent->endResetModel();
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
-       Call with transaction that was added, removed or changed.
+       Call with the new records of a transaction that was added, removed or changed,
+       an empty list removes the transaction.
      */
-    void updateWallet(const uint256 &hash, int status)
+    void updateRecords(const uint256 &hash, const QList<TransactionRecord> &records)
     {
-        if (fDebugChain && fDebugNet) OutputDebugStringF("updateWallet %s %i\n", hash.ToString().c_str(), status);
+        // Find bounds of this transaction in model
+        QList<TransactionRecord>::iterator lower = qLowerBound(
+            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+        QList<TransactionRecord>::iterator upper = qUpperBound(
+            cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
+        int lowerIndex = (lower - cachedWallet.begin());
+        int upperIndex = (upper - cachedWallet.begin());
+
+        if (fDebugChain && fDebugNet) OutputDebugStringF("updateRecords %s Index=%i-%i records=%i\n",
+                 hash.ToString().c_str(), lowerIndex, upperIndex, records.size());
+
+        if(upperIndex - lowerIndex == records.size())
         {
-            LOCK2(cs_main, wallet->cs_wallet);
-
-            // Find transaction in wallet
-            std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(hash);
-            bool inWallet = mi != wallet->mapWallet.end();
-
-            // Find bounds of this transaction in model
-            QList<TransactionRecord>::iterator lower = qLowerBound(
-                cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-            QList<TransactionRecord>::iterator upper = qUpperBound(
-                cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
-            int lowerIndex = (lower - cachedWallet.begin());
-            int upperIndex = (upper - cachedWallet.begin());
-            bool inModel = (lower != upper);
-
-            // Determine whether to show transaction or not
-            bool showTransaction = (inWallet && TransactionRecord::showTransaction(mi->second));
-
-            if(status == CT_UPDATED)
-            {
-                if(showTransaction && !inModel)
-                    status = CT_NEW; /* Not in model, but want to show, treat as new */
-                if(!showTransaction && inModel)
-                    status = CT_DELETED; /* In model, but want to hide, treat as deleted */
-            }
-
-            if (fDebugChain && fDebugNet) OutputDebugStringF("   inWallet=%i inModel=%i Index=%i-%i showTransaction=%i derivedStatus=%i\n",
-                     inWallet, inModel, lowerIndex, upperIndex, showTransaction, status);
+            if(records.isEmpty())
+                return;
+            // Same rows -- only status or details changed
+            for(int i = 0; i < records.size(); i++)
+                cachedWallet[lowerIndex + i] = records[i];
+            emit parent->dataChanged(parent->index(lowerIndex, 0), parent->index(upperIndex-1, parent->columns.length()-1));
+            return;
+        }
 
-            switch(status)
+        if(lower != upper)
+        {
+            parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
+            cachedWallet.erase(lower, upper);
+            parent->endRemoveRows();
+        }
+        if(!records.isEmpty())
+        {
+            // Added -- insert at the right position
+            parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+records.size()-1);
+            int insert_idx = lowerIndex;
+            foreach(const TransactionRecord &rec, records)
             {
-            case CT_NEW:
-                if(inModel)
-                {
-                    OutputDebugStringF("Warning: updateWallet: Got CT_NEW, but transaction is already in model\n");
-                    break;
-                }
-                if(!inWallet)
-                {
-                    OutputDebugStringF("Warning: updateWallet: Got CT_NEW, but transaction is not in wallet\n");
-                    break;
-                }
-                if(showTransaction)
-                {
-                    // Added -- insert at the right position
-                    QList<TransactionRecord> toInsert =
-                            TransactionRecord::decomposeTransaction(wallet, mi->second);
-                    if(!toInsert.isEmpty()) /* only if something to insert */
-                    {
-                        parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex+toInsert.size()-1);
-                        int insert_idx = lowerIndex;
-                        foreach(const TransactionRecord &rec, toInsert)
-                        {
-                            cachedWallet.insert(insert_idx, rec);
-                            insert_idx += 1;
-                        }
-                        parent->endInsertRows();
-                    }
-                }
-                break;
-            case CT_DELETED:
-                if(!inModel)
-                {
-                    OutputDebugStringF("Warning: updateWallet: Got CT_DELETED, but transaction is not in model\n");
-                    break;
-                }
-                // Removed -- remove entire transaction from table
-                parent->beginRemoveRows(QModelIndex(), lowerIndex, upperIndex-1);
-                cachedWallet.erase(lower, upper);
-                parent->endRemoveRows();
-                break;
-            case CT_UPDATED:
-                // Miscellaneous updates -- nothing to do, status update will take care of this, and is only computed for
-                // visible transactions.
-                break;
+                cachedWallet.insert(insert_idx, rec);
+                insert_idx += 1;
             }
+            parent->endInsertRows();
         }
     }
 
@@ -179,26 +141,13 @@ public:
         {
             TransactionRecord *rec = &cachedWallet[idx];
 
-            // Get required locks upfront. This avoids the GUI from getting
-            // stuck if the core is holding the locks for a longer time - for
-            // example, during a wallet rescan.
-            //
-            // If a status update is needed (blocks came in since last check),
-            //  update the status of this transaction from the wallet. Otherwise,
-            // simply re-use the cached status.
-            TRY_LOCK(cs_main, lockMain);
-            if(lockMain)
+            // Rows that can still change are refreshed by the wallet journal,
+            // settled rows only need their depth moved along with the chain,
+            // which may also have become shorter
+            if(rec->status.status == TransactionStatus::Confirmed && nNumBlocks >= 0 && nNumBlocks != rec->status.cur_num_blocks)
             {
-                TRY_LOCK(wallet->cs_wallet, lockWallet);
-                if(lockWallet && rec->statusUpdateNeeded())
-                {
-                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
-
-                    if(mi != wallet->mapWallet.end())
-                    {
-                        rec->updateStatus(mi->second);
-                    }
-                }
+                rec->status.depth += nNumBlocks - rec->status.cur_num_blocks;
+                rec->status.cur_num_blocks = nNumBlocks;
             }
             return rec;
         }
@@ -231,8 +180,6 @@ TransactionTableModel::TransactionTableModel(CWallet* wallet, WalletModel *paren
 {
     columns << QString() << tr("Date") << tr("Type") << tr("Address") << tr("Narration") << tr("Amount");
 
-    priv->refreshWallet();
-
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
 }
 
@@ -241,20 +188,23 @@ TransactionTableModel::~TransactionTableModel()
     delete priv;
 }
 
-void TransactionTableModel::updateTransaction(const QString &hash, int status)
+void TransactionTableModel::resetRecords(const std::map<uint256, QList<TransactionRecord> > &mapRecords)
 {
-    uint256 updated;
-    updated.SetHex(hash.toStdString());
+    priv->resetRecords(mapRecords);
+}
 
-    priv->updateWallet(updated, status);
+void TransactionTableModel::updateRecords(const uint256 &hash, const QList<TransactionRecord> &records)
+{
+    priv->updateRecords(hash, records);
 }
 
-void TransactionTableModel::updateConfirmations()
+void TransactionTableModel::updateConfirmations(int nNumBlocks)
 {
-    // Blocks came in since last poll.
+    // Blocks came in since last update.
     // Invalidate status (number of confirmations) and (possibly) description
     //  for all rows. Qt is smart enough to only actually request the data for the
     //  visible rows.
+    priv->nNumBlocks = nNumBlocks;
     emit dataChanged(index(0, Status), index(priv->size()-1, Status));
     emit dataChanged(index(0, ToAddress), index(priv->size()-1, ToAddress));
 }
@@ -4,9 +4,12 @@
 #include <QAbstractTableModel>
 #include <QStringList>
 
+#include <map>
+
+#include "transactionrecord.h"
+
 class CWallet;
 class TransactionTablePriv;
-class TransactionRecord;
 class WalletModel;
 
 /** UI model for the transaction table of a wallet.
@@ -58,6 +61,11 @@ public:
     QVariant data(const QModelIndex &index, int role) const;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
+
+    /* Rows prepared by the wallet journal reader of WalletModel */
+    void resetRecords(const std::map<uint256, QList<TransactionRecord> > &mapRecords);
+    void updateRecords(const uint256 &hash, const QList<TransactionRecord> &records);
+    void updateConfirmations(int nNumBlocks);
 private:
     CWallet* wallet;
     WalletModel *walletModel;
@@ -77,8 +85,6 @@ private:
     QVariant txAddressDecoration(const TransactionRecord *wtx) const;
 
 public slots:
-    void updateTransaction(const QString &hash, int status);
-    void updateConfirmations();
     void updateDisplayUnit();
 
     friend class TransactionTablePriv;
@@ -14,7 +14,6 @@
 #include "smessage.h"
 
 #include <QSet>
-#include <QTimer>
 #include <QDebug>
 
 #if BOOST_VERSION >= 107300
@@ -34,7 +33,8 @@ WalletModel::WalletModel(CWallet *wallet, OptionsModel *optionsModel, QObject *p
     cachedBalance(0), cachedStake(0), cachedUnconfirmedBalance(0), cachedImmatureBalance(0),
     cachedNumTransactions(0),
     cachedEncryptionStatus(Unencrypted),
-    cachedNumBlocks(0)
+    cachedNumBlocks(0),
+    fNameTableStale(false)
 {
 
     fHaveWatchOnly = wallet->HaveWatchOnly();
@@ -44,17 +44,19 @@ WalletModel::WalletModel(CWallet *wallet, OptionsModel *optionsModel, QObject *p
     nameTableModel = new NameTableModel(wallet, this);
     transactionTableModel = new TransactionTableModel(wallet, this);
 
-    // This timer will be fired repeatedly to update the balance
-    pollTimer = new QTimer(this);
-    connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollBalanceChanged()));
-    pollTimer->start(MODEL_UPDATE_DELAY);
-
     subscribeToCoreSignals();
+
+    // The reader loads the whole wallet first, the transaction table fills in
+    // when that batch arrives
+    threadJournalReader = boost::thread(boost::bind(&WalletModel::threadJournal, this));
 }
 
 WalletModel::~WalletModel()
 {
     unsubscribeFromCoreSignals();
+
+    threadJournalReader.interrupt();
+    threadJournalReader.join();
 }
 
 qint64 WalletModel::getBalance() const
@@ -128,78 +130,218 @@ void WalletModel::updateStatus()
         emit encryptionStatusChanged(newEncryptionStatus);
 }
 
-void WalletModel::pollBalanceChanged()
+void WalletModel::checkBalanceChanged(const CWalletBalances& balances)
 {
-    // Get required locks upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
-    // for example, during a wallet rescan.
-    TRY_LOCK(cs_main, lockMain);
-    if(!lockMain)
-        return;
-    TRY_LOCK(wallet->cs_wallet, lockWallet);
-    if(!lockWallet)
-        return;
-
-    if(fForceBalanceCheck && nBestHeight != cachedNumBlocks)
+    if(cachedBalance != balances.nUnlocked || cachedLockedBalance != balances.nLocked || cachedStake != balances.nStakeAmount ||
+       cachedUnconfirmedBalance != balances.nUnconfirmed || cachedImmatureBalance != balances.nImmature ||
+       cachedWatchOnlyBalance != balances.nWatchOnly || cachedWatchUnconfBalance != balances.nWatchUnconfirmed ||
+       cachedWatchImmatureBalance != balances.nWatchImmature)
     {
-        // Balance and number of transactions might have changed
-        cachedNumBlocks = nBestHeight;
-
-        checkBalanceChanged();
+        cachedBalance = balances.nUnlocked;
+        cachedLockedBalance = balances.nLocked;
+        cachedStake = balances.nStakeAmount;
+        cachedUnconfirmedBalance = balances.nUnconfirmed;
+        cachedImmatureBalance = balances.nImmature;
+        cachedWatchOnlyBalance = balances.nWatchOnly;
+        cachedWatchUnconfBalance = balances.nWatchUnconfirmed;
+        cachedWatchImmatureBalance = balances.nWatchImmature;
+
+        emit balanceChanged(balances.nUnlocked, balances.nLocked, balances.nStakeAmount, balances.nUnconfirmed, balances.nImmature,
+                            balances.nWatchOnly, balances.nWatchUnconfirmed, balances.nWatchImmature);
+    }
+}
 
-        //if(transactionTableModel)
-            //transactionTableModel->updateConfirmations();
-        //TODO: perhaps redo this. Currently it rescans all tx available in wallet - idealy we do not need such scan.
-        if (nameTableModel)
-            nameTableModel->update();
+void WalletDeltaBatch::Merge(const WalletDeltaBatch& batch)
+{
+    if (batch.fReset)
+    {
+        fReset = true;
+        mapRecords = batch.mapRecords;
+    }
+    else
+    {
+        for (std::map<uint256, QList<TransactionRecord> >::const_iterator it = batch.mapRecords.begin(); it != batch.mapRecords.end(); ++it)
+            mapRecords[it->first] = it->second;
+    }
+    if (batch.fBalances)
+    {
+        fBalances = true;
+        balances = batch.balances;
     }
+    nNumTransactions = batch.nNumTransactions;
+    nNumBlocks = batch.nNumBlocks;
+}
 
-    fForceBalanceCheck = false;
+void WalletModel::pushDelta(const CWalletDelta& delta)
+{
+    if (journal.Push(delta))
+    {
+        boost::lock_guard<boost::mutex> lock(mutexJournal);
+        condJournal.notify_one();
+    }
 }
 
-void WalletModel::checkBalanceChanged()
+// Records of a wallet transaction with their current status. Returns false
+// while the status can still change with new blocks.
+static bool ReadRecords(const CWallet *wallet, const CWalletTx &wtx, QList<TransactionRecord> &records)
 {
-    qint64 newBalance = getUnlockedBalance();
-    qint64 newLockedBalance = getLockedBalance();
-    qint64 newStake = getStakeAmount();
-    qint64 newUnconfirmedBalance = getUnconfirmedBalance();
-    qint64 newImmatureBalance = getImmatureBalance();
-    // Watch Only
-    qint64 newWatchOnlyBalance = 0;
-    qint64 newWatchUnconfBalance = 0;
-    qint64 newWatchImmatureBalance = 0;
-    if (haveWatchOnly())
+    records.clear();
+    if (!TransactionRecord::showTransaction(wtx))
+        return true;
+
+    bool fSettled = true;
+    records = TransactionRecord::decomposeTransaction(wallet, wtx);
+    for (int i = 0; i < records.size(); i++)
     {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+        records[i].updateStatus(wtx);
+        if (records[i].status.status != TransactionStatus::Confirmed)
+            fSettled = false;
     }
+    return fSettled;
+}
 
-    if(cachedBalance != newBalance || cachedLockedBalance != newLockedBalance || cachedStake != newStake || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance)
+void WalletModel::threadJournal()
+{
+    RenameThread("denarius-walletjournal");
+
+    // Transactions whose rows or balance bucket change with the next block
+    std::set<uint256> setUnsettled;
+    bool fLoaded = false;
+    int nLastHeight = -1;
+
+    try
     {
-        cachedBalance = newBalance;
-        cachedStake = newStake;
-        cachedUnconfirmedBalance = newUnconfirmedBalance;
-        cachedImmatureBalance = newImmatureBalance;
+        while (true)
+        {
+            std::vector<CWalletDelta> vDeltas;
+            {
+                boost::unique_lock<boost::mutex> lock(mutexJournal);
+                if (fLoaded && journal.Empty())
+                    condJournal.timed_wait(lock, boost::posix_time::milliseconds(MODEL_UPDATE_DELAY));
+            }
+            boost::this_thread::interruption_point();
+            journal.Drain(vDeltas);
+            if (fLoaded && vDeltas.empty())
+                continue;
+
+            std::set<uint256> setChanged;
+            bool fTxChanged = !fLoaded;
+            bool fTip = false;
+            BOOST_FOREACH(const CWalletDelta& delta, vDeltas)
+            {
+                if (delta.nType == CWalletDelta::BALANCE_CHANGED)
+                    fTip = true;
+                else
+                {
+                    setChanged.insert(delta.hash);
+                    fTxChanged = true;
+                }
+            }
+            bool fBalances = fTxChanged || (fTip && !setUnsettled.empty());
+            if (fTip)
+                setChanged.insert(setUnsettled.begin(), setUnsettled.end());
 
-        emit balanceChanged(newBalance, newLockedBalance, newStake, newUnconfirmedBalance, newImmatureBalance, newWatchOnlyBalance, newWatchUnconfBalance, newWatchImmatureBalance);
+            WalletDeltaBatch batch;
+            {
+                LOCK2(cs_main, wallet->cs_wallet);
+                if (!fLoaded)
+                {
+                    batch.fReset = true;
+                    for (std::map<uint256, CWalletTx>::const_iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+                        if (!ReadRecords(wallet, it->second, batch.mapRecords[it->first]))
+                            setUnsettled.insert(it->first);
+                    fLoaded = true;
+                }
+                else if (nBestHeight < nLastHeight)
+                {
+                    // The chain got shorter, settled rows may be confirming again
+                    for (std::map<uint256, CWalletTx>::const_iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it)
+                        setChanged.insert(it->first);
+                    fBalances = true;
+                }
+                nLastHeight = nBestHeight;
+                BOOST_FOREACH(const uint256& hash, setChanged)
+                {
+                    QList<TransactionRecord>& records = batch.mapRecords[hash];
+                    std::map<uint256, CWalletTx>::const_iterator mi = wallet->mapWallet.find(hash);
+                    if (mi == wallet->mapWallet.end() || ReadRecords(wallet, mi->second, records))
+                        setUnsettled.erase(hash);
+                    else
+                        setUnsettled.insert(hash);
+                }
+                if (fBalances)
+                {
+                    wallet->GetBalances(batch.balances);
+                    batch.fBalances = true;
+                }
+                batch.nNumTransactions = wallet->mapWallet.size();
+                batch.nNumBlocks = nBestHeight;
+            }
+
+            bool fWasEmpty;
+            {
+                boost::lock_guard<boost::mutex> lock(mutexJournal);
+                fWasEmpty = pendingBatch.IsNull();
+                pendingBatch.Merge(batch);
+            }
+            if (fWasEmpty)
+                QMetaObject::invokeMethod(this, "applyWalletDeltas", Qt::QueuedConnection);
+        }
+    }
+    catch (boost::thread_interrupted&)
+    {
     }
 }
 
-void WalletModel::updateTransaction(const QString &hash, int status)
+void WalletModel::applyWalletDeltas()
 {
-    if(transactionTableModel)
-        transactionTableModel->updateTransaction(hash, status);
+    WalletDeltaBatch batch;
+    {
+        boost::lock_guard<boost::mutex> lock(mutexJournal);
+        std::swap(batch, pendingBatch);
+    }
+    if (batch.IsNull())
+        return;
+
+    if (transactionTableModel)
+    {
+        if (batch.fReset)
+            transactionTableModel->resetRecords(batch.mapRecords);
+        else
+            for (std::map<uint256, QList<TransactionRecord> >::const_iterator it = batch.mapRecords.begin(); it != batch.mapRecords.end(); ++it)
+                transactionTableModel->updateRecords(it->first, it->second);
+    }
 
-    // Balance and number of transactions might have changed
-    // checkBalanceChanged();
+    if (batch.fBalances)
+        checkBalanceChanged(batch.balances);
 
-    fForceBalanceCheck = true;
-    int newNumTransactions = getNumTransactions();
-    if(cachedNumTransactions != newNumTransactions)
+    if (cachedNumTransactions != batch.nNumTransactions)
     {
-        cachedNumTransactions = newNumTransactions;
-        emit numTransactionsChanged(newNumTransactions);
+        cachedNumTransactions = batch.nNumTransactions;
+        emit numTransactionsChanged(batch.nNumTransactions);
+    }
+
+    if (cachedNumBlocks != batch.nNumBlocks)
+    {
+        cachedNumBlocks = batch.nNumBlocks;
+        if (transactionTableModel)
+            transactionTableModel->updateConfirmations(batch.nNumBlocks);
+        fNameTableStale |= !batch.mapRecords.empty();
+    }
+
+    // The name table still reads the wallet itself, skip it while the core is busy
+    if (fNameTableStale && nameTableModel)
+    {
+        TRY_LOCK(cs_main, lockMain);
+        if (lockMain)
+        {
+            TRY_LOCK(wallet->cs_wallet, lockWallet);
+            if (lockWallet)
+            {
+                nameTableModel->update();
+                fNameTableStale = false;
+            }
+        }
     }
 }
 
@@ -626,10 +768,24 @@ static void NotifyAddressBookChanged(WalletModel *walletmodel, CWallet *wallet,
 
 static void NotifyTransactionChanged(WalletModel *walletmodel, CWallet *wallet, const uint256 &hash, ChangeType status)
 {
-    OutputDebugStringF("NotifyTransactionChanged %s status=%i\n", hash.GetHex().c_str(), status);
-    QMetaObject::invokeMethod(walletmodel, "updateTransaction", Qt::QueuedConnection,
-                              Q_ARG(QString, QString::fromStdString(hash.GetHex())),
-                              Q_ARG(int, status));
+    // Called with cs_wallet held
+    CWalletDelta::Type nType = CWalletDelta::TX_UPDATED;
+    if (status == CT_NEW)
+        nType = CWalletDelta::TX_ADDED;
+    else if (status == CT_DELETED)
+        nType = CWalletDelta::TX_DELETED;
+    else
+    {
+        std::map<uint256, CWalletTx>::const_iterator mi = wallet->mapWallet.find(hash);
+        if (mi != wallet->mapWallet.end() && mi->second.hashBlock != 0)
+            nType = CWalletDelta::TX_CONFIRMED;
+    }
+    walletmodel->pushDelta(CWalletDelta(nType, hash));
+}
+
+static void NotifyBlocksChanged(WalletModel *walletmodel, int nHeight, int newNumBlocksOfPeers)
+{
+    walletmodel->pushDelta(CWalletDelta(CWalletDelta::BALANCE_CHANGED, 0, nHeight));
 }
 
 static void NotifyWatchonlyChanged(WalletModel *walletmodel, bool fHaveWatchonly)
@@ -645,6 +801,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyAddressBookChanged.connect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5));
     wallet->NotifyTransactionChanged.connect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
     wallet->NotifyWatchonlyChanged.connect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlocksChanged.connect(boost::bind(NotifyBlocksChanged, this, _1, _2));
 }
 
 void WalletModel::unsubscribeFromCoreSignals()
@@ -654,6 +811,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyAddressBookChanged.disconnect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5));
     wallet->NotifyTransactionChanged.disconnect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
     wallet->NotifyWatchonlyChanged.disconnect(boost::bind(NotifyWatchonlyChanged, this, _1));
+    uiInterface.NotifyBlocksChanged.disconnect(boost::bind(NotifyBlocksChanged, this, _1, _2));
 }
 
 // WalletModel::UnlockContext implementation
@@ -7,7 +7,11 @@
 
 #include "allocators.h" /* for SecureString */
 #include "wallet.h"
+#include "walletjournal.h"
 #include "namecoin.h"
+#include "transactionrecord.h"
+
+#include <boost/thread.hpp>
 
 class OptionsModel;
 class AddressTableModel;
@@ -22,10 +26,6 @@ class COutPoint;
 class uint256;
 class CCoinControl;
 
-QT_BEGIN_NAMESPACE
-class QTimer;
-QT_END_NAMESPACE
-
 class SendCoinsRecipient
 {
 public:
@@ -36,6 +36,25 @@ public:
     qint64 amount;
 };
 
+/** Rows and balances prepared off the GUI thread from a batch of wallet deltas */
+class WalletDeltaBatch
+{
+public:
+    /** Records replace the whole transaction table */
+    bool fReset;
+    /** New records of each changed transaction, an empty list removes it */
+    std::map<uint256, QList<TransactionRecord> > mapRecords;
+    bool fBalances;
+    CWalletBalances balances;
+    int nNumTransactions;
+    int nNumBlocks;
+
+    WalletDeltaBatch() : fReset(false), fBalances(false), nNumTransactions(-1), nNumBlocks(-1) {}
+
+    bool IsNull() const { return nNumBlocks == -1; }
+    void Merge(const WalletDeltaBatch& batch);
+};
+
 /** Interface to Bitcoin wallet from Qt view code. */
 class WalletModel : public QObject
 {
@@ -152,6 +171,9 @@ public:
     void listLockedCoins(std::vector<COutPoint>& vOutpts);
 	  CWallet* getWallet();
 
+    /* Called from core threads */
+    void pushDelta(const CWalletDelta& delta);
+
 private:
     CWallet *wallet;
 
@@ -182,24 +204,30 @@ private:
     int cachedTxLocks;
     EncryptionStatus cachedEncryptionStatus;
     int cachedNumBlocks;
-    bool fForceBalanceCheck;
 
-    QTimer *pollTimer;
+    bool fNameTableStale;
+
+    // Wallet changes are journaled by the core threads and turned into table
+    // rows and balances by threadJournal, so the GUI thread never waits on cs_main
+    CWalletJournal journal;
+    boost::mutex mutexJournal;
+    boost::condition_variable condJournal;
+    boost::thread threadJournalReader;
+    WalletDeltaBatch pendingBatch;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
-    void checkBalanceChanged();
+    void checkBalanceChanged(const CWalletBalances& balances);
+    void threadJournal();
 
 
 public slots:
     /* Wallet status might have changed */
     void updateStatus();
-    /* New transaction, or transaction changed status */
-    void updateTransaction(const QString &hash, int status);
+    /* Apply the rows and balances prepared from the wallet journal */
+    void applyWalletDeltas();
     /* New, updated or removed address book entry */
     void updateAddressBook(const QString &address, const QString &label, bool isMine, int status);
-    /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
-    void pollBalanceChanged();
     /* Watchonly added */
     void updateWatchOnlyFlag(bool fHaveWatchonly);
 
@@ -4,9 +4,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "main.h"
+#include "bootstrap.h"
 #include "denariusrpc.h"
 #include "init.h"
 #include "txdb.h"
+#include "blockfilter.h"
 #include <errno.h>
 
 #include <boost/filesystem.hpp>
@@ -73,7 +75,7 @@ double GetPoWMHashPS()
             pindexPrevWork = pindex;
         }
 
-        pindex = pindex->pnext;
+        pindex = chainActive.Next(pindex);
     }
 
     return GetDifficulty() * 4294.967296 / nTargetSpacingWork;
@@ -137,8 +139,8 @@ Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool fPri
     result.push_back(Pair("chaintrust", leftTrim(blockindex->nChainTrust.GetHex(), '0')));
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    if (blockindex->pnext)
-        result.push_back(Pair("nextblockhash", blockindex->pnext->GetBlockHash().GetHex()));
+    if (chainActive.Next(blockindex))
+        result.push_back(Pair("nextblockhash", chainActive.Next(blockindex)->GetBlockHash().GetHex()));
 
     result.push_back(Pair("flags", strprintf("%s%s", blockindex->IsProofOfStake()? "proof-of-stake" : "proof-of-work", blockindex->GeneratedStakeModifier()? " stake-modifier": "")));
     result.push_back(Pair("proofhash", blockindex->hashProof.GetHex()));
@@ -171,41 +173,38 @@ Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool fPri
 
 Value dumpbootstrap(const Array& params, bool fHelp)
 {
-    if (fHelp || params.size() != 2)
+    if (fHelp || params.size() < 2 || params.size() > 3)
         throw runtime_error(
-            "dumpbootstrap \"destination\" \"blocks\"\n"
-            "\nCreates a bootstrap format block dump of the blockchain in destination, which can be a directory or a path with filename, up to the given block number.");
+            "dumpbootstrap \"destination\" \"blocks\" [compress=false]\n"
+            "\nCreates a bootstrap format block dump of the blockchain in destination, which can be a directory or a path with filename, up to the given block number.\n"
+            "With compress=true the blocks are written in LZ4 compressed chunks with a chunk index; -loadblock and bootstrap.dat import accept both formats.");
 
     string strDest = params[0].get_str();
     int nBlocks = params[1].get_int();
-    if (nBlocks < 0 || nBlocks > nBestHeight)
-        throw runtime_error("Block number out of range.");
+    bool fCompress = params.size() > 2 ? params[2].get_bool() : false;
 
     boost::filesystem::path pathDest(strDest);
-    if (boost::filesystem::is_directory(pathDest))
-        pathDest /= "bootstrap.dat";
-
     try {
-        FILE* file = fopen(pathDest.string().c_str(), "wb");
-        if (!file)
-            throw JSONRPCError(RPC_MISC_ERROR, "Error: Could not open bootstrap file for writing.");
-
-        CAutoFile fileout = CAutoFile(file, SER_DISK, CLIENT_VERSION);
-        if (!fileout)
-            throw JSONRPCError(RPC_MISC_ERROR, "Error: Could not open bootstrap file for writing.");
-
-        for (int nHeight = 0; nHeight <= nBlocks; nHeight++)
-        {
-            CBlock block;
-            CBlockIndex* pblockindex = FindBlockByHeight(nHeight);
-            block.ReadFromDisk(pblockindex, true);
-            fileout << FLATDATA(pchMessageStart) << fileout.GetSerializeSize(block) << block;
-        }
+        if (boost::filesystem::is_directory(pathDest))
+            pathDest /= "bootstrap.dat";
     } catch(const boost::filesystem::filesystem_error &e) {
         throw JSONRPCError(RPC_MISC_ERROR, "Error: Bootstrap dump failed!");
     }
 
-    return Value::null;
+    // Runs without the RPC locks, DumpBootstrap holds cs_main only while it
+    // checks the height and reads the block positions
+    CExportStats stats;
+    string strError;
+    if (!DumpBootstrap(pathDest, nBlocks, fCompress, stats, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, "Error: " + strError);
+
+    Object result;
+    result.push_back(Pair("blocks", stats.nBlocks));
+    result.push_back(Pair("chunks", stats.nChunks));
+    result.push_back(Pair("rawbytes", stats.nRawBytes));
+    result.push_back(Pair("filebytes", stats.nFileBytes));
+    result.push_back(Pair("ms", stats.nTimeMillis));
+    return result;
 }
 
 Value proofofdata(const Array& params, bool fHelp)
@@ -366,6 +365,29 @@ Value getblockhash(const Array& params, bool fHelp)
     return pblockindex->phashBlock->GetHex();
 }
 
+Value getblockfilter(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getblockfilter <blockhash>\n"
+            "Returns the BIP158 basic filter of a block, built when it was connected.");
+
+    uint256 hash(params[0].get_str());
+    if (!mapBlockIndex.count(hash))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+    CBlockFilter filter;
+    if (!fBlockFilterIndex || !CTxDB("r").ReadBlockFilter(hash, filter))
+        throw JSONRPCError(RPC_MISC_ERROR, "No filter for this block, it was connected without -blockfilterindex");
+
+    std::vector<unsigned char> vchEncoded = filter.GetEncoded();
+    Object result;
+    result.push_back(Pair("blockhash", hash.GetHex()));
+    result.push_back(Pair("elements",  (int)filter.nElements));
+    result.push_back(Pair("filter",    HexStr(vchEncoded.begin(), vchEncoded.end())));
+    return result;
+}
+
 //New getblock RPC Command for Denariium Compatibility
 Value getblock(const Array& params, bool fHelp)
 {
@@ -686,7 +708,7 @@ Value gettxout(const Array& params, bool fHelp)
       ret.push_back(Pair("confirmations", 0));
     else
     {
-      map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+      BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
       if (mi != mapBlockIndex.end() && (*mi).second)
       {
         CBlockIndex* pindex = (*mi).second;
@@ -694,8 +716,8 @@ Value gettxout(const Array& params, bool fHelp)
         {
           bool isSpent=false;
           CBlockIndex* p = pindex;
-          p=p->pnext;
-          for (; p; p = p->pnext)
+          p=chainActive.Next(p);
+          for (; p; p = chainActive.Next(p))
           {
             CBlock block;
             CBlockIndex* pblockindex = mapBlockIndex[p->GetBlockHash()];
@@ -775,3 +797,85 @@ Value getblockchaininfo(const Array& params, bool fHelp)
     //obj.push_back(Pair("size_on_disk",   CalculateCurrentUsage()));
     return obj;
 }
+
+Value getblockfilestats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+                "getblockfilestats\n"
+                "Returns statistics of the memory mapped block file cache.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"enabled\": true|false,   (bool) whether block reads go through the cache\n"
+                "  \"maxfiles\": n,           (numeric) number of block files kept mapped (-blockfilecache)\n"
+                "  \"openfiles\": n,          (numeric) number of block files currently mapped\n"
+                "  \"reads\": n,              (numeric) block and transaction reads served from mappings\n"
+                "  \"cachehits\": n,          (numeric) reads that found their file already mapped\n"
+                "  \"remaps\": n,             (numeric) mappings replaced because the file had grown\n"
+                "  \"bytesmapped\": n         (numeric) bytes currently mapped\n"
+                "}\n"
+        );
+
+    Object obj;
+    obj.push_back(Pair("enabled",      blockFileCache.IsEnabled()));
+    obj.push_back(Pair("maxfiles",     (int)blockFileCache.GetMaxFiles()));
+    obj.push_back(Pair("openfiles",    (int)blockFileCache.GetOpenFiles()));
+    obj.push_back(Pair("reads",        (uint64_t)blockFileCache.nReads));
+    obj.push_back(Pair("cachehits",    (uint64_t)blockFileCache.nCacheHits));
+    obj.push_back(Pair("remaps",       (uint64_t)blockFileCache.nRemaps));
+    obj.push_back(Pair("bytesmapped",  (uint64_t)blockFileCache.nBytesMapped));
+    return obj;
+}
+
+Value getdbstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+                "getdbstats\n"
+                "Returns LevelDB properties and write batching statistics of the chain database.\n"
+                "\nResult:\n"
+                "{\n"
+                "  \"batchblocks\": n,        (numeric) blocks per deferred index batch during initial download (-dbbatchblocks)\n"
+                "  \"batchbytes\": n,         (numeric) size at which a deferred batch is written early (-dbbatchsize)\n"
+                "  \"deferredcommits\": n,    (numeric) commits currently held back\n"
+                "  \"deferredbytes\": n,      (numeric) approximate size of the held back changes\n"
+                "  \"flushes\": n,            (numeric) deferred batches written\n"
+                "  \"flushedcommits\": n,     (numeric) commits written through deferred batches\n"
+                "  \"flushms\": n,            (numeric) total time spent writing deferred batches\n"
+                "  \"compacting\": true|false, (bool) whether the background compaction is running\n"
+                "  \"filesatlevel\": [n,...], (array) number of table files at each level\n"
+                "  \"stats\": \"...\",        (string) leveldb.stats property\n"
+                "  \"sstables\": \"...\"      (string) leveldb.sstables property\n"
+                "}\n"
+        );
+
+    CTxDBStats stats = CTxDB::GetStats();
+    CTxDB txdb("r");
+
+    Object obj;
+    obj.push_back(Pair("batchblocks",     (int)stats.nBatchBlocks));
+    obj.push_back(Pair("batchbytes",      stats.nBatchBytes));
+    obj.push_back(Pair("deferredcommits", (int)stats.nDeferredCommits));
+    obj.push_back(Pair("deferredbytes",   stats.nDeferredBytes));
+    obj.push_back(Pair("flushes",         stats.nFlushes));
+    obj.push_back(Pair("flushedcommits",  stats.nFlushedCommits));
+    obj.push_back(Pair("flushms",         stats.nFlushMillis));
+    obj.push_back(Pair("compacting",      stats.fCompacting));
+
+    Array files;
+    for (int nLevel = 0; nLevel < 7; nLevel++)
+    {
+        string strValue;
+        if (!txdb.GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), strValue))
+            break;
+        files.push_back(atoi(strValue));
+    }
+    obj.push_back(Pair("filesatlevel", files));
+
+    string strStats, strTables;
+    if (txdb.GetProperty("leveldb.stats", strStats))
+        obj.push_back(Pair("stats", strStats));
+    if (txdb.GetProperty("leveldb.sstables", strTables))
+        obj.push_back(Pair("sstables", strTables));
+    return obj;
+}
@@ -226,7 +226,8 @@ Value fortunastake(const Array& params, bool fHelp)
         }
 
         Object obj;
-        for (CFortunaStake mn : vecFortunastakes) {
+        std::shared_ptr<const std::vector<CFortunaStake> > vStakes = vecFortunastakes.GetSnapshot();
+        for (CFortunaStake mn : *vStakes) {
             mn.Check();
 
             if(strCommand == "active"){
@@ -581,24 +582,24 @@ Value fortunastake(const Array& params, bool fHelp)
                 localObj.push_back(Pair("vin", activeFortunastake.vin.ToString().c_str()));
                 localObj.push_back(Pair("service", activeFortunastake.service.ToString().c_str()));
                 LOCK(cs_fortunastakes);
-                BOOST_FOREACH(CFortunaStake& mn, vecFortunastakes) {
-                    if (mn.vin == activeFortunastake.vin) {
-                        //int mnRank = GetFortunastakeRank(mn, pindexBest);
-                        pubkey = GetScriptForDestination(mn.pubkey.GetID());
-                        ExtractDestination(pubkey, address1);
-                        CBitcoinAddress address2(address1);
-                        address = address2.ToString();
-                        localObj.push_back(Pair("payment_address", address));
-                        //localObj.push_back(Pair("rank", GetFortunastakeRank(mn, pindexBest)));
-                        localObj.push_back(Pair("network_status", mn.IsActive() ? "active" : "registered"));
-                        if (mn.IsActive()) {
-                          localObj.push_back(Pair("activetime",(mn.lastTimeSeen - mn.now)));
+                const CFortunastakeList& list = vecFortunastakes;
+                const CFortunaStake* pmn = list.Find(activeFortunastake.vin);
+                if (pmn) {
+                    const CFortunaStake& mn = *pmn;
+                    //int mnRank = GetFortunastakeRank(mn, pindexBest);
+                    pubkey = GetScriptForDestination(mn.pubkey.GetID());
+                    ExtractDestination(pubkey, address1);
+                    CBitcoinAddress address2(address1);
+                    address = address2.ToString();
+                    localObj.push_back(Pair("payment_address", address));
+                    //localObj.push_back(Pair("rank", GetFortunastakeRank(mn, pindexBest)));
+                    localObj.push_back(Pair("network_status", mn.IsActive() ? "active" : "registered"));
+                    if (mn.IsActive()) {
+                      localObj.push_back(Pair("activetime",(mn.lastTimeSeen - mn.now)));
 
-                        }
-                        localObj.push_back(Pair("earnings", mn.payValue));
-                        found = true;
-                        break;
                     }
+                    localObj.push_back(Pair("earnings", mn.payValue));
+                    found = true;
                 }
                 string reason;
                 if(activeFortunastake.status == FORTUNASTAKE_REMOTELY_ENABLED) reason = "fortunastake started remotely";
@@ -941,7 +942,8 @@ Value masternode(const Array& params, bool fHelp)
         }
 
         Object obj;
-        BOOST_FOREACH(CFortunaStake mn, vecFortunastakes) {
+        std::shared_ptr<const std::vector<CFortunaStake> > vStakes = vecFortunastakes.GetSnapshot();
+        for (CFortunaStake mn : *vStakes) {
             mn.Check();
 
             if(strCommand == "active"){
@@ -1281,24 +1283,24 @@ Value masternode(const Array& params, bool fHelp)
             localObj.push_back(Pair("vin", activeFortunastake.vin.ToString().c_str()));
             localObj.push_back(Pair("service", activeFortunastake.service.ToString().c_str()));
             LOCK(cs_fortunastakes);
-            BOOST_FOREACH(CFortunaStake& mn, vecFortunastakes) {
-                if (mn.vin == activeFortunastake.vin) {
-                    //int mnRank = GetFortunastakeRank(mn, pindexBest);
-                    pubkey = GetScriptForDestination(mn.pubkey.GetID());
-                    ExtractDestination(pubkey, address1);
-                    CBitcoinAddress address2(address1);
-                    address = address2.ToString();
-                    localObj.push_back(Pair("payment_address", address));
-                    //localObj.push_back(Pair("rank", GetFortunastakeRank(mn, pindexBest)));
-                    localObj.push_back(Pair("network_status", mn.IsActive() ? "active" : "registered"));
-                    if (mn.IsActive()) {
-                        localObj.push_back(Pair("activetime",(mn.lastTimeSeen - mn.now)));
+            const CFortunastakeList& list = vecFortunastakes;
+            const CFortunaStake* pmn = list.Find(activeFortunastake.vin);
+            if (pmn) {
+                const CFortunaStake& mn = *pmn;
+                //int mnRank = GetFortunastakeRank(mn, pindexBest);
+                pubkey = GetScriptForDestination(mn.pubkey.GetID());
+                ExtractDestination(pubkey, address1);
+                CBitcoinAddress address2(address1);
+                address = address2.ToString();
+                localObj.push_back(Pair("payment_address", address));
+                //localObj.push_back(Pair("rank", GetFortunastakeRank(mn, pindexBest)));
+                localObj.push_back(Pair("network_status", mn.IsActive() ? "active" : "registered"));
+                if (mn.IsActive()) {
+                    localObj.push_back(Pair("activetime",(mn.lastTimeSeen - mn.now)));
 
-                    }
-                    localObj.push_back(Pair("earnings", mn.payValue));
-                    found = true;
-                    break;
                 }
+                localObj.push_back(Pair("earnings", mn.payValue));
+                found = true;
             }
             string reason;
             if(activeFortunastake.status == FORTUNASTAKE_REMOTELY_ENABLED) reason = "fortunastake started remotely";
@@ -7,6 +7,9 @@
 #include "denariusrpc.h"
 #include "init.h"
 #include "txdb.h"
+#include "ipfspool.h"
+#include "jupiterpod.h"
+#include "walletdb.h"
 #include <errno.h>
 
 #include <boost/filesystem.hpp>
@@ -40,7 +43,9 @@ Value jupitergetstat(const Array& params, bool fHelp)
     if (fJupiterLocal) {
         std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-        ipfs::Client client(ipfsip);
+        CIPFSClientLease lease(ipfsip);
+
+        ipfs::Client& client = *lease;
 
         /* An example output:
         Stat: {"Key":"QmQpWo5TL9nivqvL18Bq8bS34eewAA6jcgdVsUu4tGeVHo","Size":15}
@@ -51,7 +56,8 @@ Value jupitergetstat(const Array& params, bool fHelp)
 
         return obj;
     } else {
-        ipfs::Client client("https://ipfs.infura.io:5001");
+        CIPFSClientLease lease("https://ipfs.infura.io:5001");
+        ipfs::Client& client = *lease;
 
         /* An example output:
         Stat: {"Key":"QmQpWo5TL9nivqvL18Bq8bS34eewAA6jcgdVsUu4tGeVHo","Size":15}
@@ -81,14 +87,17 @@ Value jupitergetblock(const Array& params, bool fHelp)
     if (fJupiterLocal) {
         std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-        ipfs::Client client(ipfsip);
+        CIPFSClientLease lease(ipfsip);
+
+        ipfs::Client& client = *lease;
 
         client.BlockGet(userHash, &block_contents);
         obj.push_back(Pair("blockhex", ipfs::test::string_to_hex(block_contents.str()).c_str()));
 
         return obj;
     } else {
-        ipfs::Client client("https://ipfs.infura.io:5001");
+        CIPFSClientLease lease("https://ipfs.infura.io:5001");
+        ipfs::Client& client = *lease;
 
         /* E.g. userHash is "QmQpWo5TL9nivqvL18Bq8bS34eewAA6jcgdVsUu4tGeVHo". */
         client.BlockGet(userHash, &block_contents);
@@ -118,7 +127,9 @@ Value jupiterversion(const Array& params, bool fHelp)
     if (fJupiterLocal) {
         std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-        ipfs::Client client(ipfsip);
+        CIPFSClientLease lease(ipfsip);
+
+        ipfs::Client& client = *lease;
 
         client.Version(&version);
         const std::string& vv = version["Version"].dump();
@@ -143,7 +154,8 @@ Value jupiterversion(const Array& params, bool fHelp)
 
         return obj;
     } else {
-        ipfs::Client client("https://ipfs.infura.io:5001");
+        CIPFSClientLease lease("https://ipfs.infura.io:5001");
+        ipfs::Client& client = *lease;
 
         client.Version(&version);
         const std::string& vv = version["Version"].dump();
@@ -186,7 +198,9 @@ Value jupiterpod(const Array& params, bool fHelp)
 
             std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-            ipfs::Client client(ipfsip);
+            CIPFSClientLease lease(ipfsip);
+
+            ipfs::Client& client = *lease;
 
             if(userFile == "")
             { 
@@ -282,7 +296,8 @@ Value jupiterpod(const Array& params, bool fHelp)
         } else {
             try {
                 ipfs::Json add_result;
-                ipfs::Client client("https://ipfs.infura.io:5001");
+                CIPFSClientLease lease("https://ipfs.infura.io:5001");
+                ipfs::Client& client = *lease;
 
                 if(userFile == "")
                 { 
@@ -389,7 +404,9 @@ Value jupiterupload(const Array& params, bool fHelp)
 
             std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-            ipfs::Client client(ipfsip);
+            CIPFSClientLease lease(ipfsip);
+
+            ipfs::Client& client = *lease;
 
             if(userFile == "")
             { 
@@ -434,7 +451,8 @@ Value jupiterupload(const Array& params, bool fHelp)
         } else {
             try {
                 ipfs::Json add_result;
-                ipfs::Client client("https://ipfs.infura.io:5001");
+                CIPFSClientLease lease("https://ipfs.infura.io:5001");
+                ipfs::Client& client = *lease;
 
                 if(userFile == "")
                 { 
@@ -512,7 +530,9 @@ Value jupiterduo(const Array& params, bool fHelp)
 
             std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-            ipfs::Client client(ipfsip);
+            CIPFSClientLease lease(ipfsip);
+
+            ipfs::Client& client = *lease;
 
             if(userFile == "")
             { 
@@ -559,7 +579,8 @@ Value jupiterduo(const Array& params, bool fHelp)
 
             try {
                 ipfs::Json add_result;
-                ipfs::Client client("https://ipfs.infura.io:5001");
+                CIPFSClientLease lease("https://ipfs.infura.io:5001");
+                ipfs::Client& client = *lease;
 
                 if(userFile == "")
                 { 
@@ -644,7 +665,9 @@ Value jupiterduopod(const Array& params, bool fHelp)
 
             std::string ipfsip = GetArg("-jupiterip", "localhost:5001"); //Default Localhost
 
-            ipfs::Client client(ipfsip);
+            CIPFSClientLease lease(ipfsip);
+
+            ipfs::Client& client = *lease;
 
             if(userFile == "")
             { 
@@ -730,7 +753,8 @@ Value jupiterduopod(const Array& params, bool fHelp)
 
             try {
                 ipfs::Json add_result;
-                ipfs::Client client("https://ipfs.infura.io:5001");
+                CIPFSClientLease lease("https://ipfs.infura.io:5001");
+                ipfs::Client& client = *lease;
 
                 if(userFile == "")
                 { 
@@ -820,4 +844,209 @@ Value jupiterduopod(const Array& params, bool fHelp)
             return obj;
         }
 }
+Value jupitersubmit(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "jupitersubmit\n"
+            "\nArguments:\n"
+            "1. [\"filelocation\",...]   (array, required) The files to upload (e.g. [\"/home/name/file.jpg\"])\n"
+            "Queues the files for upload to IPFS and returns a job id. The files are uploaded in parallel\n"
+            "by -jupiterthreads workers, use jupiterjobstatus to follow the job.");
+
+    vector<string> vFiles;
+    if (params[0].type() == str_type)
+        vFiles.push_back(params[0].get_str());
+    else
+    {
+        const Array& files = params[0].get_array();
+        for (unsigned int i = 0; i < files.size(); i++)
+            vFiles.push_back(files[i].get_str());
+    }
+
+    for (unsigned int i = 0; i < vFiles.size(); i++)
+        if (!boost::filesystem::is_regular_file(vFiles[i]))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "File not found: " + vFiles[i]);
+
+    std::string strHost = GetJupiterHost();
+    int nId = SubmitJupiterJob(strHost, vFiles);
+
+    Object obj;
+    obj.push_back(Pair("jobid",              nId));
+    obj.push_back(Pair("ipfspeer",           strHost));
+    obj.push_back(Pair("files",              (int)vFiles.size()));
+    return obj;
+}
+
+Value jupiterjobstatus(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "jupiterjobstatus\n"
+            "\nArguments:\n"
+            "1. jobid          (numeric, required) The id returned by jupitersubmit\n"
+            "Returns the state, IPFS CID and SHA256 of every file of a Jupiter upload job.");
+
+    CJupiterJob job;
+    if (!GetJupiterJob(params[0].get_int(), job))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown job id");
+
+    int nDone = 0, nFailed = 0;
+    Array items;
+    for (unsigned int i = 0; i < job.vItems.size(); i++)
+    {
+        const CJupiterItem& item = job.vItems[i];
+        Object entry;
+        entry.push_back(Pair("file",             item.strPath));
+        entry.push_back(Pair("state",            item.GetStateName()));
+        if (item.nState == CJupiterItem::DONE)
+        {
+            entry.push_back(Pair("ipfshash",         item.strHash));
+            entry.push_back(Pair("sha256",           HexStr(item.hashContent.begin(), item.hashContent.end())));
+            entry.push_back(Pair("sizebytes",        item.nSize));
+            entry.push_back(Pair("ipfslink",         "https://ipfs.io/ipfs/" + item.strHash));
+            nDone++;
+        }
+        else if (item.nState == CJupiterItem::FAILED)
+        {
+            entry.push_back(Pair("error",            item.strError));
+            nFailed++;
+        }
+        items.push_back(entry);
+    }
+
+    Object obj;
+    obj.push_back(Pair("jobid",              job.nId));
+    obj.push_back(Pair("ipfspeer",           job.strHost));
+    obj.push_back(Pair("complete",           job.IsDone()));
+    obj.push_back(Pair("done",               nDone));
+    obj.push_back(Pair("failed",             nFailed));
+    if (job.IsDone())
+        obj.push_back(Pair("seconds",            job.nDoneTime - job.nCreateTime));
+    obj.push_back(Pair("items",              items));
+    return obj;
+}
 #endif
+
+static Object JupiterPodBatchToJSON(const CWalletTx& wtx, const uint256& hashRoot, unsigned int nItems)
+{
+    Object obj;
+    obj.push_back(Pair("merkleroot",         hashRoot.GetHex()));
+    obj.push_back(Pair("items",              (int)nItems));
+    obj.push_back(Pair("podaddress",         CBitcoinAddress(CKeyID(Hash160(hashRoot.begin(), hashRoot.end()))).ToString()));
+    obj.push_back(Pair("podtxid",            wtx.GetHash().GetHex()));
+    return obj;
+}
+
+Value jupiterpodadd(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "jupiterpodadd\n"
+            "\nArguments:\n"
+            "1. [\"cid or file\",...]   (array, required) IPFS CIDs or local files to timestamp\n"
+            "Adds the items to the pending Jupiter POD batch. The Merkle root of the batch is anchored in\n"
+            "a single transaction once -jupiterpodbatch items are pending or the oldest one has waited\n"
+            "-jupiterpodwindow seconds, use jupiterpodflush to anchor it earlier.");
+
+    vector<string> vItems;
+    if (params[0].type() == str_type)
+        vItems.push_back(params[0].get_str());
+    else
+    {
+        const Array& items = params[0].get_array();
+        for (unsigned int i = 0; i < items.size(); i++)
+            vItems.push_back(items[i].get_str());
+    }
+
+    // Files are hashed before taking cs_main
+    Array added;
+    bool fAnchor = false;
+    unsigned int nPending = 0;
+    for (unsigned int i = 0; i < vItems.size(); i++)
+    {
+        std::string strItem;
+        if (!GetJupiterPodItem(vItems[i], strItem))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot read " + vItems[i]);
+        fAnchor |= AddJupiterPodItem(strItem, nPending);
+        added.push_back(strItem);
+    }
+
+    Object obj;
+    obj.push_back(Pair("added",              added));
+    if (fAnchor)
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        CWalletTx wtx;
+        uint256 hashRoot;
+        unsigned int nItems;
+        std::string strError;
+        if (AnchorJupiterPodBatch(wtx, hashRoot, nItems, strError))
+        {
+            obj.push_back(Pair("anchored",           JupiterPodBatchToJSON(wtx, hashRoot, nItems)));
+            nPending = 0;
+        }
+        else
+            obj.push_back(Pair("error",              strError));
+    }
+    obj.push_back(Pair("pending",            (int)nPending));
+    return obj;
+}
+
+Value jupiterpodflush(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "jupiterpodflush\n"
+            "Anchors the Merkle root of the pending Jupiter POD batch now, paying a single 0.001 D POD.");
+
+    if (pwalletMain->GetBalance() < 0.001 * COIN)
+        throw JSONRPCError(RPC_WALLET_INSUFFICIENT_FUNDS, "Error, You need at least 0.001 D to send Jupiter POD!");
+
+    CWalletTx wtx;
+    uint256 hashRoot;
+    unsigned int nItems;
+    std::string strError;
+    if (!AnchorJupiterPodBatch(wtx, hashRoot, nItems, strError))
+        throw JSONRPCError(RPC_WALLET_ERROR, strError);
+
+    return JupiterPodBatchToJSON(wtx, hashRoot, nItems);
+}
+
+Value jupiterpodverify(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "jupiterpodverify\n"
+            "\nArguments:\n"
+            "1. \"cid or file\"          (string, required) The IPFS CID or local file to verify\n"
+            "Checks the Merkle proof of an item anchored by a Jupiter POD batch against the chain.");
+
+    std::string strItem;
+    if (!GetJupiterPodItem(params[0].get_str(), strItem))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot read " + params[0].get_str());
+
+    CJupiterProof proof;
+    bool fValid;
+    int nConfirmations;
+    std::string strError;
+    if (!VerifyJupiterPodItem(strItem, proof, fValid, nConfirmations, strError))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No Jupiter POD proof for " + strItem);
+
+    Array branch;
+    BOOST_FOREACH(const uint256& hash, proof.vMerkleBranch)
+        branch.push_back(hash.GetHex());
+
+    Object obj;
+    obj.push_back(Pair("item",               strItem));
+    obj.push_back(Pair("valid",              fValid));
+    obj.push_back(Pair("merkleroot",         proof.hashRoot.GetHex()));
+    obj.push_back(Pair("podtxid",            proof.txid.GetHex()));
+    obj.push_back(Pair("index",              proof.nIndex));
+    obj.push_back(Pair("branch",             branch));
+    obj.push_back(Pair("confirmations",      nConfirmations));
+    obj.push_back(Pair("time",               (boost::int64_t)proof.nTime));
+    if (!strError.empty())
+        obj.push_back(Pair("error",              strError));
+    return obj;
+}
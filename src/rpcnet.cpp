@@ -9,6 +9,8 @@
 #include "db.h"
 #include "walletdb.h"
 #include "ui_interface.h"
+#include "ddns.h"
+#include "logging.h"
 
 using namespace json_spirit;
 using namespace std;
@@ -55,6 +57,33 @@ Value ping(const Array& params, bool fHelp)
     return Value::null;
 }
 
+static Object MsgBytesToJSON(const mapMsgStats_t& mapStats)
+{
+    Object obj;
+    for (mapMsgStats_t::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it)
+        obj.push_back(Pair(it->first, it->second.nBytes));
+    return obj;
+}
+
+static Object MsgStatsToJSON(const mapMsgStats_t& mapStats, bool fTime)
+{
+    Object obj;
+    for (mapMsgStats_t::const_iterator it = mapStats.begin(); it != mapStats.end(); ++it)
+    {
+        const CMessageStats& stats = it->second;
+        Object msg;
+        msg.push_back(Pair("count", stats.nCount));
+        msg.push_back(Pair("bytes", stats.nBytes));
+        if (fTime)
+        {
+            msg.push_back(Pair("time_ms", stats.nTimeMicros / 1000));
+            msg.push_back(Pair("avg_us", stats.nCount ? stats.nTimeMicros / (int64_t)stats.nCount : (int64_t)0));
+        }
+        obj.push_back(Pair(it->first, msg));
+    }
+    return obj;
+}
+
 Value getpeerinfo(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -87,6 +116,8 @@ Value getpeerinfo(const Array& params, bool fHelp)
         obj.push_back(Pair("inbound", stats.fInbound));
         obj.push_back(Pair("chainheight", stats.nChainHeight));
         obj.push_back(Pair("banscore", stats.nMisbehavior));
+        obj.push_back(Pair("bytessend_per_msg", MsgBytesToJSON(stats.mapSendMsgStats)));
+        obj.push_back(Pair("bytesrecv_per_msg", MsgBytesToJSON(stats.mapRecvMsgStats)));
 
         ret.push_back(obj);
     }
@@ -360,6 +391,11 @@ Value getnettotals(const Array& params, bool fHelp)
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
 
+    mapMsgStats_t mapRecv, mapSend;
+    CNode::GetTotalMsgStats(mapRecv, mapSend);
+    obj.push_back(Pair("totalbytesrecv_per_msg", MsgBytesToJSON(mapRecv)));
+    obj.push_back(Pair("totalbytessent_per_msg", MsgBytesToJSON(mapSend)));
+
     Object outboundLimit;
     outboundLimit.push_back(Pair("timeframe", CNode::GetMaxOutboundTimeframe()));
     outboundLimit.push_back(Pair("target", CNode::GetMaxOutboundTarget()));
@@ -372,6 +408,74 @@ Value getnettotals(const Array& params, bool fHelp)
     return obj;
 }
 
+Value getnetmsgstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getnetmsgstats ( \"node\" )\n"
+            "Returns per message command the messages and bytes received and sent, headers included,\n"
+            "and the time spent handling the received ones. Totals since startup, or for the\n"
+            "connected <node> (see getpeerinfo for nodes).");
+
+    mapMsgStats_t mapRecv, mapSend;
+    if (params.size() > 0)
+    {
+        vector<CNodeStats> vstats;
+        CopyNodeStats(vstats);
+        bool fFound = false;
+        for (const CNodeStats& stats : vstats)
+        {
+            if (stats.addrName == params[0].get_str())
+            {
+                mapRecv = stats.mapRecvMsgStats;
+                mapSend = stats.mapSendMsgStats;
+                fFound = true;
+                break;
+            }
+        }
+        if (!fFound)
+            throw JSONRPCError(RPC_CLIENT_NOT_CONNECTED, "Error: Node is not connected.");
+    }
+    else
+        CNode::GetTotalMsgStats(mapRecv, mapSend);
+
+    Object obj;
+    obj.push_back(Pair("recv", MsgStatsToJSON(mapRecv, true)));
+    obj.push_back(Pair("sent", MsgStatsToJSON(mapSend, false)));
+    return obj;
+}
+
+Value getddnsstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+                "getddnsstats\n"
+                "Returns counters of the Denarius DNS server: queries, answer cache\n"
+                "and latency histogram in microseconds.");
+
+    DDnsStats stats;
+    DDnsGetStats(stats);
+
+    Object obj;
+    obj.push_back(Pair("threads", (int)stats.threads));
+    obj.push_back(Pair("queries", stats.queries));
+    obj.push_back(Pair("dropped", stats.dropped));
+    obj.push_back(Pair("errors", stats.errors));
+    obj.push_back(Pair("cache_hits", stats.cache_hits));
+    obj.push_back(Pair("cache_misses", stats.cache_misses));
+    obj.push_back(Pair("cache_size", stats.cache_size));
+    obj.push_back(Pair("latency_avg_us", stats.queries ? stats.latency_us / stats.queries : (uint64_t)0));
+    obj.push_back(Pair("latency_max_us", stats.latency_max_us));
+
+    static const char* pszBuckets[] = { "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+    Object hist;
+    for (int i = 0; i < 5; i++)
+        hist.push_back(Pair(pszBuckets[i], stats.latency_hist[i]));
+    obj.push_back(Pair("latency", hist));
+
+    return obj;
+}
+
 Value setdebug(const Array& params, bool fHelp)
 {
     string strType;
@@ -389,15 +493,140 @@ Value setdebug(const Array& params, bool fHelp)
 
 
     fDebug = strType == "all" && strOn == "on";
-    fDebugFS = (strType == "all" || strType == "fs") && strOn == "on";
-    fDebugChain = (strType == "all" || strType == "chain") && strOn == "on";
-    fDebugNet = (strType == "all" || strType == "net") && strOn == "on";
-    fDebugRingSig = (strType == "all" || strType == "ringsig") && strOn == "on";
-    fDebugSmsg = (strType == "all" || strType == "smsg") && strOn == "on";
+    uint32_t nCategory = LOG_NONE;
+    GetLogCategory(strType, nCategory);
+    SetLogCategories(strOn == "on" ? nCategory : LOG_NONE);
 
     return Value::null;
 }
 
+Value logging(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2)
+        throw runtime_error(
+            "logging ( [\"include\",...] [\"exclude\",...] )\n"
+            "Turns debug log categories on and off and returns the categories and log buffer statistics.\n"
+            "Categories: net, smsg, chain, fs, ringsig, bench, 'all' for every category.");
+
+    uint32_t nCategories = nLogCategories.load();
+    for (unsigned int i = 0; i < params.size(); i++)
+    {
+        BOOST_FOREACH(const Value& value, params[i].get_array())
+        {
+            uint32_t nCategory;
+            if (!GetLogCategory(value.get_str(), nCategory))
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown log category: " + value.get_str());
+            if (i == 0)
+                nCategories |= nCategory;
+            else
+                nCategories &= ~nCategory;
+        }
+    }
+    if (params.size() > 0)
+        SetLogCategories(nCategories);
+
+    Object categories;
+    std::vector<std::pair<std::string, bool> > vCategories = ListLogCategories();
+    for (unsigned int i = 0; i < vCategories.size(); i++)
+        categories.push_back(Pair(vCategories[i].first, vCategories[i].second));
+
+    CLogStats stats;
+    GetLogStats(stats);
+    Object statsObj;
+    statsObj.push_back(Pair("async", stats.fAsync));
+    statsObj.push_back(Pair("capacity", (int)stats.nCapacity));
+    statsObj.push_back(Pair("queued", (uint64_t)stats.nQueued));
+    statsObj.push_back(Pair("written", (uint64_t)stats.nWritten));
+    statsObj.push_back(Pair("dropped", (uint64_t)stats.nDropped));
+    statsObj.push_back(Pair("bytes", (uint64_t)stats.nBytes));
+    statsObj.push_back(Pair("writes", (uint64_t)stats.nWrites));
+
+    Object obj;
+    obj.push_back(Pair("categories", categories));
+    obj.push_back(Pair("stats", statsObj));
+    return obj;
+}
+
+static bool CompareLockWait(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nWait > b.nWait;
+}
+
+static Object LockStatsToJSON(const CLockSiteStats& stats)
+{
+    static const char* pszBuckets[LOCK_STATS_BUCKETS] = { "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+
+    Object obj;
+    obj.push_back(Pair("acquired", (uint64_t)stats.nAcquired));
+    obj.push_back(Pair("contended", (uint64_t)stats.nContended));
+    obj.push_back(Pair("try_failed", (uint64_t)stats.nTryFailed));
+    obj.push_back(Pair("wait_us", (uint64_t)stats.nWait));
+    obj.push_back(Pair("wait_max_us", (uint64_t)stats.nWaitMax));
+    obj.push_back(Pair("hold_sampled", (uint64_t)stats.nHoldSampled));
+    obj.push_back(Pair("hold_avg_us", stats.nHoldSampled ? stats.nHold / stats.nHoldSampled : (uint64_t)0));
+    obj.push_back(Pair("hold_max_us", (uint64_t)stats.nHoldMax));
+    Object waitHist, holdHist;
+    for (unsigned int i = 0; i < LOCK_STATS_BUCKETS; i++)
+    {
+        waitHist.push_back(Pair(pszBuckets[i], (uint64_t)stats.vWaitHist[i]));
+        holdHist.push_back(Pair(pszBuckets[i], (uint64_t)stats.vHoldHist[i]));
+    }
+    obj.push_back(Pair("wait_hist", waitHist));
+    obj.push_back(Pair("hold_hist", holdHist));
+    return obj;
+}
+
+Value getlockstats(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 2 ||
+        (params.size() > 0 && params[0].get_str() != "on" && params[0].get_str() != "off" &&
+         params[0].get_str() != "reset" && params[0].get_str() != ""))
+        throw runtime_error(
+            "getlockstats ( \"on|off|reset\" ) ( sites )\n"
+            "Returns the lock profile: per lock, acquisitions, contended acquisitions, wait and hold\n"
+            "times with histograms, and the <sites> call sites that waited longest (default: 5).\n"
+            "Hold times are measured for contended locks and one in -lockstatssample others.\n"
+            "'on' and 'off' switch profiling, 'reset' clears the counters.");
+
+    string strAction = params.size() > 0 ? params[0].get_str() : "";
+    if (strAction == "on" || strAction == "off")
+        SetLockStats(strAction == "on", GetArg("-lockstatssample", 16));
+    else if (strAction == "reset")
+        ResetLockStats();
+    unsigned int nSites = params.size() > 1 ? std::max(0, params[1].get_int()) : 5;
+
+    vector<CLockSiteStats> vSites;
+    GetLockStats(vSites);
+    sort(vSites.begin(), vSites.end(), CompareLockWait);
+
+    map<string, CLockSiteStats> mapLocks;
+    map<string, Array> mapLockSites;
+    BOOST_FOREACH(const CLockSiteStats& site, vSites)
+    {
+        mapLocks[site.strLock].Add(site);
+        Array& sites = mapLockSites[site.strLock];
+        if (sites.size() < nSites)
+        {
+            Object obj = LockStatsToJSON(site);
+            obj.insert(obj.begin(), Pair("site", site.strSite));
+            sites.push_back(obj);
+        }
+    }
+
+    Object locks;
+    for (map<string, CLockSiteStats>::iterator it = mapLocks.begin(); it != mapLocks.end(); ++it)
+    {
+        Object obj = LockStatsToJSON(it->second);
+        obj.push_back(Pair("sites", mapLockSites[it->first]));
+        locks.push_back(Pair(it->first, obj));
+    }
+
+    Object obj;
+    obj.push_back(Pair("enabled", fLockStats.load()));
+    obj.push_back(Pair("locks", locks));
+    return obj;
+}
+
 // ppcoin: send alert.  
 // There is a known deadlock situation with ThreadMessageHandler
 // ThreadMessageHandler: holds cs_vSend and acquiring cs_main in SendMessages()
@@ -1707,7 +1707,7 @@ Value gettransaction(const Array& params, bool fHelp)
             else
             {
                 entry.push_back(Pair("blockhash", hashBlock.GetHex()));
-                map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hashBlock);
+                BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
                 if (mi != mapBlockIndex.end() && (*mi).second)
                 {
                     CBlockIndex* pindex = (*mi).second;
@@ -2407,81 +2407,34 @@ Value clearwallettransactions(const Array& params, bool fHelp)
 
         CWalletDB walletdb(pwalletMain->strWalletFile);
         walletdb.TxnBegin();
-        Dbc* pcursor = walletdb.GetTxnCursor();
+        CDBCursor* pcursor = walletdb.GetTxnCursor();
         if (!pcursor)
             throw runtime_error("Cannot get wallet DB cursor");
 
-        Dbt datKey;
-        Dbt datValue;
-
-        datKey.set_flags(DB_DBT_USERMEM);
-        datValue.set_flags(DB_DBT_USERMEM);
-
-        std::vector<unsigned char> vchKey;
-        std::vector<unsigned char> vchType;
-        std::vector<unsigned char> vchKeyData;
-        std::vector<unsigned char> vchValueData;
-
-        vchKeyData.resize(100);
-        vchValueData.resize(100);
-
-        datKey.set_ulen(vchKeyData.size());
-        datKey.set_data(&vchKeyData[0]);
-
-        datValue.set_ulen(vchValueData.size());
-        datValue.set_data(&vchValueData[0]);
-
-        unsigned int fFlags = DB_NEXT; // same as using DB_FIRST for new cursor
         while (true)
         {
-            int ret = pcursor->get(&datKey, &datValue, fFlags);
-
-            if (ret == ENOMEM
-                || ret == DB_BUFFER_SMALL)
-            {
-                if (datKey.get_size() > datKey.get_ulen())
-                {
-                    vchKeyData.resize(datKey.get_size());
-                    datKey.set_ulen(vchKeyData.size());
-                    datKey.set_data(&vchKeyData[0]);
-                };
-
-                if (datValue.get_size() > datValue.get_ulen())
-                {
-                    vchValueData.resize(datValue.get_size());
-                    datValue.set_ulen(vchValueData.size());
-                    datValue.set_data(&vchValueData[0]);
-                };
-                // -- try once more, when DB_BUFFER_SMALL cursor is not expected to move
-                ret = pcursor->get(&datKey, &datValue, fFlags);
-            };
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = walletdb.ReadAtCursor(pcursor, ssKey, ssValue, DB_NEXT);
 
             if (ret == DB_NOTFOUND)
                 break;
             else
-            if (datKey.get_data() == NULL || datValue.get_data() == NULL
-                || ret != 0)
+            if (ret != 0)
             {
                 snprintf(cbuf, sizeof(cbuf), "wallet DB error %d, %s", ret, db_strerror(ret));
                 throw runtime_error(cbuf);
             };
 
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            ssValue.SetType(SER_DISK);
-            ssValue.clear();
-            ssValue.write((char*)datKey.get_data(), datKey.get_size());
-
-            ssValue >> vchType;
-
-
-            std::string strType(vchType.begin(), vchType.end());
+            std::string strType;
+            ssKey >> strType;
 
             //printf("strType %s\n", strType.c_str());
 
             if (strType == "tx")
             {
                 uint256 hash;
-                ssValue >> hash;
+                ssKey >> hash;
 
                 if ((ret = pcursor->del(0)) != 0)
                 {
@@ -2552,6 +2505,34 @@ Value scanforalltxns(const Array& params, bool fHelp)
     return result;
 }
 
+Value getrescaninfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrescaninfo\n"
+            "Returns the progress of the running wallet rescan, or of the last one.");
+
+    CWalletScanProgress progress;
+    GetWalletScanProgress(progress);
+    int64_t nNow = GetTime();
+
+    Object result;
+    result.push_back(Pair("active",      progress.fActive));
+    result.push_back(Pair("threads",     (int)progress.nThreads));
+    result.push_back(Pair("startheight", progress.nStartHeight));
+    result.push_back(Pair("endheight",   progress.nEndHeight));
+    result.push_back(Pair("height",      progress.nHeight));
+    result.push_back(Pair("blocks",      (int)progress.nBlocks));
+    result.push_back(Pair("blocksdone",  (int)progress.nBlocksDone));
+    result.push_back(Pair("blocksskipped", (int)progress.nBlocksSkipped));
+    result.push_back(Pair("progress",    progress.nBlocks ? 100.0 * progress.nBlocksDone / progress.nBlocks : 0.0));
+    result.push_back(Pair("candidates",  (int)progress.nCandidates));
+    result.push_back(Pair("found",       progress.nFound));
+    result.push_back(Pair("elapsed",     progress.nStartTime ? (progress.fActive ? nNow : progress.nEndTime) - progress.nStartTime : 0));
+    result.push_back(Pair("eta",         progress.GetETA(nNow)));
+    return result;
+}
+
 Value senddtoanon(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 5)
@@ -857,7 +857,9 @@ struct ser_streamplaceholder
 
 
 
-typedef std::vector<char, zero_after_free_allocator<char> > CSerializeData;
+/** Serialization buffers come from the thread caches of pool_allocator and
+ *  are not cleared when freed, streams holding keys are CSecureDataStream */
+typedef std::vector<char, pool_allocator<char> > CSerializeData;
 
 class CSizeComputer
 {
@@ -947,6 +949,11 @@ public:
         Init(nTypeIn, nVersionIn);
     }
 
+    CDataStream(int nTypeIn, int nVersionIn, const allocator_type& alloc) : vch(alloc)
+    {
+        Init(nTypeIn, nVersionIn);
+    }
+
     void Init(int nTypeIn, int nVersionIn)
     {
         nReadPos = 0;
@@ -1183,6 +1190,83 @@ public:
 };
 
 
+/** CDataStream for wallet records and other secrets, every buffer it frees,
+ *  including those left behind as it grows, is cleared first */
+class CSecureDataStream : public CDataStream
+{
+public:
+    CSecureDataStream(int nTypeIn, int nVersionIn) : CDataStream(nTypeIn, nVersionIn, allocator_type(true)) {}
+
+    CSecureDataStream(const char* pbegin, const char* pend, int nTypeIn, int nVersionIn) : CDataStream(nTypeIn, nVersionIn, allocator_type(true))
+    {
+        write(pbegin, pend - pbegin);
+    }
+};
+
+
+/** Read-only, non-owning stream over a contiguous range of bytes.
+ *
+ * Unserializes directly from memory owned by someone else (a memory mapped
+ * block file, a received network buffer) without first copying it into a
+ * CDataStream. The caller must keep the underlying memory alive for as long
+ * as the reader is in use.
+ */
+class CBufferReader
+{
+protected:
+    const char* pbegin;
+    const char* pcur;
+    const char* pend;
+public:
+    int nType;
+    int nVersion;
+
+    CBufferReader(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn) :
+        pbegin(pbeginIn), pcur(pbeginIn), pend(pendIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    const char* begin() const    { return pcur; }
+    const char* end() const      { return pend; }
+    size_t size() const          { return pend - pcur; }
+    bool empty() const           { return pcur == pend; }
+    bool eof() const             { return pcur == pend; }
+    size_t GetPos() const        { return pcur - pbegin; }
+
+    void SetType(int n)          { nType = n; }
+    int GetType()                { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion()             { return nVersion; }
+
+    CBufferReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+        {
+            memset(pch, 0, nSize);
+            throw std::ios_base::failure("CBufferReader::read() : end of data");
+        }
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return (*this);
+    }
+
+    CBufferReader& ignore(int nSize)
+    {
+        assert(nSize >= 0);
+        if ((size_t)nSize > size())
+            throw std::ios_base::failure("CBufferReader::ignore() : end of data");
+        pcur += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CBufferReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+
 
 
 
@@ -378,7 +378,7 @@ bool SecMsgDB::ReadPK(CKeyID& addr, CPubKey& pubkey)
     };
 
     try {
-        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        CBufferReader ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
         ssValue >> pubkey;
     } catch (std::exception& e) {
         printf("SecMsgDB::ReadPK() unserialize threw: %s.\n", e.what());
@@ -464,7 +464,7 @@ bool SecMsgDB::NextSmesg(leveldb::Iterator* it, std::string& prefix, unsigned ch
     memcpy(chKey, it->key().data(), 18);
 
     try {
-        CDataStream ssValue(it->value().data(), it->value().data() + it->value().size(), SER_DISK, CLIENT_VERSION);
+        CBufferReader ssValue(it->value().data(), it->value().data() + it->value().size(), SER_DISK, CLIENT_VERSION);
         ssValue >> smsgStored;
     } catch (std::exception& e) {
         printf("SecMsgDB::NextSmesg() unserialize threw: %s.\n", e.what());
@@ -526,7 +526,7 @@ bool SecMsgDB::ReadSmesg(unsigned char* chKey, SecMsgStored& smsgStored)
     };
 
     try {
-        CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        CBufferReader ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
         ssValue >> smsgStored;
     } catch (std::exception& e) {
         printf("SecMsgDB::ReadSmesg() unserialize threw: %s.\n", e.what());
@@ -2133,7 +2133,7 @@ bool ScanChainForPublicKeys(CBlockIndex* pindexStart)
             ScanBlock(block, txdb, addrpkdb,
                       nTransactions, nInputs, nPubkeys, nDuplicates);
 
-            pindex = pindex->pnext;
+            pindex = chainActive.Next(pindex);
         };
 
         addrpkdb.TxnCommit();
@@ -23,6 +23,7 @@ enum
 {
     NODE_NETWORK        = (1 << 0),
     SMSG_RELAY          = (1 << 4),
+    NODE_COMPACT_FILTERS = (1 << 6),    // serves BIP158 basic filters with getcfilters
 };
 
 extern int nBloomFilterElements;
@@ -8,6 +8,276 @@
 
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+std::atomic<bool> fLockStats(false);
+
+static const unsigned int LOCK_SITES = 4096;    // power of two
+
+class CLockSite
+{
+public:
+    const char* pszName;
+    const char* pszFile;
+    int nLine;
+    std::atomic<uint64_t> nAcquired;
+    std::atomic<uint64_t> nContended;
+    std::atomic<uint64_t> nTryFailed;
+    std::atomic<uint64_t> nWait;
+    std::atomic<uint64_t> nWaitMax;
+    std::atomic<uint64_t> nHoldSampled;
+    std::atomic<uint64_t> nHold;
+    std::atomic<uint64_t> nHoldMax;
+    std::atomic<uint64_t> vWaitHist[LOCK_STATS_BUCKETS];
+    std::atomic<uint64_t> vHoldHist[LOCK_STATS_BUCKETS];
+
+    CLockSite(const char* pszNameIn, const char* pszFileIn, int nLineIn) : pszName(pszNameIn), pszFile(pszFileIn), nLine(nLineIn)
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        nAcquired = 0;
+        nContended = 0;
+        nTryFailed = 0;
+        nWait = 0;
+        nWaitMax = 0;
+        nHoldSampled = 0;
+        nHold = 0;
+        nHoldMax = 0;
+        for (unsigned int i = 0; i < LOCK_STATS_BUCKETS; i++)
+        {
+            vWaitHist[i] = 0;
+            vHoldHist[i] = 0;
+        }
+    }
+};
+
+// Sites are only ever added, lookups read the table without a lock
+static std::atomic<CLockSite*> vLockSites[LOCK_SITES];
+static boost::mutex cs_lockSites;
+static std::atomic<unsigned int> nLockSampleRate(16);
+
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine)
+{
+    // LOCK2 puts two locks on one line, the name tells them apart
+    size_t nHash = (((size_t)pszFile >> 3) * 0x9E3779B1u) ^ (((size_t)pszName >> 3) * 0x85EBCA6Bu) ^ (size_t)nLine;
+    for (unsigned int i = 0; i < LOCK_SITES; i++)
+    {
+        std::atomic<CLockSite*>& slot = vLockSites[(nHash + i) & (LOCK_SITES - 1)];
+        CLockSite* psite = slot.load(std::memory_order_acquire);
+        if (psite == NULL)
+        {
+            boost::unique_lock<boost::mutex> lock(cs_lockSites);
+            psite = slot.load(std::memory_order_acquire);
+            if (psite == NULL)
+            {
+                psite = new CLockSite(pszName, pszFile, nLine);
+                slot.store(psite, std::memory_order_release);
+                return psite;
+            }
+        }
+        if (psite->pszFile == pszFile && psite->nLine == nLine && psite->pszName == pszName)
+            return psite;
+    }
+    return NULL;    // table full, the site is not profiled
+}
+
+int64_t LockStatsTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool LockStatsSample()
+{
+    static thread_local unsigned int nCount = 0;
+    return ++nCount % nLockSampleRate.load(std::memory_order_relaxed) == 0;
+}
+
+static unsigned int LockStatsBucket(int64_t nMicros)
+{
+    unsigned int n = 0;
+    for (int64_t nLimit = 10; n < LOCK_STATS_BUCKETS - 1 && nMicros >= nLimit; nLimit *= 10)
+        n++;
+    return n;
+}
+
+static void UpdateMax(std::atomic<uint64_t>& nMax, uint64_t n)
+{
+    uint64_t nPrev = nMax.load(std::memory_order_relaxed);
+    while (n > nPrev && !nMax.compare_exchange_weak(nPrev, n, std::memory_order_relaxed))
+        ;
+}
+
+void LockStatsAcquired(CLockSite* psite, bool fContended, int64_t nWait)
+{
+    psite->nAcquired.fetch_add(1, std::memory_order_relaxed);
+    if (!fContended)
+        return;
+    psite->nContended.fetch_add(1, std::memory_order_relaxed);
+    psite->nWait.fetch_add(nWait, std::memory_order_relaxed);
+    psite->vWaitHist[LockStatsBucket(nWait)].fetch_add(1, std::memory_order_relaxed);
+    UpdateMax(psite->nWaitMax, nWait);
+}
+
+void LockStatsTryFailed(CLockSite* psite)
+{
+    psite->nTryFailed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockStatsReleased(CLockSite* psite, int64_t nHold)
+{
+    psite->nHoldSampled.fetch_add(1, std::memory_order_relaxed);
+    psite->nHold.fetch_add(nHold, std::memory_order_relaxed);
+    psite->vHoldHist[LockStatsBucket(nHold)].fetch_add(1, std::memory_order_relaxed);
+    UpdateMax(psite->nHoldMax, nHold);
+}
+
+CLockSiteStats::CLockSiteStats() : nAcquired(0), nContended(0), nTryFailed(0), nWait(0), nWaitMax(0),
+    nHoldSampled(0), nHold(0), nHoldMax(0)
+{
+    for (unsigned int i = 0; i < LOCK_STATS_BUCKETS; i++)
+    {
+        vWaitHist[i] = 0;
+        vHoldHist[i] = 0;
+    }
+}
+
+void CLockSiteStats::Add(const CLockSiteStats& other)
+{
+    nAcquired += other.nAcquired;
+    nContended += other.nContended;
+    nTryFailed += other.nTryFailed;
+    nWait += other.nWait;
+    nWaitMax = std::max(nWaitMax, other.nWaitMax);
+    nHoldSampled += other.nHoldSampled;
+    nHold += other.nHold;
+    nHoldMax = std::max(nHoldMax, other.nHoldMax);
+    for (unsigned int i = 0; i < LOCK_STATS_BUCKETS; i++)
+    {
+        vWaitHist[i] += other.vWaitHist[i];
+        vHoldHist[i] += other.vHoldHist[i];
+    }
+}
+
+void SetLockStats(bool fEnable, unsigned int nSampleRate)
+{
+    nLockSampleRate.store(std::max(1U, nSampleRate), std::memory_order_relaxed);
+    fLockStats.store(fEnable, std::memory_order_relaxed);
+}
+
+// "pwallet->cs_wallet" and "pnode->cs_vSend" count with every other holder of the same lock
+static std::string LockName(const char* pszName)
+{
+    std::string str(pszName);
+    size_t nPos = str.find_last_of(">.");
+    if (nPos != std::string::npos)
+        str.erase(0, nPos + 1);
+    return str;
+}
+
+void GetLockStats(std::vector<CLockSiteStats>& vStats)
+{
+    vStats.clear();
+    for (unsigned int i = 0; i < LOCK_SITES; i++)
+    {
+        CLockSite* psite = vLockSites[i].load(std::memory_order_acquire);
+        if (psite == NULL || psite->nAcquired.load(std::memory_order_relaxed) + psite->nTryFailed.load(std::memory_order_relaxed) == 0)
+            continue;
+
+        CLockSiteStats stats;
+        stats.strLock = LockName(psite->pszName);
+        const char* pszBase = strrchr(psite->pszFile, '/');
+        stats.strSite = strprintf("%s:%d", pszBase ? pszBase + 1 : psite->pszFile, psite->nLine);
+        stats.nAcquired = psite->nAcquired.load(std::memory_order_relaxed);
+        stats.nContended = psite->nContended.load(std::memory_order_relaxed);
+        stats.nTryFailed = psite->nTryFailed.load(std::memory_order_relaxed);
+        stats.nWait = psite->nWait.load(std::memory_order_relaxed);
+        stats.nWaitMax = psite->nWaitMax.load(std::memory_order_relaxed);
+        stats.nHoldSampled = psite->nHoldSampled.load(std::memory_order_relaxed);
+        stats.nHold = psite->nHold.load(std::memory_order_relaxed);
+        stats.nHoldMax = psite->nHoldMax.load(std::memory_order_relaxed);
+        for (unsigned int j = 0; j < LOCK_STATS_BUCKETS; j++)
+        {
+            stats.vWaitHist[j] = psite->vWaitHist[j].load(std::memory_order_relaxed);
+            stats.vHoldHist[j] = psite->vHoldHist[j].load(std::memory_order_relaxed);
+        }
+        vStats.push_back(stats);
+    }
+}
+
+void ResetLockStats()
+{
+    for (unsigned int i = 0; i < LOCK_SITES; i++)
+    {
+        CLockSite* psite = vLockSites[i].load(std::memory_order_acquire);
+        if (psite)
+            psite->Reset();
+    }
+}
+
+static bool CompareLockWait(const CLockSiteStats& a, const CLockSiteStats& b)
+{
+    return a.nWait > b.nWait;
+}
+
+static void PrintLockStats()
+{
+    std::vector<CLockSiteStats> vSites;
+    GetLockStats(vSites);
+
+    std::map<std::string, CLockSiteStats> mapLocks;
+    BOOST_FOREACH(const CLockSiteStats& site, vSites)
+    {
+        CLockSiteStats& lock = mapLocks[site.strLock];
+        lock.strLock = site.strLock;
+        lock.Add(site);
+    }
+    std::vector<CLockSiteStats> vLocks;
+    for (std::map<std::string, CLockSiteStats>::iterator it = mapLocks.begin(); it != mapLocks.end(); ++it)
+        vLocks.push_back(it->second);
+
+    std::sort(vLocks.begin(), vLocks.end(), CompareLockWait);
+    std::sort(vSites.begin(), vSites.end(), CompareLockWait);
+
+    for (unsigned int i = 0; i < vLocks.size() && i < 5; i++)
+    {
+        const CLockSiteStats& lock = vLocks[i];
+        printf("lockstats: %s acquired %" PRIu64", contended %" PRIu64", waited %" PRIu64"ms (max %" PRIu64"us), held avg %" PRIu64"us (max %" PRIu64"us)\n",
+            lock.strLock.c_str(), lock.nAcquired, lock.nContended, lock.nWait / 1000, lock.nWaitMax,
+            lock.nHoldSampled ? lock.nHold / lock.nHoldSampled : 0, lock.nHoldMax);
+    }
+    for (unsigned int i = 0; i < vSites.size() && i < 5 && vSites[i].nWait > 0; i++)
+    {
+        const CLockSiteStats& site = vSites[i];
+        printf("lockstats: %s at %s waited %" PRIu64"ms in %" PRIu64" contended acquisitions\n",
+            site.strLock.c_str(), site.strSite.c_str(), site.nWait / 1000, site.nContended);
+    }
+}
+
+void ThreadLockStats(void* parg)
+{
+    RenameThread("denarius-lockstats");
+
+    int64_t nInterval = GetArg("-lockstatsinterval", 600);
+    if (nInterval <= 0)
+        return;
+
+    int64_t nLastPrint = GetTime();
+    while (!fShutdown)
+    {
+        MilliSleep(1000);
+        if (GetTime() - nLastPrint < nInterval)
+            continue;
+        nLastPrint = GetTime();
+        if (fLockStats.load(std::memory_order_relaxed))
+            PrintLockStats();
+    }
+}
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 {
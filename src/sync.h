@@ -13,6 +13,12 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include <atomic>
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 
 ////////////////////////////////////////////////
 //                                            //
@@ -100,16 +106,82 @@ void static inline AssertLockHeldInternal(const char* pszName, const char* pszFi
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Lock profiling per LOCK() call site, switched on by -lockstats or the
+ *  getlockstats RPC. While off, taking a lock costs one more relaxed load. */
+extern std::atomic<bool> fLockStats;
+
+static const unsigned int LOCK_STATS_BUCKETS = 6;    // <10us <100us <1ms <10ms <100ms >=100ms
+
+class CLockSite;
+CLockSite* GetLockSite(const char* pszName, const char* pszFile, int nLine);
+/** Microseconds of a monotonic clock */
+int64_t LockStatsTime();
+/** True for one in -lockstatssample uncontended locks, whose hold time is then measured */
+bool LockStatsSample();
+void LockStatsAcquired(CLockSite* psite, bool fContended, int64_t nWait);
+void LockStatsTryFailed(CLockSite* psite);
+void LockStatsReleased(CLockSite* psite, int64_t nHold);
+
+class CLockSiteStats
+{
+public:
+    std::string strLock;    // lock name, "pwallet->cs_wallet" is counted as cs_wallet
+    std::string strSite;    // file:line of the LOCK
+    uint64_t nAcquired;
+    uint64_t nContended;    // acquisitions that had to wait
+    uint64_t nTryFailed;    // TRY_LOCKs that did not get the lock
+    uint64_t nWait;         // microseconds waited, summed
+    uint64_t nWaitMax;
+    uint64_t nHoldSampled;  // acquisitions whose hold time was measured
+    uint64_t nHold;         // microseconds held by those, summed
+    uint64_t nHoldMax;
+    uint64_t vWaitHist[LOCK_STATS_BUCKETS];
+    uint64_t vHoldHist[LOCK_STATS_BUCKETS];
+
+    CLockSiteStats();
+    void Add(const CLockSiteStats& other);
+};
+
+void SetLockStats(bool fEnable, unsigned int nSampleRate);
+void GetLockStats(std::vector<CLockSiteStats>& vStats);
+void ResetLockStats();
+/** Writes the most waited for locks and call sites to debug.log every -lockstatsinterval seconds */
+void ThreadLockStats(void* parg);
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template<typename Mutex>
 class CMutexLock
 {
 private:
     boost::unique_lock<Mutex> lock;
+    CLockSite* psite;   // set while profiled
+    int64_t nLockTime;  // when the lock was taken, 0 when the hold time is not measured
+
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+    {
+        if (lock.try_lock())
+        {
+            nLockTime = LockStatsSample() ? LockStatsTime() : 0;
+            LockStatsAcquired(psite, false, 0);
+            return;
+        }
+#ifdef DEBUG_LOCKCONTENTION
+        PrintLockContention(pszName, pszFile, nLine);
+#endif
+        int64_t nStart = LockStatsTime();
+        lock.lock();
+        nLockTime = LockStatsTime();
+        LockStatsAcquired(psite, true, nLockTime - nStart);
+    }
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (fLockStats.load(std::memory_order_relaxed) && (psite = GetLockSite(pszName, pszFile, nLine)) != NULL)
+        {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock())
         {
@@ -125,13 +197,23 @@ private:
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()), true);
         lock.try_lock();
+        if (fLockStats.load(std::memory_order_relaxed) && (psite = GetLockSite(pszName, pszFile, nLine)) != NULL)
+        {
+            if (lock.owns_lock())
+            {
+                nLockTime = LockStatsSample() ? LockStatsTime() : 0;
+                LockStatsAcquired(psite, false, 0);
+            }
+            else
+                LockStatsTryFailed(psite);
+        }
         if (!lock.owns_lock())
             LeaveCritical();
         return lock.owns_lock();
     }
 
 public:
-    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock)
+    CMutexLock(Mutex& mutexIn, const char* pszName, const char* pszFile, int nLine, bool fTry = false) : lock(mutexIn, boost::defer_lock), psite(NULL), nLockTime(0)
     {
         if (fTry)
             TryEnter(pszName, pszFile, nLine);
@@ -142,7 +224,11 @@ public:
     ~CMutexLock()
     {
         if (lock.owns_lock())
+        {
+            if (nLockTime)
+                LockStatsReleased(psite, LockStatsTime() - nLockTime);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -257,5 +343,74 @@ public:
         return fHaveGrant;
     }
 };
+
+/** Blocking FIFO with a fixed capacity for handing work between threads.
+ *
+ * Push waits while the queue is full, Pop waits while it is empty. After
+ * Close() no more items are accepted and Pop returns false once the queue
+ * has been drained, which lets consumer threads exit cleanly.
+ */
+template<typename T>
+class CBoundedQueue
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable condNotEmpty;
+    boost::condition_variable condNotFull;
+    std::deque<T> queue;
+    size_t nMaxSize;
+    bool fClosed;
+
+public:
+    explicit CBoundedQueue(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn), fClosed(false) {}
+
+    bool Push(const T& item) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fClosed && queue.size() >= nMaxSize)
+            condNotFull.wait(lock);
+        if (fClosed)
+            return false;
+        queue.push_back(item);
+        condNotEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fClosed && queue.empty())
+            condNotEmpty.wait(lock);
+        if (queue.empty())
+            return false;
+        item = queue.front();
+        queue.pop_front();
+        condNotFull.notify_one();
+        return true;
+    }
+
+    void Close() {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fClosed = true;
+        }
+        condNotEmpty.notify_all();
+        condNotFull.notify_all();
+    }
+
+    /** Close and throw away whatever is still queued */
+    void Abort() {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fClosed = true;
+            queue.clear();
+        }
+        condNotEmpty.notify_all();
+        condNotFull.notify_all();
+    }
+
+    size_t Size() {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return queue.size();
+    }
+};
 #endif
 
@@ -16,10 +16,10 @@
 #include <stdint.h>
 
 // Tests this internal-to-main.cpp method:
-extern bool AddOrphanTx(const CDataStream& vMsg);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
-extern std::map<uint256, CDataStream*> mapOrphanTransactions;
-extern std::map<uint256, std::map<uint256, CDataStream*> > mapOrphanTransactionsByPrev;
+extern bool AddOrphanTx(const CTransaction& tx, NodeId peer);
+extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, uint64_t nMaxBytes);
+extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
 
 CService ip(uint32_t i)
 {
@@ -134,14 +134,11 @@ BOOST_AUTO_TEST_CASE(DoS_checknbits)
 
 CTransaction RandomOrphan()
 {
-    std::map<uint256, CDataStream*>::iterator it;
+    std::map<uint256, COrphanTx>::iterator it;
     it = mapOrphanTransactions.lower_bound(GetRandHash());
     if (it == mapOrphanTransactions.end())
         it = mapOrphanTransactions.begin();
-    const CDataStream* pvMsg = it->second;
-    CTransaction tx;
-    CDataStream(*pvMsg) >> tx;
-    return tx;
+    return it->second.tx;
 }
 
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
@@ -163,9 +160,7 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
 
-        CDataStream ds(SER_DISK, CLIENT_VERSION);
-        ds << tx;
-        AddOrphanTx(ds);
+        AddOrphanTx(tx, i);
     }
 
     // ... and 50 that depend on other orphans:
@@ -182,9 +177,7 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
         SignSignature(keystore, txPrev, tx, 0);
 
-        CDataStream ds(SER_DISK, CLIENT_VERSION);
-        ds << tx;
-        AddOrphanTx(ds);
+        AddOrphanTx(tx, i);
     }
 
     // This really-big orphan should be ignored:
@@ -208,21 +201,56 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         for (unsigned int j = 1; j < tx.vin.size(); j++)
             tx.vin[j].scriptSig = tx.vin[0].scriptSig;
 
-        CDataStream ds(SER_DISK, CLIENT_VERSION);
-        ds << tx;
-        BOOST_CHECK(!AddOrphanTx(ds));
+        BOOST_CHECK(!AddOrphanTx(tx, i));
     }
 
     // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
+    LimitOrphanTxSize(40, 1000000);
     BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
+    LimitOrphanTxSize(10, 1000000);
     BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
+    unsigned int nBytes = 0;
+    BOOST_FOREACH(const PAIRTYPE(uint256, COrphanTx)& item, mapOrphanTransactions)
+        nBytes += item.second.nSize;
+    LimitOrphanTxSize(10, nBytes / 2);
+    unsigned int nBytesLeft = 0;
+    BOOST_FOREACH(const PAIRTYPE(uint256, COrphanTx)& item, mapOrphanTransactions)
+        nBytesLeft += item.second.nSize;
+    BOOST_CHECK(nBytesLeft <= nBytes / 2);
+    LimitOrphanTxSize(0, 1000000);
     BOOST_CHECK(mapOrphanTransactions.empty());
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
 }
 
+BOOST_AUTO_TEST_CASE(DoS_mapOrphansPeerShare)
+{
+    // A peer may hold at most half of the pool
+    mapArgs["-maxorphantxkb"] = "1";
+    unsigned int nAdded = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        CTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = 0;
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].scriptSig << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1*CENT;
+        if (AddOrphanTx(tx, 1))
+            nAdded++;
+    }
+    BOOST_CHECK(nAdded > 0 && nAdded < 20);
+
+    unsigned int nBytes = 0;
+    BOOST_FOREACH(const PAIRTYPE(uint256, COrphanTx)& item, mapOrphanTransactions)
+        nBytes += item.second.nSize;
+    BOOST_CHECK(nBytes <= 500);
+
+    mapArgs.erase("-maxorphantxkb");
+    LimitOrphanTxSize(0, 0);
+    BOOST_CHECK(mapOrphanTransactions.empty());
+}
+
 BOOST_AUTO_TEST_CASE(DoS_checkSig)
 {
     // Test signature caching code (see key.cpp Verify() methods)
@@ -246,9 +274,7 @@ BOOST_AUTO_TEST_CASE(DoS_checkSig)
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
 
-        CDataStream ds(SER_DISK, CLIENT_VERSION);
-        ds << tx;
-        AddOrphanTx(ds);
+        AddOrphanTx(tx, -1);
     }
 
     // Create a transaction that depends on orphans:
@@ -308,7 +334,7 @@ BOOST_AUTO_TEST_CASE(DoS_checkSig)
         BOOST_CHECK(VerifySignature(orphans[j], tx, j, true, SIGHASH_ALL));
     mapArgs.erase("-maxsigcachesize");
 
-    LimitOrphanTxSize(0);
+    LimitOrphanTxSize(0, 0);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -112,4 +112,93 @@ BOOST_AUTO_TEST_CASE(test_LockedPageManagerBase)
     BOOST_CHECK((last_unlock_len & (test_page_size-1)) == 0); // always unlock entire pages
 }
 
+BOOST_AUTO_TEST_CASE(pool_allocator_reuse)
+{
+    CPoolAllocatorStats before, after;
+    GetPoolAllocatorStats(before);
+
+    pool_allocator<char> plain;
+    char* p = plain.allocate(1000);
+    plain.deallocate(p, 1000);
+    char* q = plain.allocate(900);     // same size class, taken from the thread cache
+    BOOST_CHECK(q == p);
+    plain.deallocate(q, 900);
+
+    GetPoolAllocatorStats(after);
+    BOOST_CHECK_EQUAL(after.nAllocs - before.nAllocs, 2U);
+    BOOST_CHECK_EQUAL(after.nPoolHits - before.nPoolHits, 1U);
+
+    // A secure buffer is cleared before it goes back to the cache
+    pool_allocator<char> secure(true);
+    char* s = secure.allocate(1000);
+    memset(s, 0x5a, 1000);
+    secure.deallocate(s, 1000);
+    char* t = plain.allocate(1000);
+    BOOST_CHECK(t == s);
+    BOOST_CHECK(t[0] == 0 && t[999] == 0);
+    plain.deallocate(t, 1000);
+
+    // Copies and swaps keep the policy with the buffer
+    CSecureDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::string("secret");
+    CDataStream ssCopy(ss);
+    BOOST_CHECK(ssCopy.begin() != ss.begin());
+    BOOST_CHECK(ssCopy.str() == ss.str());
+}
+
+// Heap allocations of the serialization patterns of the network, the
+// databases and hashing, once the thread cache is warm
+BOOST_AUTO_TEST_CASE(pool_allocator_stream_allocations)
+{
+    CTransaction tx;
+    tx.vin.resize(2);
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 1;
+    tx.vout[1].nValue = 2;
+    uint256 hash = tx.GetHash();
+
+    static const int nRounds = 1000;
+    const char* pszSubsystems[] = { "net", "db", "hash" };
+    for (int nSubsystem = 0; nSubsystem < 3; nSubsystem++)
+    {
+        CPoolAllocatorStats before, after;
+        for (int nPass = 0; nPass < 2; nPass++)
+        {
+            GetPoolAllocatorStats(before);
+            for (int i = 0; i < nRounds; i++)
+            {
+                if (nSubsystem == 0)
+                {
+                    // PushMessage: serialize, then hand the buffer to the send queue
+                    CDataStream ssSend(SER_NETWORK, PROTOCOL_VERSION);
+                    ssSend << tx;
+                    std::deque<CSerializeData> vSendMsg(1);
+                    ssSend.GetAndClear(vSendMsg.back());
+                    // readData: the received bytes, then the message is unserialized
+                    CDataStream vRecv(SER_NETWORK, PROTOCOL_VERSION);
+                    vRecv.write(&vSendMsg.back()[0], vSendMsg.back().size());
+                    CTransaction txRecv;
+                    vRecv >> txRecv;
+                }
+                else if (nSubsystem == 1)
+                {
+                    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+                    ssKey.reserve(1000);
+                    ssKey << std::make_pair(std::string("tx"), hash);
+                    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                    ssValue.reserve(10000);
+                    ssValue << tx;
+                }
+                else
+                    SerializeHash(tx);
+            }
+            GetPoolAllocatorStats(after);
+        }
+        uint64_t nHeap = (after.nAllocs - before.nAllocs) - (after.nPoolHits - before.nPoolHits);
+        BOOST_TEST_MESSAGE(strprintf("%s: %" PRIu64" buffers, %" PRIu64" from the heap in %d rounds",
+            pszSubsystems[nSubsystem], after.nAllocs - before.nAllocs, nHeap, nRounds));
+        BOOST_CHECK(nHeap == 0);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
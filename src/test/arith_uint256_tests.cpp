@@ -0,0 +1,204 @@
+#include <boost/test/unit_test.hpp>
+
+#include "arith_uint256.h"
+#include "bignum.h"
+#include "kernel.h"
+#include "main.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(arith_uint256_tests)
+
+static arith_uint256 RandArith(unsigned int nBits)
+{
+    arith_uint256 a = UintToArith256(GetRandHash());
+    return nBits >= 256 ? a : a >> (256 - nBits);
+}
+
+static unsigned int RandCompact()
+{
+    // Mostly sane targets, sometimes negative or past 256 bits
+    unsigned int nSize = GetRandInt(36);
+    unsigned int nWord = GetRandInt(0x01000000);
+    return nSize << 24 | nWord;
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_compact)
+{
+    BOOST_CHECK(arith_uint256().SetCompact(0x1d00ffff) == arith_uint256(0xffff) << 208);
+    BOOST_CHECK(arith_uint256().SetCompact(0x01123456) == 0x12);
+    BOOST_CHECK(arith_uint256().SetCompact(0x05009234) == 0x92340000);
+    BOOST_CHECK_EQUAL(arith_uint256(0x80).GetCompact(), 0x02008000U);
+    BOOST_CHECK_EQUAL((~arith_uint256(0) >> 20).GetCompact(), 0x1e0fffffU);
+
+    bool fNegative, fOverflow;
+    arith_uint256().SetCompact(0x04923456, &fNegative, &fOverflow);
+    BOOST_CHECK(fNegative && !fOverflow);
+    arith_uint256().SetCompact(0xff123456, &fNegative, &fOverflow);
+    BOOST_CHECK(!fNegative && fOverflow);
+    arith_uint256().SetCompact(0x00800000, &fNegative, &fOverflow);
+    BOOST_CHECK(!fNegative && !fOverflow);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        unsigned int nCompact = RandCompact();
+        arith_uint256 a;
+        a.SetCompact(nCompact, &fNegative, &fOverflow);
+        if (fNegative || fOverflow)
+            continue;
+        CBigNum bn;
+        bn.SetCompact(nCompact);
+        BOOST_CHECK(ArithToUint256(a) == bn.getuint256());
+        BOOST_CHECK_EQUAL(a.GetCompact(), bn.GetCompact());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_matches_bignum)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        arith_uint256 a = RandArith(GetRandInt(257));
+        arith_uint256 b = RandArith(GetRandInt(129));
+        CBigNum bnA(ArithToUint256(a)), bnB(ArithToUint256(b));
+
+        BOOST_CHECK(ArithToUint256(a >> 7) == (bnA >> 7).getuint256());
+        if (a.bits() + b.bits() <= 256)
+            BOOST_CHECK(ArithToUint256(a * b) == (bnA * bnB).getuint256());
+        if (!!b)
+            BOOST_CHECK(ArithToUint256(a / b) == (bnA / bnB).getuint256());
+        BOOST_CHECK_EQUAL(a > b, bnA > bnB);
+        BOOST_CHECK(UintToArith256(ArithToUint256(a)) == a);
+    }
+    BOOST_CHECK_THROW(arith_uint256(1) / arith_uint256(0), uint_error);
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_block_trust)
+{
+    // (~t / (t + 1)) + 1 is 2**256 / (t + 1) without the 257th bit
+    for (int i = 0; i < 200; i++)
+    {
+        arith_uint256 bnTarget = RandArith(1 + GetRandInt(255));
+        if (!bnTarget)
+            continue;
+        CBigNum bnRef = (CBigNum(1) << 256) / (CBigNum(ArithToUint256(bnTarget)) + 1);
+        BOOST_CHECK(ArithToUint256((~bnTarget / (bnTarget + 1)) + 1) == bnRef.getuint256());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_stake_target)
+{
+    for (int i = 0; i < 2000; i++)
+    {
+        unsigned int nBits = RandCompact();
+        int64_t nValueIn = GetRandInt(1000000) * (int64_t)GetRandInt(1000000) * (GetRandInt(10) ? 1 : -1);
+        int64_t nTimeWeight = GetRandInt(60 * 24 * 60 * 60) - (GetRandInt(10) ? 0 : 24 * 60 * 60);
+        uint256 hashProofOfStake = ArithToUint256(RandArith(GetRandInt(257)));
+
+        CBigNum bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+        CBigNum bnCoinDayWeight = CBigNum(nValueIn) * nTimeWeight / COIN / (24 * 60 * 60);
+        bool fRef = !(CBigNum(hashProofOfStake) > bnCoinDayWeight * bnTargetPerCoinDay);
+
+        uint256 targetProofOfStake;
+        BOOST_CHECK_EQUAL(CheckStakeTarget(hashProofOfStake, nBits, nValueIn, nTimeWeight, targetProofOfStake), fRef);
+    }
+}
+
+// ComputeMaxBits as it was with CBigNum
+static unsigned int RefMaxBits(const arith_uint256& bnLimit, unsigned int nBase, int64_t nTime)
+{
+    CBigNum bnTargetLimit(ArithToUint256(bnLimit));
+    CBigNum bnResult;
+    bnResult.SetCompact(nBase);
+    bnResult *= 2;
+    while (nTime > 0 && bnResult < bnTargetLimit)
+    {
+        bnResult *= 2;
+        nTime -= 24 * 60 * 60;
+    }
+    if (bnResult > bnTargetLimit)
+        bnResult = bnTargetLimit;
+    return bnResult.GetCompact();
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_max_bits)
+{
+    unsigned int nLimit = bnProofOfWorkLimit.GetCompact();
+    std::vector<unsigned int> vBases;
+    // At, above and far above the limit, past 256 bits, and zero
+    vBases.push_back(nLimit);
+    vBases.push_back(nLimit + 1);
+    vBases.push_back(nLimit + 0x01000000);
+    vBases.push_back(0x207fffff);
+    vBases.push_back(0x22123456);
+    vBases.push_back(0xff123456);
+    vBases.push_back(0);
+    vBases.push_back(0x05000000);
+    for (int i = 0; i < 2000; i++)
+        vBases.push_back(RandCompact());
+
+    BOOST_FOREACH(unsigned int nBase, vBases)
+    {
+        // Accepted blocks never carry a negative nBits, ComputeMaxBits only sees theirs
+        bool fNegative;
+        arith_uint256().SetCompact(nBase, &fNegative);
+        if (fNegative)
+            continue;
+        int64_t nTime = GetRandInt(90 * 24 * 60 * 60) - (GetRandInt(10) ? 0 : 24 * 60 * 60);
+        BOOST_CHECK_EQUAL(ComputeMinWork(nBase, nTime), RefMaxBits(bnProofOfWorkLimit, nBase, nTime));
+        BOOST_CHECK_EQUAL(ComputeMinStake(nBase, nTime, 0), RefMaxBits(bnProofOfStakeLimit, nBase, nTime));
+    }
+}
+
+// The retarget of GetNextTargetRequired as it was with CBigNum
+static unsigned int RefNextTarget(const arith_uint256& bnLimit, unsigned int nBits, int64_t nActualSpacing)
+{
+    CBigNum bnTargetLimit(ArithToUint256(bnLimit));
+    if (nActualSpacing < 0)
+        nActualSpacing = nTargetSpacing;
+    CBigNum bnNew;
+    bnNew.SetCompact(nBits);
+    int64_t nInterval = 60 / nTargetSpacing;
+    bnNew *= ((nInterval - 1) * nTargetSpacing + nActualSpacing + nActualSpacing);
+    bnNew /= ((nInterval + 1) * nTargetSpacing);
+    if (bnNew <= 0 || bnNew > bnTargetLimit)
+        bnNew = bnTargetLimit;
+    return bnNew.GetCompact();
+}
+
+BOOST_AUTO_TEST_CASE(arith_uint256_next_target)
+{
+    // Genesis, then the two blocks the retarget looks at
+    CBlockIndex blocks[3];
+    blocks[1].pprev = &blocks[0];
+    blocks[2].pprev = &blocks[1];
+
+    unsigned int nLimit = bnProofOfWorkLimit.GetCompact();
+    for (int i = 0; i < 4000; i++)
+    {
+        bool fProofOfStake = GetRandInt(2);
+        for (int j = 0; j < 3; j++)
+            blocks[j].nFlags = fProofOfStake ? CBlockIndex::BLOCK_PROOF_OF_STAKE : 0;
+
+        // Mostly sane targets, then the limit, above it, past 256 bits and negative ones
+        unsigned int nBits;
+        switch (GetRandInt(8))
+        {
+        case 0: nBits = nLimit; break;
+        case 1: nBits = nLimit + 1 + GetRandInt(0x02000000); break;
+        case 2: nBits = 0xff000000 | GetRandInt(0x01000000); break;
+        case 3: nBits = (GetRandInt(0x22) << 24) | 0x00800000 | GetRandInt(0x00800000); break;
+        default: nBits = ((0x10 + GetRandInt(0x0e)) << 24) | GetRandInt(0x00800000); break;
+        }
+        blocks[2].nBits = nBits;
+
+        // Spacing from far behind the previous block to days after it
+        blocks[1].nTime = 1500000000 + GetRandInt(1000000);
+        int nSpacing = GetRandInt(5) ? GetRandInt(600) : GetRandInt(10 * 24 * 60 * 60) - 5 * 24 * 60 * 60;
+        blocks[2].nTime = blocks[1].nTime + nSpacing;
+
+        const arith_uint256& bnLimit = fProofOfStake ? bnProofOfStakeLimit : bnProofOfWorkLimit;
+        BOOST_CHECK_EQUAL(GetNextTargetRequired(&blocks[2], fProofOfStake), RefNextTarget(bnLimit, nBits, nSpacing));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
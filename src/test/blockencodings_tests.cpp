@@ -0,0 +1,65 @@
+#include <boost/test/unit_test.hpp>
+
+#include "blockencodings.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(blockencodings_tests)
+
+static CTransaction RandTx()
+{
+    CTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1 + GetRandInt(1000000);
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(compact_block_roundtrip)
+{
+    CBlock block;
+    block.vtx.resize(1);
+    block.vtx[0].vin.resize(1);
+    block.vtx[0].vin[0].prevout.SetNull();
+    block.vtx[0].vout.resize(1);
+    for (int i = 0; i < 4; i++)
+        block.vtx.push_back(RandTx());
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockHeaderAndShortTxIDs cmpctblock(block);
+    BOOST_CHECK_EQUAL(cmpctblock.vPrefilledTxn.size(), 1U);
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), block.vtx.size());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cmpctblock;
+    CBlockHeaderAndShortTxIDs cmpctblock2;
+    ss >> cmpctblock2;
+
+    // The mempool holds all but the third transaction
+    CTxMemPool pool;
+    for (unsigned int i = 1; i < block.vtx.size(); i++)
+        if (i != 3)
+            pool.addUnchecked(block.vtx[i].GetHash(), block.vtx[i]);
+
+    CPartialBlock partial;
+    BOOST_CHECK(partial.Init(cmpctblock2, pool) == READ_STATUS_OK);
+    std::vector<unsigned int> vIndexes;
+    partial.GetMissing(vIndexes);
+    BOOST_CHECK_EQUAL(vIndexes.size(), 1U);
+    BOOST_CHECK_EQUAL(vIndexes[0], 3U);
+
+    BOOST_CHECK(partial.Fill(std::vector<CTransaction>()) == READ_STATUS_INVALID);
+    CPartialBlock partial2;
+    partial2.Init(cmpctblock2, pool);
+    BOOST_CHECK(partial2.Fill(std::vector<CTransaction>(1, block.vtx[3])) == READ_STATUS_OK);
+    BOOST_CHECK(partial2.block.BuildMerkleTree() == block.hashMerkleRoot);
+    BOOST_CHECK(partial2.block.GetHash() == block.GetHash());
+
+    // No transactions in the header, and prefilled indexes must be in range
+    CBlockHeaderAndShortTxIDs bad(cmpctblock2);
+    bad.vPrefilledTxn[0].nIndex = block.vtx.size();
+    BOOST_CHECK(CPartialBlock().Init(bad, pool) == READ_STATUS_INVALID);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
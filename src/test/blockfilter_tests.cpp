@@ -0,0 +1,96 @@
+#include <boost/test/unit_test.hpp>
+
+#include "blockfilter.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(blockfilter_tests)
+
+static GCSElement RandElement()
+{
+    GCSElement element(20 + GetRandInt(20));
+    for (unsigned int i = 0; i < element.size(); i++)
+        element[i] = insecure_rand();
+    return element;
+}
+
+static GCSElementSet Single(const GCSElement& element)
+{
+    GCSElementSet setElements;
+    setElements.insert(element);
+    return setElements;
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_bip158_vectors)
+{
+    // BIP158 test vector: testnet genesis block, whose only element is the
+    // script of its coinbase output
+    uint256 hashGenesis;
+    hashGenesis.SetHex("000000000933ea01ad0ee984209779baaec3ced90fa3f408719526f8d77f4943");
+    GCSElementSet setGenesis = Single(ParseHex("4104678afdb0fe5548271967f1a67130b7105cd6a828e03909a67962e0ea1f61deb649f6bc3f4cef38c4f35504e51ec112de5c384df7ba0b8d578a4c702b6bf11d5fac"));
+    CBlockFilter filter(hashGenesis, setGenesis);
+    BOOST_CHECK_EQUAL(HexStr(filter.GetEncoded()), "019dfca8");
+    BOOST_CHECK(filter.MatchAny(setGenesis));
+
+    // A block without filtered scripts encodes as N = 0 and matches nothing
+    CBlockFilter empty(hashGenesis, GCSElementSet());
+    BOOST_CHECK_EQUAL(HexStr(empty.GetEncoded()), "00");
+    BOOST_CHECK(!empty.MatchAny(setGenesis));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_roundtrip)
+{
+    unsigned int nSizes[] = {1, 2, 10, 100, 1000};
+    for (unsigned int n = 0; n < sizeof(nSizes) / sizeof(nSizes[0]); n++)
+    {
+        GCSElementSet setElements;
+        while (setElements.size() < nSizes[n])
+            setElements.insert(RandElement());
+
+        CBlockFilter filter(GetRandHash(), setElements);
+        BOOST_CHECK_EQUAL(filter.nElements, nSizes[n]);
+        BOOST_CHECK(filter.MatchAny(setElements));
+
+        // Every element decodes back out of the filter
+        for (const GCSElement& element : setElements)
+            BOOST_CHECK(filter.MatchAny(Single(element)));
+
+        // A quotient of about one bit and P remainder bits per element
+        BOOST_CHECK(filter.vchFilter.size() <= (nSizes[n] * (BLOCK_FILTER_P + 3) + 7) / 8);
+
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << filter;
+        CBlockFilter filter2;
+        ss >> filter2;
+        BOOST_CHECK(filter2.hashBlock == filter.hashBlock);
+        BOOST_CHECK(filter2.vchFilter == filter.vchFilter);
+        BOOST_CHECK(filter2.MatchAny(setElements));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_false_positives)
+{
+    GCSElementSet setElements;
+    while (setElements.size() < 100)
+        setElements.insert(RandElement());
+    CBlockFilter filter(GetRandHash(), setElements);
+
+    // One in BLOCK_FILTER_M queries matches by chance, 0.13 expected here
+    int nQueries = 100000;
+    int nFalsePositives = 0;
+    for (int i = 0; i < nQueries; i++)
+    {
+        GCSElement element = RandElement();
+        if (!setElements.count(element) && filter.MatchAny(Single(element)))
+            nFalsePositives++;
+    }
+    BOOST_CHECK(nFalsePositives <= 5);
+
+    // A query set matches when any of its elements is in the filter
+    GCSElementSet setQuery;
+    while (setQuery.size() < 50)
+        setQuery.insert(RandElement());
+    setQuery.insert(*setElements.begin());
+    BOOST_CHECK(filter.MatchAny(setQuery));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
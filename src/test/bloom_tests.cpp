@@ -0,0 +1,43 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bloom.h"
+#include "util.h"
+
+BOOST_AUTO_TEST_SUITE(bloom_tests)
+
+BOOST_AUTO_TEST_CASE(rolling_bloom)
+{
+    // Holds at least the last 100 inserted, at about 1% false positives
+    CRollingBloomFilter rb(100, 0.01);
+    std::vector<uint256> vInserted;
+    for (int i = 0; i < 399; i++)
+    {
+        vInserted.push_back(GetRandHash());
+        rb.insert(vInserted.back());
+    }
+    for (int i = 299; i < 399; i++)
+        BOOST_CHECK(rb.contains(vInserted[i]));
+
+    // Older ones are forgotten a generation at a time
+    unsigned int nOld = 0;
+    for (int i = 0; i < 100; i++)
+        if (rb.contains(vInserted[i]))
+            nOld++;
+    BOOST_CHECK(nOld < 10);
+
+    unsigned int nFalsePositives = 0;
+    for (int i = 0; i < 10000; i++)
+        if (rb.contains(GetRandHash()))
+            nFalsePositives++;
+    BOOST_CHECK(nFalsePositives < 200);
+
+    // Reset forgets everything, but for false positives
+    rb.reset();
+    unsigned int nAfterReset = 0;
+    for (int i = 0; i < 399; i++)
+        if (rb.contains(vInserted[i]))
+            nAfterReset++;
+    BOOST_CHECK(nAfterReset < 20);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
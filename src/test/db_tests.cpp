@@ -0,0 +1,157 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include "db.h"
+#include "util.h"
+
+// CDB keeps its accessors for the database classes built on it
+class CTestDB : public CDB
+{
+public:
+    CTestDB(const std::string& strFile, const char* pszMode) : CDB(strFile.c_str(), pszMode) {}
+
+    using CDB::Read;
+    using CDB::Write;
+    using CDB::Erase;
+    using CDB::Exists;
+    using CDB::GetCursor;
+};
+
+static std::string LevelDBTestFile(const char* pszName)
+{
+    std::string strFile = strprintf("%s_%s.dat", pszName, GetRandHash().ToString().substr(0, 8).c_str());
+    bitdb.UseLevelDB(strFile);
+    return strFile;
+}
+
+static void RemoveLevelDBTestFile(const std::string& strFile)
+{
+    bitdb.CloseLevelDB(strFile);
+    boost::filesystem::remove_all(bitdb.GetLevelDBPath(strFile));
+}
+
+BOOST_AUTO_TEST_SUITE(db_tests)
+
+BOOST_AUTO_TEST_CASE(leveldb_read_write)
+{
+    std::string strFile = LevelDBTestFile("dbtest_rw");
+    {
+        CTestDB db(strFile, "cr+");
+        int nValue = 0;
+        BOOST_CHECK(db.Exists(std::string("version")));
+
+        // Outside a transaction writes go straight to the store
+        BOOST_CHECK(db.Write(std::string("a"), 1));
+        BOOST_CHECK(!db.Write(std::string("a"), 2, false));
+        BOOST_CHECK(db.Read(std::string("a"), nValue) && nValue == 1);
+        BOOST_CHECK(db.Erase(std::string("a")));
+        BOOST_CHECK(!db.Exists(std::string("a")));
+        BOOST_CHECK(db.Write(std::string("a"), 1));
+
+        // Inside one, reads see the transaction's own writes and erases
+        BOOST_CHECK(db.TxnBegin());
+        BOOST_CHECK(db.Write(std::string("b"), 2));
+        BOOST_CHECK(db.Read(std::string("b"), nValue) && nValue == 2);
+        BOOST_CHECK(db.Erase(std::string("a")));
+        BOOST_CHECK(!db.Exists(std::string("a")));
+        BOOST_CHECK(!db.Read(std::string("a"), nValue));
+        BOOST_CHECK(db.Write(std::string("a"), 3));
+        BOOST_CHECK(db.Read(std::string("a"), nValue) && nValue == 3);
+        BOOST_CHECK(db.TxnAbort());
+
+        // An aborted transaction leaves nothing behind
+        BOOST_CHECK(!db.Exists(std::string("b")));
+        BOOST_CHECK(db.Read(std::string("a"), nValue) && nValue == 1);
+
+        BOOST_CHECK(db.TxnBegin());
+        BOOST_CHECK(db.Write(std::string("b"), 2));
+        BOOST_CHECK(db.Erase(std::string("a")));
+        BOOST_CHECK(db.TxnCommit());
+    }
+    {
+        CTestDB db(strFile, "r");
+        int nValue = 0;
+        BOOST_CHECK(db.Read(std::string("b"), nValue) && nValue == 2);
+        BOOST_CHECK(!db.Exists(std::string("a")));
+    }
+    RemoveLevelDBTestFile(strFile);
+}
+
+BOOST_AUTO_TEST_CASE(leveldb_cursor_del)
+{
+    std::string strFile = LevelDBTestFile("dbtest_cursor");
+    {
+        CTestDB db(strFile, "cr+");
+        BOOST_CHECK(db.Write(std::string("k1"), 1));
+        BOOST_CHECK(db.Write(std::string("k2"), 2));
+        BOOST_CHECK(db.Write(std::string("k3"), 3));
+
+        // Walk everything, deleting k2 under the cursor
+        CDBCursor* pcursor = db.GetCursor();
+        BOOST_REQUIRE(pcursor);
+        int nSum = 0;
+        unsigned int nRecords = 0;
+        while (true)
+        {
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            int ret = db.ReadAtCursor(pcursor, ssKey, ssValue);
+            if (ret == DB_NOTFOUND)
+                break;
+            BOOST_REQUIRE(ret == 0);
+            nRecords++;
+            std::string strKey;
+            ssKey >> strKey;
+            if (strKey == "version")
+                continue;
+            int nValue;
+            ssValue >> nValue;
+            nSum += nValue;
+            if (strKey == "k2")
+                BOOST_CHECK_EQUAL(pcursor->del(0), 0);
+        }
+        pcursor->close();
+        BOOST_CHECK_EQUAL(nRecords, 4U);
+        BOOST_CHECK_EQUAL(nSum, 6);
+
+        BOOST_CHECK(db.Exists(std::string("k1")));
+        BOOST_CHECK(!db.Exists(std::string("k2")));
+        BOOST_CHECK(db.Exists(std::string("k3")));
+    }
+    RemoveLevelDBTestFile(strFile);
+}
+
+BOOST_AUTO_TEST_CASE(leveldb_migrate)
+{
+    std::string strFile = strprintf("dbtest_migrate_%s.dat", GetRandHash().ToString().substr(0, 8).c_str());
+    {
+        CTestDB db(strFile, "cr+");
+        for (int i = 0; i < 100; i++)
+            BOOST_CHECK(db.Write(std::make_pair(std::string("n"), i), i * i));
+        BOOST_CHECK(db.Write(std::string("name"), std::string("value")));
+    }
+
+    BOOST_REQUIRE(CDB::MigrateToLevelDB(strFile));
+    BOOST_CHECK(boost::filesystem::exists(bitdb.GetLevelDBPath(strFile)));
+    // The Berkeley DB file is kept under a name that marks it stale
+    BOOST_CHECK(!boost::filesystem::exists(GetDataDir() / strFile));
+    BOOST_CHECK(boost::filesystem::exists(bitdb.GetMigratedPath(strFile)));
+
+    bitdb.UseLevelDB(strFile);
+    {
+        CTestDB db(strFile, "r");
+        int nVersion = 0;
+        BOOST_CHECK(db.ReadVersion(nVersion) && nVersion == CLIENT_VERSION);
+        for (int i = 0; i < 100; i++)
+        {
+            int nValue = -1;
+            BOOST_CHECK(db.Read(std::make_pair(std::string("n"), i), nValue) && nValue == i * i);
+        }
+        std::string strValue;
+        BOOST_CHECK(db.Read(std::string("name"), strValue) && strValue == "value");
+    }
+    RemoveLevelDBTestFile(strFile);
+    boost::filesystem::remove(bitdb.GetMigratedPath(strFile));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,42 @@
+#include <boost/test/unit_test.hpp>
+
+#include "sync.h"
+
+BOOST_AUTO_TEST_SUITE(sync_tests)
+
+BOOST_AUTO_TEST_CASE(lockstats_lock2_sites)
+{
+    CCriticalSection cs_first, cs_second;
+    SetLockStats(true, 1);
+    {
+        LOCK2(cs_first, cs_second);
+    }
+    SetLockStats(false, 16);
+
+    std::vector<CLockSiteStats> vStats;
+    GetLockStats(vStats);
+    std::string strSite;
+    unsigned int nFirst = 0, nSecond = 0;
+    for (const CLockSiteStats& stats : vStats)
+    {
+        if (stats.strLock == "cs_first")
+        {
+            nFirst++;
+            strSite = stats.strSite;
+            BOOST_CHECK_EQUAL(stats.nAcquired, 1U);
+        }
+        else if (stats.strLock == "cs_second")
+        {
+            nSecond++;
+            BOOST_CHECK_EQUAL(stats.nAcquired, 1U);
+        }
+    }
+    // One line, two sites, each counted under its own lock
+    BOOST_CHECK_EQUAL(nFirst, 1U);
+    BOOST_CHECK_EQUAL(nSecond, 1U);
+    for (const CLockSiteStats& stats : vStats)
+        if (stats.strLock == "cs_second")
+            BOOST_CHECK_EQUAL(stats.strSite, strSite);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file license.txt or http://www.opensource.org/licenses/mit-license.php.
 
+#include <atomic>
 #include <map>
 
 #include <boost/version.hpp>
@@ -30,15 +31,94 @@ static leveldb::Options GetOptions() {
     int nCacheSizeMB = GetArg("-dbcache", 25);
     options.block_cache = leveldb::NewLRUCache(nCacheSizeMB * 1048576);
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    // A larger memtable means fewer, larger level 0 files while syncing
+    options.write_buffer_size = std::max((int64_t)1, GetArg("-dbwritebuffer", 16)) * 1048576;
+    options.max_open_files = std::max((int64_t)64, GetArg("-dbmaxopenfiles", 1000));
+    options.block_size = std::max((int64_t)1, GetArg("-dbblocksize", 4)) * 1024;
+    options.compression = GetBoolArg("-dbcompression", true) ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     return options;
 }
 
+//
+// Deferred writes
+//
+// During initial block download every connected block used to be committed
+// to LevelDB on its own. Commits are now collected in mapDeferred, which
+// holds the latest value (or erase) per key, and written out as one batch
+// without sync every -dbbatchblocks blocks. Reads check mapDeferred first,
+// and since each flush is atomic the database on disk is always the state
+// after some earlier block, never a partially written one.
+//
+
+static CCriticalSection cs_deferred;
+static std::map<std::string, std::pair<bool, std::string> > mapDeferred; // key -> (erased, value)
+static std::atomic<size_t> nDeferredKeys(0);
+static int nDeferredStartHeight = 0;
+static bool fDeferring = false;
+static CTxDBStats dbstats;
+static std::atomic<bool> fCompacting(false);
+
+class CDeferHandler : public leveldb::WriteBatch::Handler {
+public:
+    uint64_t nBytes;
+
+    CDeferHandler() : nBytes(0) {}
+
+    virtual void Put(const leveldb::Slice& key, const leveldb::Slice& value) {
+        std::pair<bool, std::string>& entry = mapDeferred[key.ToString()];
+        entry.first = false;
+        entry.second.assign(value.data(), value.size());
+        nBytes += key.size() + value.size();
+    }
+
+    virtual void Delete(const leveldb::Slice& key) {
+        std::pair<bool, std::string>& entry = mapDeferred[key.ToString()];
+        entry.first = true;
+        entry.second.clear();
+        nBytes += key.size();
+    }
+};
+
+// Compact the whole key space after initial block download, in slices so
+// that shutdown does not have to wait for one huge manual compaction.
+static void ThreadCompactTxDB(void* parg)
+{
+    RenameThread("denarius-dbcompact");
+
+    leveldb::DB* pdb = txdb;
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<std::string> vBoundaries;
+    leveldb::Iterator* iterator = pdb->NewIterator(leveldb::ReadOptions());
+    unsigned int nKeys = 0;
+    for (iterator->SeekToFirst(); iterator->Valid() && !fShutdown; iterator->Next())
+        if (nKeys++ % 65536 == 0)
+            vBoundaries.push_back(iterator->key().ToString());
+    delete iterator;
+
+    for (unsigned int i = 0; i < vBoundaries.size() && !fShutdown; i++)
+    {
+        leveldb::Slice begin(vBoundaries[i]);
+        if (i + 1 < vBoundaries.size())
+        {
+            leveldb::Slice end(vBoundaries[i + 1]);
+            pdb->CompactRange(&begin, &end);
+        }
+        else
+            pdb->CompactRange(&begin, NULL);
+    }
+
+    printf("ThreadCompactTxDB() : compacted %u keys in %" PRId64"ms%s\n", nKeys, GetTimeMillis() - nStart, fShutdown ? ", interrupted" : "");
+    fCompacting = false;
+}
+
 void init_blockindex(leveldb::Options& options, bool fRemoveOld = false) {
     // First time init.
     filesystem::path directory = GetDataDir() / "txleveldb";
 
     if (fRemoveOld) {
         filesystem::remove_all(directory); // remove directory
+        blockFileCache.Clear();
         unsigned int nFile = 1;
 
         while (true)
@@ -80,7 +160,12 @@ CTxDB::CTxDB(const char* pszMode)
 
     options = GetOptions();
     options.create_if_missing = true; //fCreate
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+
+    {
+        LOCK(cs_deferred);
+        dbstats.nBatchBlocks = std::max((int64_t)0, GetArg("-dbbatchblocks", DEFAULT_DB_BATCH_BLOCKS));
+        dbstats.nBatchBytes = std::max((int64_t)1, GetArg("-dbbatchsize", DEFAULT_DB_BATCH_SIZE)) * 1048576;
+    }
 
     init_blockindex(options); // Init directory
     pdb = txdb;
@@ -122,6 +207,9 @@ CTxDB::CTxDB(const char* pszMode)
 
 void CTxDB::Close()
 {
+    Flush();
+    while (fCompacting)
+        MilliSleep(20);
     delete txdb;
     txdb = pdb = NULL;
     delete options.filter_policy;
@@ -140,8 +228,63 @@ bool CTxDB::TxnBegin()
 }
 
 bool CTxDB::TxnCommit()
+{
+    std::vector<boost::function<void()> > vActions;
+    vActions.swap(vCommitActions);
+    if (!CommitBatch())
+        return false;
+
+    for (unsigned int i = 0; i < vActions.size(); i++)
+        vActions[i]();
+    return true;
+}
+
+bool CTxDB::CommitBatch()
 {
     assert(activeBatch);
+
+    if (dbstats.nBatchBlocks > 0 && IsInitialBlockDownload())
+    {
+        bool fFull;
+        {
+            LOCK(cs_deferred);
+            if (!fDeferring)
+            {
+                fDeferring = true;
+                nDeferredStartHeight = nBestHeight;
+            }
+            CDeferHandler handler;
+            leveldb::Status status = activeBatch->Iterate(&handler);
+            delete activeBatch;
+            activeBatch = NULL;
+            if (!status.ok())
+                return error("CTxDB::TxnCommit() : reading batch failed: %s", status.ToString().c_str());
+
+            nDeferredKeys = mapDeferred.size();
+            dbstats.nDeferredCommits++;
+            dbstats.nDeferredBytes += handler.nBytes;
+            fFull = nBestHeight - nDeferredStartHeight >= (int)dbstats.nBatchBlocks || dbstats.nDeferredBytes >= dbstats.nBatchBytes;
+        }
+        if (fFull)
+            return Flush();
+        return true;
+    }
+
+    if (fDeferring)
+    {
+        // Initial block download is over, go back to committing every block
+        // and tidy up the files it left behind.
+        if (!Flush())
+            return false;
+        {
+            LOCK(cs_deferred);
+            fDeferring = false;
+        }
+        if (GetBoolArg("-dbcompact", true) && !fCompacting.exchange(true))
+            if (!NewThread(ThreadCompactTxDB, NULL))
+                fCompacting = false;
+    }
+
     leveldb::Status status = pdb->Write(leveldb::WriteOptions(), activeBatch);
     delete activeBatch;
     activeBatch = NULL;
@@ -152,6 +295,108 @@ bool CTxDB::TxnCommit()
     return true;
 }
 
+bool CTxDB::Flush()
+{
+    LOCK(cs_deferred);
+    if (mapDeferred.empty())
+        return true;
+
+    int64_t nStart = GetTimeMillis();
+    leveldb::WriteBatch batch;
+    for (std::map<std::string, std::pair<bool, std::string> >::const_iterator mi = mapDeferred.begin(); mi != mapDeferred.end(); ++mi)
+    {
+        if (mi->second.first)
+            batch.Delete(mi->first);
+        else
+            batch.Put(mi->first, mi->second.second);
+    }
+
+    leveldb::WriteOptions options;
+    options.sync = false;
+    leveldb::Status status = txdb->Write(options, &batch);
+    if (!status.ok())
+        return error("CTxDB::Flush() : LevelDB batch commit failure: %s", status.ToString().c_str());
+
+    if (fDebug)
+        printf("CTxDB::Flush() : wrote %u commits, %" PRIszu" keys in %" PRId64"ms\n",
+            dbstats.nDeferredCommits, mapDeferred.size(), GetTimeMillis() - nStart);
+
+    dbstats.nFlushes++;
+    dbstats.nFlushedCommits += dbstats.nDeferredCommits;
+    dbstats.nFlushMillis += GetTimeMillis() - nStart;
+    dbstats.nDeferredCommits = 0;
+    dbstats.nDeferredBytes = 0;
+    mapDeferred.clear();
+    nDeferredKeys = 0;
+    nDeferredStartHeight = nBestHeight;
+    return true;
+}
+
+leveldb::Status CTxDB::Get(const std::string& key, std::string* value)
+{
+    if (nDeferredKeys > 0)
+    {
+        LOCK(cs_deferred);
+        std::map<std::string, std::pair<bool, std::string> >::const_iterator mi = mapDeferred.find(key);
+        if (mi != mapDeferred.end())
+        {
+            if (mi->second.first)
+                return leveldb::Status::NotFound(leveldb::Slice());
+            *value = mi->second.second;
+            return leveldb::Status::OK();
+        }
+    }
+    return pdb->Get(leveldb::ReadOptions(), key, value);
+}
+
+leveldb::Status CTxDB::Put(const std::string& key, const std::string& value)
+{
+    // Must not be overwritten by an older deferred value on the next flush
+    if (nDeferredKeys > 0)
+    {
+        LOCK(cs_deferred);
+        if (!mapDeferred.empty())
+        {
+            CDeferHandler handler;
+            handler.Put(key, value);
+            dbstats.nDeferredBytes += handler.nBytes;
+            nDeferredKeys = mapDeferred.size();
+            return leveldb::Status::OK();
+        }
+    }
+    return pdb->Put(leveldb::WriteOptions(), key, value);
+}
+
+leveldb::Status CTxDB::Delete(const std::string& key)
+{
+    if (nDeferredKeys > 0)
+    {
+        LOCK(cs_deferred);
+        if (!mapDeferred.empty())
+        {
+            CDeferHandler handler;
+            handler.Delete(key);
+            dbstats.nDeferredBytes += handler.nBytes;
+            nDeferredKeys = mapDeferred.size();
+            return leveldb::Status::OK();
+        }
+    }
+    return pdb->Delete(leveldb::WriteOptions(), key);
+}
+
+bool CTxDB::GetProperty(const std::string& strName, std::string& strValue)
+{
+    return pdb && pdb->GetProperty(strName, &strValue);
+}
+
+CTxDBStats CTxDB::GetStats()
+{
+    LOCK(cs_deferred);
+    CTxDBStats stats = dbstats;
+    stats.fCompacting = fCompacting;
+    return stats;
+}
+
 bool CTxDB::WriteKeyImage(ec_point& keyImage, CKeyImageSpent& keyImageSpent)
 {
     return Write(make_pair(string("ki"), keyImage), keyImageSpent);
@@ -253,6 +498,16 @@ bool CTxDB::ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes)
     return Read(make_pair(string("adr"), addrHash), txHashes);
 }
 
+bool CTxDB::ReadBlockFilter(const uint256& hashBlock, CBlockFilter& filter)
+{
+    return Read(make_pair(string("blockfilter"), hashBlock), filter);
+}
+
+bool CTxDB::WriteBlockFilter(const CBlockFilter& filter)
+{
+    return Write(make_pair(string("blockfilter"), filter.hashBlock), filter);
+}
+
 bool CTxDB::ReadTxIndex(uint256 hash, CTxIndex& txindex)
 {
     txindex.SetNull();
@@ -360,7 +615,7 @@ static CBlockIndex *InsertBlockIndex(uint256 hash)
         return NULL;
 
     // Return existing
-    map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(hash);
+    BlockMap::iterator mi = mapBlockIndex.find(hash);
     if (mi != mapBlockIndex.end())
         return (*mi).second;
 
@@ -410,7 +665,6 @@ bool CTxDB::LoadBlockIndex()
         // Construct block index object
         CBlockIndex* pindexNew    = InsertBlockIndex(blockHash);
         pindexNew->pprev          = InsertBlockIndex(diskindex.hashPrev);
-        pindexNew->pnext          = InsertBlockIndex(diskindex.hashNext);
         pindexNew->nFile          = diskindex.nFile;
         pindexNew->nBlockPos      = diskindex.nBlockPos;
         pindexNew->nHeight        = diskindex.nHeight;
@@ -476,6 +730,7 @@ bool CTxDB::LoadBlockIndex()
     if (!mapBlockIndex.count(hashBestChain))
         return error("CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
     pindexBest = mapBlockIndex[hashBestChain];
+    chainActive.SetTip(pindexBest);
     nBestHeight = pindexBest->nHeight;
     nBestChainTrust = pindexBest->nChainTrust;
 
@@ -8,14 +8,39 @@
 
 #include "main.h"
 #include "ringsig.h"
+#include "blockfilter.h"
 
 #include <map>
 #include <string>
 #include <vector>
 
+#include <boost/function.hpp>
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+/** Blocks whose index writes are collected into one batch during initial block download */
+static const unsigned int DEFAULT_DB_BATCH_BLOCKS = 500;
+/** Upper bound of the deferred batch in MB, flushed earlier when reached */
+static const unsigned int DEFAULT_DB_BATCH_SIZE = 64;
+
+/** Chain database configuration and write path counters, see getdbstats */
+class CTxDBStats
+{
+public:
+    unsigned int nBatchBlocks;
+    uint64_t nBatchBytes;
+    unsigned int nDeferredCommits;
+    uint64_t nDeferredBytes;
+    uint64_t nFlushes;
+    uint64_t nFlushedCommits;
+    int64_t nFlushMillis;
+    bool fCompacting;
+
+    CTxDBStats() : nBatchBlocks(0), nBatchBytes(0), nDeferredCommits(0), nDeferredBytes(0),
+        nFlushes(0), nFlushedCommits(0), nFlushMillis(0), fCompacting(false) {}
+};
+
 // Class that provides access to a LevelDB. Note that this class is frequently
 // instantiated on the stack and then destroyed again, so instantiation has to
 // be very cheap. Unfortunately that means, a CTxDB instance is actually just a
@@ -52,12 +77,23 @@ private:
     bool fReadOnly;
     int nVersion;
 
+    // Run after activeBatch has been committed, dropped by TxnAbort.
+    std::vector<boost::function<void()> > vCommitActions;
+
+    bool CommitBatch();
+
 protected:
     // Returns true and sets (value,false) if activeBatch contains the given key
     // or leaves value alone and sets deleted = true if activeBatch contains a
     // delete for it.
     bool ScanBatch(const CDataStream &key, std::string *value, bool *deleted) const;
 
+    // Single key access to the database that also sees commits which are
+    // still held back in the deferred batch during initial block download.
+    leveldb::Status Get(const std::string& key, std::string* value);
+    leveldb::Status Put(const std::string& key, const std::string& value);
+    leveldb::Status Delete(const std::string& key);
+
     template<typename K, typename T>
     bool Read(const K& key, T& value)
     {
@@ -77,8 +113,7 @@ protected:
             }
         }
         if (readFromDb) {
-            leveldb::Status status = pdb->Get(leveldb::ReadOptions(),
-                                              ssKey.str(), &strValue);
+            leveldb::Status status = Get(ssKey.str(), &strValue);
             if (!status.ok()) {
                 if (status.IsNotFound())
                     return false;
@@ -87,10 +122,10 @@ protected:
                 return false;
             }
         }
-        // Unserialize value
+        // Unserialize value, straight from the string leveldb filled
         try {
-            CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(),
-                                SER_DISK, CLIENT_VERSION);
+            CBufferReader ssValue(strValue.data(), strValue.data() + strValue.size(),
+                                  SER_DISK, CLIENT_VERSION);
             ssValue >> value;
         }
         catch (std::exception &e) {
@@ -116,7 +151,7 @@ protected:
             activeBatch->Put(ssKey.str(), ssValue.str());
             return true;
         }
-        leveldb::Status status = pdb->Put(leveldb::WriteOptions(), ssKey.str(), ssValue.str());
+        leveldb::Status status = Put(ssKey.str(), ssValue.str());
         if (!status.ok()) {
             printf("LevelDB write failure: %s\n", status.ToString().c_str());
             return false;
@@ -139,7 +174,7 @@ protected:
             activeBatch->Delete(ssKey.str());
             return true;
         }
-        leveldb::Status status = pdb->Delete(leveldb::WriteOptions(), ssKey.str());
+        leveldb::Status status = Delete(ssKey.str());
         return (status.ok() || status.IsNotFound());
     }
 
@@ -159,7 +194,7 @@ protected:
         }
 
 
-        leveldb::Status status = pdb->Get(leveldb::ReadOptions(), ssKey.str(), &unused);
+        leveldb::Status status = Get(ssKey.str(), &unused);
         return status.IsNotFound() == false;
     }
 
@@ -171,14 +206,38 @@ public:
     {
         delete activeBatch;
         activeBatch = NULL;
+        vCommitActions.clear();
         return true;
     }
 
+    bool IsInTransaction() const
+    {
+        return activeBatch != NULL;
+    }
+
+    // Keeps in-memory indexes in step with the database: fn runs once the
+    // current transaction is committed, or right away outside of one.
+    void OnCommit(const boost::function<void()>& fn)
+    {
+        if (activeBatch)
+            vCommitActions.push_back(fn);
+        else
+            fn();
+    }
+
+    // Callers iterate over the raw database, so deferred writes go to disk first.
     leveldb::DB* GetInstance()
     {
+        Flush();
         return pdb;
     }
 
+    // Write out index changes that are held back during initial block download
+    bool Flush();
+
+    bool GetProperty(const std::string& strName, std::string& strValue);
+    static CTxDBStats GetStats();
+
     bool ReadVersion(int& nVersion)
     {
         nVersion = 0;
@@ -200,6 +259,8 @@ public:
 
 	bool ReadAddrIndex(uint160 addrHash, std::vector<uint256>& txHashes);
     bool WriteAddrIndex(uint160 addrHash, uint256 txHash);
+    bool ReadBlockFilter(const uint256& hashBlock, CBlockFilter& filter);
+    bool WriteBlockFilter(const CBlockFilter& filter);
     bool ReadTxIndex(uint256 hash, CTxIndex& txindex);
     bool UpdateTxIndex(uint256 hash, const CTxIndex& txindex);
     bool AddTxIndex(const CTransaction& tx, const CDiskTxPos& pos, int nHeight);
@@ -224,6 +285,8 @@ public:
     bool LoadBlockIndex();
 private:
     bool LoadBlockIndexGuts();
+
+    friend class CNameDB;
 };
 
 
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "util.h"
+#include "logging.h"
 #include "sync.h"
 #include "strlcpy.h"
 #include "version.h"
@@ -267,31 +268,16 @@ bool LogAcceptCategory(const char* category)
 {
     if (category != NULL)
     {
-        if (!fDebug)
-            return false;
-
-        // Give each thread quick access to -debug settings.
-        // This helps prevent issues debugging global destructors,
-        // where mapMultiArgs might be deleted before another
-        // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
-        if (ptrCategory.get() == NULL)
-        {
-            const vector<string>& categories = mapMultiArgs["-debug"];
-            ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
-            // thread_specific_ptr automatically deletes the set when the thread ends.
-        }
-        const set<string>& setCategories = *ptrCategory.get();
-
-        // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
-            setCategories.count(string(category)) == 0)
-            return false;
+        // Unknown categories follow -debug
+        uint32_t nCategory;
+        if (!GetLogCategory(category, nCategory))
+            return fDebug;
+        return LogAcceptFlag(nCategory);
     }
     return true;
 }
 
-int LogPrintStr(const std::string &str)
+int LogPrintStr(const std::string &str, const char* category)
 {
     int ret = 0; // Returns total number of characters written
     if (fPrintToConsole)
@@ -299,8 +285,12 @@ int LogPrintStr(const std::string &str)
         // print to console
         ret = fwrite(str.data(), 1, str.size(), stdout);
     }
-    else if (fDebug)
+    else if (fDebug || category != NULL)
     {
+        std::string strQueued(str);
+        if (LogQueue(category, strQueued))
+            return str.size();
+
         static bool fStartedNewLine = false;
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
 
@@ -332,7 +322,7 @@ int LogPrintStr(const std::string &str)
 }
 
 
-inline int OutputDebugStringF(const char* pszFormat, ...)
+int OutputDebugStringF(const char* pszFormat, ...)
 {
     int ret = 0;
     if (fPrintToConsole)
@@ -343,6 +333,20 @@ inline int OutputDebugStringF(const char* pszFormat, ...)
         ret = vprintf(pszFormat, arg_ptr);
         va_end(arg_ptr);
     }
+    else if (!fPrintToDebugger && IsLoggingAsync())
+    {
+        // formatted here, timestamped and written by the log writer thread
+        va_list arg_ptr;
+        va_start(arg_ptr, pszFormat);
+        std::string str = vstrprintf(pszFormat, arg_ptr);
+        va_end(arg_ptr);
+        ret = str.size();
+        if (!LogQueue(NULL, str))
+        {
+            // the writer stopped meanwhile
+            ret = LogPrintStr(str, "");
+        }
+    }
     else if (!fPrintToDebugger)
     {
         // print to debug.log
@@ -138,7 +138,7 @@ bool IsLogOpen();
 /* Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
 /* Send a string to the log output */
-int LogPrintStr(const std::string &str);
+int LogPrintStr(const std::string &str, const char* category = NULL);
 
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
@@ -151,7 +151,7 @@ int LogPrintStr(const std::string &str);
     static inline int LogPrint(const char* category, const char* format, TINYFORMAT_VARARGS(n))  \
     {                                                                                \
         if(!LogAcceptCategory(category)) return 0;                                   \
-        return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)));             \
+        return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)), category);   \
     }                                                                                \
     /*   Log error and return false */                                               \
     template<TINYFORMAT_ARGTYPES(n)>                                                 \
@@ -176,7 +176,7 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
 static inline int LogPrint(const char* category, const char* format)
 {
     if(!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(format);
+    return LogPrintStr(format, category);
 }
 
 
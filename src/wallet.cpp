@@ -1267,61 +1267,46 @@ bool CWalletTx::WriteToDisk()
 // exist in the wallet will be updated.
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
-    int ret = 0;
+    return ScanWalletBlocks(this, pindexStart, fUpdate);
+}
 
-    CBlockIndex* pindex = pindexStart;
+void CWallet::GetScanFilter(CWalletScanFilter& filter) const
+{
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    filter.setIds.insert(setKeys.begin(), setKeys.end());
+    BOOST_FOREACH(const CKeyID& keyID, setKeys)
     {
+        CScript script;
+        script.SetDestination(keyID);
+        AddBlockFilterScript(script, filter.setScripts);
 
-        int dProgressTop;
+        // Coinstakes pay to the public key
+        CPubKey pubkey;
+        if (GetPubKey(keyID, pubkey))
         {
-            LOCK(cs_main);
-            dProgressTop = pindexBest->nHeight;
+            script.clear();
+            script << pubkey << OP_CHECKSIG;
+            AddBlockFilterScript(script, filter.setScripts);
         }
-
-        int dProgressStart = pindex ? pindex->nHeight : 0;
-        int dProgressCurrent = dProgressStart;
-        int dProgressTotal =  dProgressTop - dProgressStart;
-        double dProgressShow = 0;
-        double dProgressShowPrev = 0;
-
-        while (pindex && !fShutdown)
+    }
+    {
+        LOCK(cs_KeyStore);
+        BOOST_FOREACH(const PAIRTYPE(CScriptID, CScript)& item, mapScripts)
         {
-            if (dProgressCurrent > 0)
-                dProgressShow = ((static_cast<double>(dProgressCurrent) / dProgressTop) * 100.0);
-
-            if ((pindex->nHeight % 100 == 0) && (dProgressTotal > 0))
-            {
-                if (dProgressShowPrev != dProgressShow)
-                {
-                    dProgressShowPrev = dProgressShow;
-                    uiInterface.InitMessage(strprintf("%s %d/%d %s... (%.2f%%)",_("Rescanning").c_str(), dProgressCurrent , dProgressTop,_("blocks").c_str(),dProgressShow));
-                }
-            }
-            // no need to read and scan block, if block was created before
-            // our wallet birthday (as adjusted for block time variability)
-            if (nTimeFirstKey && (pindex->nTime < (nTimeFirstKey - 7200))) {
-                pindex = pindex->pnext;
-                continue;
-            }
-
-            CBlock block;
-            block.ReadFromDisk(pindex, true);
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
-            {
-                LOCK(cs_wallet);
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
-            }
-            pindex = pindex->pnext;
-
-            // Update current height for progress
-            if (pindex) dProgressCurrent = pindex->nHeight;
-
+            filter.setIds.insert(item.first);
+            CScript script;
+            script.SetDestination(item.first);
+            AddBlockFilterScript(script, filter.setScripts);
         }
-
-        uiInterface.InitMessage(_("Rescanning complete."));
+        filter.setWatchOnly = setWatchOnly;
+        BOOST_FOREACH(const CScript& script, setWatchOnly)
+            AddBlockFilterScript(script, filter.setScripts);
+    }
+    {
+        LOCK(cs_wallet);
+        filter.fStealth = !stealthAddresses.empty() && !fDisableStealth;
     }
-    return ret;
 }
 
 /*
@@ -1631,6 +1616,43 @@ int64_t CWallet::GetImmatureWatchOnlyBalance() const
     return nTotal;
 }
 
+void CWallet::GetBalances(CWalletBalances& balances) const
+{
+    balances = CWalletBalances();
+    bool fWatchOnly = HaveWatchOnly();
+
+    LOCK2(cs_main, cs_wallet);
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+    {
+        const CWalletTx* pcoin = &(*it).second;
+        bool fTrusted = pcoin->IsTrusted();
+        int nDepth = pcoin->GetDepthInMainChain();
+
+        if (fTrusted && nDepth > 0)
+        {
+            balances.nUnlocked += pcoin->GetUnlockedCredit();
+            balances.nLocked += pcoin->GetLockedCredit();
+            balances.nStakeAmount += pcoin->GetAvailableCredit();
+        }
+        if (!pcoin->IsFinal() || (!fTrusted && nDepth == 0))
+            balances.nUnconfirmed += pcoin->GetAvailableCredit();
+
+        bool fImmature = (pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0 && nDepth > 0;
+        if (fImmature)
+            balances.nImmature += pcoin->GetImmatureCredit();
+
+        if (fWatchOnly)
+        {
+            if (fTrusted)
+                balances.nWatchOnly += pcoin->GetAvailableWatchOnlyCredit();
+            if (!IsFinalTx(*pcoin) || (!fTrusted && nDepth == 0))
+                balances.nWatchUnconfirmed += pcoin->GetAvailableWatchOnlyCredit();
+            if (fImmature)
+                balances.nWatchImmature += pcoin->GetImmatureWatchOnlyCredit();
+        }
+    }
+}
+
 // populate vCoins with vector of spendable COutputs
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl) const
 {
@@ -3709,9 +3731,6 @@ bool CWallet::GetStakeWeight(const CKeyStore& keystore, uint64_t& nMinWeight, ui
 bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, int64_t nFees, CTransaction& txNew, CKey& key)
 {
     CBlockIndex* pindexPrev = pindexBest;
-    CBigNum bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
-
     txNew.vin.clear();
     txNew.vout.clear();
 
@@ -4766,8 +4785,10 @@ void CWallet::UpdatedTransaction(const uint256 &hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end())
+        {
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
-			vMintingWalletUpdated.push_back(hashTx);
+            vMintingWalletUpdated.push_back(hashTx);
+        }
     }
 }
 
@@ -4800,7 +4821,7 @@ void CWallet::GetKeyBirthTimes(std::map<CKeyID, int64_t> &mapKeyBirth) const {
     for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); it++) {
         // iterate over all wallet transactions...
         const CWalletTx &wtx = (*it).second;
-        std::map<uint256, CBlockIndex*>::const_iterator blit = mapBlockIndex.find(wtx.hashBlock);
+        BlockMap::const_iterator blit = mapBlockIndex.find(wtx.hashBlock);
         if (blit != mapBlockIndex.end() && blit->second->IsInMainChain()) {
             // ... which are already in a block
             int nHeight = blit->second->nHeight;
@@ -4865,7 +4886,7 @@ static int GetBlockHeightFromHash(const uint256& blockHash)
     if (blockHash == 0)
         return 0;
 
-    std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(blockHash);
+    BlockMap::iterator mi = mapBlockIndex.find(blockHash);
     if (mi == mapBlockIndex.end())
         return 0;
     return mi->second->nHeight;
@@ -6186,7 +6207,7 @@ int CWallet::ListUnspentAnonOutputs(std::list<COwnedAnonOutput>& lUAnonOutputs,
 {
     CWalletDB walletdb(strWalletFile, "r");
 
-    Dbc* pcursor = walletdb.GetAtCursor();
+    CDBCursor* pcursor = walletdb.GetAtCursor();
     if (!pcursor)
         throw runtime_error("CWallet::ListUnspentAnonOutputs() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -6444,7 +6465,7 @@ int CWallet::CountOwnedAnonOutputs(std::map<int64_t, int>& mOwnedOutputCounts, b
 
     CWalletDB walletdb(strWalletFile, "r");
 
-    Dbc* pcursor = walletdb.GetAtCursor();
+    CDBCursor* pcursor = walletdb.GetAtCursor();
     if (!pcursor)
         throw runtime_error("CWallet::CountOwnedAnonOutputs() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -6551,7 +6572,7 @@ bool CWallet::EraseAllAnonData()
 
 
     walletdb.TxnBegin();
-    Dbc* pcursor = walletdb.GetTxnCursor();
+    CDBCursor* pcursor = walletdb.GetTxnCursor();
 
     if (!pcursor)
         throw runtime_error("EraseAllAnonData() : cannot create DB cursor");
@@ -7429,7 +7450,7 @@ bool CWallet::ProcessLockedAnonOutputs()
 
     CWalletDB walletdb(strWalletFile, "cr+");
     walletdb.TxnBegin();
-    Dbc *pcursor = walletdb.GetTxnCursor();
+    CDBCursor* pcursor = walletdb.GetTxnCursor();
 
     if (!pcursor)
         throw runtime_error(strprintf("%s : cannot create DB cursor.", __func__).c_str());
@@ -21,6 +21,7 @@
 #include "stealth.h"
 #include "smessage.h"
 #include "hooks.h"
+#include "walletscan.h"
 
 static const int NAME_TX_VERSION = 0x0333;
 //static const int NAMECOIN_TX_VERSION = 0x0333; //0x0333 is initial version
@@ -108,6 +109,23 @@ public:
     )
 };
 
+/** The balances shown by the GUI, gathered in a single pass over the wallet */
+class CWalletBalances
+{
+public:
+    int64_t nUnlocked;
+    int64_t nLocked;
+    int64_t nStakeAmount;
+    int64_t nUnconfirmed;
+    int64_t nImmature;
+    int64_t nWatchOnly;
+    int64_t nWatchUnconfirmed;
+    int64_t nWatchImmature;
+
+    CWalletBalances() : nUnlocked(0), nLocked(0), nStakeAmount(0), nUnconfirmed(0), nImmature(0),
+        nWatchOnly(0), nWatchUnconfirmed(0), nWatchImmature(0) {}
+};
+
 /** A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
@@ -292,6 +310,7 @@ public:
     bool EraseFromWallet(uint256 hash);
     void WalletUpdateSpent(const CTransaction& prevout, bool fBlock = false);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    void GetScanFilter(CWalletScanFilter& filter) const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(bool fForce = false);
     int64_t GetBalance() const;
@@ -304,6 +323,7 @@ public:
     int64_t GetWatchOnlyBalance() const;
     int64_t GetUnconfirmedWatchOnlyBalance() const;
     int64_t GetImmatureWatchOnlyBalance() const;
+    void GetBalances(CWalletBalances& balances) const;
 
     int64_t GetStake() const;
     int64_t GetStakeAmount() const;
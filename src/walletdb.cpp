@@ -8,12 +8,17 @@
 #include "key.h"
 #include <boost/version.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace boost;
 
 
 static uint64_t nAccountingEntryNumber = 0;
+/** Transaction records LoadWallet holds before decoding them */
+static const unsigned int WALLET_DECODE_BATCH = 10000;
+/** Fewest transaction records worth a decoding thread */
+static const unsigned int WALLET_DECODE_MIN_RECORDS = 256;
 extern bool fWalletUnlockStakingOnly;
 
 //
@@ -112,7 +117,7 @@ void CWalletDB::ListAccountCreditDebit(const string& strAccount, list<CAccountin
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = GetCursor();
+    CDBCursor* pcursor = GetCursor();
     if (!pcursor)
         throw runtime_error("CWalletDB::ListAccountCreditDebit() : cannot create DB cursor");
     unsigned int fFlags = DB_SET_RANGE;
@@ -242,6 +247,37 @@ public:
     }
 };
 
+// Rest of loading a "tx" record, once the transaction is deserialized and checked
+static void
+LoadWalletTx(CWallet* pwallet, const uint256& hash, CWalletTx& wtx, CDataStream& ssValue,
+             CWalletScanState &wss, string& strErr)
+{
+    wtx.BindWallet(pwallet);
+
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount.c_str(), hash.ToString().c_str());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString().c_str());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        wss.vWalletUpgrade.push_back(hash);
+    }
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, string& strType, string& strErr)
@@ -263,36 +299,12 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             ssKey >> hash;
             CWalletTx& wtx = pwallet->mapWallet[hash];
             ssValue >> wtx;
-            if (wtx.CheckTransaction() && (wtx.GetHash() == hash))
-                wtx.BindWallet(pwallet);
-            else
+            if (!wtx.CheckTransaction() || wtx.GetHash() != hash)
             {
                 pwallet->mapWallet.erase(hash);
                 return false;
             }
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount.c_str(), hash.ToString().c_str());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString().c_str());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
+            LoadWalletTx(pwallet, hash, wtx, ssValue, wss, strErr);
 
             //// debug print
             //printf("LoadWallet  %s\n", wtx.GetHash().ToString().c_str());
@@ -524,6 +536,71 @@ static bool IsKeyType(string strType)
             strType == "mkey" || strType == "ckey");
 }
 
+/** A "tx" record read by LoadWallet, decoded in parallel with the others */
+class CWalletTxRecord
+{
+public:
+    uint256 hash;
+    CWalletTx* pwtx;
+    CDataStream ssValue;
+    bool fValid;
+
+    CWalletTxRecord(const uint256& hashIn, CWalletTx* pwtxIn, const CDataStream& ssValueIn) :
+        hash(hashIn), pwtx(pwtxIn), ssValue(ssValueIn), fValid(false) {}
+};
+
+static bool IsTxRecord(const CDataStream& ssKey)
+{
+    // Serialized string "tx" followed by the hash
+    return ssKey.size() == 3 + sizeof(uint256) && ssKey[0] == 2 && ssKey[1] == 't' && ssKey[2] == 'x';
+}
+
+static void DecodeWalletTxs(vector<CWalletTxRecord>* pvRecords, unsigned int nFirst, unsigned int nStep)
+{
+    for (unsigned int i = nFirst; i < pvRecords->size(); i += nStep)
+    {
+        CWalletTxRecord& record = (*pvRecords)[i];
+        try {
+            record.ssValue >> *record.pwtx;
+            record.fValid = record.pwtx->CheckTransaction() && record.pwtx->GetHash() == record.hash;
+        }
+        catch (...) {
+            record.fValid = false;
+        }
+    }
+}
+
+// Deserializes and checks the transactions on all cores, then adds them to
+// the wallet one by one
+static void LoadWalletTxs(CWallet* pwallet, vector<CWalletTxRecord>& vRecords, CWalletScanState& wss, bool& fNoncriticalErrors)
+{
+    unsigned int nThreads = std::min(boost::thread::hardware_concurrency(), (unsigned int)vRecords.size() / WALLET_DECODE_MIN_RECORDS);
+    nThreads = std::max(nThreads, 1u);
+    boost::thread_group threadGroup;
+    for (unsigned int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&DecodeWalletTxs, &vRecords, i, nThreads));
+    DecodeWalletTxs(&vRecords, 0, nThreads);
+    threadGroup.join_all();
+
+    BOOST_FOREACH(CWalletTxRecord& record, vRecords)
+    {
+        if (!record.fValid)
+        {
+            pwallet->mapWallet.erase(record.hash);
+            fNoncriticalErrors = true;
+            // Rescan if there is a bad transaction record:
+            SoftSetBoolArg("-rescan", true);
+            continue;
+        }
+
+        string strErr;
+        LoadWalletTx(pwallet, record.hash, *record.pwtx, record.ssValue, wss, strErr);
+        if (!strErr.empty())
+            printf("%s\n", strErr.c_str());
+    }
+    vRecords.clear();
+}
+
 DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
 {
     pwallet->vchDefaultKey = CPubKey();
@@ -542,18 +619,20 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             printf("Error getting wallet database cursor\n");
             return DB_CORRUPT;
         }
 
+        vector<CWalletTxRecord> vTxRecords;
+        vTxRecords.reserve(WALLET_DECODE_BATCH);
         while (true)
         {
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
             int ret = ReadAtCursor(pcursor, ssKey, ssValue);
             if (ret == DB_NOTFOUND)
                 break;
@@ -563,6 +642,17 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
+            if (IsTxRecord(ssKey))
+            {
+                string strType;
+                uint256 hash;
+                ssKey >> strType >> hash;
+                vTxRecords.push_back(CWalletTxRecord(hash, &pwallet->mapWallet[hash], ssValue));
+                if (vTxRecords.size() >= WALLET_DECODE_BATCH)
+                    LoadWalletTxs(pwallet, vTxRecords, wss, fNoncriticalErrors);
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
@@ -584,6 +674,9 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 printf("%s\n", strErr.c_str());
         }
         pcursor->close();
+
+        if (!vTxRecords.empty())
+            LoadWalletTxs(pwallet, vTxRecords, wss, fNoncriticalErrors);
     }
     catch (...)
     {
@@ -641,7 +734,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash)
         }
 
         // Get cursor
-        Dbc* pcursor = GetCursor();
+        CDBCursor* pcursor = GetCursor();
         if (!pcursor)
         {
             printf("Error getting wallet database cursor\n");
@@ -652,7 +745,7 @@ DBErrors CWalletDB::FindWalletTx(CWallet* pwallet, vector<uint256>& vTxHash)
         {
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            CSecureDataStream ssValue(SER_DISK, CLIENT_VERSION);
             int ret = ReadAtCursor(pcursor, ssKey, ssValue);
             if (ret == DB_NOTFOUND)
                 break;
@@ -764,7 +857,15 @@ void ThreadFlushWalletDB(void* parg)
                 if (nRefCount == 0 && !fShutdown)
                 {
                     map<string, int>::iterator mi = bitdb.mapFileUseCount.find(strFile);
-                    if (mi != bitdb.mapFileUseCount.end())
+                    if (mi != bitdb.mapFileUseCount.end() && bitdb.IsLevelDB(strFile))
+                    {
+                        // Only the log needs syncing, the handle stays open
+                        nLastFlushed = nWalletDBUpdated;
+                        int64_t nStart = GetTimeMillis();
+                        bitdb.SyncLevelDB(strFile);
+                        printf("Synced wallet store %" PRId64"ms\n", GetTimeMillis() - nStart);
+                    }
+                    else if (mi != bitdb.mapFileUseCount.end())
                     {
                         printf("Flushing wallet.dat\n");
                         nLastFlushed = nWalletDBUpdated;
@@ -793,6 +894,18 @@ bool BackupWallet(const CWallet& wallet, const string& strDest)
             LOCK(bitdb.cs_db);
             if (!bitdb.mapFileUseCount.count(wallet.strWalletFile) || bitdb.mapFileUseCount[wallet.strWalletFile] == 0)
             {
+                if (bitdb.IsLevelDB(wallet.strWalletFile))
+                {
+                    // Copy the records into a new store
+                    filesystem::path pathDest(strDest);
+                    if (filesystem::is_directory(pathDest))
+                        pathDest /= bitdb.GetLevelDBPath(wallet.strWalletFile).filename();
+                    if (!bitdb.BackupLevelDB(wallet.strWalletFile, pathDest))
+                        return false;
+                    printf("copied wallet store to %s\n", pathDest.string().c_str());
+                    return true;
+                }
+
                 // Flush log data to the dat file
                 bitdb.CloseDb(wallet.strWalletFile);
                 bitdb.CheckpointLSN(wallet.strWalletFile);
@@ -879,7 +992,7 @@ bool CWalletDB::Recover(CDBEnv& dbenv, std::string filename, bool fOnlyKeys)
         if (fOnlyKeys)
         {
             CDataStream ssKey(row.first, SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(row.second, SER_DISK, CLIENT_VERSION);
+            CSecureDataStream ssValue((const char*)row.second.data(), (const char*)row.second.data() + row.second.size(), SER_DISK, CLIENT_VERSION);
             string strType, strErr;
             bool fReadOK = ReadKeyValue(&dummyWallet, ssKey, ssValue,
                                         wss, strType, strErr);
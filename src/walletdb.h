@@ -113,6 +113,39 @@ public:
     )
 };
 
+// Inclusion proof of an item anchored by a batched Jupiter POD transaction,
+// stored in walletdb, key is the leaf hash of the item
+class CJupiterProof
+{
+public:
+    int nVersion;
+    std::string strItem;    // "ipfs:<cid>" or "sha256:<file digest>"
+    uint256 hashRoot;
+    uint256 txid;
+    int nIndex;
+    std::vector<uint256> vMerkleBranch;
+    int64_t nTime;
+
+    CJupiterProof()
+    {
+        nVersion = 0;
+        hashRoot = 0;
+        txid = 0;
+        nIndex = -1;
+        nTime = 0;
+    }
+
+    IMPLEMENT_SERIALIZE(
+        READWRITE(nVersion);
+        READWRITE(strItem);
+        READWRITE(hashRoot);
+        READWRITE(txid);
+        READWRITE(nIndex);
+        READWRITE(vMerkleBranch);
+        READWRITE(nTime);
+    )
+};
+
 class CLockedAnonOutput
 {
 // expand key for anon output received with wallet locked
@@ -178,23 +211,25 @@ private:
     CWalletDB(const CWalletDB&);
     void operator=(const CWalletDB&);
 public:
-    Dbc* GetAtCursor()
+    CDBCursor* GetAtCursor()
     {
         return GetCursor();
     }
 
-    Dbc* GetTxnCursor()
+    CDBCursor* GetTxnCursor()
     {
+        if (pldb)
+            return GetCursor(); // deletes go into the active batch
         if (!pdb)
             return NULL;
 
         DbTxn* ptxnid = activeTxn; // call TxnBegin first
 
-        Dbc* pcursor = NULL;
-        int ret = pdb->cursor(ptxnid, &pcursor, 0);
+        Dbc* pdbc = NULL;
+        int ret = pdb->cursor(ptxnid, &pdbc, 0);
         if (ret != 0)
             return NULL;
-        return pcursor;
+        return new CDBCursor(this, pdbc);
     }
 
     DbTxn* GetAtActiveTxn()
@@ -314,6 +349,17 @@ public:
         return Read(std::make_pair(std::string("sxAddr"), sxAddr.scan_pubkey), sxAddr);
     }
 
+    bool WriteJupiterProof(const uint256& hashLeaf, const CJupiterProof& proof)
+    {
+        nWalletDBUpdated++;
+        return Write(std::make_pair(std::string("jpod"), hashLeaf), proof);
+    }
+
+    bool ReadJupiterProof(const uint256& hashLeaf, CJupiterProof& proof)
+    {
+        return Read(std::make_pair(std::string("jpod"), hashLeaf), proof);
+    }
+
 	bool WriteAdrenalineNodeConfig(std::string sAlias, const CAdrenalineNodeConfig& nodeConfig);
     bool ReadAdrenalineNodeConfig(std::string sAlias, CAdrenalineNodeConfig& nodeConfig);
     bool EraseAdrenalineNodeConfig(std::string sAlias);
@@ -0,0 +1,87 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_WALLETJOURNAL_H
+#define BITCOIN_WALLETJOURNAL_H
+
+#include "uint256.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+/** A change to the wallet, queued for the GUI */
+class CWalletDelta
+{
+public:
+    enum Type
+    {
+        TX_ADDED,
+        TX_UPDATED,
+        TX_CONFIRMED,
+        TX_DELETED,
+        BALANCE_CHANGED,    // new best block, hash is unused
+    };
+
+    Type nType;
+    uint256 hash;
+    int nHeight;
+
+    CWalletDelta(Type nTypeIn, const uint256& hashIn, int nHeightIn = 0) : nType(nTypeIn), hash(hashIn), nHeight(nHeightIn) {}
+};
+
+/** Lock-free journal of wallet deltas. Any number of threads may push, deltas
+ *  are taken in batches by a single reader. */
+class CWalletJournal
+{
+public:
+    CWalletJournal() : pHead(NULL) {}
+
+    ~CWalletJournal()
+    {
+        std::vector<CWalletDelta> vDeltas;
+        Drain(vDeltas);
+    }
+
+    /** Returns true if the journal was empty, so the reader may need waking */
+    bool Push(const CWalletDelta& delta)
+    {
+        Node* pnode = new Node(delta, pHead.load(std::memory_order_relaxed));
+        while (!pHead.compare_exchange_weak(pnode->pNext, pnode, std::memory_order_release, std::memory_order_relaxed))
+            ;
+        return pnode->pNext == NULL;
+    }
+
+    /** Appends all queued deltas to vDeltas, oldest first */
+    void Drain(std::vector<CWalletDelta>& vDeltas)
+    {
+        Node* pnode = pHead.exchange(NULL, std::memory_order_acquire);
+        size_t nStart = vDeltas.size();
+        while (pnode)
+        {
+            Node* pnext = pnode->pNext;
+            vDeltas.push_back(pnode->delta);
+            delete pnode;
+            pnode = pnext;
+        }
+        std::reverse(vDeltas.begin() + nStart, vDeltas.end());
+    }
+
+    bool Empty() const { return pHead.load(std::memory_order_acquire) == NULL; }
+
+private:
+    struct Node
+    {
+        CWalletDelta delta;
+        Node* pNext;
+
+        Node(const CWalletDelta& deltaIn, Node* pNextIn) : delta(deltaIn), pNext(pNextIn) {}
+    };
+
+    std::atomic<Node*> pHead;
+
+    CWalletJournal(const CWalletJournal&);
+    CWalletJournal& operator=(const CWalletJournal&);
+};
+
+#endif // BITCOIN_WALLETJOURNAL_H
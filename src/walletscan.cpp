@@ -0,0 +1,299 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "walletscan.h"
+#include "init.h"
+#include "main.h"
+#include "ringsig.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "wallet.h"
+
+#include <boost/thread.hpp>
+
+using namespace std;
+
+static CCriticalSection cs_scanProgress;
+static CWalletScanProgress scanProgress;
+
+bool CWalletScanFilter::MatchScript(const CScript& scriptPubKey) const
+{
+    if (scriptPubKey.empty())
+        return false;
+    if (setWatchOnly.count(scriptPubKey))
+        return true;
+    if (scriptPubKey[0] == OP_RETURN)
+        return fStealth;
+
+    vector<valtype> vSolutions;
+    txnouttype whichType;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return false;
+
+    switch (whichType)
+    {
+    case TX_PUBKEY:
+        return setIds.count(Hash160(vSolutions[0])) > 0;
+    case TX_PUBKEYHASH:
+    case TX_SCRIPTHASH:
+        return setIds.count(uint160(vSolutions[0])) > 0;
+    case TX_MULTISIG:
+        for (unsigned int i = 1; i + 1 < vSolutions.size(); i++)
+            if (setIds.count(Hash160(vSolutions[i])))
+                return true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool CWalletScanFilter::IsCandidate(const CTransaction& tx) const
+{
+    if (tx.nVersion == ANON_TXN_VERSION)
+        return true;
+    BOOST_FOREACH(const CTxOut& txout, tx.vout)
+        if (MatchScript(txout.scriptPubKey))
+            return true;
+    return false;
+}
+
+int64_t CWalletScanProgress::GetETA(int64_t nNow) const
+{
+    if (!fActive || nBlocksDone == 0)
+        return -1;
+    return (nNow - nStartTime) * (int64_t)(nBlocks - nBlocksDone) / nBlocksDone;
+}
+
+void GetWalletScanProgress(CWalletScanProgress& progress)
+{
+    LOCK(cs_scanProgress);
+    progress = scanProgress;
+}
+
+/** A block read and matched by a rescan thread */
+class CScanBlock
+{
+public:
+    int nIndex;     // position in the blocks of the scan, -1 while the slot is being filled
+    bool fRead;
+    bool fSkipped;  // the block filter ruled the block out, it was not read
+    CBlock block;
+    std::vector<bool> vCandidate;
+
+    CScanBlock() : nIndex(-1), fRead(false), fSkipped(false) {}
+};
+
+class CWalletScanner
+{
+public:
+    CWalletScanner(const std::vector<CBlockIndex*>& vBlocksIn, const CWalletScanFilter& filterIn, unsigned int nThreads) :
+        vBlocks(vBlocksIn), filter(filterIn), vSlots(nThreads * WALLET_SCAN_BLOCKS_PER_THREAD),
+        nNextRead(0), nNextApply(0), fStop(false)
+    {
+        for (unsigned int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&CWalletScanner::ThreadRead, this));
+    }
+
+    ~CWalletScanner()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fStop = true;
+        }
+        condApplied.notify_all();
+        threadGroup.join_all();
+    }
+
+    /** Waits for block nIndex to be read */
+    CScanBlock& Get(unsigned int nIndex)
+    {
+        CScanBlock& scan = vSlots[nIndex % vSlots.size()];
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (scan.nIndex != (int)nIndex)
+            condRead.wait(lock);
+        return scan;
+    }
+
+    /** Frees the slot of block nIndex for a block further on */
+    void Release(unsigned int nIndex)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nNextApply = nIndex + 1;
+        }
+        condApplied.notify_all();
+    }
+
+private:
+    const std::vector<CBlockIndex*>& vBlocks;
+    const CWalletScanFilter& filter;
+    std::vector<CScanBlock> vSlots;
+    unsigned int nNextRead;
+    unsigned int nNextApply;
+    bool fStop;
+    boost::mutex mutex;
+    boost::condition_variable condRead;
+    boost::condition_variable condApplied;
+    boost::thread_group threadGroup;
+
+    void ThreadRead()
+    {
+        RenameThread("denarius-rescan");
+
+        CTxDB txdb("r");
+        bool fUseFilters = filter.CanUseBlockFilters();
+
+        while (true)
+        {
+            unsigned int nIndex;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (!fStop && nNextRead < vBlocks.size() && nNextRead >= nNextApply + vSlots.size())
+                    condApplied.wait(lock);
+                if (fStop || nNextRead >= vBlocks.size())
+                    return;
+                nIndex = nNextRead++;
+            }
+
+            // The slot was applied and released before nNextRead got here
+            CScanBlock& scan = vSlots[nIndex % vSlots.size()];
+            scan.block.SetNull();
+            scan.fSkipped = false;
+
+            CBlockFilter blockFilter;
+            if (fUseFilters && txdb.ReadBlockFilter(vBlocks[nIndex]->GetBlockHash(), blockFilter) &&
+                !blockFilter.MatchAny(filter.setScripts))
+            {
+                scan.fSkipped = true;
+                scan.fRead = true;
+            }
+            else
+            {
+                scan.fRead = scan.block.ReadFromDisk(vBlocks[nIndex], true);
+                if (!scan.fRead)
+                    printf("ScanWalletBlocks() : failed to read block %d\n", vBlocks[nIndex]->nHeight);
+            }
+            scan.vCandidate.assign(scan.block.vtx.size(), false);
+            for (unsigned int i = 0; i < scan.block.vtx.size(); i++)
+                scan.vCandidate[i] = filter.IsCandidate(scan.block.vtx[i]);
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                scan.nIndex = nIndex;
+            }
+            condRead.notify_all();
+        }
+    }
+};
+
+// Spends of wallet outputs are found by their inputs, which needs the wallet
+// as it is after the earlier blocks of the scan
+static bool SpendsWalletTx(const CWallet* pwallet, const CTransaction& tx)
+{
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        if (pwallet->mapWallet.count(txin.prevout.hash))
+            return true;
+    return false;
+}
+
+int ScanWalletBlocks(CWallet* pwallet, CBlockIndex* pindexStart, bool fUpdate)
+{
+    int ret = 0;
+
+    // No need to read blocks created before the wallet birthday
+    // (as adjusted for block time variability)
+    vector<CBlockIndex*> vBlocks;
+    int nTop;
+    {
+        LOCK(cs_main);
+        nTop = pindexBest->nHeight;
+        for (CBlockIndex* pindex = pindexStart; pindex; pindex = chainActive.Next(pindex))
+            if (!pwallet->nTimeFirstKey || pindex->nTime >= pwallet->nTimeFirstKey - 7200)
+                vBlocks.push_back(pindex);
+    }
+
+    CWalletScanFilter filter;
+    pwallet->GetScanFilter(filter);
+
+    int nThreads = GetArg("-rescanthreads", 0);
+    if (nThreads <= 0)
+        nThreads = boost::thread::hardware_concurrency();
+    nThreads = std::max(1, std::min(nThreads, (int)vBlocks.size()));
+
+    {
+        LOCK(cs_scanProgress);
+        scanProgress = CWalletScanProgress();
+        scanProgress.fActive = true;
+        scanProgress.nThreads = nThreads;
+        scanProgress.nStartHeight = pindexStart ? pindexStart->nHeight : 0;
+        scanProgress.nEndHeight = nTop;
+        scanProgress.nHeight = scanProgress.nStartHeight;
+        scanProgress.nBlocks = vBlocks.size();
+        scanProgress.nStartTime = GetTime();
+    }
+    printf("ScanWalletBlocks() : %u blocks from height %d on %d threads, %u wallet keys and scripts, block filters %s\n",
+        (unsigned int)vBlocks.size(), pindexStart ? pindexStart->nHeight : 0, nThreads, (unsigned int)filter.setIds.size(),
+        filter.CanUseBlockFilters() ? "used" : "not used");
+
+    if (!vBlocks.empty())
+    {
+        CWalletScanner scanner(vBlocks, filter, nThreads);
+        double dProgressShowPrev = 0;
+        for (unsigned int i = 0; i < vBlocks.size() && !fShutdown; i++)
+        {
+            CScanBlock& scan = scanner.Get(i);
+            unsigned int nCandidates = 0;
+            int nFound = 0;
+            if (scan.fRead)
+            {
+                LOCK(pwallet->cs_wallet);
+                for (unsigned int j = 0; j < scan.block.vtx.size(); j++)
+                {
+                    const CTransaction& tx = scan.block.vtx[j];
+                    if (!scan.vCandidate[j] && !SpendsWalletTx(pwallet, tx) &&
+                        !(fUpdate && pwallet->mapWallet.count(tx.GetHash())))
+                        continue;
+                    nCandidates++;
+                    if (pwallet->AddToWalletIfInvolvingMe(tx, &scan.block, fUpdate))
+                        nFound++;
+                }
+            }
+            bool fSkipped = scan.fSkipped;
+            scanner.Release(i);
+            ret += nFound;
+
+            int nHeight = vBlocks[i]->nHeight;
+            {
+                LOCK(cs_scanProgress);
+                scanProgress.nHeight = nHeight;
+                scanProgress.nBlocksDone = i + 1;
+                if (fSkipped)
+                    scanProgress.nBlocksSkipped++;
+                scanProgress.nCandidates += nCandidates;
+                scanProgress.nFound += nFound;
+            }
+
+            if (nHeight % 100 == 0 && nTop > 0)
+            {
+                double dProgressShow = (static_cast<double>(nHeight) / nTop) * 100.0;
+                if (dProgressShowPrev != dProgressShow)
+                {
+                    dProgressShowPrev = dProgressShow;
+                    uiInterface.InitMessage(strprintf("%s %d/%d %s... (%.2f%%)",_("Rescanning").c_str(), nHeight, nTop, _("blocks").c_str(), dProgressShow));
+                }
+            }
+        }
+    }
+
+    {
+        LOCK(cs_scanProgress);
+        scanProgress.fActive = false;
+        scanProgress.nEndTime = GetTime();
+        printf("ScanWalletBlocks() : %d transactions found in %u candidates, %u blocks skipped by filter, %" PRId64"s\n",
+            scanProgress.nFound, scanProgress.nCandidates, scanProgress.nBlocksSkipped, scanProgress.nEndTime - scanProgress.nStartTime);
+    }
+
+    uiInterface.InitMessage(_("Rescanning complete."));
+    return ret;
+}
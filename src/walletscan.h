@@ -0,0 +1,83 @@
+// Copyright (c) 2020 The Denarius developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef BITCOIN_WALLETSCAN_H
+#define BITCOIN_WALLETSCAN_H
+
+#include "blockfilter.h"
+#include "script.h"
+#include "uint256.h"
+
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+class CBlockIndex;
+class CTransaction;
+class CWallet;
+
+/** Blocks each rescan thread may read ahead of the block being applied */
+static const unsigned int WALLET_SCAN_BLOCKS_PER_THREAD = 16;
+
+/** Key and script ids are hashes already, 64 bits of them make the bucket hash */
+struct KeyIdHasher
+{
+    size_t operator()(const uint160& id) const { return id.Get64(); }
+};
+
+/** The keys, scripts and watch-only scripts of a wallet, taken once per
+ *  rescan so that the read threads can match outputs without locking the
+ *  wallet. Matching is a superset of IsMine(): a candidate still goes through
+ *  AddToWalletIfInvolvingMe. */
+class CWalletScanFilter
+{
+public:
+    std::unordered_set<uint160, KeyIdHasher> setIds;   // key ids and script ids
+    std::set<CScript> setWatchOnly;
+    GCSElementSet setScripts;   // every output script of the wallet, matched against block filters
+    bool fStealth;      // the wallet has stealth addresses, outputs behind OP_RETURN may be ours
+
+    CWalletScanFilter() : fStealth(false) {}
+
+    bool IsCandidate(const CTransaction& tx) const;
+
+    /** Stealth outputs are not in the block filters, such wallets read every block */
+    bool CanUseBlockFilters() const { return !fStealth && fBlockFilterIndex; }
+
+private:
+    bool MatchScript(const CScript& scriptPubKey) const;
+};
+
+/** State of the running or last wallet rescan, for getrescaninfo */
+class CWalletScanProgress
+{
+public:
+    bool fActive;
+    unsigned int nThreads;
+    int nStartHeight;
+    int nEndHeight;
+    int nHeight;            // last block applied
+    unsigned int nBlocks;   // blocks to scan, after the wallet birthday
+    unsigned int nBlocksDone;
+    unsigned int nBlocksSkipped;    // blocks whose filter did not match
+    unsigned int nCandidates;
+    int nFound;
+    int64_t nStartTime;
+    int64_t nEndTime;
+
+    CWalletScanProgress() : fActive(false), nThreads(0), nStartHeight(0), nEndHeight(0), nHeight(0),
+        nBlocks(0), nBlocksDone(0), nBlocksSkipped(0), nCandidates(0), nFound(0), nStartTime(0), nEndTime(0) {}
+
+    /** Seconds left at the rate so far, -1 while unknown */
+    int64_t GetETA(int64_t nNow) const;
+};
+
+void GetWalletScanProgress(CWalletScanProgress& progress);
+
+/** Rescans the main chain from pindexStart. Blocks are read and matched
+ *  against the wallet filter on -rescanthreads threads, candidates are
+ *  applied on the calling thread in chain order. Returns the number of
+ *  transactions added or updated. */
+int ScanWalletBlocks(CWallet* pwallet, CBlockIndex* pindexStart, bool fUpdate);
+
+#endif // BITCOIN_WALLETSCAN_H